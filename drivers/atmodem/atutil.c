@@ -25,12 +25,14 @@
 
 #include <glib.h>
 #include <gatchat.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 #define OFONO_API_SUBJECT_TO_CHANGE
 #include <ofono/log.h>
 #include <ofono/types.h>
+#include <ofono/diagnostics.h>
 
 #include "atutil.h"
 #include "vendor.h"
@@ -614,3 +616,71 @@ void at_util_sim_state_query_free(struct at_util_sim_state_query *req)
 
 	g_free(req);
 }
+
+static void at_util_trace(gboolean in, const unsigned char *data,
+					gsize size, gpointer user_data)
+{
+	const char *prefix = user_data;
+	size_t len = strcspn(prefix, ": ");
+	char tag[16];
+
+	/* "Modem: " is traced as "Modem", an empty prefix as "AT" */
+	if (len == 0)
+		snprintf(tag, sizeof(tag), "AT");
+	else
+		snprintf(tag, sizeof(tag), "%.*s", (int) len, prefix);
+
+	ofono_log_trace(tag, in, data, size);
+}
+
+void at_util_set_trace(GAtChat *chat, const char *prefix)
+{
+	if (ofono_log_trace_enabled() == FALSE)
+		return;
+
+	g_at_chat_set_trace(chat, at_util_trace, (gpointer) prefix);
+}
+
+static void append_urc_count(gpointer key, gpointer value, gpointer user_data)
+{
+	DBusMessageIter *dict = user_data;
+	dbus_uint32_t count = GPOINTER_TO_UINT(value);
+	char *name = g_strconcat("Unsolicited.", key, NULL);
+
+	ofono_dbus_dict_append(dict, name, DBUS_TYPE_UINT32, &count);
+	g_free(name);
+}
+
+void at_util_diagnostics_append(DBusMessageIter *dict, void *user_data)
+{
+	GAtChat *chat = user_data;
+	GAtChatStats stats;
+
+	if (g_at_chat_get_stats(chat, &stats) == FALSE)
+		return;
+
+	ofono_dbus_dict_append(dict, "CommandsSent", DBUS_TYPE_UINT32,
+					&stats.commands_sent);
+	ofono_dbus_dict_append(dict, "RepliesMatched", DBUS_TYPE_UINT32,
+					&stats.replies_matched);
+	ofono_dbus_dict_append(dict, "Unsolicited", DBUS_TYPE_UINT32,
+					&stats.unsolicited);
+	ofono_dbus_dict_append(dict, "QueueDepth", DBUS_TYPE_UINT32,
+					&stats.queue_depth);
+	ofono_dbus_dict_append(dict, "QueueDepthMax", DBUS_TYPE_UINT32,
+					&stats.queue_depth_max);
+	ofono_dbus_dict_append(dict, "BytesIn", DBUS_TYPE_UINT64,
+					&stats.bytes_in);
+	ofono_dbus_dict_append(dict, "BytesOut", DBUS_TYPE_UINT64,
+					&stats.bytes_out);
+	ofono_dbus_dict_append(dict, "ReadBufferMax", DBUS_TYPE_UINT32,
+					&stats.rx_buffer_max);
+	ofono_diagnostics_append_histogram(dict, "QueueTime",
+					stats.queue_time,
+					G_AT_CHAT_STATS_BUCKETS);
+	ofono_diagnostics_append_histogram(dict, "ResponseTime",
+					stats.response_time,
+					G_AT_CHAT_STATS_BUCKETS);
+
+	g_at_chat_foreach_urc_count(chat, append_urc_count, dict);
+}
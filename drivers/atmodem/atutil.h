@@ -83,6 +83,15 @@ struct at_util_sim_state_query *at_util_sim_state_query_new(GAtChat *chat,
 						GDestroyNotify destroy);
 void at_util_sim_state_query_free(struct at_util_sim_state_query *req);
 
+/* Copies raw traffic to the trace file, prefix is the debug prefix */
+void at_util_set_trace(GAtChat *chat, const char *prefix);
+
+struct DBusMessageIter;
+
+/* Diagnostics channel callback, user_data is the GAtChat */
+void at_util_diagnostics_append(struct DBusMessageIter *dict,
+					void *user_data);
+
 struct cb_data {
 	void *cb;
 	void *data;
@@ -44,6 +44,12 @@
 
 #define INDEX_INVALID -1
 
+/*
+ * Number of entries read per AT+CPBR.  Reading the phonebook in windows
+ * lets other commands, e.g. SMS or call control, through in between.
+ */
+#define CPBR_WINDOW_SIZE 50
+
 #define CHARSET_UTF8 1
 #define CHARSET_UCS2 2
 #define CHARSET_IRA  4
@@ -56,6 +62,8 @@ static const char *cpbs_prefix[] = { "+CPBS:", NULL };
 
 struct pb_data {
 	int index_min, index_max;
+	int read_index;
+	guint cpbr_id;
 	char *old_charset;
 	int supported;
 	GAtChat *chat;
@@ -213,6 +221,8 @@ static void export_failed(struct cb_data *cbd)
 	}
 }
 
+static void at_read_window(struct cb_data *cbd);
+
 static void at_read_entries_cb(gboolean ok, GAtResult *result,
 						gpointer user_data)
 {
@@ -220,55 +230,110 @@ static void at_read_entries_cb(gboolean ok, GAtResult *result,
 	struct ofono_phonebook *pb = cbd->user;
 	struct pb_data *pbd = ofono_phonebook_get_data(pb);
 	ofono_phonebook_cb_t cb = cbd->cb;
-	const char *charset;
 	struct ofono_error error;
-	char buf[32];
+
+	pbd->cpbr_id = 0;
 
 	decode_at_error(&error, g_at_result_final_response(result));
-	cb(&error, cbd->data);
-	g_free(cbd);
 
-	charset = best_charset(pbd->supported);
+	/* A window without any entries is reported as "not found" */
+	if (error.type == OFONO_ERROR_TYPE_CME && error.error == 22) {
+		error.type = OFONO_ERROR_TYPE_NO_ERROR;
+		error.error = 0;
+	}
 
-	if (strcmp(pbd->old_charset, charset)) {
-		snprintf(buf, sizeof(buf), "AT+CSCS=\"%s\"", pbd->old_charset);
-		g_at_chat_send(pbd->chat, buf, none_prefix, NULL, NULL, NULL);
+	if (error.type == OFONO_ERROR_TYPE_NO_ERROR &&
+			pbd->read_index <= pbd->index_max) {
+		ofono_phonebook_entries_flush(pb);
+		at_read_window(cbd);
+		return;
 	}
 
+	/* The charset restore of the last window is already queued */
+	cb(&error, cbd->data);
+	g_free(cbd);
+
 	g_free(pbd->old_charset);
 	pbd->old_charset = NULL;
 }
 
-static void at_read_entries(struct cb_data *cbd)
+static void at_set_charset_cb(gboolean ok, GAtResult *result,
+						gpointer user_data)
 {
+	struct cb_data *cbd = user_data;
 	struct ofono_phonebook *pb = cbd->user;
 	struct pb_data *pbd = ofono_phonebook_get_data(pb);
-	char buf[32];
 
-	snprintf(buf, sizeof(buf), "AT+CPBR=%d,%d",
-			pbd->index_min, pbd->index_max);
-	if (g_at_chat_send_listing(pbd->chat, buf, cpbr_prefix,
-					at_cpbr_notify, at_read_entries_cb,
-					cbd, NULL) > 0)
+	if (ok)
 		return;
 
+	/* Don't parse the window in the wrong charset */
+	g_at_chat_cancel(pbd->chat, pbd->cpbr_id);
+	pbd->cpbr_id = 0;
+
+	export_failed(cbd);
+}
+
+/*
+ * Each window switches to the charset we parse and back again.  The
+ * three commands are queued together, so other users of the chat, e.g.
+ * USSD with its cached charset, never run while the charset is changed.
+ */
+static void at_read_window(struct cb_data *cbd)
+{
+	struct ofono_phonebook *pb = cbd->user;
+	struct pb_data *pbd = ofono_phonebook_get_data(pb);
+	const char *charset = best_charset(pbd->supported);
+	gboolean switch_charset = strcmp(pbd->old_charset, charset) != 0;
+	guint cscs_id = 0;
+	int last;
+	char buf[32];
+
+	if (switch_charset) {
+		snprintf(buf, sizeof(buf), "AT+CSCS=\"%s\"", charset);
+		cscs_id = g_at_chat_send(pbd->chat, buf, none_prefix,
+						at_set_charset_cb, cbd, NULL);
+		if (cscs_id == 0)
+			goto error;
+	}
+
+	last = MIN(pbd->read_index + CPBR_WINDOW_SIZE - 1, pbd->index_max);
+
+	snprintf(buf, sizeof(buf), "AT+CPBR=%d,%d", pbd->read_index, last);
+	pbd->read_index = last + 1;
+
+	pbd->cpbr_id = g_at_chat_send_listing(pbd->chat, buf, cpbr_prefix,
+						at_cpbr_notify,
+						at_read_entries_cb, cbd, NULL);
+	if (pbd->cpbr_id == 0) {
+		if (cscs_id > 0)
+			g_at_chat_cancel(pbd->chat, cscs_id);
+
+		goto error;
+	}
+
+	if (switch_charset) {
+		snprintf(buf, sizeof(buf), "AT+CSCS=\"%s\"",
+				pbd->old_charset);
+		g_at_chat_send(pbd->chat, buf, none_prefix, NULL, NULL, NULL);
+	}
+
+	return;
+
+error:
 	/* If we get here, then most likely connection to the modem dropped
 	 * and we can't really restore the charset anyway
 	 */
 	export_failed(cbd);
 }
 
-static void at_set_charset_cb(gboolean ok, GAtResult *result,
-						gpointer user_data)
+static void at_read_entries(struct cb_data *cbd)
 {
-	struct cb_data *cbd = user_data;
-
-	if (!ok) {
-		export_failed(cbd);
-		return;
-	}
+	struct ofono_phonebook *pb = cbd->user;
+	struct pb_data *pbd = ofono_phonebook_get_data(pb);
 
-	at_read_entries(cbd);
+	pbd->read_index = pbd->index_min;
+	at_read_window(cbd);
 }
 
 static void at_read_charset_cb(gboolean ok, GAtResult *result,
@@ -279,7 +344,6 @@ static void at_read_charset_cb(gboolean ok, GAtResult *result,
 	struct pb_data *pbd = ofono_phonebook_get_data(pb);
 	GAtResultIter iter;
 	const char *charset;
-	char buf[32];
 
 	if (!ok)
 		goto error;
@@ -293,17 +357,8 @@ static void at_read_charset_cb(gboolean ok, GAtResult *result,
 
 	pbd->old_charset = g_strdup(charset);
 
-	charset = best_charset(pbd->supported);
-
-	if (!strcmp(pbd->old_charset, charset)) {
-		at_read_entries(cbd);
-		return;
-	}
-
-	snprintf(buf, sizeof(buf), "AT+CSCS=\"%s\"", charset);
-	if (g_at_chat_send(pbd->chat, buf, none_prefix,
-				at_set_charset_cb, cbd, NULL) > 0)
-		return;
+	at_read_entries(cbd);
+	return;
 
 error:
 	export_failed(cbd);
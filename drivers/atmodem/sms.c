@@ -73,6 +73,7 @@ struct sms_data {
 	int retries;
 	gboolean expect_sr;
 	gboolean cnma_enabled;
+	int cmms_mode;
 	char *cnma_ack_pdu;
 	int cnma_ack_pdu_len;
 	guint timeout_source;
@@ -219,10 +220,17 @@ static void at_cmgs(struct ofono_sms *sms, const unsigned char *pdu,
 	char buf[512];
 	int len;
 
-	if (mms) {
+	/*
+	 * Mode 1 falls back to 0 on its own once the link times out, so
+	 * it is repeated for every PDU.  Mode 2 holds until changed, which
+	 * saves a command per PDU during long bursts.
+	 */
+	if (mms == 1 || mms != data->cmms_mode) {
 		snprintf(buf, sizeof(buf), "AT+CMMS=%d", mms);
 		g_at_chat_send(data->chat, buf, none_prefix,
 				NULL, NULL, NULL);
+
+		data->cmms_mode = mms == 2 ? 2 : 0;
 	}
 
 	len = snprintf(buf, sizeof(buf), "AT+CMGS=%d\r", tpdu_len);
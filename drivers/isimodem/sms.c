@@ -470,7 +470,7 @@ static gboolean submit_tpdu(GIsiClient *client, const unsigned char *pdu,
 
 	uint8_t msg[] = {
 		SMS_MESSAGE_SEND_REQ,
-		mms,			/* More messages to send */
+		mms ? 1 : 0,		/* More messages to send */
 		SMS_ROUTE_ANY,		/* Use any (default) route */
 		0,			/* Repeated message */
 		0, 0,			/* Filler */
@@ -521,7 +521,7 @@ static gboolean submit_gsm_tpdu(GIsiClient *client, const unsigned char *pdu,
 
 	uint8_t msg[] = {
 		SMS_MESSAGE_SEND_REQ,
-		mms,	/* More messages to send */
+		mms ? 1 : 0,	/* More messages to send */
 		SMS_ROUTE_CS_PREF,
 		0,	/* Repeated message */
 		SMS_SENDER_ANY,
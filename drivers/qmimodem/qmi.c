@@ -33,6 +33,8 @@
 
 #include <glib.h>
 
+#include <ofono/histogram.h>
+
 #include "qmi.h"
 #include "ctl.h"
 
@@ -60,6 +62,7 @@ struct qmi_device {
 	uint8_t version_count;
 	GHashTable *service_list;
 	unsigned int release_users;
+	struct qmi_stats stats;
 };
 
 struct qmi_service {
@@ -94,6 +97,8 @@ struct qmi_request {
 	size_t len;
 	qmi_message_func_t callback;
 	void *user_data;
+	gint64 queued_at;
+	gint64 sent_at;
 };
 
 struct qmi_notify {
@@ -609,6 +614,13 @@ static gboolean can_write_data(GIOChannel *channel, GIOCondition cond,
 	__hexdump('>', req->buf, bytes_written,
 				device->debug_func, device->debug_data);
 
+	req->sent_at = g_get_monotonic_time();
+	device->stats.requests_sent += 1;
+	device->stats.bytes_out += bytes_written;
+	ofono_histogram_add(device->stats.queue_time,
+					QMI_STATS_BUCKETS,
+					req->sent_at - req->queued_at);
+
 	__debug_msg(' ', req->buf, bytes_written,
 				device->debug_func, device->debug_data);
 
@@ -649,9 +661,15 @@ static void __request_submit(struct qmi_device *device,
 				struct qmi_request *req, uint16_t transaction)
 {
 	req->tid = transaction;
+	req->queued_at = g_get_monotonic_time();
 
 	g_queue_push_tail(device->req_queue, req);
 
+	if (g_queue_get_length(device->req_queue) >
+					device->stats.queue_depth_max)
+		device->stats.queue_depth_max =
+				g_queue_get_length(device->req_queue);
+
 	wakeup_writer(device);
 }
 
@@ -678,6 +696,8 @@ static void handle_indication(struct qmi_device *device,
 	struct qmi_result result;
 	unsigned int hash_id;
 
+	device->stats.indications += 1;
+
 	if (service_type == QMI_SERVICE_CONTROL)
 		return;
 
@@ -774,6 +794,13 @@ static void handle_packet(struct qmi_device *device,
 		g_queue_delete_link(device->service_queue, list);
 	}
 
+	device->stats.replies_matched += 1;
+
+	if (req->sent_at)
+		ofono_histogram_add(device->stats.response_time,
+					QMI_STATS_BUCKETS,
+					g_get_monotonic_time() - req->sent_at);
+
 	if (req->callback)
 		req->callback(message, length, data, req->user_data);
 
@@ -799,6 +826,8 @@ static gboolean received_data(GIOChannel *channel, GIOCondition cond,
 	__hexdump('<', buf, bytes_read,
 				device->debug_func, device->debug_data);
 
+	device->stats.bytes_in += bytes_read;
+
 	offset = 0;
 
 	while (offset < bytes_read) {
@@ -962,6 +991,20 @@ void qmi_device_set_close_on_unref(struct qmi_device *device, bool do_close)
 	device->close_on_unref = do_close;
 }
 
+bool qmi_device_get_stats(struct qmi_device *device, struct qmi_stats *stats)
+{
+	if (device == NULL || stats == NULL)
+		return false;
+
+	memcpy(stats, &device->stats, sizeof(*stats));
+
+	stats->queue_depth = g_queue_get_length(device->req_queue) +
+			g_queue_get_length(device->control_queue) +
+			g_queue_get_length(device->service_queue);
+
+	return true;
+}
+
 static const void *tlv_get(const void *data, uint16_t size,
 					uint8_t type, uint16_t *length)
 {
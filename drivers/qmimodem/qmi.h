@@ -67,6 +67,21 @@ typedef void (*qmi_shutdown_func_t)(void *user_data);
 typedef void (*qmi_discover_func_t)(uint8_t count,
 			const struct qmi_version *list, void *user_data);
 
+#define QMI_STATS_BUCKETS 16
+
+/* Time histograms use power of two millisecond buckets */
+struct qmi_stats {
+	uint32_t requests_sent;
+	uint32_t replies_matched;
+	uint32_t indications;
+	uint32_t queue_depth;
+	uint32_t queue_depth_max;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint32_t queue_time[QMI_STATS_BUCKETS];
+	uint32_t response_time[QMI_STATS_BUCKETS];
+};
+
 struct qmi_device *qmi_device_new(int fd);
 
 struct qmi_device *qmi_device_ref(struct qmi_device *device);
@@ -77,6 +92,8 @@ void qmi_device_set_debug(struct qmi_device *device,
 
 void qmi_device_set_close_on_unref(struct qmi_device *device, bool do_close);
 
+bool qmi_device_get_stats(struct qmi_device *device, struct qmi_stats *stats);
+
 bool qmi_device_discover(struct qmi_device *device, qmi_discover_func_t func,
 				void *user_data, qmi_destroy_func_t destroy);
 bool qmi_device_shutdown(struct qmi_device *device, qmi_shutdown_func_t func,
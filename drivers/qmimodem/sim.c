@@ -38,6 +38,8 @@
 #define EF_STATUS_INVALIDATED 0
 #define EF_STATUS_VALID 1
 
+#define QMI_SIM_MAX_PENDING_READS 4
+
 struct sim_data {
 	struct qmi_service *uim;
 	uint32_t event_mask;
@@ -295,6 +297,102 @@ error:
 	g_free(cbd);
 }
 
+static void read_records_cb(struct qmi_result *result, void *user_data)
+{
+	struct cb_data *cbd = user_data;
+	ofono_sim_read_cb_t cb = cbd->cb;
+	const unsigned char *first;
+	const unsigned char *more;
+	unsigned char *content;
+	uint16_t first_len;
+	uint16_t more_len;
+
+	DBG("");
+
+	if (qmi_result_set_error(result, NULL)) {
+		CALLBACK_WITH_FAILURE(cb, NULL, 0, cbd->data);
+		return;
+	}
+
+	first = qmi_result_get(result, 0x11, &first_len);
+	if (!first || first_len < 2) {
+		CALLBACK_WITH_FAILURE(cb, NULL, 0, cbd->data);
+		return;
+	}
+
+	/* Records past the first one are returned in a separate TLV */
+	more = qmi_result_get(result, 0x12, &more_len);
+	if (!more || more_len < 2) {
+		CALLBACK_WITH_SUCCESS(cb, first + 2, first_len - 2, cbd->data);
+		return;
+	}
+
+	content = g_try_malloc(first_len + more_len - 4);
+	if (!content) {
+		CALLBACK_WITH_FAILURE(cb, NULL, 0, cbd->data);
+		return;
+	}
+
+	memcpy(content, first + 2, first_len - 2);
+	memcpy(content + first_len - 2, more + 2, more_len - 2);
+
+	CALLBACK_WITH_SUCCESS(cb, content, first_len + more_len - 4,
+				cbd->data);
+
+	g_free(content);
+}
+
+static void qmi_read_records(struct ofono_sim *sim,
+				int fileid, int record, int count, int length,
+				const unsigned char *path,
+				unsigned int path_len,
+				ofono_sim_read_cb_t cb, void *user_data)
+{
+	struct sim_data *data = ofono_sim_get_data(sim);
+	struct cb_data *cbd = cb_data_new(cb, user_data);
+	unsigned char aid_data[2] = { 0x06, 0x00 };
+	unsigned char read_data[4];
+	unsigned char fileid_data[9];
+	int fileid_len;
+	uint16_t last;
+	struct qmi_param *param;
+
+	DBG("file id 0x%04x records %d-%d", fileid, record,
+						record + count - 1);
+
+	fileid_len = create_fileid_data(data->app_type, fileid,
+						path, path_len, fileid_data);
+	if (fileid_len < 0)
+		goto error;
+
+	read_data[0] = record & 0xff;
+	read_data[1] = (record & 0xff00) >> 8;
+	read_data[2] = length & 0xff;
+	read_data[3] = (length & 0xff00) >> 8;
+
+	param = qmi_param_new();
+	if (!param)
+		goto error;
+
+	qmi_param_append(param, 0x01, sizeof(aid_data), aid_data);
+	qmi_param_append(param, 0x02, fileid_len, fileid_data);
+	qmi_param_append(param, 0x03, sizeof(read_data), read_data);
+
+	last = record + count - 1;
+	qmi_param_append_uint16(param, 0x10, last);
+
+	if (qmi_service_send(data->uim, QMI_UIM_READ_RECORD, param,
+					read_records_cb, cbd, g_free) > 0)
+		return;
+
+	qmi_param_free(param);
+
+error:
+	CALLBACK_WITH_FAILURE(cb, NULL, 0, user_data);
+
+	g_free(cbd);
+}
+
 static void qmi_query_passwd_state(struct ofono_sim *sim,
 				ofono_sim_passwd_cb_t cb, void *user_data)
 {
@@ -403,6 +501,8 @@ static void get_card_status_cb(struct qmi_result *result, void *user_data)
 	}
 
 done:
+	/* UIM requests are independent, let simfs overlap file reads */
+	ofono_sim_set_max_pending_reads(sim, QMI_SIM_MAX_PENDING_READS);
 	ofono_sim_register(sim);
 
 	switch (data->card_state) {
@@ -516,6 +616,7 @@ static struct ofono_sim_driver driver = {
 	.read_file_transparent	= qmi_read_transparent,
 	.read_file_linear	= qmi_read_record,
 	.read_file_cyclic	= qmi_read_record,
+	.read_file_linear_records = qmi_read_records,
 	.query_passwd_state	= qmi_query_passwd_state,
 	.query_pin_retries	= qmi_query_pin_retries,
 };
@@ -32,6 +32,8 @@ typedef void (*GAtDisconnectFunc)(gpointer user_data);
 typedef void (*GAtReceiveFunc)(const unsigned char *data, gsize size,
 							gpointer user_data);
 typedef void (*GAtDebugFunc)(const char *str, gpointer user_data);
+typedef void (*GAtTraceFunc)(gboolean in, const unsigned char *data,
+					gsize size, gpointer user_data);
 typedef void (*GAtSuspendFunc)(gpointer user_data);
 
 #ifdef __cplusplus
@@ -32,8 +32,11 @@
 
 #include <glib.h>
 
+#include <ofono/histogram.h>
+
 #include "ringbuffer.h"
 #include "gatchat.h"
+#include "gatutil.h"
 #include "gatio.h"
 
 /* #define WRITE_SCHEDULER_DEBUG 1 */
@@ -56,6 +59,8 @@ struct at_command {
 	GAtNotifyFunc listing;
 	gpointer user_data;
 	GDestroyNotify notify;
+	gint64 queued_at;
+	gint64 sent_at;
 };
 
 struct at_notify_node {
@@ -73,6 +78,7 @@ typedef gboolean (*node_remove_func)(struct at_notify_node *node,
 struct at_notify {
 	GSList *nodes;
 	gboolean pdu;
+	guint count;
 };
 
 struct at_chat {
@@ -90,6 +96,8 @@ struct at_chat {
 	gboolean suspended;			/* Are we suspended? */
 	GAtDebugFunc debugf;			/* debugging output function */
 	gpointer debug_data;			/* Data to pass to debug func */
+	GAtTraceFunc tracef;			/* raw I/O trace function */
+	gpointer trace_data;			/* Data to pass to trace func */
 	char *pdu_notify;			/* Unsolicited Resp w/ PDU */
 	GSList *response_lines;			/* char * lines of the response */
 	char *wakeup;				/* command sent to wakeup modem */
@@ -103,6 +111,7 @@ struct at_chat {
 	gboolean in_notify;
 	GSList *terminator_list;		/* Non-standard terminator */
 	guint16 terminator_blacklist;		/* Blacklisted terinators */
+	GAtChatStats stats;			/* Channel counters */
 };
 
 struct _GAtChat {
@@ -404,7 +413,10 @@ static gboolean at_chat_match_notify(struct at_chat *chat, char *line)
 		if (!g_str_has_prefix(line, key))
 			continue;
 
+		notify->count += 1;
+
 		if (notify->pdu) {
+			chat->stats.unsolicited += 1;
 			chat->pdu_notify = line;
 
 			if (chat->syntax->set_hint)
@@ -424,6 +436,9 @@ static gboolean at_chat_match_notify(struct at_chat *chat, char *line)
 	chat->in_notify = FALSE;
 
 	if (ret) {
+		/* Once per line, however many prefixes matched it */
+		chat->stats.unsolicited += 1;
+
 		g_slist_free(result.lines);
 		g_free(line);
 
@@ -444,6 +459,13 @@ static void at_chat_finish_command(struct at_chat *p, gboolean ok, char *final)
 
 	p->cmd_bytes_written = 0;
 
+	if (cmd->sent_at) {
+		p->stats.replies_matched += 1;
+		ofono_histogram_add(p->stats.response_time,
+					G_AT_CHAT_STATS_BUCKETS,
+					g_get_monotonic_time() - cmd->sent_at);
+	}
+
 	if (g_queue_peek_head(p->command_queue))
 		chat_wakeup_writer(p);
 
@@ -926,6 +948,16 @@ static gboolean can_write_data(gpointer data)
 	if (chat->wakeup_timer)
 		g_timer_start(chat->wakeup_timer);
 
+	if (chat->cmd_bytes_written >= len && cmd->sent_at == 0) {
+		cmd->sent_at = g_get_monotonic_time();
+		chat->stats.commands_sent += 1;
+
+		if (cmd->queued_at)
+			ofono_histogram_add(chat->stats.queue_time,
+						G_AT_CHAT_STATS_BUCKETS,
+						cmd->sent_at - cmd->queued_at);
+	}
+
 	return FALSE;
 }
 
@@ -955,6 +987,7 @@ static void at_chat_resume(struct at_chat *chat)
 	g_at_io_set_disconnect_function(chat->io, io_disconnect, chat);
 
 	g_at_io_set_debug(chat->io, chat->debugf, chat->debug_data);
+	g_at_io_set_trace(chat->io, chat->tracef, chat->trace_data);
 	g_at_io_set_read_handler(chat->io, new_bytes, chat);
 
 	if (g_queue_get_length(chat->command_queue) > 0)
@@ -1006,6 +1039,18 @@ static gboolean at_chat_set_debug(struct at_chat *chat,
 	return TRUE;
 }
 
+static gboolean at_chat_set_trace(struct at_chat *chat,
+					GAtTraceFunc func, gpointer user_data)
+{
+	chat->tracef = func;
+	chat->trace_data = user_data;
+
+	if (chat->io)
+		g_at_io_set_trace(chat->io, func, user_data);
+
+	return TRUE;
+}
+
 static gboolean at_chat_set_wakeup_command(struct at_chat *chat,
 						const char *cmd,
 						unsigned int timeout,
@@ -1041,9 +1086,15 @@ static guint at_chat_send_common(struct at_chat *chat, guint gid,
 		return 0;
 
 	c->id = chat->next_cmd_id++;
+	c->queued_at = g_get_monotonic_time();
 
 	g_queue_push_tail(chat->command_queue, c);
 
+	if (g_queue_get_length(chat->command_queue) >
+			chat->stats.queue_depth_max)
+		chat->stats.queue_depth_max =
+			g_queue_get_length(chat->command_queue);
+
 	if (g_queue_get_length(chat->command_queue) == 1)
 		chat_wakeup_writer(chat);
 
@@ -1471,6 +1522,53 @@ gboolean g_at_chat_set_debug(GAtChat *chat,
 	return at_chat_set_debug(chat->parent, func, user_data);
 }
 
+gboolean g_at_chat_set_trace(GAtChat *chat,
+				GAtTraceFunc func, gpointer user_data)
+{
+	if (chat == NULL || chat->group != 0)
+		return FALSE;
+
+	return at_chat_set_trace(chat->parent, func, user_data);
+}
+
+gboolean g_at_chat_get_stats(GAtChat *chat, GAtChatStats *stats)
+{
+	struct at_chat *p;
+
+	if (chat == NULL || stats == NULL)
+		return FALSE;
+
+	p = chat->parent;
+
+	memcpy(stats, &p->stats, sizeof(*stats));
+
+	if (p->command_queue)
+		stats->queue_depth = g_queue_get_length(p->command_queue);
+
+	g_at_io_get_counters(p->io, &stats->bytes_in, &stats->bytes_out,
+					&stats->rx_buffer_max);
+
+	return TRUE;
+}
+
+void g_at_chat_foreach_urc_count(GAtChat *chat, GHFunc func,
+					gpointer user_data)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (chat == NULL || chat->parent->notify_list == NULL)
+		return;
+
+	g_hash_table_iter_init(&iter, chat->parent->notify_list);
+
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct at_notify *notify = value;
+
+		func(key, GUINT_TO_POINTER(notify->count), user_data);
+	}
+}
+
 void g_at_chat_add_terminator(GAtChat *chat, char *terminator,
 					int len, gboolean success)
 {
@@ -54,6 +54,27 @@ enum _GAtChatTerminator {
 
 typedef enum _GAtChatTerminator GAtChatTerminator;
 
+#define G_AT_CHAT_STATS_BUCKETS 16
+
+/*!
+ * Counters of a GAtChat channel.  Time histograms use power of two
+ * millisecond buckets, see ofono_histogram_add.
+ */
+struct _GAtChatStats {
+	guint commands_sent;		/* Commands fully written */
+	guint replies_matched;		/* Final responses received */
+	guint unsolicited;		/* URCs delivered to a notifier */
+	guint queue_depth;		/* Commands currently queued */
+	guint queue_depth_max;		/* Queue high-water mark */
+	guint64 bytes_in;
+	guint64 bytes_out;
+	guint rx_buffer_max;		/* Read ring buffer high-water */
+	guint queue_time[G_AT_CHAT_STATS_BUCKETS];
+	guint response_time[G_AT_CHAT_STATS_BUCKETS];
+};
+
+typedef struct _GAtChatStats GAtChatStats;
+
 GAtChat *g_at_chat_new(GIOChannel *channel, GAtSyntax *syntax);
 GAtChat *g_at_chat_new_blocking(GIOChannel *channel, GAtSyntax *syntax);
 
@@ -82,6 +103,25 @@ gboolean g_at_chat_set_disconnect_function(GAtChat *chat,
 gboolean g_at_chat_set_debug(GAtChat *chat,
 				GAtDebugFunc func, gpointer user_data);
 
+/*!
+ * If the function is not NULL, it is called with the raw bytes of every
+ * read/write on the underlying GIOChannel, e.g. to feed a binary trace.
+ */
+gboolean g_at_chat_set_trace(GAtChat *chat,
+				GAtTraceFunc func, gpointer user_data);
+
+/*!
+ * Fill stats with the counters accumulated since the channel was created
+ */
+gboolean g_at_chat_get_stats(GAtChat *chat, GAtChatStats *stats);
+
+/*!
+ * Call func with the prefix and GUINT_TO_POINTER(count) of every registered
+ * unsolicited notification
+ */
+void g_at_chat_foreach_urc_count(GAtChat *chat, GHFunc func,
+					gpointer user_data);
+
 /*!
  * Queue an AT command for execution.  The command contents are given
  * in cmd.  Once the command executes, the callback function given by
@@ -60,6 +60,9 @@ gboolean g_at_io_set_disconnect_function(GAtIO *io,
 			GAtDisconnectFunc disconnect, gpointer user_data);
 
 gboolean g_at_io_set_debug(GAtIO *io, GAtDebugFunc func, gpointer user_data);
+gboolean g_at_io_set_trace(GAtIO *io, GAtTraceFunc func, gpointer user_data);
+void g_at_io_get_counters(GAtIO *io, guint64 *bytes_in, guint64 *bytes_out,
+							guint *rx_max);
 
 #ifdef __cplusplus
 }
@@ -49,10 +49,15 @@ typedef void (*GAtMuxWriteFrame)(GAtMux *mux, guint8 dlc, guint8 control,
  * Refer to Section 5.6 in 27.007
  */
 #define MAX_CHANNELS 61
-#define BITMAP_SIZE 8
 #define MUX_CHANNEL_BUFFER_SIZE 4096
 #define MUX_BUFFER_SIZE 4096
 
+/*
+ * Bytes a DLC may write at once.  Writers write once per dispatch, so
+ * this caps a round and bulk data can't starve the AT channels.
+ */
+#define MUX_WRITE_MAX 1024
+
 struct _GAtMuxChannel
 {
 	GIOChannel channel;
@@ -62,6 +67,8 @@ struct _GAtMuxChannel
 	GSList *sources;
 	gboolean throttled;
 	guint dlc;
+	GAtMuxChannel *ready_next;		/* Next DLC with new data */
+	gboolean ready;				/* Queued on the ready list */
 };
 
 struct _GAtMuxWatch
@@ -81,10 +88,14 @@ struct _GAtMux {
 	GAtDebugFunc debugf;			/* debugging output function */
 	gpointer debug_data;			/* Data to pass to debug func */
 	GAtMuxChannel *dlcs[MAX_CHANNELS];	/* DLCs opened by the MUX */
-	guint8 newdata[BITMAP_SIZE];		/* Channels that got new data */
+	GSList *channels;			/* Open DLCs, in creation order */
+	guint write_rotor;			/* First DLC of next write round */
+	GAtMuxChannel *ready_head;		/* DLCs that got new data */
+	GAtMuxChannel *ready_tail;
 	const GAtMuxDriver *driver;		/* Driver functions */
 	void *driver_data;			/* Driver data */
 	char buf[MUX_BUFFER_SIZE];		/* Buffer on the main mux */
+	int buf_start;				/* Offset of unprocessed data */
 	int buf_used;				/* Bytes of buf being used */
 	gboolean shutdown;
 };
@@ -178,11 +189,56 @@ static void dispatch_sources(GAtMuxChannel *channel, GIOCondition condition)
 	}
 }
 
+static void ready_list_remove(GAtMux *mux, GAtMuxChannel *channel)
+{
+	GAtMuxChannel *prev = NULL;
+	GAtMuxChannel *cur;
+
+	if (channel->ready == FALSE)
+		return;
+
+	for (cur = mux->ready_head; cur; prev = cur, cur = cur->ready_next) {
+		if (cur != channel)
+			continue;
+
+		if (prev)
+			prev->ready_next = cur->ready_next;
+		else
+			mux->ready_head = cur->ready_next;
+
+		if (mux->ready_tail == cur)
+			mux->ready_tail = prev;
+
+		break;
+	}
+
+	channel->ready = FALSE;
+	channel->ready_next = NULL;
+}
+
+static void dispatch_ready(GAtMux *mux)
+{
+	GAtMuxChannel *channel;
+
+	while ((channel = mux->ready_head) != NULL) {
+		mux->ready_head = channel->ready_next;
+
+		if (mux->ready_head == NULL)
+			mux->ready_tail = NULL;
+
+		channel->ready = FALSE;
+		channel->ready_next = NULL;
+
+		debug(mux, "dispatching sources for channel: %p", channel);
+
+		dispatch_sources(channel, G_IO_IN);
+	}
+}
+
 static gboolean received_data(GIOChannel *channel, GIOCondition cond,
 							gpointer data)
 {
 	GAtMux *mux = data;
-	int i;
 	GIOStatus status;
 	gsize bytes_read;
 
@@ -191,36 +247,36 @@ static gboolean received_data(GIOChannel *channel, GIOCondition cond,
 
 	debug(mux, "received data");
 
+	/*
+	 * Leftovers of a partial frame are only moved to the front once
+	 * the end of the buffer is reached, not after every read
+	 */
+	if (mux->buf_start + mux->buf_used == sizeof(mux->buf) &&
+			mux->buf_start > 0) {
+		memmove(mux->buf, mux->buf + mux->buf_start, mux->buf_used);
+		mux->buf_start = 0;
+	}
+
 	bytes_read = 0;
-	status = g_io_channel_read_chars(mux->channel, mux->buf + mux->buf_used,
-					sizeof(mux->buf) - mux->buf_used,
-					&bytes_read, NULL);
+	status = g_io_channel_read_chars(mux->channel,
+			mux->buf + mux->buf_start + mux->buf_used,
+			sizeof(mux->buf) - mux->buf_start - mux->buf_used,
+			&bytes_read, NULL);
 
 	mux->buf_used += bytes_read;
 
 	if (bytes_read > 0 && mux->driver->feed_data) {
 		int nread;
 
-		memset(mux->newdata, 0, BITMAP_SIZE);
-
-		nread = mux->driver->feed_data(mux, mux->buf, mux->buf_used);
+		nread = mux->driver->feed_data(mux, mux->buf + mux->buf_start,
+							mux->buf_used);
 		mux->buf_used -= nread;
+		mux->buf_start += nread;
 
-		if (mux->buf_used > 0)
-			memmove(mux->buf, mux->buf + nread, mux->buf_used);
-
-		for (i = 1; i <= MAX_CHANNELS; i++) {
-			int offset = i / 8;
-			int bit = i % 8;
+		if (mux->buf_used == 0)
+			mux->buf_start = 0;
 
-			if (!(mux->newdata[offset] & (1 << bit)))
-				continue;
-
-			debug(mux, "dispatching sources for channel: %p",
-				mux->dlcs[i-1]);
-
-			dispatch_sources(mux->dlcs[i-1], G_IO_IN);
-		}
+		dispatch_ready(mux);
 	}
 
 	if (cond & (G_IO_HUP | G_IO_ERR))
@@ -242,53 +298,69 @@ static void write_watcher_destroy_notify(gpointer user_data)
 	mux->write_watch = 0;
 }
 
+static gboolean channel_wants_write(GAtMuxChannel *channel)
+{
+	GSList *l;
+
+	if (channel->throttled)
+		return FALSE;
+
+	for (l = channel->sources; l; l = l->next) {
+		GAtMuxWatch *source = l->data;
+
+		if (source->condition & G_IO_OUT)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
 static gboolean can_write_data(GIOChannel *chan, GIOCondition cond,
 				gpointer data)
 {
 	GAtMux *mux = data;
-	int dlc;
+	guint8 order[MAX_CHANNELS];
+	gboolean again = FALSE;
+	GSList *l;
+	guint n;
+	guint i;
 
 	if (cond & (G_IO_NVAL | G_IO_HUP | G_IO_ERR))
 		return FALSE;
 
 	debug(mux, "can write data");
 
-	for (dlc = 0; dlc < MAX_CHANNELS; dlc += 1) {
-		GAtMuxChannel *channel = mux->dlcs[dlc];
+	n = g_slist_length(mux->channels);
+	if (n == 0)
+		return FALSE;
 
-		if (channel == NULL)
-			continue;
+	/*
+	 * Sources may close DLCs, so work from a snapshot of DLC numbers.
+	 * The starting DLC rotates every round so that no channel is
+	 * always served first.
+	 */
+	for (l = mux->channels, i = 0; l; l = l->next, i++)
+		order[i] = ((GAtMuxChannel *) l->data)->dlc;
+
+	mux->write_rotor += 1;
 
-		debug(mux, "checking channel for write: %p", channel);
+	for (i = 0; i < n; i++) {
+		guint8 dlc = order[(mux->write_rotor + i) % n];
+		GAtMuxChannel *channel = mux->dlcs[dlc - 1];
 
-		if (channel->throttled)
+		if (channel == NULL || !channel_wants_write(channel))
 			continue;
 
 		debug(mux, "dispatching write sources: %p", channel);
 
 		dispatch_sources(channel, G_IO_OUT);
-	}
-
-	for (dlc = 0; dlc < MAX_CHANNELS; dlc += 1) {
-		GAtMuxChannel *channel = mux->dlcs[dlc];
-		GSList *l;
-		GAtMuxWatch *source;
-
-		if (channel == NULL)
-			continue;
-
-		if (channel->throttled)
-			continue;
 
-		for (l = channel->sources; l; l = l->next) {
-			source = l->data;
-
-			if (source->condition & G_IO_OUT)
-				return TRUE;
-		}
+		if (mux->dlcs[dlc - 1] == channel &&
+				channel_wants_write(channel))
+			again = TRUE;
 	}
 
-	return FALSE;
+	return again;
 }
 
 static void wakeup_writer(GAtMux *mux)
@@ -320,10 +392,7 @@ void g_at_mux_feed_dlc_data(GAtMux *mux, guint8 dlc,
 				const void *data, int tofeed)
 {
 	GAtMuxChannel *channel;
-
 	int written;
-	int offset;
-	int bit;
 
 	debug(mux, "deliver_data: dlc: %hu", dlc);
 
@@ -340,11 +409,19 @@ void g_at_mux_feed_dlc_data(GAtMux *mux, guint8 dlc,
 	if (written < 0)
 		return;
 
-	offset = dlc / 8;
-	bit = dlc % 8;
-
-	mux->newdata[offset] |= 1 << bit;
 	channel->condition |= G_IO_IN;
+
+	if (channel->ready)
+		return;
+
+	channel->ready = TRUE;
+
+	if (mux->ready_tail)
+		mux->ready_tail->ready_next = channel;
+	else
+		mux->ready_head = channel;
+
+	mux->ready_tail = channel;
 }
 
 void g_at_mux_set_dlc_status(GAtMux *mux, guint8 dlc, int status)
@@ -456,6 +533,13 @@ static GIOStatus channel_write(GIOChannel *channel, const gchar *buf,
 	GAtMuxChannel *mux_channel = (GAtMuxChannel *) channel;
 	GAtMux *mux = mux_channel->mux;
 
+	/*
+	 * A short write makes the writer wait for the next round.  It is
+	 * never empty, GAtIO takes that as a reason to stop writing.
+	 */
+	if (count > MUX_WRITE_MAX)
+		count = MUX_WRITE_MAX;
+
 	if (mux->driver->write)
 		mux->driver->write(mux, mux_channel->dlc, buf, count);
 	*bytes_written = count;
@@ -481,6 +565,8 @@ static GIOStatus channel_close(GIOChannel *channel, GError **err)
 	if (mux->driver->close_dlc)
 		mux->driver->close_dlc(mux, mux_channel->dlc);
 
+	ready_list_remove(mux, mux_channel);
+	mux->channels = g_slist_remove(mux->channels, mux_channel);
 	mux->dlcs[mux_channel->dlc - 1] = NULL;
 
 	return G_IO_STATUS_NORMAL;
@@ -708,6 +794,7 @@ GIOChannel *g_at_mux_create_channel(GAtMux *mux)
 	mux_channel->throttled = FALSE;
 
 	mux->dlcs[i] = mux_channel;
+	mux->channels = g_slist_append(mux->channels, mux_channel);
 
 	debug(mux, "created channel %p, dlc: %d", channel, i+1);
 
@@ -1031,32 +1118,20 @@ static gboolean gsm0710_basic_close_dlc(GAtMux *mux, guint8 dlc)
 	return TRUE;
 }
 
-static int gsm0710_basic_feed_data(GAtMux *mux, void *data, int len)
+static void gsm0710_basic_frame(guint8 dlc, guint8 ctrl,
+					const guint8 *frame, int len,
+					gpointer user_data)
 {
-	int total = 0;
-	int nread;
-	guint8 dlc;
-	guint8 ctrl;
-	guint8 *frame;
-	int frame_len;
-
-	do {
-		frame = NULL;
-		nread = gsm0710_basic_extract_frame(data, len, &dlc, &ctrl,
-							&frame, &frame_len);
-
-		total += nread;
-		data += nread;
-		len -= nread;
-
-		if (frame == NULL)
-			break;
+	GAtMux *mux = user_data;
 
-		gsm0710_packet(mux, dlc, ctrl, frame, frame_len,
-				gsm0710_basic_write_frame);
-	} while (nread > 0);
+	gsm0710_packet(mux, dlc, ctrl, frame, len,
+			gsm0710_basic_write_frame);
+}
 
-	return total;
+static int gsm0710_basic_feed_data(GAtMux *mux, void *data, int len)
+{
+	return gsm0710_basic_extract_frames(data, len,
+					gsm0710_basic_frame, mux);
 }
 
 static void gsm0710_basic_set_status(GAtMux *mux, guint8 dlc, guint8 status)
@@ -1185,32 +1260,20 @@ static gboolean gsm0710_advanced_close_dlc(GAtMux *mux, guint8 dlc)
 	return TRUE;
 }
 
-static int gsm0710_advanced_feed_data(GAtMux *mux, void *data, int len)
+static void gsm0710_advanced_frame(guint8 dlc, guint8 ctrl,
+					const guint8 *frame, int len,
+					gpointer user_data)
 {
-	int total = 0;
-	int nread;
-	guint8 dlc;
-	guint8 ctrl;
-	guint8 *frame;
-	int frame_len;
-
-	do {
-		frame = NULL;
-		nread = gsm0710_advanced_extract_frame(data, len, &dlc, &ctrl,
-							&frame, &frame_len);
-
-		total += nread;
-		data += nread;
-		len -= nread;
-
-		if (frame == NULL)
-			break;
+	GAtMux *mux = user_data;
 
-		gsm0710_packet(mux, dlc, ctrl, frame, frame_len,
-				gsm0710_advanced_write_frame);
-	} while (nread > 0);
+	gsm0710_packet(mux, dlc, ctrl, frame, len,
+			gsm0710_advanced_write_frame);
+}
 
-	return total;
+static int gsm0710_advanced_feed_data(GAtMux *mux, void *data, int len)
+{
+	return gsm0710_advanced_extract_frames(data, len,
+					gsm0710_advanced_frame, mux);
 }
 
 static void gsm0710_advanced_set_status(GAtMux *mux, guint8 dlc, guint8 status)
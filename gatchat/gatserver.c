@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #include <glib.h>
 
@@ -34,8 +35,6 @@
 #include "gatio.h"
 
 #define BUF_SIZE 4096
-/* <cr><lf> + the max length of information text + <cr><lf> */
-#define MAX_TEXT_SIZE 2052
 /* #define WRITE_SCHEDULER_DEBUG 1 */
 
 enum ParserState {
@@ -106,6 +105,14 @@ struct at_command {
 	GDestroyNotify destroy_notify;
 };
 
+/*
+ * Single letter basic commands ("E", "D", ...) and their '&' variants
+ * ("&C", "&D", ...) are also kept in a table indexed by letter, so the
+ * common case needs no hashing.  All other prefixes only live in the
+ * command hash.
+ */
+#define BASIC_COMMANDS 26
+
 struct _GAtServer {
 	gint ref_count;				/* Ref count */
 	struct v250_settings v250;		/* V.250 command setting */
@@ -116,11 +123,14 @@ struct _GAtServer {
 	GAtDebugFunc debugf;			/* Debugging output function */
 	gpointer debug_data;			/* Data to pass to debug func */
 	GHashTable *command_list;		/* List of AT commands */
+	struct at_command *basic[2][BASIC_COMMANDS];	/* X and &X commands */
 	GQueue *write_queue;			/* Write buffer queue */
+	struct ring_buffer *spare_buf;		/* Drained write buffer */
 	guint max_read_attempts;		/* Max reads per select */
 	enum ParserState parser_state;
 	gboolean destroyed;			/* Re-entrancy guard */
 	char *last_line;			/* Last read line */
+	gsize last_line_size;			/* Size of last_line buffer */
 	unsigned int cur_pos;			/* Where we are on the line */
 	GAtServerResult last_result;
 	gboolean final_sent;
@@ -135,7 +145,13 @@ static void server_parse_line(GAtServer *server);
 
 static struct ring_buffer *allocate_next(GAtServer *server)
 {
-	struct ring_buffer *buf = ring_buffer_new(BUF_SIZE);
+	struct ring_buffer *buf = server->spare_buf;
+
+	/* Reuse the last drained buffer if there is one */
+	if (buf != NULL)
+		server->spare_buf = NULL;
+	else
+		buf = ring_buffer_new(BUF_SIZE);
 
 	if (buf == NULL)
 		return NULL;
@@ -145,17 +161,16 @@ static struct ring_buffer *allocate_next(GAtServer *server)
 	return buf;
 }
 
-static void send_common(GAtServer *server, const char *buf, unsigned int len)
+static void queue_bytes(GAtServer *server, const char *buf, gsize len)
 {
-	gsize towrite = len;
 	gsize bytes_written = 0;
 	struct ring_buffer *write_buf;
 
 	write_buf = g_queue_peek_tail(server->write_queue);
 
-	while (bytes_written < towrite) {
+	while (bytes_written < len) {
 		gsize wbytes = MIN((gsize)ring_buffer_avail(write_buf),
-						towrite - bytes_written);
+						len - bytes_written);
 
 		bytes_written += ring_buffer_write(write_buf,
 							buf + bytes_written,
@@ -166,9 +181,29 @@ static void send_common(GAtServer *server, const char *buf, unsigned int len)
 		 * everything out already
 		 */
 		if (ring_buffer_avail(write_buf) == 0 &&
-				bytes_written < towrite)
+				bytes_written < len)
 			write_buf = allocate_next(server);
 	}
+}
+
+/*
+ * Queue the pieces of a response straight into the write buffers, no
+ * intermediate formatting needed.
+ */
+static void send_common_v(GAtServer *server, const struct iovec *iov,
+				int iovcnt)
+{
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		queue_bytes(server, iov[i].iov_base, iov[i].iov_len);
+
+	server_wakeup_writer(server);
+}
+
+static void send_common(GAtServer *server, const char *buf, unsigned int len)
+{
+	queue_bytes(server, buf, len);
 
 	server_wakeup_writer(server);
 }
@@ -176,27 +211,39 @@ static void send_common(GAtServer *server, const char *buf, unsigned int len)
 static void send_result_common(GAtServer *server, const char *result)
 
 {
-	struct v250_settings v250 = server->v250;
-	char buf[MAX_TEXT_SIZE + 1];
-	char t = v250.s3;
-	char r = v250.s4;
-	unsigned int len;
+	struct v250_settings *v250 = &server->v250;
+	struct iovec iov[5];
+	gsize len;
+	int n = 0;
 
-	if (v250.quiet)
+	if (v250->quiet)
 		return;
 
 	if (result == NULL)
 		return;
 
-	if (strlen(result) > 2048)
+	len = strlen(result);
+	if (len > 2048)
 		return;
 
-	if (v250.is_v1)
-		len = sprintf(buf, "%c%c%s%c%c", t, r, result, t, r);
-	else
-		len = sprintf(buf, "%s%c", result, t);
+	if (v250->is_v1) {
+		iov[n].iov_base = &v250->s3;
+		iov[n++].iov_len = 1;
+		iov[n].iov_base = &v250->s4;
+		iov[n++].iov_len = 1;
+	}
+
+	iov[n].iov_base = (char *) result;
+	iov[n++].iov_len = len;
+	iov[n].iov_base = &v250->s3;
+	iov[n++].iov_len = 1;
+
+	if (v250->is_v1) {
+		iov[n].iov_base = &v250->s4;
+		iov[n++].iov_len = 1;
+	}
 
-	send_common(server, buf, len);
+	send_common_v(server, iov, n);
 }
 
 static inline void send_final_common(GAtServer *server, const char *result)
@@ -210,13 +257,14 @@ static inline void send_final_common(GAtServer *server, const char *result)
 
 static inline void send_final_numeric(GAtServer *server, GAtServerResult result)
 {
-	char buf[1024];
+	char buf[16];
 
-	if (server->v250.is_v1)
-		sprintf(buf, "%s", server_result_to_string(result));
-	else
-		sprintf(buf, "%u", (unsigned int)result);
+	if (server->v250.is_v1) {
+		send_final_common(server, server_result_to_string(result));
+		return;
+	}
 
+	sprintf(buf, "%u", (unsigned int)result);
 	send_final_common(server, buf);
 }
 
@@ -260,20 +308,19 @@ void g_at_server_send_unsolicited(GAtServer *server, const char *result)
 
 void g_at_server_send_info(GAtServer *server, const char *line, gboolean last)
 {
-	char buf[MAX_TEXT_SIZE + 1];
-	char t = server->v250.s3;
-	char r = server->v250.s4;
-	unsigned int len;
+	struct iovec iov[5] = {
+		{ &server->v250.s3, 1 },
+		{ &server->v250.s4, 1 },
+		{ (char *) line, 0 },
+		{ &server->v250.s3, 1 },
+		{ &server->v250.s4, 1 },
+	};
 
-	if (strlen(line) > 2048)
+	iov[2].iov_len = strlen(line);
+	if (iov[2].iov_len > 2048)
 		return;
 
-	if (last)
-		len = sprintf(buf, "%c%c%s%c%c", t, r, line, t, r);
-	else
-		len = sprintf(buf, "%c%c%s", t, r, line);
-
-	send_common(server, buf, len);
+	send_common_v(server, iov, last ? 5 : 3);
 }
 
 static gboolean get_result_value(GAtServer *server, GAtResult *result,
@@ -585,25 +632,50 @@ static inline gboolean is_extended_command_prefix(const char c)
 	}
 }
 
+static struct at_command **basic_command_slot(GAtServer *server,
+						const char *prefix)
+{
+	int amp = prefix[0] == '&';
+	char c = prefix[amp];
+
+	if (c < 'A' || c > 'Z' || prefix[amp + 1] != '\0')
+		return NULL;
+
+	return &server->basic[amp][c - 'A'];
+}
+
+static struct at_command *command_lookup(GAtServer *server, const char *prefix)
+{
+	struct at_command **slot = basic_command_slot(server, prefix);
+
+	if (slot != NULL)
+		return *slot;
+
+	return g_hash_table_lookup(server->command_list, prefix);
+}
+
 static void at_command_notify(GAtServer *server, char *command,
 				char *prefix, GAtServerRequestType type)
 {
 	struct at_command *node;
 	GAtResult result;
+	GSList line;
 
-	node = g_hash_table_lookup(server->command_list, prefix);
+	node = command_lookup(server, prefix);
 
 	if (node == NULL) {
 		g_at_server_send_final(server, G_AT_SERVER_RESULT_ERROR);
 		return;
 	}
 
-	result.lines = g_slist_prepend(NULL, command);
+	/* The result only lives for the duration of the callback */
+	line.data = command;
+	line.next = NULL;
+
+	result.lines = &line;
 	result.final_or_pdu = 0;
 
 	node->notify(server, type, &result, node->user_data);
-
-	g_slist_free(result.lines);
 }
 
 static unsigned int parse_extended_command(GAtServer *server, char *buf)
@@ -935,6 +1007,10 @@ out:
 	return res;
 }
 
+/*
+ * The command line is copied into last_line, which is kept around for
+ * A/ and only reallocated when a longer line comes in.
+ */
 static char *extract_line(GAtServer *p, struct ring_buffer *rbuf)
 {
 	unsigned int wrap = ring_buffer_len_no_wrap(rbuf);
@@ -968,12 +1044,22 @@ static char *extract_line(GAtServer *p, struct ring_buffer *rbuf)
 	/* We will strip AT and S3 */
 	line_length -= 3;
 
-	line = g_try_new(char, line_length + 1);
-	if (line == NULL) {
-		ring_buffer_drain(rbuf, p->read_so_far);
-		return NULL;
+	if ((gsize) line_length + 1 > p->last_line_size) {
+		line = g_try_realloc(p->last_line, line_length + 1);
+		if (line == NULL) {
+			g_free(p->last_line);
+			p->last_line = NULL;
+			p->last_line_size = 0;
+			ring_buffer_drain(rbuf, p->read_so_far);
+			return NULL;
+		}
+
+		p->last_line = line;
+		p->last_line_size = line_length + 1;
 	}
 
+	line = p->last_line;
+
 	/* Strip leading whitespace + AT */
 	ring_buffer_drain(rbuf, strip_front + 2);
 
@@ -1055,12 +1141,9 @@ static void new_bytes(struct ring_buffer *rbuf, gpointer user_data)
 
 		case PARSER_RESULT_COMMAND:
 		{
-			g_free(p->last_line);
-
-			p->last_line = extract_line(p, rbuf);
 			p->cur_pos = 0;
 
-			if (p->last_line)
+			if (extract_line(p, rbuf))
 				server_parse_line(p);
 			else
 				g_at_server_send_final(p,
@@ -1155,7 +1238,13 @@ static gboolean can_write_data(gpointer data)
 	if ((ring_buffer_len(write_buf) == 0) &&
 			(g_queue_get_length(server->write_queue) > 1)) {
 		write_buf = g_queue_pop_head(server->write_queue);
-		ring_buffer_free(write_buf);
+
+		if (server->spare_buf == NULL) {
+			ring_buffer_reset(write_buf);
+			server->spare_buf = write_buf;
+		} else
+			ring_buffer_free(write_buf);
+
 		write_buf = g_queue_peek_head(server->write_queue);
 	}
 
@@ -1180,8 +1269,14 @@ static void g_at_server_cleanup(GAtServer *server)
 	/* Cleanup pending data to write */
 	write_queue_free(server->write_queue);
 
+	if (server->spare_buf != NULL) {
+		ring_buffer_free(server->spare_buf);
+		server->spare_buf = NULL;
+	}
+
 	g_hash_table_destroy(server->command_list);
 	server->command_list = NULL;
+	memset(server->basic, 0, sizeof(server->basic));
 
 	g_free(server->last_line);
 
@@ -1432,6 +1527,7 @@ gboolean g_at_server_register(GAtServer *server, const char *prefix,
 					GDestroyNotify destroy_notify)
 {
 	struct at_command *node;
+	struct at_command **slot;
 
 	if (server == NULL || server->command_list == NULL)
 		return FALSE;
@@ -1452,12 +1548,17 @@ gboolean g_at_server_register(GAtServer *server, const char *prefix,
 
 	g_hash_table_replace(server->command_list, g_strdup(prefix), node);
 
+	slot = basic_command_slot(server, prefix);
+	if (slot != NULL)
+		*slot = node;
+
 	return TRUE;
 }
 
 gboolean g_at_server_unregister(GAtServer *server, const char *prefix)
 {
 	struct at_command *node;
+	struct at_command **slot;
 
 	if (server == NULL || server->command_list == NULL)
 		return FALSE;
@@ -1469,6 +1570,10 @@ gboolean g_at_server_unregister(GAtServer *server, const char *prefix)
 	if (node == NULL)
 		return FALSE;
 
+	slot = basic_command_slot(server, prefix);
+	if (slot != NULL)
+		*slot = NULL;
+
 	g_hash_table_remove(server->command_list, prefix);
 
 	return TRUE;
@@ -94,68 +94,95 @@ static inline gboolean gsm0710_check_fcs(const guint8 *data, int len,
 	return FALSE;
 }
 
+/*
+ * Undo control byte quoting in place, starting at the first escape byte.
+ * Runs of unquoted bytes are moved in bulk.  Returns the new length.
+ */
+static int gsm0710_unescape(guint8 *frame, guint8 *esc, int len)
+{
+	guint8 *end = frame + len;
+	guint8 *in = esc;
+	guint8 *out = esc;
+
+	while (in < end) {
+		guint8 *next;
+
+		/* in always points to a 0x7D byte here */
+		in += 1;
+
+		if (in >= end)
+			break;
+
+		*out++ = *in++ ^ 0x20;
+
+		next = memchr(in, 0x7D, end - in);
+		if (next == NULL)
+			next = end;
+
+		memmove(out, in, next - in);
+		out += next - in;
+		in = next;
+	}
+
+	return out - frame;
+}
+
 int gsm0710_advanced_extract_frame(guint8 *buf, int len,
 					guint8 *out_dlc, guint8 *out_control,
 					guint8 **out_frame, int *out_len)
 {
 	int posn = 0;
-	int posn2;
+	guint8 *flag;
+	guint8 *frame;
+	guint8 *esc;
 	int framelen;
 	guint8 dlc;
 	guint8 control;
 
 	while (posn < len) {
-		if (buf[posn] != 0x7E) {
-			posn += 1;
-			continue;
+		flag = memchr(buf + posn, 0x7E, len - posn);
+		if (flag == NULL) {
+			posn = len;
+			break;
 		}
 
+		posn = flag - buf;
+
 		/* Skip additional 0x7E bytes between frames */
 		while ((posn + 1) < len && buf[posn + 1] == 0x7E)
 			posn += 1;
 
 		/* Search for the end of the packet (the next 0x7E byte) */
-		framelen = posn + 1;
-		while (framelen < len && buf[framelen] != 0x7E)
-			framelen += 1;
-
-		if (framelen >= len)
+		flag = memchr(buf + posn + 1, 0x7E, len - posn - 1);
+		if (flag == NULL)
 			break;
 
-		if (framelen < 4) {
-			posn = framelen;
-			continue;
-		}
+		frame = buf + posn + 1;
+		framelen = flag - frame;
+		posn = flag - buf;
 
-		/* Undo control byte quoting in the packet */
-		posn2 = 0;
-		++posn;
-		while (posn < framelen) {
-			if (buf[posn] == 0x7D) {
-				++posn;
+		/* Frames without quoting are handed out as they are */
+		esc = memchr(frame, 0x7D, framelen);
+		if (esc)
+			framelen = gsm0710_unescape(frame, esc, framelen);
 
-				if (posn >= framelen)
-					break;
-
-				buf[posn2++] = buf[posn++] ^ 0x20;
-			} else {
-				buf[posn2++] = buf[posn++];
-			}
-		}
+		/* Address, control and FCS at the very least */
+		if (framelen < 3)
+			continue;
 
 		/* Validate the checksum on the packet header */
-		if (!gsm0710_check_fcs(buf, 2, buf[posn2 - 1]))
+		if (!gsm0710_check_fcs(frame, 2, frame[framelen - 1]))
 			continue;
 
 		/* Decode and dispatch the packet */
-		dlc = (buf[0] >> 2) & 0x3F;
-		control = buf[1] & 0xEF; /* Strip "PF" bit */
+		dlc = (frame[0] >> 2) & 0x3F;
+		control = frame[1] & 0xEF; /* Strip "PF" bit */
 
 		if (out_frame)
-			*out_frame = buf + 2;
+			*out_frame = frame + 2;
 
 		if (out_len)
-			*out_len = posn2 - 3;
+			*out_len = framelen - 3;
 
 		if (out_dlc)
 			*out_dlc = dlc;
@@ -169,6 +196,34 @@ int gsm0710_advanced_extract_frame(guint8 *buf, int len,
 	return posn;
 }
 
+int gsm0710_advanced_extract_frames(guint8 *buf, int len,
+					GSM0710FrameFunc func,
+					gpointer user_data)
+{
+	int total = 0;
+	int nread;
+	guint8 dlc;
+	guint8 control;
+	guint8 *frame;
+	int frame_len;
+
+	do {
+		frame = NULL;
+		nread = gsm0710_advanced_extract_frame(buf + total,
+							len - total,
+							&dlc, &control,
+							&frame, &frame_len);
+		total += nread;
+
+		if (frame == NULL)
+			break;
+
+		func(dlc, control, frame, frame_len, user_data);
+	} while (nread > 0);
+
+	return total;
+}
+
 int gsm0710_advanced_fill_frame(guint8 *frame, guint8 dlc, guint8 type,
 					const guint8 *data, int len)
 {
@@ -195,15 +250,26 @@ int gsm0710_advanced_fill_frame(guint8 *frame, guint8 dlc, guint8 type,
 	}
 
 	while (len > 0) {
-		temp = *data++ & 0xFF;
+		const guint8 *end = data + len;
+		const guint8 *next = data;
+
+		/* Copy runs of bytes that need no quoting in one go */
+		while (next < end && *next != 0x7E && *next != 0x7D)
+			next += 1;
+
+		memcpy(frame + size, data, next - data);
+		size += next - data;
+		len -= next - data;
+		data = next;
+
+		if (len == 0)
+			break;
+
+		temp = *data++;
 		--len;
 
-		if (temp != 0x7E && temp != 0x7D) {
-			frame[size++] = temp;
-		} else {
-			frame[size++] = 0x7D;
-			frame[size++] = (temp ^ 0x20);
-		}
+		frame[size++] = 0x7D;
+		frame[size++] = (temp ^ 0x20);
 	}
 
 	if (crc != 0x7E && crc != 0x7D) {
@@ -223,6 +289,7 @@ int gsm0710_basic_extract_frame(guint8 *buf, int len,
 					guint8 **out_frame, int *out_len)
 {
 	int posn = 0;
+	guint8 *flag;
 	int framelen;
 	int header_size;
 	guint8 fcs;
@@ -230,11 +297,14 @@ int gsm0710_basic_extract_frame(guint8 *buf, int len,
 	guint8 type;
 
 	while (posn < len) {
-		if (buf[posn] != 0xF9) {
-			posn += 1;
-			continue;
+		flag = memchr(buf + posn, 0xF9, len - posn);
+		if (flag == NULL) {
+			posn = len;
+			break;
 		}
 
+		posn = flag - buf;
+
 		/* Skip additional 0xF9 bytes between frames */
 		while ((posn + 1) < len && buf[posn + 1] == 0xF9)
 			posn += 1;
@@ -324,6 +394,33 @@ int gsm0710_basic_extract_frame(guint8 *buf, int len,
 	return posn;
 }
 
+int gsm0710_basic_extract_frames(guint8 *buf, int len,
+					GSM0710FrameFunc func,
+					gpointer user_data)
+{
+	int total = 0;
+	int nread;
+	guint8 dlc;
+	guint8 control;
+	guint8 *frame;
+	int frame_len;
+
+	do {
+		frame = NULL;
+		nread = gsm0710_basic_extract_frame(buf + total, len - total,
+							&dlc, &control,
+							&frame, &frame_len);
+		total += nread;
+
+		if (frame == NULL)
+			break;
+
+		func(dlc, control, frame, frame_len, user_data);
+	} while (nread > 0);
+
+	return total;
+}
+
 int gsm0710_basic_fill_frame(guint8 *frame, guint8 dlc, guint8 type,
 				const guint8 *data, int len)
 {
@@ -35,10 +35,23 @@ extern "C" {
 #define GSM0710_STATUS_SET		0xE3
 #define GSM0710_STATUS_ACK		0xE1
 
+/*
+ * Called for every frame found by the *_extract_frames functions.  The
+ * payload points into the caller's buffer and is only valid during the
+ * callback.
+ */
+typedef void (*GSM0710FrameFunc)(guint8 dlc, guint8 control,
+					const guint8 *frame, int len,
+					gpointer user_data);
+
 int gsm0710_basic_extract_frame(guint8 *data, int len,
 					guint8 *out_dlc, guint8 *out_type,
 					guint8 **frame, int *out_len);
 
+int gsm0710_basic_extract_frames(guint8 *data, int len,
+					GSM0710FrameFunc func,
+					gpointer user_data);
+
 int gsm0710_basic_fill_frame(guint8 *frame, guint8 dlc, guint8 type,
 				const guint8 *data, int len);
 
@@ -46,6 +59,10 @@ int gsm0710_advanced_extract_frame(guint8 *data, int len,
 					guint8 *out_dlc, guint8 *out_type,
 					guint8 **frame, int *out_len);
 
+int gsm0710_advanced_extract_frames(guint8 *data, int len,
+					GSM0710FrameFunc func,
+					gpointer user_data);
+
 int gsm0710_advanced_fill_frame(guint8 *frame, guint8 dlc, guint8 type,
 					const guint8 *data, int len);
 #ifdef __cplusplus
@@ -46,6 +46,9 @@
 struct _GIsiServiceMux {
 	GIsiModem *modem;
 	GSList *pending;
+	GSList *by_msgid[256];
+	GIsiPending *by_utid[256];
+	GSList *common;
 	GIsiVersion version;
 	uint8_t resource;
 	uint8_t last_utid;
@@ -70,6 +73,9 @@ struct _GIsiModem {
 	GIsiNotifyFunc trace;
 	void *opaque;
 	unsigned long flags;
+	GIsiPhonetBatch *batch;
+	gboolean dispatching;
+	gboolean destroyed;
 };
 
 struct _GIsiPending {
@@ -109,12 +115,71 @@ static GIsiServiceMux *service_get(GIsiModem *modem, uint8_t resource)
 	return mux;
 }
 
-static gint utid_equal(gconstpointer a, gconstpointer b)
+/*
+ * Besides the list of all pendings, each service keeps them indexed
+ * the way they are looked up on receive: RESPs by unique transaction
+ * ID, REQs, INDs and NTFs by message ID, and version queries on their
+ * own short list.
+ */
+static void pending_link(GIsiServiceMux *mux, GIsiPending *op)
 {
-	const GIsiPending *pa = a;
-	const GIsiPending *pb = b;
+	switch (op->type) {
+	case GISI_MESSAGE_TYPE_RESP:
+		mux->by_utid[op->utid] = op;
+		mux->pending = g_slist_prepend(mux->pending, op);
+		break;
+
+	case GISI_MESSAGE_TYPE_COMMON:
+		mux->common = g_slist_prepend(mux->common, op);
+		mux->pending = g_slist_prepend(mux->pending, op);
+		break;
 
-	return pa->utid - pb->utid;
+	default:
+		mux->by_msgid[op->msgid] =
+			g_slist_append(mux->by_msgid[op->msgid], op);
+		mux->pending = g_slist_append(mux->pending, op);
+		break;
+	}
+}
+
+static void pending_unlink(GIsiPending *op)
+{
+	GIsiServiceMux *mux = op->service;
+
+	switch (op->type) {
+	case GISI_MESSAGE_TYPE_RESP:
+		if (mux->by_utid[op->utid] == op)
+			mux->by_utid[op->utid] = NULL;
+		break;
+
+	case GISI_MESSAGE_TYPE_COMMON:
+		mux->common = g_slist_remove(mux->common, op);
+		break;
+
+	default:
+		mux->by_msgid[op->msgid] =
+			g_slist_remove(mux->by_msgid[op->msgid], op);
+		break;
+	}
+
+	mux->pending = g_slist_remove(mux->pending, op);
+}
+
+static gboolean service_utid_busy(GIsiServiceMux *mux, uint8_t utid)
+{
+	GSList *l;
+
+	if (mux->by_utid[utid] != NULL)
+		return TRUE;
+
+	for (l = mux->common; l != NULL; l = l->next) {
+		GIsiPending *op = l->data;
+
+		if (op->utid == utid)
+			return TRUE;
+	}
+
+	return FALSE;
 }
 
 static const char *pend_type_to_str(enum GIsiMessageType type)
@@ -155,7 +220,7 @@ static void pending_remove_and_dispatch(GIsiPending *op, GIsiMessage *msg)
 {
 	GIsiModem *modem;
 
-	op->service->pending = g_slist_remove(op->service->pending, op);
+	pending_unlink(op);
 
 	if (op->notify == NULL || msg == NULL)
 		goto destroy;
@@ -185,45 +250,54 @@ static void service_dispatch(GIsiServiceMux *mux, GIsiMessage *msg,
 {
 	uint8_t msgid = g_isi_msg_id(msg);
 	uint8_t utid = g_isi_msg_utid(msg);
+	GIsiPending *pend;
+	GSList *l;
 
-	GSList *l = mux->pending;
-
-	while (l != NULL) {
-		GSList *next = l->next;
-		GIsiPending *pend = l->data;
+	/*
+	 * RESPs are dispatched on unique transaction ID, explicitly
+	 * ignoring the msgid.  A RESP also completes a transaction,
+	 * so it needs to be removed after being notified of.
+	 */
+	pend = mux->by_utid[utid];
 
-		/*
-		 * REQs, NTFs and INDs are dispatched on message ID.  While
-		 * INDs have the unique transaction ID set to zero, NTFs
-		 * typically mirror the UTID of the request that set up the
-		 * session, and REQs can naturally have any transaction ID.
-		 *
-		 * RESPs are dispatched on unique transaction ID, explicitly
-		 * ignoring the msgid.  A RESP also completes a transaction,
-		 * so it needs to be removed after being notified of.
-		 *
-		 * Version query responses are dispatched in a similar fashion
-		 * as RESPs, but based on the pending type and the message ID.
-		 * Some of these may be synthesized, but nevertheless need to
-		 * be removed.
-		 */
-		if (pend->type < GISI_MESSAGE_TYPE_RESP
-				&& pend->msgid == msgid) {
+	if (pend != NULL && !is_indication) {
+		pending_remove_and_dispatch(pend, msg);
+		return;
+	}
 
-			pending_dispatch(pend, msg);
+	/*
+	 * Version query responses are dispatched in a similar fashion
+	 * as RESPs, but based on the pending type and the message ID.
+	 * Some of these may be synthesized, but nevertheless need to
+	 * be removed.
+	 */
+	if (msgid == COMMON_MESSAGE) {
+		l = mux->common;
 
-		} else if (pend->type == GISI_MESSAGE_TYPE_RESP &&
-				!is_indication && pend->utid == utid) {
+		while (l != NULL) {
+			GSList *next = l->next;
 
-			pending_remove_and_dispatch(pend, msg);
-			break;
+			pend = l->data;
 
-		} else if (pend->type == GISI_MESSAGE_TYPE_COMMON &&
-				msgid == COMMON_MESSAGE &&
-				pend->msgid == COMM_ISI_VERSION_GET_REQ) {
+			if (pend->msgid == COMM_ISI_VERSION_GET_REQ)
+				pending_remove_and_dispatch(pend, msg);
 
-			pending_remove_and_dispatch(pend, msg);
+			l = next;
 		}
+	}
+
+	/*
+	 * REQs, NTFs and INDs are dispatched on message ID.  While
+	 * INDs have the unique transaction ID set to zero, NTFs
+	 * typically mirror the UTID of the request that set up the
+	 * session, and REQs can naturally have any transaction ID.
+	 */
+	l = mux->by_msgid[msgid];
+
+	while (l != NULL) {
+		GSList *next = l->next;
+
+		pending_dispatch(l->data, msg);
 
 		l = next;
 	}
@@ -277,62 +351,91 @@ static void firewall_notify_handle(GIsiModem *modem, GIsiMessage *msg)
 	ISIDBG(modem, "firewall blocked message 0x%02X", id);
 }
 
+static void isi_message_handle(GIsiModem *modem, const void *buf, size_t len,
+				struct sockaddr_pn *addr, gboolean is_indication)
+{
+	GIsiServiceMux *mux;
+	GIsiMessage msg;
+	unsigned key;
+
+	msg.addr = addr;
+	msg.error = 0;
+	msg.data = buf;
+	msg.len = len;
+
+	if (modem->trace != NULL)
+		modem->trace(&msg, NULL);
+
+	key = addr->spn_resource;
+	mux = g_hash_table_lookup(modem->services, GINT_TO_POINTER(key));
+	if (mux == NULL) {
+		/*
+		 * Unfortunately, the FW report has the wrong
+		 * resource ID in the N900 modem.
+		 */
+		if (key == PN_FIREWALL)
+			firewall_notify_handle(modem, &msg);
+
+		return;
+	}
+
+	msg.version = &mux->version;
+
+	if (g_isi_msg_id(&msg) == COMMON_MESSAGE)
+		common_message_decode(mux, &msg);
+
+	service_dispatch(mux, &msg, is_indication);
+}
+
 static gboolean isi_callback(GIOChannel *channel, GIOCondition cond,
 				gpointer data)
 {
 	GIsiModem *modem = data;
-	int len;
-	int fd;
+	gboolean is_indication;
+	int count;
+	int i;
 
 	if (cond & (G_IO_NVAL|G_IO_HUP)) {
 		ISIDBG(modem, "Unexpected event on PhoNet channel %p", channel);
 		return FALSE;
 	}
 
-	fd = g_io_channel_unix_get_fd(channel);
-	len = g_isi_phonet_peek_length(channel);
+	is_indication = g_io_channel_unix_get_fd(channel) == modem->ind_fd;
 
-	if (len > 0) {
-		struct sockaddr_pn addr;
-		uint32_t buf[(len + 3) / 4];
+	/* Indications tend to come in bursts, pick up all that are queued */
+	count = g_isi_phonet_read_batch(channel, modem->batch);
+	if (count <= 0)
+		return TRUE;
 
-		GIsiServiceMux *mux;
-		GIsiMessage msg;
-		unsigned key;
+	modem->dispatching = TRUE;
 
-		len = g_isi_phonet_read(channel, buf, len, &addr);
-		if (len < 2)
-			return TRUE;
-
-		msg.addr = &addr;
-		msg.error = 0;
-		msg.data = buf;
-		msg.len = len;
-
-		if (modem->trace != NULL)
-			modem->trace(&msg, NULL);
-
-		key = addr.spn_resource;
-		mux = g_hash_table_lookup(modem->services,
-						GINT_TO_POINTER(key));
-		if (mux == NULL) {
-			/*
-			 * Unfortunately, the FW report has the wrong
-			 * resource ID in the N900 modem.
-			 */
-			if (key == PN_FIREWALL)
-				firewall_notify_handle(modem, &msg);
+	for (i = 0; i < count && !modem->destroyed; i++) {
+		struct sockaddr_pn *addr;
+		const void *buf;
+		size_t len;
 
-			return TRUE;
+		buf = g_isi_phonet_batch_get(modem->batch, i, &len, &addr);
+		if (buf == NULL) {
+			ISIDBG(modem, "Dropped truncated message on %p",
+				channel);
+			continue;
 		}
 
-		msg.version = &mux->version;
+		if (len < 2)
+			continue;
+
+		isi_message_handle(modem, buf, len, addr, is_indication);
+	}
 
-		if (g_isi_msg_id(&msg) == COMMON_MESSAGE)
-			common_message_decode(mux, &msg);
+	modem->dispatching = FALSE;
 
-		service_dispatch(mux, &msg, fd == modem->ind_fd);
+	/* The modem was destroyed from one of the callbacks above */
+	if (modem->destroyed) {
+		g_isi_phonet_batch_free(modem->batch);
+		g_free(modem);
+		return FALSE;
 	}
+
 	return TRUE;
 }
 
@@ -459,6 +562,7 @@ static void service_finalize(gpointer value)
 {
 	GIsiServiceMux *mux = value;
 	GIsiModem *modem = mux->modem;
+	unsigned i;
 
 	if (mux->subscriptions > 0)
 		modem_subs_update_when_idle(modem);
@@ -468,6 +572,11 @@ static void service_finalize(gpointer value)
 
 	g_slist_foreach(mux->pending, pending_destroy, NULL);
 	g_slist_free(mux->pending);
+	g_slist_free(mux->common);
+
+	for (i = 0; i < G_N_ELEMENTS(mux->by_msgid); i++)
+		g_slist_free(mux->by_msgid[i]);
+
 	g_free(mux);
 }
 
@@ -488,10 +597,18 @@ GIsiModem *g_isi_modem_create(unsigned index)
 		return NULL;
 	}
 
+	modem->batch = g_isi_phonet_batch_new();
+	if (modem->batch == NULL) {
+		g_free(modem);
+		errno = ENOMEM;
+		return NULL;
+	}
+
 	inds = g_isi_phonet_new(index);
 	reqs = g_isi_phonet_new(index);
 
 	if (inds == NULL || reqs == NULL) {
+		g_isi_phonet_batch_free(modem->batch);
 		g_free(modem);
 		return NULL;
 	}
@@ -648,6 +765,13 @@ void g_isi_modem_destroy(GIsiModem *modem)
 	if (modem->req_watch > 0)
 		g_source_remove(modem->req_watch);
 
+	/* Let isi_callback() finish with the current batch first */
+	if (modem->dispatching) {
+		modem->destroyed = TRUE;
+		return;
+	}
+
+	g_isi_phonet_batch_free(modem->batch);
 	g_free(modem);
 }
 
@@ -782,7 +906,7 @@ GIsiPending *g_isi_request_vsendto(GIsiModem *modem, struct sockaddr_pn *dst,
 	resp->destroy = destroy;
 	resp->data = data;
 
-	if (g_slist_find_custom(mux->pending, resp, utid_equal)) {
+	if (service_utid_busy(mux, resp->utid)) {
 		/*
 		 * FIXME: perhaps retry with randomized access after
 		 * initial miss. Although if the rate at which
@@ -815,7 +939,7 @@ GIsiPending *g_isi_request_vsendto(GIsiModem *modem, struct sockaddr_pn *dst,
 		goto error;
 	}
 
-	mux->pending = g_slist_prepend(mux->pending, resp);
+	pending_link(mux, resp);
 
 	if (timeout > 0)
 		resp->timeout = g_timeout_add_seconds(timeout, resp_timeout,
@@ -854,7 +978,7 @@ void g_isi_pending_remove(GIsiPending *op)
 		return;
 	}
 
-	op->service->pending = g_slist_remove(op->service->pending, op);
+	pending_unlink(op);
 
 	pending_destroy(op, NULL);
 }
@@ -906,10 +1030,9 @@ void g_isi_remove_pending_by_owner(GIsiModem *modem, uint8_t resource,
 		if (op->owner != owner)
 			continue;
 
-		mux->pending = g_slist_remove_link(mux->pending, l);
+		pending_unlink(op);
 
-		l->next = owned;
-		owned = l;
+		owned = g_slist_prepend(owned, op);
 	}
 
 	for (l = owned; l != NULL; l = l->next) {
@@ -947,7 +1070,7 @@ GIsiPending *g_isi_ntf_subscribe(GIsiModem *modem, uint8_t resource,
 	ntf->destroy = destroy;
 	ntf->msgid = msgid;
 
-	mux->pending = g_slist_append(mux->pending, ntf);
+	pending_link(mux, ntf);
 
 	ISIDBG(modem, "Subscribed to %s (%p) [res=0x%02X, id=0x%02X]",
 		pend_type_to_str(ntf->type), ntf, resource, msgid);
@@ -981,7 +1104,7 @@ GIsiPending *g_isi_service_bind(GIsiModem *modem, uint8_t resource,
 	srv->destroy = destroy;
 	srv->msgid = msgid;
 
-	mux->pending = g_slist_append(mux->pending, srv);
+	pending_link(mux, srv);
 
 	ISIDBG(modem, "Bound service for %s (%p) [res=0x%02X, id=0x%02X]",
 		pend_type_to_str(srv->type), srv, resource, msgid);
@@ -1017,7 +1140,7 @@ GIsiPending *g_isi_ind_subscribe(GIsiModem *modem, uint8_t resource,
 	ind->destroy = destroy;
 	ind->msgid = msgid;
 
-	mux->pending = g_slist_append(mux->pending, ind);
+	pending_link(mux, ind);
 
 	ISIDBG(modem, "Subscribed for %s (%p) [res=0x%02X, id=0x%02X]",
 		pend_type_to_str(ind->type), ind, resource, msgid);
@@ -1165,7 +1288,7 @@ static int version_get_send(GIsiModem *modem, GIsiPending *ping)
 	};
 	ssize_t ret;
 
-	if (g_slist_find_custom(mux->pending, ping, utid_equal))
+	if (service_utid_busy(mux, ping->utid))
 		return -EBUSY;
 
 	ret = sendto(modem->req_fd, msg, sizeof(msg), MSG_NOSIGNAL,
@@ -1247,7 +1370,7 @@ GIsiPending *g_isi_resource_ping(GIsiModem *modem, uint8_t resource,
 
 	ping->timeout = g_timeout_add_seconds(COMMON_TIMEOUT, resp_timeout,
 						ping);
-	mux->pending = g_slist_prepend(mux->pending, ping);
+	pending_link(mux, ping);
 	mux->version_pending = TRUE;
 
 	ISIDBG(modem, "Ping sent %s (%p) [res=0x%02X]",
@@ -23,9 +23,13 @@
 #include <config.h>
 #endif
 
+#define _GNU_SOURCE
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <net/if.h>
@@ -91,3 +95,142 @@ ssize_t g_isi_phonet_read(GIOChannel *channel, void *restrict buf, size_t len,
 
 	return ret;
 }
+
+/*
+ * Each slot takes a message of up to GISI_PHONET_SLOT_SIZE bytes, the
+ * rest of a larger one spills over into a buffer shared by all slots.
+ * Only the last message to spill over in a batch is then intact, it is
+ * copied out in one piece.
+ */
+struct _GIsiPhonetBatch {
+	struct mmsghdr hdr[GISI_PHONET_BATCH_MAX];
+	struct iovec iov[GISI_PHONET_BATCH_MAX][2];
+	struct sockaddr_pn addr[GISI_PHONET_BATCH_MAX];
+	uint32_t buf[GISI_PHONET_BATCH_MAX][GISI_PHONET_SLOT_SIZE / 4];
+	uint32_t spill[GISI_PHONET_MSG_MAX / 4];
+	void *large;
+	int large_index;
+	gboolean no_mmsg;
+};
+
+GIsiPhonetBatch *g_isi_phonet_batch_new(void)
+{
+	GIsiPhonetBatch *batch;
+	int i;
+
+	batch = g_try_new0(GIsiPhonetBatch, 1);
+	if (batch == NULL)
+		return NULL;
+
+	for (i = 0; i < GISI_PHONET_BATCH_MAX; i++) {
+		batch->iov[i][0].iov_base = batch->buf[i];
+		batch->iov[i][0].iov_len = GISI_PHONET_SLOT_SIZE;
+		batch->iov[i][1].iov_base = batch->spill;
+		batch->iov[i][1].iov_len = GISI_PHONET_MSG_MAX;
+	}
+
+	batch->large_index = -1;
+
+	return batch;
+}
+
+void g_isi_phonet_batch_free(GIsiPhonetBatch *batch)
+{
+	g_free(batch->large);
+	g_free(batch);
+}
+
+static void batch_collect_large(GIsiPhonetBatch *batch, int count)
+{
+	size_t len;
+	int i;
+
+	for (i = count - 1; i >= 0; i--)
+		if (batch->hdr[i].msg_len > GISI_PHONET_SLOT_SIZE)
+			break;
+
+	if (i < 0)
+		return;
+
+	len = batch->hdr[i].msg_len;
+
+	batch->large = g_try_malloc(len);
+	if (batch->large == NULL)
+		return;
+
+	memcpy(batch->large, batch->buf[i], GISI_PHONET_SLOT_SIZE);
+	memcpy((uint8_t *) batch->large + GISI_PHONET_SLOT_SIZE,
+				batch->spill, len - GISI_PHONET_SLOT_SIZE);
+	batch->large_index = i;
+}
+
+/*
+ * Drain up to GISI_PHONET_BATCH_MAX queued datagrams with a single
+ * system call.  Returns the number of messages read, or -1 on error.
+ */
+int g_isi_phonet_read_batch(GIOChannel *channel, GIsiPhonetBatch *batch)
+{
+	int fd = g_io_channel_unix_get_fd(channel);
+	int ret;
+	int i;
+
+	for (i = 0; i < GISI_PHONET_BATCH_MAX; i++) {
+		struct msghdr *hdr = &batch->hdr[i].msg_hdr;
+
+		memset(hdr, 0, sizeof(*hdr));
+		hdr->msg_name = &batch->addr[i];
+		hdr->msg_namelen = sizeof(struct sockaddr_pn);
+		hdr->msg_iov = batch->iov[i];
+		hdr->msg_iovlen = 2;
+		batch->hdr[i].msg_len = 0;
+	}
+
+	g_free(batch->large);
+	batch->large = NULL;
+	batch->large_index = -1;
+
+	if (!batch->no_mmsg) {
+		ret = recvmmsg(fd, batch->hdr, GISI_PHONET_BATCH_MAX,
+				MSG_DONTWAIT, NULL);
+		if (ret > 0)
+			batch_collect_large(batch, ret);
+
+		if (ret >= 0 || errno != ENOSYS)
+			return ret;
+
+		batch->no_mmsg = TRUE;
+	}
+
+	/* Kernels without recvmmsg get one message per wakeup */
+	ret = recvmsg(fd, &batch->hdr[0].msg_hdr, MSG_DONTWAIT);
+	if (ret < 0)
+		return -1;
+
+	batch->hdr[0].msg_len = ret;
+	batch_collect_large(batch, 1);
+
+	return 1;
+}
+
+const void *g_isi_phonet_batch_get(GIsiPhonetBatch *batch, int index,
+					size_t *len, struct sockaddr_pn **addr)
+{
+	if (index < 0 || index >= GISI_PHONET_BATCH_MAX)
+		return NULL;
+
+	/* Never pass on a partial message */
+	if (batch->hdr[index].msg_hdr.msg_flags & MSG_TRUNC)
+		return NULL;
+
+	*len = batch->hdr[index].msg_len;
+	*addr = &batch->addr[index];
+
+	if (*len <= GISI_PHONET_SLOT_SIZE)
+		return batch->buf[index];
+
+	/* Its spilled over part was overwritten by a later message */
+	if (index != batch->large_index)
+		return NULL;
+
+	return batch->large;
+}
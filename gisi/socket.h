@@ -19,7 +19,24 @@
  *
  */
 
+/*
+ * Messages read per wakeup, the slot size, which fits nearly all ISI
+ * messages, and the largest payload the 16 bit PhoNet length field
+ * allows.
+ */
+#define GISI_PHONET_BATCH_MAX	16
+#define GISI_PHONET_SLOT_SIZE	4096
+#define GISI_PHONET_MSG_MAX	65536
+
+typedef struct _GIsiPhonetBatch GIsiPhonetBatch;
+
 GIOChannel *g_isi_phonet_new(unsigned int ifindex);
 size_t g_isi_phonet_peek_length(GIOChannel *io);
 ssize_t g_isi_phonet_read(GIOChannel *io, void *restrict buf, size_t len,
 				struct sockaddr_pn *addr);
+
+GIsiPhonetBatch *g_isi_phonet_batch_new(void);
+void g_isi_phonet_batch_free(GIsiPhonetBatch *batch);
+int g_isi_phonet_read_batch(GIOChannel *io, GIsiPhonetBatch *batch);
+const void *g_isi_phonet_batch_get(GIsiPhonetBatch *batch, int index,
+					size_t *len, struct sockaddr_pn **addr);
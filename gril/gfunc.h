@@ -33,6 +33,8 @@ typedef void (*GRilDisconnectFunc)(gpointer user_data);
 typedef void (*GRilReceiveFunc)(const unsigned char *data, gsize size,
 							gpointer user_data);
 typedef void (*GRilDebugFunc)(const char *str, gpointer user_data);
+typedef void (*GRilTraceFunc)(gboolean in, const unsigned char *data,
+					gsize size, gpointer user_data);
 typedef void (*GRilSuspendFunc)(gpointer user_data);
 
 #ifdef __cplusplus
@@ -39,6 +39,7 @@
 #include <glib.h>
 
 #include "log.h"
+#include "histogram.h"
 #include "ringbuffer.h"
 #include "gril.h"
 #include "grilutil.h"
@@ -63,6 +64,17 @@ struct ril_request {
 	GRilResponseFunc callback;
 	gpointer user_data;
 	GDestroyNotify notify;
+	gint64 queued_at;
+	gint64 sent_at;
+	guint8 priority;
+	gboolean in_flight;			/* On the out_queue */
+};
+
+/* Lower values are written first when pipelining is enabled */
+enum ril_request_priority {
+	RIL_PRIORITY_HIGH = 0,
+	RIL_PRIORITY_NORMAL,
+	RIL_PRIORITY_LOW,
 };
 
 struct ril_notify_node {
@@ -78,6 +90,7 @@ typedef gboolean (*node_remove_func)(struct ril_notify_node *node,
 
 struct ril_notify {
 	GSList *nodes;
+	guint count;
 };
 
 struct ril_s {
@@ -105,6 +118,9 @@ struct ril_s {
 	GRilMsgIdToStrFunc req_to_string;
 	GRilMsgIdToStrFunc unsol_to_string;
 	int version;
+	guint pipeline_depth;			/* Requests in flight per group */
+	GHashTable *group_in_flight;		/* In flight count by group */
+	GRilStats stats;
 };
 
 struct _GRil {
@@ -309,6 +325,26 @@ static void ril_request_destroy(struct ril_request *req)
 	g_free(req);
 }
 
+/* Counted on write and reply, so next_request needn't rescan the queue */
+static guint group_in_flight(struct ril_s *ril, guint gid)
+{
+	return GPOINTER_TO_UINT(g_hash_table_lookup(ril->group_in_flight,
+						GUINT_TO_POINTER(gid)));
+}
+
+static void group_in_flight_update(struct ril_s *ril, guint gid, int delta)
+{
+	guint count = group_in_flight(ril, gid) + delta;
+
+	if (count == 0)
+		g_hash_table_remove(ril->group_in_flight,
+					GUINT_TO_POINTER(gid));
+	else
+		g_hash_table_insert(ril->group_in_flight,
+					GUINT_TO_POINTER(gid),
+					GUINT_TO_POINTER(count));
+}
+
 static void ril_cleanup(struct ril_s *p)
 {
 	/* Cleanup pending commands */
@@ -323,6 +359,11 @@ static void ril_cleanup(struct ril_s *p)
 		p->out_queue = NULL;
 	}
 
+	if (p->group_in_flight) {
+		g_hash_table_destroy(p->group_in_flight);
+		p->group_in_flight = NULL;
+	}
+
 	/* Cleanup registered notifications */
 	if (p->notify_list) {
 		g_hash_table_destroy(p->notify_list);
@@ -378,6 +419,17 @@ static void handle_response(struct ril_s *p, struct ril_msg *message)
 					ril_error_to_string(message->error));
 
 			req = g_queue_pop_nth(p->command_queue, i);
+
+			if (req->in_flight)
+				group_in_flight_update(p, req->gid, -1);
+
+			p->stats.replies_matched += 1;
+
+			if (req->sent_at)
+				ofono_histogram_add(p->stats.response_time,
+					G_RIL_STATS_BUCKETS,
+					g_get_monotonic_time() - req->sent_at);
+
 			if (req->callback)
 				req->callback(message, req->user_data);
 
@@ -427,11 +479,14 @@ static void handle_unsol_req(struct ril_s *p, struct ril_msg *message)
 		return;
 
 	p->in_notify = TRUE;
+	p->stats.unsolicited += 1;
 
 	notify = g_hash_table_lookup(p->notify_list, &message->req);
 	if (notify != NULL) {
 		GSList *list_item;
 
+		notify->count += 1;
+
 		for (list_item = notify->nodes; list_item;
 				list_item = g_slist_next(list_item)) {
 			struct ril_notify_node *node = list_item->data;
@@ -644,6 +699,47 @@ static void new_bytes(struct ring_buffer *rbuf, gpointer user_data)
 		g_free(p);
 }
 
+static struct ril_request *find_request(struct ril_s *ril, gint id)
+{
+	GList *l;
+
+	for (l = g_queue_peek_head_link(ril->command_queue); l; l = l->next) {
+		struct ril_request *req = l->data;
+
+		if (req->id == id)
+			return req;
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns the first request that has not been written yet.  With pipelining
+ * enabled the queue is ordered by priority and a group that already has
+ * pipeline_depth requests outstanding is skipped, so that a long run of
+ * requests from one group cannot hold back the others.
+ */
+static struct ril_request *next_request(struct ril_s *ril)
+{
+	GList *l;
+
+	for (l = g_queue_peek_head_link(ril->command_queue); l; l = l->next) {
+		struct ril_request *req = l->data;
+
+		if (req->in_flight)
+			continue;
+
+		if (ril->pipeline_depth > 0 &&
+				group_in_flight(ril, req->gid) >=
+							ril->pipeline_depth)
+			continue;
+
+		return req;
+	}
+
+	return NULL;
+}
+
 /*
  * This function is a GIOFunc and may be called directly or via an IO watch.
  * The return value controls whether the watch stays active ( TRUE ), or is
@@ -654,69 +750,23 @@ static gboolean can_write_data(gpointer data)
 	struct ril_s *ril = data;
 	struct ril_request *req;
 	gsize bytes_written, towrite, len;
-	guint qlen, oqlen;
-	gint id;
-	gboolean written = TRUE;
-	guint i, j;
-
-	qlen = g_queue_get_length(ril->command_queue);
-	if (qlen < 1)
-		return FALSE;
 
 	/* if the whole request was not written */
 	if (ril->req_bytes_written != 0) {
-
-		for (i = 0; i < qlen; i++) {
-			req = g_queue_peek_nth(ril->command_queue, i);
-			if (req) {
-				id = GPOINTER_TO_INT(g_queue_peek_head(
-							ril->out_queue));
-				if (req->id == id)
-					goto out;
-			} else {
-				return FALSE;
-			}
-		}
-	}
-	/* if no requests already sent */
-	oqlen = g_queue_get_length(ril->out_queue);
-	if (oqlen < 1) {
-		req = g_queue_peek_head(ril->command_queue);
+		req = find_request(ril, GPOINTER_TO_INT(
+					g_queue_peek_head(ril->out_queue)));
 		if (req == NULL)
 			return FALSE;
-
-		g_queue_push_head(ril->out_queue, GINT_TO_POINTER(req->id));
-
-		goto out;
-	}
-
-	for (i = 0; i < qlen; i++) {
-		req = g_queue_peek_nth(ril->command_queue, i);
+	} else {
+		req = next_request(ril);
 		if (req == NULL)
 			return FALSE;
 
-		for (j = 0; j < oqlen; j++) {
-			id = GPOINTER_TO_INT(
-					g_queue_peek_nth(ril->out_queue, j));
-			if (req->id == id) {
-				written = TRUE;
-				break;
-			} else {
-				written = FALSE;
-			}
-		}
-
-		if (written == FALSE)
-			break;
+		g_queue_push_head(ril->out_queue, GINT_TO_POINTER(req->id));
+		req->in_flight = TRUE;
+		group_in_flight_update(ril, req->gid, 1);
 	}
 
-	/* watcher fired though requests already written */
-	if (written == TRUE)
-		return FALSE;
-
-	g_queue_push_head(ril->out_queue, GINT_TO_POINTER(req->id));
-
-out:
 	len = req->data_len;
 
 	towrite = len - ril->req_bytes_written;
@@ -739,6 +789,16 @@ out:
 	else
 		ril->req_bytes_written = 0;
 
+	req->sent_at = g_get_monotonic_time();
+	ril->stats.requests_sent += 1;
+	ofono_histogram_add(ril->stats.queue_time,
+					G_RIL_STATS_BUCKETS,
+					req->sent_at - req->queued_at);
+
+	/* Keep writing while the pipeline has room */
+	if (ril->pipeline_depth > 0 && next_request(ril) != NULL)
+		return TRUE;
+
 	return FALSE;
 }
 
@@ -891,6 +951,8 @@ static struct ril_s *create_ril(const char *sock_path)
 		goto error;
 	}
 
+	ril->group_in_flight = g_hash_table_new(g_direct_hash, g_direct_equal);
+
 	ril->notify_list = g_hash_table_new_full(g_int_hash, g_int_equal,
 							g_free,
 							ril_notify_destroy);
@@ -929,9 +991,7 @@ static struct ril_notify *ril_notify_create(struct ril_s *ril,
 static void ril_cancel_group(struct ril_s *ril, guint group)
 {
 	int n = 0;
-	guint len, i;
 	struct ril_request *req;
-	gboolean sent;
 
 	if (ril->command_queue == NULL)
 		return;
@@ -943,21 +1003,11 @@ static void ril_cancel_group(struct ril_s *ril, guint group)
 		}
 
 		req->callback = NULL;
-		sent = FALSE;
-
-		len = g_queue_get_length(ril->out_queue);
-		for (i = 0; i < len; i++) {
-			if (GPOINTER_TO_INT(
-					g_queue_peek_nth(ril->out_queue, i))
-					== req->id) {
-				n += 1;
-				sent = TRUE;
-				break;
-			}
-		 }
 
-		if (sent)
+		if (req->in_flight) {
+			n += 1;
 			continue;
+		}
 
 		g_queue_remove(ril->command_queue, req);
 		ril_request_destroy(req);
@@ -1123,6 +1173,50 @@ GRil *g_ril_ref(GRil *ril)
 	return ril;
 }
 
+static guint8 request_priority(gint req)
+{
+	switch (req) {
+	case RIL_REQUEST_GET_CURRENT_CALLS:
+	case RIL_REQUEST_DIAL:
+	case RIL_REQUEST_HANGUP:
+	case RIL_REQUEST_HANGUP_WAITING_OR_BACKGROUND:
+	case RIL_REQUEST_HANGUP_FOREGROUND_RESUME_BACKGROUND:
+	case RIL_REQUEST_SWITCH_WAITING_OR_HOLDING_AND_ACTIVE:
+	case RIL_REQUEST_CONFERENCE:
+	case RIL_REQUEST_UDUB:
+	case RIL_REQUEST_LAST_CALL_FAIL_CAUSE:
+	case RIL_REQUEST_DTMF:
+	case RIL_REQUEST_DTMF_START:
+	case RIL_REQUEST_DTMF_STOP:
+	case RIL_REQUEST_ANSWER:
+	case RIL_REQUEST_SEPARATE_CONNECTION:
+	case RIL_REQUEST_EXPLICIT_CALL_TRANSFER:
+	case RIL_REQUEST_SEND_SMS:
+	case RIL_REQUEST_SEND_SMS_EXPECT_MORE:
+	case RIL_REQUEST_SMS_ACKNOWLEDGE:
+	case RIL_REQUEST_IMS_SEND_SMS:
+	case RIL_REQUEST_CDMA_SEND_SMS:
+		return RIL_PRIORITY_HIGH;
+	case RIL_REQUEST_SIM_IO:
+	case RIL_REQUEST_QUERY_AVAILABLE_NETWORKS:
+	case RIL_REQUEST_QUERY_AVAILABLE_BAND_MODE:
+	case RIL_REQUEST_GET_NEIGHBORING_CELL_IDS:
+		return RIL_PRIORITY_LOW;
+	}
+
+	return RIL_PRIORITY_NORMAL;
+}
+
+/* Keeps the queue stable: a request goes after all others of its priority */
+static gint compare_request_priority(gconstpointer a, gconstpointer b,
+					gpointer user_data)
+{
+	const struct ril_request *queued = a;
+	const struct ril_request *req = b;
+
+	return queued->priority <= req->priority ? -1 : 1;
+}
+
 gint g_ril_send(GRil *ril, const gint reqid, struct parcel *rilp,
 		GRilResponseFunc func, gpointer user_data,
 		GDestroyNotify notify)
@@ -1147,8 +1241,18 @@ gint g_ril_send(GRil *ril, const gint reqid, struct parcel *rilp,
 		return 0;
 
 	p->next_cmd_id++;
+	r->queued_at = g_get_monotonic_time();
+
+	if (p->pipeline_depth > 0) {
+		r->priority = request_priority(reqid);
+		g_queue_insert_sorted(p->command_queue, r,
+					compare_request_priority, NULL);
+	} else
+		g_queue_push_tail(p->command_queue, r);
 
-	g_queue_push_tail(p->command_queue, r);
+	if (g_queue_get_length(p->command_queue) > p->stats.queue_depth_max)
+		p->stats.queue_depth_max =
+				g_queue_get_length(p->command_queue);
 
 	ril_wakeup_writer(p);
 
@@ -1179,6 +1283,49 @@ void g_ril_unref(GRil *ril)
 	g_free(ril);
 }
 
+gboolean g_ril_get_stats(GRil *ril, GRilStats *stats)
+{
+	struct ril_s *p;
+
+	if (ril == NULL || ril->parent == NULL || stats == NULL)
+		return FALSE;
+
+	p = ril->parent;
+
+	memcpy(stats, &p->stats, sizeof(*stats));
+
+	if (p->command_queue)
+		stats->queue_depth = g_queue_get_length(p->command_queue);
+
+	g_ril_io_get_counters(p->io, &stats->bytes_in, &stats->bytes_out,
+					&stats->rx_buffer_max);
+
+	return TRUE;
+}
+
+void g_ril_foreach_unsol_count(GRil *ril, GRilUnsolCountFunc func,
+					gpointer user_data)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	struct ril_s *p;
+
+	if (ril == NULL || ril->parent == NULL ||
+			ril->parent->notify_list == NULL)
+		return;
+
+	p = ril->parent;
+
+	g_hash_table_iter_init(&iter, p->notify_list);
+
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct ril_notify *notify = value;
+
+		func(unsol_request_to_string(p, *(int *) key), notify->count,
+								user_data);
+	}
+}
+
 gboolean g_ril_get_trace(GRil *ril)
 {
 
@@ -1188,15 +1335,46 @@ gboolean g_ril_get_trace(GRil *ril)
 	return ril->parent->trace;
 }
 
+static void ril_io_trace(gboolean in, const unsigned char *data,
+					gsize size, gpointer user_data)
+{
+	struct ril_s *ril = user_data;
+	char tag[16];
+
+	snprintf(tag, sizeof(tag), "ril%d", ril->slot);
+	ofono_log_trace(tag, in, data, size);
+}
+
 gboolean g_ril_set_trace(GRil *ril, gboolean trace)
 {
 
 	if (ril == NULL || ril->parent == NULL)
 		return FALSE;
 
+	/* Raw parcels go to the binary trace file when one is configured */
+	if (trace && ofono_log_trace_enabled())
+		g_ril_io_set_trace(ril->parent->io, ril_io_trace, ril->parent);
+	else
+		g_ril_io_set_trace(ril->parent->io, NULL, NULL);
+
 	return ril->parent->trace = trace;
 }
 
+gboolean g_ril_set_pipeline_depth(GRil *ril, guint depth)
+{
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	ril->parent->pipeline_depth = depth;
+
+	/* More requests may be eligible for writing now */
+	if (ril->parent->command_queue &&
+			g_queue_peek_head(ril->parent->command_queue))
+		ril_wakeup_writer(ril->parent);
+
+	return TRUE;
+}
+
 gboolean g_ril_set_slot(GRil *ril, int slot)
 {
 	if (ril == NULL || ril->parent == NULL)
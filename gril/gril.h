@@ -59,6 +59,31 @@ typedef void (*GRilNotifyFunc)(struct ril_msg *message, gpointer user_data);
 
 typedef const char *(*GRilMsgIdToStrFunc)(int msg_id);
 
+#define G_RIL_STATS_BUCKETS 16
+
+/*
+ * Counters of a RIL socket.  Time histograms use power of two millisecond
+ * buckets, see ofono_histogram_add.
+ */
+struct _GRilStats {
+	guint requests_sent;		/* Requests fully written */
+	guint replies_matched;		/* Solicited responses received */
+	guint unsolicited;		/* Unsolicited responses received */
+	guint queue_depth;		/* Requests awaiting a response */
+	guint queue_depth_max;		/* Queue high-water mark */
+	guint64 bytes_in;
+	guint64 bytes_out;
+	guint rx_buffer_max;		/* Read ring buffer high-water */
+	guint queue_time[G_RIL_STATS_BUCKETS];
+	guint response_time[G_RIL_STATS_BUCKETS];
+};
+
+typedef struct _GRilStats GRilStats;
+
+/* Called with the unsolicited response name and its count */
+typedef void (*GRilUnsolCountFunc)(const char *name, guint count,
+					gpointer user_data);
+
 /**
  * TRACE:
  * @fmt: format string
@@ -123,12 +148,24 @@ GRil *g_ril_clone(GRil *ril);
 void g_ril_set_disconnect_function(GRil *ril, GRilDisconnectFunc disconnect,
 					gpointer user_data);
 
+gboolean g_ril_get_stats(GRil *ril, GRilStats *stats);
+void g_ril_foreach_unsol_count(GRil *ril, GRilUnsolCountFunc func,
+					gpointer user_data);
+
 gboolean g_ril_get_trace(GRil *ril);
 gboolean g_ril_set_trace(GRil *ril, gboolean trace);
 
 int g_ril_get_slot(GRil *ril);
 gboolean g_ril_set_slot(GRil *ril, int slot);
 
+/*
+ * Allow up to depth requests of each GRil group (a GRil and each of its
+ * clones) to be outstanding at the same time and write urgent requests
+ * (calls, SMS) ahead of background ones (SIM IO, network scans).  A depth
+ * of 0, the default, writes requests in submission order.
+ */
+gboolean g_ril_set_pipeline_depth(GRil *ril, guint depth);
+
 int g_ril_get_version(GRil *ril);
 gboolean g_ril_set_version(GRil *ril, int version);
 
@@ -52,6 +52,11 @@ struct _GRilIO {
 	gpointer write_data;			/* Write callback userdata */
 	GRilDebugFunc debugf;			/* debugging output function */
 	gpointer debug_data;			/* Data to pass to debug func */
+	GRilTraceFunc tracef;			/* raw I/O trace function */
+	gpointer trace_data;			/* Data to pass to trace func */
+	guint64 bytes_in;			/* Total bytes read */
+	guint64 bytes_out;			/* Total bytes written */
+	guint rx_max;				/* Read buffer high-water */
 	GRilDisconnectFunc write_done_func;	/* tx empty notifier */
 	gpointer write_done_data;		/* tx empty data */
 	gboolean destroyed;			/* Re-entrancy guard */
@@ -66,6 +71,8 @@ static void read_watcher_destroy_notify(gpointer user_data)
 
 	io->debugf = NULL;
 	io->debug_data = NULL;
+	io->tracef = NULL;
+	io->trace_data = NULL;
 
 	io->read_watch = 0;
 	io->read_handler = NULL;
@@ -109,6 +116,11 @@ static gboolean received_data(GIOChannel *channel, GIOCondition cond,
 		g_ril_util_debug_hexdump(TRUE, (guchar *) buf, rbytes,
 						io->debugf, io->debug_data);
 
+		if (io->tracef && rbytes > 0)
+			io->tracef(TRUE, buf, rbytes, io->trace_data);
+
+		io->bytes_in += rbytes;
+
 		read_count++;
 
 		total_read += rbytes;
@@ -119,6 +131,9 @@ static gboolean received_data(GIOChannel *channel, GIOCondition cond,
 	} while (status == G_IO_STATUS_NORMAL && rbytes > 0 &&
 					read_count < io->max_read_attempts);
 
+	if (ring_buffer_len(io->buf) > io->rx_max)
+		io->rx_max = ring_buffer_len(io->buf);
+
 	if (total_read > 0 && io->read_handler)
 		io->read_handler(io->buf, io->read_data);
 
@@ -151,6 +166,12 @@ gsize g_ril_io_write(GRilIO *io, const gchar *data, gsize count)
 	g_ril_util_debug_hexdump(FALSE, (guchar *) data, bytes_written,
 				io->debugf, io->debug_data);
 
+	io->bytes_out += bytes_written;
+
+	if (io->tracef && bytes_written > 0)
+		io->tracef(FALSE, (const unsigned char *) data, bytes_written,
+							io->trace_data);
+
 	return bytes_written;
 }
 
@@ -381,6 +402,33 @@ gboolean g_ril_io_set_debug(GRilIO *io, GRilDebugFunc func, gpointer user_data)
 	return TRUE;
 }
 
+gboolean g_ril_io_set_trace(GRilIO *io, GRilTraceFunc func, gpointer user_data)
+{
+	if (io == NULL)
+		return FALSE;
+
+	io->tracef = func;
+	io->trace_data = user_data;
+
+	return TRUE;
+}
+
+void g_ril_io_get_counters(GRilIO *io, guint64 *bytes_in, guint64 *bytes_out,
+							guint *rx_max)
+{
+	if (io == NULL)
+		return;
+
+	if (bytes_in)
+		*bytes_in = io->bytes_in;
+
+	if (bytes_out)
+		*bytes_out = io->bytes_out;
+
+	if (rx_max)
+		*rx_max = io->rx_max;
+}
+
 void g_ril_io_set_write_done(GRilIO *io, GRilDisconnectFunc func,
 				gpointer user_data)
 {
@@ -63,6 +63,9 @@ gboolean g_ril_io_set_disconnect_function(GRilIO *io,
 			GRilDisconnectFunc disconnect, gpointer user_data);
 
 gboolean g_ril_io_set_debug(GRilIO *io, GRilDebugFunc func, gpointer user_data);
+gboolean g_ril_io_set_trace(GRilIO *io, GRilTraceFunc func, gpointer user_data);
+void g_ril_io_get_counters(GRilIO *io, guint64 *bytes_in, guint64 *bytes_out,
+							guint *rx_max);
 
 #ifdef __cplusplus
 }
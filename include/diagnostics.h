@@ -0,0 +1,56 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __OFONO_DIAGNOSTICS_H
+#define __OFONO_DIAGNOSTICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <ofono/types.h>
+#include <ofono/dbus.h>
+#include <ofono/histogram.h>
+
+struct ofono_modem;
+
+/*
+ * Called on every GetChannels request, appends the current counters of
+ * the channel to the a{sv} dictionary iterator.
+ */
+typedef void (*ofono_diagnostics_append_cb_t)(DBusMessageIter *dict,
+						void *data);
+
+unsigned int ofono_diagnostics_add_channel(struct ofono_modem *modem,
+					const char *name,
+					ofono_diagnostics_append_cb_t append,
+					void *data);
+void ofono_diagnostics_remove_channel(struct ofono_modem *modem,
+					unsigned int id);
+
+void ofono_diagnostics_append_histogram(DBusMessageIter *dict,
+					const char *key,
+					const unsigned int *buckets,
+					unsigned int n_buckets);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __OFONO_DIAGNOSTICS_H */
@@ -0,0 +1,52 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __OFONO_HISTOGRAM_H
+#define __OFONO_HISTOGRAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Counts a sample in power of two millisecond buckets: bucket 0 counts
+ * samples below 1ms, bucket n samples below 2^n ms and the last bucket
+ * everything else.  Inline and free of dependencies, so that GAtChat,
+ * GRil and QMI can use it without the core or D-Bus.
+ */
+static inline void ofono_histogram_add(unsigned int *buckets,
+					unsigned int n_buckets,
+					long long usec)
+{
+	unsigned long long ms = usec > 0 ? usec / 1000 : 0;
+	unsigned int i = 0;
+
+	while (ms > 0 && i < n_buckets - 1) {
+		ms >>= 1;
+		i += 1;
+	}
+
+	buckets[i] += 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __OFONO_HISTOGRAM_H */
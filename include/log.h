@@ -26,6 +26,10 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
+
+#include <ofono/types.h>
+
 /**
  * SECTION:log
  * @title: Logging premitives
@@ -41,6 +45,10 @@ extern void ofono_error(const char *format, ...)
 extern void ofono_debug(const char *format, ...)
 				__attribute__((format(printf, 1, 2)));
 
+void ofono_log_trace(const char *tag, ofono_bool_t in,
+					const void *data, size_t len);
+ofono_bool_t ofono_log_trace_enabled(void);
+
 struct ofono_debug_desc {
 	const char *name;
 	const char *file;
@@ -53,6 +53,13 @@ void ofono_phonebook_entry(struct ofono_phonebook *pb, int index,
 				const char *secondtext, const char *email,
 				const char *sip_uri, const char *tel_uri);
 
+/*
+ * Drivers that read a storage in several steps may call this after each
+ * step, so that the entries received so far are passed on to clients
+ * before the whole import has finished
+ */
+void ofono_phonebook_entries_flush(struct ofono_phonebook *pb);
+
 int ofono_phonebook_driver_register(const struct ofono_phonebook_driver *d);
 void ofono_phonebook_driver_unregister(const struct ofono_phonebook_driver *d);
 
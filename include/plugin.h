@@ -44,6 +44,15 @@ understanding that oFono hasn't reached a stable API."
  * @short_description: Functions for declaring plugins
  */
 
+/*
+ * Plugins carrying only data, e.g. lookup tables, that nothing needs
+ * during startup.  Their init is run once the main loop is up, so
+ * ofonod can serve D-Bus requests while they are still loading.  Not
+ * for plugins registering drivers that atoms look up when registered,
+ * a modem coming up first would find no driver.
+ */
+#define OFONO_PLUGIN_FLAG_DEFERRED	0x1
+
 struct ofono_plugin_desc {
 	const char *name;
 	const char *description;
@@ -53,25 +62,33 @@ struct ofono_plugin_desc {
 	void (*exit) (void);
 	void *debug_start;
 	void *debug_stop;
+	unsigned int flags;
+	const char *depends;
 };
 
 /**
- * OFONO_PLUGIN_DEFINE:
+ * OFONO_PLUGIN_DEFINE_FULL:
  * @name: plugin name
  * @description: plugin description
  * @version: plugin version string
  * @init: init function called on plugin loading
  * @exit: exit function called on plugin removal
+ * @flags: OFONO_PLUGIN_FLAG_* values
+ * @depends: space separated names of the plugins that have to be
+ *	initialized before this one, or NULL
  *
- * Macro for defining a plugin descriptor
+ * Macro for defining a plugin descriptor with scheduling hints
  */
 #ifdef OFONO_PLUGIN_BUILTIN
-#define OFONO_PLUGIN_DEFINE(name, description, version, priority, init, exit) \
+#define OFONO_PLUGIN_DEFINE_FULL(name, description, version, priority, \
+					init, exit, flags, depends) \
 		struct ofono_plugin_desc __ofono_builtin_ ## name = { \
-			#name, description, version, priority, init, exit \
+			#name, description, version, priority, init, exit, \
+			NULL, NULL, flags, depends \
 		};
 #else
-#define OFONO_PLUGIN_DEFINE(name, description, version, priority, init, exit) \
+#define OFONO_PLUGIN_DEFINE_FULL(name, description, version, priority, \
+					init, exit, flags, depends) \
 		extern struct ofono_debug_desc __start___debug[] \
 				__attribute__ ((weak, visibility("hidden"))); \
 		extern struct ofono_debug_desc __stop___debug[] \
@@ -80,10 +97,24 @@ struct ofono_plugin_desc {
 				__attribute__ ((visibility("default"))); \
 		struct ofono_plugin_desc ofono_plugin_desc = { \
 			#name, description, version, priority, init, exit, \
-			__start___debug, __stop___debug \
+			__start___debug, __stop___debug, flags, depends \
 		};
 #endif
 
+/**
+ * OFONO_PLUGIN_DEFINE:
+ * @name: plugin name
+ * @description: plugin description
+ * @version: plugin version string
+ * @init: init function called on plugin loading
+ * @exit: exit function called on plugin removal
+ *
+ * Macro for defining a plugin descriptor
+ */
+#define OFONO_PLUGIN_DEFINE(name, description, version, priority, init, exit) \
+		OFONO_PLUGIN_DEFINE_FULL(name, description, version, priority, \
+						init, exit, 0, NULL)
+
 #ifdef __cplusplus
 }
 #endif
@@ -145,6 +145,10 @@ struct ofono_sim_driver {
 			int record, int length,
 			const unsigned char *path, unsigned int path_len,
 			ofono_sim_read_cb_t cb, void *data);
+	void (*read_file_linear_records)(struct ofono_sim *sim, int fileid,
+			int record, int count, int length,
+			const unsigned char *path, unsigned int path_len,
+			ofono_sim_read_cb_t cb, void *data);
 	void (*write_file_transparent)(struct ofono_sim *sim, int fileid,
 			int start, int length, const unsigned char *value,
 			const unsigned char *path, unsigned int path_len,
@@ -193,7 +197,14 @@ void ofono_sim_remove(struct ofono_sim *sim);
 void ofono_sim_set_data(struct ofono_sim *sim, void *data);
 void *ofono_sim_get_data(struct ofono_sim *sim);
 
+/*
+ * Drivers able to run several file operations at once can raise the
+ * number simfs keeps in flight, the default is one
+ */
+void ofono_sim_set_max_pending_reads(struct ofono_sim *sim, unsigned int count);
+
 const char *ofono_sim_get_imsi(struct ofono_sim *sim);
+const char *ofono_sim_get_iccid(struct ofono_sim *sim);
 const char *ofono_sim_get_mcc(struct ofono_sim *sim);
 const char *ofono_sim_get_mnc(struct ofono_sim *sim);
 const char *ofono_sim_get_spn(struct ofono_sim *sim);
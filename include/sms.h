@@ -51,6 +51,11 @@ struct ofono_sms_driver {
 	void (*sca_set)(struct ofono_sms *sms,
 			const struct ofono_phone_number *sca,
 			ofono_sms_sca_set_cb_t cb, void *data);
+	/*
+	 * mms takes the values of 27.005 +CMMS: 0 when this is the last
+	 * PDU queued, 1 when another follows, 2 while a longer burst is
+	 * in progress and the link should stay up until told otherwise
+	 */
 	void (*submit)(struct ofono_sms *sms, const unsigned char *pdu,
 			int pdu_len, int tpdu_len, int mms,
 			ofono_sms_submit_cb_t cb, void *data);
@@ -39,10 +39,17 @@
 #include <ofono/plugin.h>
 #include <ofono/spn-table.h>
 
+#include "storage.h"
+#include "strtable.h"
+
 /* TODO: consider reading path from an environment variable */
 #define ANDROID_SPN_DATABASE "/system/etc/spn-conf.xml"
 
-static GHashTable *android_spn_table;
+/* Compiled form of the database, reused until the XML file changes */
+#define ANDROID_SPN_CACHE STORAGEDIR "/spn-table"
+
+static struct str_table *android_spn_table;
+static GThread *android_spn_loader;
 
 static void android_spndb_g_set_error(GMarkupParseContext *context,
 					GError **error,
@@ -70,12 +77,10 @@ static void toplevel_spndb_start(GMarkupParseContext *context,
 					const gchar **attribute_values,
 					gpointer userdata, GError **error)
 {
-	GHashTable *spn_table = userdata;
+	struct str_table_builder *builder = userdata;
 	int i;
 	const gchar *numeric = NULL;
 	const gchar *spn = NULL;
-	char *numeric_dup;
-	char *spn_dup;
 
 	if (!g_str_equal(element_name, "spnOverride"))
 		return;
@@ -101,12 +106,8 @@ static void toplevel_spndb_start(GMarkupParseContext *context,
 		return;
 	}
 
-	numeric_dup = g_malloc(strlen(numeric) + 1);
-	strcpy(numeric_dup, numeric);
-	spn_dup = g_malloc(strlen(spn) + 1);
-	strcpy(spn_dup, spn);
-
-	g_hash_table_insert(spn_table, numeric_dup, spn_dup);
+	/* Entries that aren't plain MCC/MNC pairs can never match */
+	str_table_builder_add(builder, numeric, spn);
 }
 
 static void toplevel_spndb_end(GMarkupParseContext *context,
@@ -177,9 +178,66 @@ static gboolean android_spndb_parse(const GMarkupParser *parser,
 	return ret;
 }
 
+static guint64 android_spndb_stamp(const struct stat *st)
+{
+	return (guint64) st->st_mtime << 32 ^ st->st_size;
+}
+
+/*
+ * When the compiled table is missing or stale, the database is parsed
+ * by a worker thread started from the plugin init, which owns the table
+ * until it is joined.  Lookups are then served from a mapping of the
+ * compiled file, falling back to the in-memory copy if it can't be
+ * written.
+ */
+static gpointer android_spn_table_load(gpointer user_data)
+{
+	guint64 stamp = *(guint64 *) user_data;
+	struct str_table_builder *builder;
+	struct str_table *table;
+	GError *error = NULL;
+	unsigned char *data;
+	size_t len;
+
+	g_free(user_data);
+
+	builder = str_table_builder_new();
+
+	if (android_spndb_parse(&toplevel_spndb_parser, builder,
+				&error) == FALSE) {
+		str_table_builder_free(builder);
+		g_clear_error(&error);
+		return NULL;
+	}
+
+	data = str_table_builder_finish(builder, stamp, &len);
+
+	if (write_file(data, len, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH,
+					ANDROID_SPN_CACHE) == (ssize_t) len) {
+		table = str_table_open(ANDROID_SPN_CACHE);
+		if (table != NULL) {
+			g_free(data);
+			return table;
+		}
+	}
+
+	return str_table_new(data, len);
+}
+
+static void android_spn_table_wait(void)
+{
+	if (android_spn_loader == NULL)
+		return;
+
+	android_spn_table = g_thread_join(android_spn_loader);
+	android_spn_loader = NULL;
+}
+
 static const char *android_get_spn(const char *numeric)
 {
-	return g_hash_table_lookup(android_spn_table, numeric);
+	android_spn_table_wait();
+
+	return str_table_lookup(android_spn_table, numeric);
 }
 
 static struct ofono_spn_table_driver android_spn_table_driver = {
@@ -190,18 +248,36 @@ static struct ofono_spn_table_driver android_spn_table_driver = {
 static int android_spn_table_init(void)
 {
 	GError *error = NULL;
+	struct stat st;
+	guint64 *stamp;
 
-	android_spn_table = g_hash_table_new_full(g_str_hash, g_str_equal,
-							g_free, g_free);
+	if (access(ANDROID_SPN_DATABASE, R_OK) < 0 ||
+				stat(ANDROID_SPN_DATABASE, &st) < 0)
+		return -errno;
 
-	if (android_spndb_parse(&toplevel_spndb_parser, android_spn_table,
-				&error) == FALSE) {
-		g_hash_table_destroy(android_spn_table);
-		android_spn_table = NULL;
+	android_spn_table = str_table_open(ANDROID_SPN_CACHE);
+	if (android_spn_table != NULL && str_table_get_stamp(android_spn_table)
+						== android_spndb_stamp(&st))
+		goto done;
+
+	str_table_free(android_spn_table);
+	android_spn_table = NULL;
+
+	stamp = g_new(guint64, 1);
+	*stamp = android_spndb_stamp(&st);
+
+	android_spn_loader = g_thread_try_new("spn-table",
+						android_spn_table_load,
+						stamp, &error);
+	if (android_spn_loader == NULL) {
+		ofono_error("Can't start SPN table loader: %s",
+							error->message);
 		g_clear_error(&error);
-		return -EINVAL;
+		g_free(stamp);
+		return -EIO;
 	}
 
+done:
 	return ofono_spn_table_driver_register(&android_spn_table_driver);
 }
 
@@ -209,9 +285,13 @@ static void android_spn_table_exit(void)
 {
 	ofono_spn_table_driver_unregister(&android_spn_table_driver);
 
-	g_hash_table_destroy(android_spn_table);
+	android_spn_table_wait();
+
+	str_table_free(android_spn_table);
+	android_spn_table = NULL;
 }
 
-OFONO_PLUGIN_DEFINE(androidspntable, "Android SPN table Plugin", VERSION,
+OFONO_PLUGIN_DEFINE_FULL(androidspntable, "Android SPN table Plugin", VERSION,
 			OFONO_PLUGIN_PRIORITY_DEFAULT,
-			android_spn_table_init, android_spn_table_exit)
+			android_spn_table_init, android_spn_table_exit,
+			OFONO_PLUGIN_FLAG_DEFERRED, NULL)
@@ -40,6 +40,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <arpa/nameser.h>
 #include <sys/time.h>
 
 #include <ares.h>
@@ -52,6 +53,30 @@
 #include <ofono/modem.h>
 #include <ofono/dns-client.h>
 
+/*
+ * Answers are cached for the lifetime given by their TTL, clamped to the
+ * range below.  Failed lookups for names that do not exist are cached
+ * for DNS_CACHE_NEGATIVE_TTL seconds.  An entry that has been hit more
+ * than once is refreshed in the background once less than a quarter of
+ * its lifetime is left, so that regular users never see it expire.
+ */
+#define DNS_CACHE_MIN_TTL	10
+#define DNS_CACHE_MAX_TTL	86400
+#define DNS_CACHE_NEGATIVE_TTL	60
+#define DNS_CACHE_SIZE		32
+#define DNS_CACHE_MAX_ADDRS	8
+
+struct dns_cache_entry {
+	ofono_dns_client_status_t status;
+	struct sockaddr_in addr;  /* valid if status is success */
+	gint64 expires;  /* monotonic time, in microseconds */
+	gint64 lifetime;  /* microseconds */
+	char *interface;  /* used for the background refresh */
+	char **servers;
+	unsigned int hits;
+	gboolean refreshing;
+};
+
 /* Structure representing a pending asynchronous name resolution request. */
 struct ares_request {
 	char *hostname;  /* hostname that we're resolving */
@@ -65,6 +90,10 @@ struct ares_request {
 	GHashTable *ares_watches;  /* fds that we're monitoring for c-ares */
 	guint timeout_source_id;  /* glib source id for our ares timeout */
 	gboolean running;  /* stopped requests are eligible for deletion */
+	char *cache_key;  /* key of the answer in |dns_cache| */
+	guint cached_source_id;  /* glib source id delivering a cached answer */
+	ofono_dns_client_status_t cached_status;
+	struct sockaddr_in cached_addr;
 };
 
 /*
@@ -105,12 +134,30 @@ static int req_using_dev_cnt;
  */
 static guint deferred_deletion_g_source_id;
 
+/*
+ * Answers of past requests. Key is built from the interface, the name
+ * servers and the hostname of the request, so that answers obtained over
+ * one context are never handed out for another.
+ */
+static GHashTable *dns_cache;
+
 static void reset_ares_timeout(struct ares_request *request,
 			       gboolean destroy_old_source);
 static void stop_ares_request(struct ares_request *request);
 
 #define IFACE_ALL "all"
 
+/* Background refreshes have no client to notify */
+static void request_notify(struct ares_request *request,
+				ofono_dns_client_status_t status,
+				struct sockaddr *ip_addr)
+{
+	if (request->cb == NULL)
+		return;
+
+	request->cb(request->data, status, ip_addr);
+}
+
 /*
  * Set/unset rp_filter file content for an interface (from connman)
  */
@@ -235,8 +282,7 @@ static void reset_ares_timeout(struct ares_request *request,
 	timeout_provided = request->timeout.tv_sec != 0 ||
 			   request->timeout.tv_usec != 0;
 	if (timeout_provided && timercmp(&elapsed, &request->timeout, >=)) {
-		request->cb(request->data, OFONO_DNS_CLIENT_ERROR_TIMED_OUT,
-			    NULL);
+		request_notify(request, OFONO_DNS_CLIENT_ERROR_TIMED_OUT, NULL);
 		stop_ares_request(request);
 		return;
 	}
@@ -405,7 +451,13 @@ static void destroy_ares_request(struct ares_request *request)
 
 	DBG("request %p", request);
 
-	ares_destroy(request->channel);
+	if (request->channel != NULL)
+		ares_destroy(request->channel);
+
+	if (request->cached_source_id != 0)
+		g_source_remove(request->cached_source_id);
+
+	g_free(request->cache_key);
 	g_free(request->hostname);
 	if (request->interface) {
 		enable_rp_filter(request->interface);
@@ -418,7 +470,8 @@ static void destroy_ares_request(struct ares_request *request)
 	if (request->timeout_source_id != 0)
 		g_source_remove(request->timeout_source_id);
 	/* Hash table destruction calls destroy_ares_watch on all watches. */
-	g_hash_table_destroy(request->ares_watches);
+	if (request->ares_watches != NULL)
+		g_hash_table_destroy(request->ares_watches);
 	g_free(request);
 }
 
@@ -467,6 +520,18 @@ static void stop_ares_request(struct ares_request *request)
 
 	request->running = FALSE;
 
+	/*
+	 * A background refresh ends here whether it got an answer, failed
+	 * or timed out, the entry can then be refreshed or evicted again.
+	 */
+	if (request->cb == NULL && request->cache_key != NULL) {
+		struct dns_cache_entry *entry;
+
+		entry = g_hash_table_lookup(dns_cache, request->cache_key);
+		if (entry != NULL)
+			entry->refreshing = FALSE;
+	}
+
 	if (deferred_deletion_g_source_id != 0)
 		return;
 
@@ -560,7 +625,7 @@ static void ares_request_cb(void *arg, int ares_status, int timeouts,
 		DBG("ares request for '%s' failed: %s",
 				request->hostname, ares_strerror(ares_status));
 		/* Notify client. */
-		request->cb(request->data, status_from_ares_status(ares_status),
+		request_notify(request, status_from_ares_status(ares_status),
 				NULL);
 		return;
 	}
@@ -568,8 +633,7 @@ static void ares_request_cb(void *arg, int ares_status, int timeouts,
 	if (hostent->h_addrtype != AF_INET && hostent->h_addrtype != AF_INET6) {
 		ofono_error("%s: unsupported addrtype: %d",
 				__func__, hostent->h_addrtype);
-		request->cb(request->data, OFONO_DNS_CLIENT_ERROR_NO_DATA,
-				NULL);
+		request_notify(request, OFONO_DNS_CLIENT_ERROR_NO_DATA, NULL);
 		return;
 	}
 
@@ -590,8 +654,7 @@ static void ares_request_cb(void *arg, int ares_status, int timeouts,
 	if (hostent->h_length > addr_length) {
 		ofono_error("%s: address too large: %u bytes",
 				__func__, hostent->h_length);
-		request->cb(request->data, OFONO_DNS_CLIENT_ERROR_NO_DATA,
-				NULL);
+		request_notify(request, OFONO_DNS_CLIENT_ERROR_NO_DATA, NULL);
 		return;
 	}
 
@@ -601,15 +664,180 @@ static void ares_request_cb(void *arg, int ares_status, int timeouts,
 			sizeof(ip_addr_string)) == NULL) {
 		ofono_error("%s: could not convert address to string: %s",
 				__func__, strerror(errno));
-		request->cb(request->data, OFONO_DNS_CLIENT_ERROR_NO_DATA,
-				NULL);
+		request_notify(request, OFONO_DNS_CLIENT_ERROR_NO_DATA, NULL);
 		return;
 	}
 
 	DBG("ares request for '%s' succeeded with %d timeouts: %s",
 			request->hostname, timeouts, ip_addr_string);
-	request->cb(request->data, status_from_ares_status(ares_status),
-			ip_addr);
+	request_notify(request, status_from_ares_status(ares_status), ip_addr);
+}
+
+static void dns_cache_entry_free(gpointer data)
+{
+	struct dns_cache_entry *entry = data;
+
+	g_free(entry->interface);
+	g_strfreev(entry->servers);
+	g_free(entry);
+}
+
+static char *dns_cache_key(const char *hostname, const char *interface,
+						const char **servers)
+{
+	GString *key = g_string_new(interface);
+	const char **dns;
+
+	for (dns = servers; dns != NULL && *dns != NULL; ++dns)
+		g_string_append_printf(key, ",%s", *dns);
+
+	g_string_append_printf(key, "/%s", hostname);
+
+	return g_string_free(key, FALSE);
+}
+
+/* Make room for a new entry, dropping expired ones first */
+static void dns_cache_evict(gint64 now)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	gpointer oldest = NULL;
+	gint64 oldest_expiry = G_MAXINT64;
+
+	g_hash_table_iter_init(&iter, dns_cache);
+
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct dns_cache_entry *entry = value;
+
+		if (entry->refreshing)
+			continue;
+
+		if (entry->expires <= now) {
+			g_hash_table_iter_remove(&iter);
+			continue;
+		}
+
+		if (entry->expires < oldest_expiry) {
+			oldest_expiry = entry->expires;
+			oldest = key;
+		}
+	}
+
+	if (g_hash_table_size(dns_cache) >= DNS_CACHE_SIZE && oldest != NULL)
+		g_hash_table_remove(dns_cache, oldest);
+}
+
+static void dns_cache_store(struct ares_request *request, int ares_status,
+				struct hostent *hostent,
+				struct ares_addrttl *addrttls, int naddrttls)
+{
+	struct dns_cache_entry *entry;
+	gint64 now = g_get_monotonic_time();
+	int ttl;
+	int i;
+
+	entry = g_hash_table_lookup(dns_cache, request->cache_key);
+	if (entry != NULL)
+		entry->refreshing = FALSE;
+
+	switch (ares_status) {
+	case ARES_SUCCESS:
+		if (hostent->h_addrtype != AF_INET || naddrttls <= 0)
+			return;
+
+		ttl = DNS_CACHE_MAX_TTL;
+
+		for (i = 0; i < naddrttls; i++)
+			ttl = MIN(ttl, addrttls[i].ttl);
+
+		if (ttl <= 0)
+			return;
+
+		ttl = MAX(ttl, DNS_CACHE_MIN_TTL);
+		break;
+	case ARES_ENOTFOUND:
+	case ARES_ENODATA:
+		ttl = DNS_CACHE_NEGATIVE_TTL;
+		break;
+	default:
+		/* Transient failures are retried on the next request */
+		return;
+	}
+
+	if (entry == NULL) {
+		if (g_hash_table_size(dns_cache) >= DNS_CACHE_SIZE)
+			dns_cache_evict(now);
+
+		if (g_hash_table_size(dns_cache) >= DNS_CACHE_SIZE)
+			return;
+
+		entry = g_new0(struct dns_cache_entry, 1);
+		entry->interface = g_strdup(request->interface);
+		g_hash_table_insert(dns_cache, g_strdup(request->cache_key),
+								entry);
+	}
+
+	g_strfreev(entry->servers);
+	entry->servers = NULL;
+
+	if (request->servers != NULL) {
+		struct ares_addr_node *node;
+		GPtrArray *servers = g_ptr_array_new();
+		char buf[INET6_ADDRSTRLEN];
+
+		for (node = request->servers; node != NULL; node = node->next) {
+			if (inet_ntop(node->family, &node->addr, buf,
+							sizeof(buf)) != NULL)
+				g_ptr_array_add(servers, g_strdup(buf));
+		}
+
+		g_ptr_array_add(servers, NULL);
+		entry->servers = (char **) g_ptr_array_free(servers, FALSE);
+	}
+
+	entry->status = status_from_ares_status(ares_status);
+	entry->lifetime = (gint64) ttl * G_USEC_PER_SEC;
+	entry->expires = now + entry->lifetime;
+	entry->hits = 0;
+
+	memset(&entry->addr, 0, sizeof(entry->addr));
+
+	if (ares_status == ARES_SUCCESS) {
+		entry->addr.sin_family = AF_INET;
+		memcpy(&entry->addr.sin_addr.s_addr, &addrttls[0].ipaddr,
+					sizeof(entry->addr.sin_addr.s_addr));
+	}
+
+	DBG("cached '%s' for %d seconds", request->hostname, ttl);
+}
+
+/*
+ * Callback invoked by c-ares with the raw answer to a query, which unlike
+ * the hostent based interface carries the TTLs we need for caching.
+ */
+static void ares_query_cb(void *arg, int ares_status, int timeouts,
+				unsigned char *abuf, int alen)
+{
+	struct ares_request *request = arg;
+	struct ares_addrttl addrttls[DNS_CACHE_MAX_ADDRS];
+	int naddrttls = DNS_CACHE_MAX_ADDRS;
+	struct hostent *hostent = NULL;
+
+	DBG("");
+
+	if (!request->running)
+		return;
+
+	if (ares_status == ARES_SUCCESS)
+		ares_status = ares_parse_a_reply(abuf, alen, &hostent,
+							addrttls, &naddrttls);
+
+	dns_cache_store(request, ares_status, hostent, addrttls, naddrttls);
+
+	ares_request_cb(request, ares_status, timeouts, hostent);
+
+	if (hostent != NULL)
+		ares_free_hostent(hostent);
 }
 
 /* Cancel all in-progress asynchronous name resolution requests. */
@@ -657,28 +885,22 @@ static void set_request_servers(const char **servers,
 	}
 }
 
-/* Initiate an asynchronous name resolution request. */
-static ofono_dns_client_request_t
-ofono_dns_client_submit_request(const char *hostname,
+/* Start a c-ares lookup for |hostname| */
+static struct ares_request *start_ares_request(const char *hostname,
 				const char *interface,
 				const char **servers,
 				int timeout_ms,
+				char *cache_key,
 				ofono_dns_client_callback_t cb,
 				void *data)
 {
 	int ares_status;
 	struct ares_request *request;
 	struct ares_options options;
+	struct in_addr literal;
 	int optmask;
 	const gboolean destroy_old_source = TRUE;
 
-	DBG("");
-
-	if (timeout_ms < 0) {
-		DBG("invalid timeout value of %d ms", timeout_ms);
-		return NULL;
-	}
-
 	request = g_malloc0(sizeof(struct ares_request));
 	request->running = TRUE;
 
@@ -688,6 +910,7 @@ ofono_dns_client_submit_request(const char *hostname,
 		ofono_error("%s: could not create ares_watches table",
 								__func__);
 		g_free(request);
+		g_free(cache_key);
 		return NULL;
 	}
 
@@ -712,6 +935,7 @@ ofono_dns_client_submit_request(const char *hostname,
 		request->running = FALSE;  /* don't trip assertion */
 		g_hash_table_destroy(request->ares_watches);
 		g_free(request);
+		g_free(cache_key);
 		return NULL;
 	}
 
@@ -747,20 +971,136 @@ ofono_dns_client_submit_request(const char *hostname,
 	request->cb = cb;
 	request->data = data;
 	request->hostname = g_strdup(hostname);
+	request->cache_key = cache_key;
 	request->timeout.tv_sec = timeout_ms / 1000;
 	request->timeout.tv_usec = (timeout_ms % 1000) * 1000;
 	gettimeofday(&request->start_time, NULL);
 
 	pending_requests = g_list_append(pending_requests, request);
 
-	ares_gethostbyname(request->channel, hostname, AF_INET,
+	/* Literal addresses need no query, and there is nothing to cache */
+	if (inet_pton(AF_INET, hostname, &literal) == 1)
+		ares_gethostbyname(request->channel, hostname, AF_INET,
 						ares_request_cb, request);
+	else
+		ares_search(request->channel, hostname, ns_c_in, ns_t_a,
+						ares_query_cb, request);
 
 	reset_ares_timeout(request, destroy_old_source);
 
 	return request;
 }
 
+/*
+ * Callback invoked from the main loop to hand out a cached answer, so that
+ * clients get called back the same way as for a real lookup.
+ */
+static gboolean cached_reply_cb(gpointer data)
+{
+	struct ares_request *request = data;
+
+	request->cached_source_id = 0;
+
+	if (!request->running)
+		return FALSE;
+
+	stop_ares_request(request);
+
+	if (request->cached_status == OFONO_DNS_CLIENT_SUCCESS)
+		request_notify(request, request->cached_status,
+				(struct sockaddr *) &request->cached_addr);
+	else
+		request_notify(request, request->cached_status, NULL);
+
+	return FALSE;
+}
+
+static void dns_cache_refresh(const char *key, struct dns_cache_entry *entry,
+				const char *hostname, int timeout_ms)
+{
+	struct ares_request *request;
+
+	DBG("refreshing '%s' in the background", hostname);
+
+	/* Set first, c-ares may fail the query before returning */
+	entry->refreshing = TRUE;
+
+	request = start_ares_request(hostname, entry->interface,
+					(const char **) entry->servers,
+					timeout_ms, g_strdup(key), NULL, NULL);
+	if (request == NULL)
+		entry->refreshing = FALSE;
+}
+
+static struct ares_request *dns_cache_lookup(const char *hostname,
+						const char *key,
+						int timeout_ms,
+						ofono_dns_client_callback_t cb,
+						void *data)
+{
+	struct dns_cache_entry *entry;
+	struct ares_request *request;
+	gint64 now = g_get_monotonic_time();
+
+	entry = g_hash_table_lookup(dns_cache, key);
+	if (entry == NULL || entry->expires <= now)
+		return NULL;
+
+	entry->hits++;
+
+	DBG("cache hit for '%s', expires in %" G_GINT64_FORMAT " s",
+			hostname, (entry->expires - now) / G_USEC_PER_SEC);
+
+	request = g_malloc0(sizeof(struct ares_request));
+	request->running = TRUE;
+	request->cb = cb;
+	request->data = data;
+	request->hostname = g_strdup(hostname);
+	request->cached_status = entry->status;
+	request->cached_addr = entry->addr;
+	request->cached_source_id = g_idle_add(cached_reply_cb, request);
+
+	pending_requests = g_list_append(pending_requests, request);
+
+	if (entry->status == OFONO_DNS_CLIENT_SUCCESS && entry->hits > 1 &&
+			!entry->refreshing &&
+			entry->expires - now < entry->lifetime / 4)
+		dns_cache_refresh(key, entry, hostname, timeout_ms);
+
+	return request;
+}
+
+/* Initiate an asynchronous name resolution request. */
+static ofono_dns_client_request_t
+ofono_dns_client_submit_request(const char *hostname,
+				const char *interface,
+				const char **servers,
+				int timeout_ms,
+				ofono_dns_client_callback_t cb,
+				void *data)
+{
+	struct ares_request *request;
+	char *key;
+
+	DBG("");
+
+	if (timeout_ms < 0) {
+		DBG("invalid timeout value of %d ms", timeout_ms);
+		return NULL;
+	}
+
+	key = dns_cache_key(hostname, interface, servers);
+
+	request = dns_cache_lookup(hostname, key, timeout_ms, cb, data);
+	if (request != NULL) {
+		g_free(key);
+		return request;
+	}
+
+	return start_ares_request(hostname, interface, servers, timeout_ms,
+							key, cb, data);
+}
+
 /* Cancel an in-progress name resolution request. */
 static gboolean ofono_dns_client_cancel_request(ofono_dns_client_request_t req)
 {
@@ -802,6 +1142,9 @@ static int c_ares_init(void)
 	req_per_dev_cnt = g_tree_new_full((GCompareDataFunc) strcmp, NULL,
 								g_free, g_free);
 
+	dns_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free, dns_cache_entry_free);
+
 	return ofono_dns_client_driver_register(&dns_driver);
 }
 
@@ -821,6 +1164,10 @@ static void c_ares_exit(void)
 		deferred_deletion_g_source_id = 0;
 	}
 	cancel_all_ares_requests();
+
+	g_hash_table_destroy(dns_cache);
+	dns_cache = NULL;
+
 	ares_library_cleanup();
 }
 
@@ -56,6 +56,7 @@
 #include <ofono/voicecall.h>
 #include <ofono/stk.h>
 
+#include <drivers/atmodem/atutil.h>
 #include <drivers/atmodem/vendor.h>
 
 #define CALYPSO_POWER_PATH "/sys/bus/platform/devices/gta02-pm-gsm.0/power_on"
@@ -276,9 +277,11 @@ static void mux_setup(GAtMux *mux, gpointer user_data)
 		g_at_syntax_unref(syntax);
 		g_io_channel_unref(io);
 
-		if (getenv("OFONO_AT_DEBUG"))
+		if (getenv("OFONO_AT_DEBUG")) {
 			g_at_chat_set_debug(data->dlcs[i], calypso_debug,
 							debug_prefixes[i]);
+			at_util_set_trace(data->dlcs[i], debug_prefixes[i]);
+		}
 
 		g_at_chat_set_wakeup_command(data->dlcs[i], "AT\r", 500, 5000);
 	}
@@ -327,8 +330,10 @@ static void modem_initialize(struct ofono_modem *modem)
 	if (chat == NULL)
 		goto error;
 
-	if (getenv("OFONO_AT_DEBUG") != NULL)
+	if (getenv("OFONO_AT_DEBUG") != NULL) {
 		g_at_chat_set_debug(chat, calypso_debug, "Setup: ");
+		at_util_set_trace(chat, "Setup: ");
+	}
 
 	g_at_chat_set_wakeup_command(chat, "AT\r", 500, 5000);
 
@@ -120,8 +120,10 @@ static int cinterion_enable(struct ofono_modem *modem)
 	if (chat == NULL)
 		return -ENOMEM;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, cinterion_debug, "");
+		at_util_set_trace(chat, "");
+	}
 
 	ofono_modem_set_data(modem, chat);
 
@@ -48,6 +48,7 @@
 #include <ofono/ussd.h>
 #include <ofono/voicecall.h>
 
+#include <drivers/atmodem/atutil.h>
 #include <drivers/atmodem/vendor.h>
 
 static void g1_debug(const char *str, void *user_data)
@@ -113,8 +114,10 @@ static int g1_enable(struct ofono_modem *modem)
 	if (chat == NULL)
 		return -EIO;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, g1_debug, "");
+		at_util_set_trace(chat, "");
+	}
 
 	ofono_modem_set_data(modem, chat);
 
@@ -43,6 +43,7 @@
 #include <ofono/gprs-context.h>
 #include <ofono/radio-settings.h>
 #include <ofono/location-reporting.h>
+#include <ofono/diagnostics.h>
 #include <ofono/log.h>
 
 #include <drivers/qmimodem/qmi.h>
@@ -66,8 +67,37 @@ struct gobi_data {
 	unsigned long features;
 	unsigned int discover_attempts;
 	uint8_t oper_mode;
+	unsigned int diag_id;
 };
 
+static void gobi_diagnostics_append(DBusMessageIter *dict, void *user_data)
+{
+	struct gobi_data *data = user_data;
+	struct qmi_stats stats;
+
+	if (!qmi_device_get_stats(data->device, &stats))
+		return;
+
+	ofono_dbus_dict_append(dict, "RequestsSent", DBUS_TYPE_UINT32,
+					&stats.requests_sent);
+	ofono_dbus_dict_append(dict, "RepliesMatched", DBUS_TYPE_UINT32,
+					&stats.replies_matched);
+	ofono_dbus_dict_append(dict, "Unsolicited", DBUS_TYPE_UINT32,
+					&stats.indications);
+	ofono_dbus_dict_append(dict, "QueueDepth", DBUS_TYPE_UINT32,
+					&stats.queue_depth);
+	ofono_dbus_dict_append(dict, "QueueDepthMax", DBUS_TYPE_UINT32,
+					&stats.queue_depth_max);
+	ofono_dbus_dict_append(dict, "BytesIn", DBUS_TYPE_UINT64,
+					&stats.bytes_in);
+	ofono_dbus_dict_append(dict, "BytesOut", DBUS_TYPE_UINT64,
+					&stats.bytes_out);
+	ofono_diagnostics_append_histogram(dict, "QueueTime",
+					stats.queue_time, QMI_STATS_BUCKETS);
+	ofono_diagnostics_append_histogram(dict, "ResponseTime",
+					stats.response_time, QMI_STATS_BUCKETS);
+}
+
 static void gobi_debug(const char *str, void *user_data)
 {
 	const char *prefix = user_data;
@@ -98,6 +128,8 @@ static void gobi_remove(struct ofono_modem *modem)
 
 	ofono_modem_set_data(modem, NULL);
 
+	ofono_diagnostics_remove_channel(modem, data->diag_id);
+
 	qmi_service_unref(data->dms);
 
 	qmi_device_unref(data->device);
@@ -114,6 +146,9 @@ static void shutdown_cb(void *user_data)
 
 	data->discover_attempts = 0;
 
+	ofono_diagnostics_remove_channel(modem, data->diag_id);
+	data->diag_id = 0;
+
 	qmi_device_unref(data->device);
 	data->device = NULL;
 
@@ -328,6 +363,9 @@ static int gobi_enable(struct ofono_modem *modem)
 
 	qmi_device_set_close_on_unref(data->device, true);
 
+	data->diag_id = ofono_diagnostics_add_channel(modem, "QMI",
+					gobi_diagnostics_append, data);
+
 	qmi_device_discover(data->device, discover_cb, modem, NULL);
 
 	return -EINPROGRESS;
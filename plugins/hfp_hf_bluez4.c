@@ -46,6 +46,7 @@
 #include <ofono/handsfree.h>
 #include <ofono/siri.h>
 
+#include <drivers/atmodem/atutil.h>
 #include <drivers/hfpmodem/slc.h>
 
 #include "bluez4.h"
@@ -150,8 +151,10 @@ static int service_level_connection(struct ofono_modem *modem, int fd)
 
 	g_at_chat_set_disconnect_function(chat, hfp_disconnected_cb, modem);
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, hfp_debug, "");
+		at_util_set_trace(chat, "");
+	}
 
 	data->info.chat = chat;
 	hfp_slc_establish(&data->info, slc_established, slc_failed, modem);
@@ -165,8 +165,10 @@ static int service_level_connection(struct ofono_modem *modem,
 
 	g_at_chat_set_disconnect_function(chat, hfp_disconnected_cb, modem);
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, hfp_debug, "");
+		at_util_set_trace(chat, "");
+	}
 
 	hfp_slc_info_init(info, version);
 	info->chat = chat;
@@ -578,8 +578,10 @@ static GAtChat *open_device(struct ofono_modem *modem,
 	g_at_chat_add_terminator(chat, "COMMAND NOT SUPPORT", -1, FALSE);
 	g_at_chat_add_terminator(chat, "TOO MANY PARAMETERS", -1, FALSE);
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, huawei_debug, debug);
+		at_util_set_trace(chat, debug);
+	}
 
 	return chat;
 }
@@ -128,8 +128,10 @@ static GAtChat *open_device(struct ofono_modem *modem,
 	if (chat == NULL)
 		return NULL;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, icera_debug, debug);
+		at_util_set_trace(chat, debug);
+	}
 
 	return chat;
 }
@@ -283,8 +283,10 @@ static GAtChat *create_chat(GIOChannel *channel, struct ofono_modem *modem,
 	if (chat == NULL)
 		return NULL;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, ifx_debug, debug);
+		at_util_set_trace(chat, debug);
+	}
 
 	g_at_chat_set_disconnect_function(chat, dlc_disconnect, modem);
 
@@ -570,8 +572,10 @@ static int ifx_enable(struct ofono_modem *modem)
 		return -EIO;
 	}
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, ifx_debug, "Master: ");
+		at_util_set_trace(chat, "Master: ");
+	}
 
 	g_at_chat_send(chat, "ATE0 +CMEE=1", NULL,
 					NULL, NULL, NULL);
@@ -326,8 +326,10 @@ static int mbm_enable(struct ofono_modem *modem)
 	if (data->modem_port == NULL)
 		return -EIO;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(data->modem_port, mbm_debug, "Modem: ");
+		at_util_set_trace(data->modem_port, "Modem: ");
+	}
 
 	data->data_port = create_port(data_dev);
 	if (data->data_port == NULL) {
@@ -337,8 +339,10 @@ static int mbm_enable(struct ofono_modem *modem)
 		return -EIO;
 	}
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(data->data_port, mbm_debug, "Data: ");
+		at_util_set_trace(data->data_port, "Data: ");
+	}
 
 	g_at_chat_register(data->modem_port, "*EMRDY:", emrdy_notifier,
 					FALSE, modem, NULL);
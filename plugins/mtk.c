@@ -90,6 +90,9 @@
 #define RILD_MAX_CONNECT_RETRIES 5
 #define RILD_CONNECT_RETRY_TIME_S 5
 
+/* Requests each atom may have outstanding on a rild socket */
+#define RIL_PIPELINE_DEPTH 4
+
 #define T_WAIT_DISCONN_MS 1000
 #define T_SIM_SWITCH_FAILSAFE_MS 1000
 
@@ -1586,6 +1589,8 @@ static int create_gril(struct ofono_modem *modem)
 		sock_1 = sock;
 	}
 
+	g_ril_set_pipeline_depth(sock->ril, RIL_PIPELINE_DEPTH);
+
 	sock->radio_state = RADIO_STATE_UNAVAILABLE;
 	sock->radio_state_ev_id =
 		g_ril_register(sock->ril,
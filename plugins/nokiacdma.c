@@ -118,9 +118,11 @@ static int nokiacdma_enable(struct ofono_modem *modem)
 	if (data->chat == NULL)
 		return -ENOMEM;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(data->chat, nokiacdma_debug,
 					"CDMA Device: ");
+		at_util_set_trace(data->chat, "CDMA Device: ");
+	}
 
 	return 0;
 }
@@ -44,6 +44,7 @@
 #include <ofono/gprs-context.h>
 #include <ofono/sms.h>
 
+#include <drivers/atmodem/atutil.h>
 #include <drivers/atmodem/vendor.h>
 
 struct palmpre_data {
@@ -127,8 +128,10 @@ static int palmpre_enable(struct ofono_modem *modem)
 	if (data->chat == NULL)
 		return -ENOMEM;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(data->chat, palmpre_debug, "");
+		at_util_set_trace(data->chat, "");
+	}
 
 	/* Ensure terminal is in a known state */
 	g_at_chat_send(data->chat, "ATZ E0 +CMEE=1", NULL, NULL, NULL, NULL);
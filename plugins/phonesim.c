@@ -62,6 +62,7 @@
 #include <ofono/gnss.h>
 #include <ofono/handsfree.h>
 #include <ofono/siri.h>
+#include <ofono/diagnostics.h>
 
 #include <drivers/atmodem/vendor.h>
 #include <drivers/atmodem/atutil.h>
@@ -87,6 +88,7 @@ struct phonesim_data {
 	unsigned int hfp_watch;
 	int batt_level;
 	struct ofono_sim *sim;
+	unsigned int diag_id;
 };
 
 struct gprs_context_data {
@@ -632,8 +634,10 @@ static void mux_setup(GAtMux *mux, gpointer user_data)
 	g_at_syntax_unref(syntax);
 	g_io_channel_unref(io);
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(data->chat, phonesim_debug, "");
+		at_util_set_trace(data->chat, "");
+	}
 
 	if (data->calypso)
 		g_at_chat_set_wakeup_command(data->chat, "AT\r", 500, 5000);
@@ -729,8 +733,10 @@ static int phonesim_enable(struct ofono_modem *modem)
 	if (data->chat == NULL)
 		return -ENOMEM;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(data->chat, phonesim_debug, "");
+		at_util_set_trace(data->chat, "");
+	}
 
 	g_at_chat_set_disconnect_function(data->chat,
 						phonesim_disconnected, modem);
@@ -775,6 +781,9 @@ static int phonesim_enable(struct ofono_modem *modem)
 					OFONO_ATOM_TYPE_EMULATOR_HFP,
 					emulator_hfp_watch, data, NULL);
 
+	data->diag_id = ofono_diagnostics_add_channel(modem, "AT",
+					at_util_diagnostics_append, data->chat);
+
 	return 0;
 }
 
@@ -815,6 +824,9 @@ static int phonesim_disable(struct ofono_modem *modem)
 
 	__ofono_modem_remove_atom_watch(modem, data->hfp_watch);
 
+	ofono_diagnostics_remove_channel(modem, data->diag_id);
+	data->diag_id = 0;
+
 	g_at_chat_unref(data->chat);
 	data->chat = NULL;
 
@@ -997,8 +1009,10 @@ static int localhfp_enable(struct ofono_modem *modem)
 	if (chat == NULL)
 		return -ENOMEM;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, phonesim_debug, "LocalHfp: ");
+		at_util_set_trace(chat, "LocalHfp: ");
+	}
 
 	g_at_chat_set_disconnect_function(chat, slc_failed, modem);
 
@@ -54,6 +54,7 @@
 #include <ofono/gprs.h>
 #include <ofono/gprs-context.h>
 #include <ofono/audio-settings.h>
+#include <ofono/diagnostics.h>
 #include <ofono/types.h>
 
 #include "ofono.h"
@@ -77,6 +78,9 @@
 #define RILD_MAX_CONNECT_RETRIES 5
 #define RILD_CONNECT_RETRY_TIME_S 5
 
+/* Requests each atom may have outstanding on the rild socket */
+#define RIL_PIPELINE_DEPTH 4
+
 struct ril_data {
 	GRil *ril;
 	enum ofono_ril_vendor vendor;
@@ -90,6 +94,7 @@ struct ril_data {
 	GRilMsgIdToStrFunc unsol_request_to_string;
 	ril_get_driver_type_func get_driver_type;
 	struct cb_data *set_online_cbd;
+	unsigned int diag_id;
 };
 
 /*
@@ -112,6 +117,49 @@ GRil *ril_get_gril_complement(struct ofono_modem *modem)
 	return NULL;
 }
 
+static void append_unsol_count(const char *name, guint count,
+					gpointer user_data)
+{
+	DBusMessageIter *dict = user_data;
+	char *key = g_strconcat("Unsolicited.", name, NULL);
+
+	ofono_dbus_dict_append(dict, key, DBUS_TYPE_UINT32, &count);
+	g_free(key);
+}
+
+static void ril_diagnostics_append(DBusMessageIter *dict, void *user_data)
+{
+	struct ril_data *rd = user_data;
+	GRilStats stats;
+
+	if (g_ril_get_stats(rd->ril, &stats) == FALSE)
+		return;
+
+	ofono_dbus_dict_append(dict, "RequestsSent", DBUS_TYPE_UINT32,
+					&stats.requests_sent);
+	ofono_dbus_dict_append(dict, "RepliesMatched", DBUS_TYPE_UINT32,
+					&stats.replies_matched);
+	ofono_dbus_dict_append(dict, "Unsolicited", DBUS_TYPE_UINT32,
+					&stats.unsolicited);
+	ofono_dbus_dict_append(dict, "QueueDepth", DBUS_TYPE_UINT32,
+					&stats.queue_depth);
+	ofono_dbus_dict_append(dict, "QueueDepthMax", DBUS_TYPE_UINT32,
+					&stats.queue_depth_max);
+	ofono_dbus_dict_append(dict, "BytesIn", DBUS_TYPE_UINT64,
+					&stats.bytes_in);
+	ofono_dbus_dict_append(dict, "BytesOut", DBUS_TYPE_UINT64,
+					&stats.bytes_out);
+	ofono_dbus_dict_append(dict, "ReadBufferMax", DBUS_TYPE_UINT32,
+					&stats.rx_buffer_max);
+	ofono_diagnostics_append_histogram(dict, "QueueTime",
+					stats.queue_time, G_RIL_STATS_BUCKETS);
+	ofono_diagnostics_append_histogram(dict, "ResponseTime",
+					stats.response_time,
+					G_RIL_STATS_BUCKETS);
+
+	g_ril_foreach_unsol_count(rd->ril, append_unsol_count, dict);
+}
+
 static void ril_debug(const char *str, void *user_data)
 {
 	struct ril_data *rd = user_data;
@@ -305,6 +353,8 @@ void ril_remove(struct ofono_modem *modem)
 	if (!rd)
 		return;
 
+	ofono_diagnostics_remove_channel(modem, rd->diag_id);
+
 	g_ril_unref(rd->ril);
 
 	g_free(rd);
@@ -510,6 +560,7 @@ static int create_gril(struct ofono_modem *modem)
 		ril_data_1 = rd;
 
 	g_ril_set_slot(rd->ril, slot_id);
+	g_ril_set_pipeline_depth(rd->ril, RIL_PIPELINE_DEPTH);
 	g_ril_set_vendor_print_msg_id_funcs(rd->ril,
 						rd->request_id_to_string,
 						rd->unsol_request_to_string);
@@ -520,6 +571,10 @@ static int create_gril(struct ofono_modem *modem)
 	if (getenv("OFONO_RIL_HEX_TRACE"))
 		g_ril_set_debugf(rd->ril, ril_debug, rd);
 
+	if (rd->diag_id == 0)
+		rd->diag_id = ofono_diagnostics_add_channel(modem, "RIL",
+						ril_diagnostics_append, rd);
+
 	g_ril_register(rd->ril, RIL_UNSOL_RIL_CONNECTED,
 			ril_connected, modem);
 
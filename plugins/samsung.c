@@ -187,8 +187,10 @@ static int samsung_enable(struct ofono_modem *modem)
 	if (data->chat == NULL)
 		return -ENOMEM;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(data->chat, samsung_debug, "Device: ");
+		at_util_set_trace(data->chat, "Device: ");
+	}
 
 	g_at_chat_send(data->chat, "ATE0", NULL, NULL, NULL, NULL);
 	g_at_chat_send(data->chat, "AT+CMEE=1", NULL, NULL, NULL, NULL);
@@ -45,6 +45,7 @@
 #include <ofono/log.h>
 #include <ofono/voicecall.h>
 #include <ofono/call-volume.h>
+#include <drivers/atmodem/atutil.h>
 #include <drivers/atmodem/vendor.h>
 
 #define NUM_DLC 5
@@ -147,8 +148,10 @@ static GAtChat *open_device(struct ofono_modem *modem,
 		return NULL;
 	}
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, sim900_debug, debug);
+		at_util_set_trace(chat, debug);
+	}
 
 	return chat;
 }
@@ -170,8 +173,10 @@ static GAtChat *create_chat(GIOChannel *channel, struct ofono_modem *modem,
 	if (chat == NULL)
 		return NULL;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, sim900_debug, debug);
+		at_util_set_trace(chat, debug);
+	}
 
 	return chat;
 }
@@ -38,6 +38,7 @@
 #include <ofono/cdma-connman.h>
 #include <ofono/log.h>
 
+#include "drivers/atmodem/atutil.h"
 #include "drivers/atmodem/vendor.h"
 
 struct speedupcdma_data {
@@ -126,8 +127,10 @@ static GAtChat *open_device(struct ofono_modem *modem,
 	if (chat == NULL)
 		return NULL;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, speedupcdma_debug, debug);
+		at_util_set_trace(chat, debug);
+	}
 
 	return chat;
 }
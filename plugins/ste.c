@@ -332,9 +332,11 @@ static int ste_enable(struct ofono_modem *modem)
 			goto error;
 		}
 
-		if (getenv("OFONO_AT_DEBUG"))
+		if (getenv("OFONO_AT_DEBUG")) {
 			g_at_chat_set_debug(data->chat[i], ste_debug,
 						chat_prefixes[i]);
+			at_util_set_trace(data->chat[i], chat_prefixes[i]);
+		}
 
 		g_at_chat_send(data->chat[i], "AT&F E0 V1 X4 &C1 +CMEE=1",
 				NULL, NULL, NULL, NULL);
@@ -149,8 +149,10 @@ static int stktest_enable(struct ofono_modem *modem)
 	if (data->chat == NULL)
 		return -ENOMEM;
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(data->chat, stktest_debug, "");
+		at_util_set_trace(data->chat, "");
+	}
 
 	g_at_chat_set_disconnect_function(data->chat,
 						stktest_disconnected, modem);
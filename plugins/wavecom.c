@@ -48,6 +48,7 @@
 #include <ofono/ussd.h>
 #include <ofono/voicecall.h>
 
+#include <drivers/atmodem/atutil.h>
 #include <drivers/atmodem/vendor.h>
 
 
@@ -113,8 +114,10 @@ static int wavecom_enable(struct ofono_modem *modem)
 
 	g_at_chat_add_terminator(chat, "+CPIN:", 6, TRUE);
 
-	if (getenv("OFONO_AT_DEBUG"))
+	if (getenv("OFONO_AT_DEBUG")) {
 		g_at_chat_set_debug(chat, wavecom_debug, "");
+		at_util_set_trace(chat, "");
+	}
 
 	ofono_modem_set_data(modem, chat);
 
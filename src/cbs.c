@@ -68,6 +68,7 @@ struct ofono_cbs {
 	GSList *efcbmir_contents;
 	unsigned short efcbmid_length;
 	GSList *efcbmid_contents;
+	struct cbs_topic_index *efcbmid_index;
 	gboolean efcbmid_update;
 	guint reset_source;
 	int lac;
@@ -191,7 +192,8 @@ void ofono_cbs_notify(struct ofono_cbs *cbs, const unsigned char *pdu,
 		return;
 	}
 
-	if (cbs_topic_in_range(c.message_identifier, cbs->efcbmid_contents)) {
+	if (cbs_topic_index_contains(cbs->efcbmid_index,
+					c.message_identifier)) {
 		if (cbs->sim == NULL)
 			return;
 
@@ -606,6 +608,8 @@ static void cbs_unregister(struct ofono_atom *atom)
 		g_slist_foreach(cbs->efcbmid_contents, (GFunc) g_free, NULL);
 		g_slist_free(cbs->efcbmid_contents);
 		cbs->efcbmid_contents = NULL;
+		cbs_topic_index_free(cbs->efcbmid_index);
+		cbs->efcbmid_index = NULL;
 	}
 
 	if (cbs->sim_context) {
@@ -882,6 +886,7 @@ static void sim_cbmid_read_cb(int ok, int length, int record,
 		goto done;
 
 	cbs->efcbmid_contents = g_slist_reverse(contents);
+	cbs->efcbmid_index = cbs_topic_index_new(cbs->efcbmid_contents);
 
 	str = cbs_topic_ranges_to_string(cbs->efcbmid_contents);
 	DBG("Got cbmid: %s", str);
@@ -910,6 +915,8 @@ static void cbs_efcbmid_changed(int id, void *userdata)
 		g_slist_foreach(cbs->efcbmid_contents, (GFunc) g_free, NULL);
 		g_slist_free(cbs->efcbmid_contents);
 		cbs->efcbmid_contents = NULL;
+		cbs_topic_index_free(cbs->efcbmid_index);
+		cbs->efcbmid_index = NULL;
 	}
 
 	cbs->efcbmid_update = TRUE;
@@ -34,16 +34,512 @@
 #include "ofono.h"
 
 #include "cdma-smsutil.h"
+#include "timerwheel.h"
+
+#define CDMA_SMS_FLAG_TXQ_ACTIVE 0x1
+#define CDMA_SMS_FLAG_TXQ_SUBMITTING 0x2
+
+#define TXQ_MAX_RETRIES 4
+
+#define CDMA_SMS_BATCH_MAX 1000
+#define CDMA_SMS_BATCH_PROGRESS_INTERVAL 1000
 
 static GSList *g_drivers;
 
 struct ofono_cdma_sms {
+	int flags;
+	GQueue *txq;
+	guint tx_source;
+	unsigned int retry_source;
+	guint16 next_msg_id;
+	guint32 next_submit_id;
+	GSList *batches;
+	unsigned int next_batch_id;
 	const struct ofono_cdma_sms_driver *driver;
 	void *driver_data;
 	struct ofono_atom *atom;
 };
 
+struct cdma_sms_batch {
+	struct ofono_cdma_sms *cdma_sms;
+	unsigned int id;
+	unsigned int total;
+	unsigned int sent;
+	unsigned int failed;
+	guint progress_source;
+};
+
+struct tx_queue_entry {
+	guint8 pdu[CDMA_SMS_PDU_MAX_LEN];
+	int pdu_len;
+	unsigned int retry;
+	guint32 id;
+	struct cdma_sms_batch *batch;
+};
+
+static const char *priority_names[] = {
+	[CDMA_SMS_PRIORITY_NORMAL] = "normal",
+	[CDMA_SMS_PRIORITY_INTERACTIVE] = "interactive",
+	[CDMA_SMS_PRIORITY_URGENT] = "urgent",
+	[CDMA_SMS_PRIORITY_EMERGENCY] = "emergency",
+};
+
+static const char *privacy_names[] = {
+	[CDMA_SMS_PRIVACY_NOT_RESTRICTED] = "not restricted",
+	[CDMA_SMS_PRIVACY_RESTRICTED] = "restricted",
+	[CDMA_SMS_PRIVACY_CONFIDENTIAL] = "confidential",
+	[CDMA_SMS_PRIVACY_SECRET] = "secret",
+};
+
+static gboolean tx_next(gpointer user_data);
+
+static int name_to_index(const char **names, unsigned int n, const char *str)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		if (g_str_equal(names[i], str))
+			return i;
+
+	return -1;
+}
+
+static void cdma_sms_batch_free(gpointer data)
+{
+	struct cdma_sms_batch *batch = data;
+
+	if (batch->progress_source)
+		g_source_remove(batch->progress_source);
+
+	g_free(batch);
+}
+
+static void cdma_sms_batch_emit_progress(struct cdma_sms_batch *batch)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+	const char *path = __ofono_atom_get_path(batch->cdma_sms->atom);
+	DBusMessage *signal;
+	DBusMessageIter iter;
+	DBusMessageIter dict;
+
+	signal = dbus_message_new_signal(path,
+					OFONO_CDMA_MESSAGE_MANAGER_INTERFACE,
+					"BatchProgress");
+	if (signal == NULL)
+		return;
+
+	dbus_message_iter_init_append(signal, &iter);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &batch->id);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					OFONO_PROPERTIES_ARRAY_SIGNATURE,
+					&dict);
+	ofono_dbus_dict_append(&dict, "Total", DBUS_TYPE_UINT32,
+				&batch->total);
+	ofono_dbus_dict_append(&dict, "Sent", DBUS_TYPE_UINT32, &batch->sent);
+	ofono_dbus_dict_append(&dict, "Failed", DBUS_TYPE_UINT32,
+				&batch->failed);
+	dbus_message_iter_close_container(&iter, &dict);
+
+	g_dbus_send_message(conn, signal);
+}
+
+static gboolean cdma_sms_batch_progress_timeout(gpointer user_data)
+{
+	struct cdma_sms_batch *batch = user_data;
+
+	batch->progress_source = 0;
+	cdma_sms_batch_emit_progress(batch);
+
+	return FALSE;
+}
+
+/* Same reporting as for GSM batches, see sms_batch_entry_done */
+static void cdma_sms_batch_entry_done(struct cdma_sms_batch *batch,
+					gboolean sent)
+{
+	struct ofono_cdma_sms *cdma_sms = batch->cdma_sms;
+
+	if (sent)
+		batch->sent += 1;
+	else
+		batch->failed += 1;
+
+	if (batch->sent + batch->failed < batch->total) {
+		if (batch->progress_source == 0)
+			batch->progress_source =
+				g_timeout_add(CDMA_SMS_BATCH_PROGRESS_INTERVAL,
+						cdma_sms_batch_progress_timeout,
+						batch);
+		return;
+	}
+
+	cdma_sms_batch_emit_progress(batch);
+
+	cdma_sms->batches = g_slist_remove(cdma_sms->batches, batch);
+	cdma_sms_batch_free(batch);
+}
+
+static void cdma_sms_emit_submit_status(struct ofono_cdma_sms *cdma_sms,
+						guint32 id, gboolean sent)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+	const char *path = __ofono_atom_get_path(cdma_sms->atom);
+	dbus_bool_t submitted = sent;
+
+	g_dbus_emit_signal(conn, path, OFONO_CDMA_MESSAGE_MANAGER_INTERFACE,
+				"SubmitStatus",
+				DBUS_TYPE_UINT32, &id,
+				DBUS_TYPE_BOOLEAN, &submitted,
+				DBUS_TYPE_INVALID);
+}
+
+static void tx_queue_entry_done(struct ofono_cdma_sms *cdma_sms,
+				struct tx_queue_entry *entry, gboolean sent)
+{
+	if (entry->batch)
+		cdma_sms_batch_entry_done(entry->batch, sent);
+	else
+		cdma_sms_emit_submit_status(cdma_sms, entry->id, sent);
+
+	g_free(entry);
+}
+
+/*
+ * As for GSM, the next message is handed to the driver straight from
+ * the completion of the previous one.  Completions reported from within
+ * the submit call itself go through the main loop to bound the recursion.
+ */
+static void tx_schedule_next(struct ofono_cdma_sms *cdma_sms)
+{
+	if (cdma_sms->flags & CDMA_SMS_FLAG_TXQ_SUBMITTING) {
+		cdma_sms->tx_source = g_timeout_add(0, tx_next, cdma_sms);
+		return;
+	}
+
+	tx_next(cdma_sms);
+}
+
+static gboolean tx_retry(gpointer user_data)
+{
+	struct ofono_cdma_sms *cdma_sms = user_data;
+
+	cdma_sms->retry_source = 0;
+	tx_next(cdma_sms);
+
+	return FALSE;
+}
+
+static void tx_finished(const struct ofono_error *error, void *data)
+{
+	struct ofono_cdma_sms *cdma_sms = data;
+	struct tx_queue_entry *entry = g_queue_peek_head(cdma_sms->txq);
+	gboolean ok = error->type == OFONO_ERROR_TYPE_NO_ERROR;
+
+	DBG("tx_finished %p", entry);
+
+	cdma_sms->flags &= ~CDMA_SMS_FLAG_TXQ_ACTIVE;
+
+	if (ok == FALSE) {
+		entry->retry += 1;
+
+		if (entry->retry < TXQ_MAX_RETRIES) {
+			DBG("Sending failed, retry in %d secs",
+					entry->retry * 5);
+			cdma_sms->retry_source =
+				timer_wheel_add_seconds(entry->retry * 5,
+							tx_retry, cdma_sms);
+			return;
+		}
+
+		DBG("Max retries reached, giving up");
+	}
+
+	g_queue_pop_head(cdma_sms->txq);
+	tx_queue_entry_done(cdma_sms, entry, ok);
+
+	if (g_queue_peek_head(cdma_sms->txq)) {
+		DBG("Scheduling next");
+		tx_schedule_next(cdma_sms);
+	}
+}
+
+static gboolean tx_next(gpointer user_data)
+{
+	struct ofono_cdma_sms *cdma_sms = user_data;
+	struct tx_queue_entry *entry = g_queue_peek_head(cdma_sms->txq);
+
+	DBG("tx_next: %p", entry);
+
+	cdma_sms->tx_source = 0;
+
+	if (entry == NULL)
+		return FALSE;
+
+	cdma_sms->flags |= CDMA_SMS_FLAG_TXQ_ACTIVE;
+	cdma_sms->flags |= CDMA_SMS_FLAG_TXQ_SUBMITTING;
+
+	cdma_sms->driver->submit(cdma_sms, entry->pdu, entry->pdu_len,
+					tx_finished, cdma_sms);
+
+	cdma_sms->flags &= ~CDMA_SMS_FLAG_TXQ_SUBMITTING;
+
+	return FALSE;
+}
+
+static void tx_queue_start(struct ofono_cdma_sms *cdma_sms)
+{
+	if (cdma_sms->flags & CDMA_SMS_FLAG_TXQ_ACTIVE)
+		return;
+
+	if (cdma_sms->tx_source > 0 || cdma_sms->retry_source > 0)
+		return;
+
+	cdma_sms->tx_source = g_timeout_add(0, tx_next, cdma_sms);
+}
+
+/*
+ * Encodes a WMT SUBMIT from a SendMessage style dictionary.  Returns
+ * -EINVAL for malformed arguments and -EBADMSG for a recipient or text
+ * that can't be sent.
+ */
+static int tx_queue_entry_prepare(struct ofono_cdma_sms *cdma_sms,
+					DBusMessageIter *dict,
+					struct tx_queue_entry *entry)
+{
+	struct cdma_sms s;
+	struct cdma_sms_bearer_data *bd = &s.p2p_msg.bd;
+	const char *to = NULL;
+	const char *text = NULL;
+	int priority = -1;
+	int privacy = -1;
+
+	while (dbus_message_iter_get_arg_type(dict) == DBUS_TYPE_DICT_ENTRY) {
+		DBusMessageIter dict_entry;
+		DBusMessageIter value;
+		const char *key;
+		const char *str;
+
+		dbus_message_iter_recurse(dict, &dict_entry);
+		dbus_message_iter_get_basic(&dict_entry, &key);
+		dbus_message_iter_next(&dict_entry);
+		dbus_message_iter_recurse(&dict_entry, &value);
+
+		if (dbus_message_iter_get_arg_type(&value) != DBUS_TYPE_STRING)
+			return -EINVAL;
+
+		dbus_message_iter_get_basic(&value, &str);
+
+		if (g_str_equal(key, "To"))
+			to = str;
+		else if (g_str_equal(key, "Text"))
+			text = str;
+		else if (g_str_equal(key, "Priority")) {
+			priority = name_to_index(priority_names,
+					G_N_ELEMENTS(priority_names), str);
+			if (priority < 0)
+				return -EINVAL;
+		} else if (g_str_equal(key, "Privacy")) {
+			privacy = name_to_index(privacy_names,
+					G_N_ELEMENTS(privacy_names), str);
+			if (privacy < 0)
+				return -EINVAL;
+		} else
+			return -EINVAL;
+
+		dbus_message_iter_next(dict);
+	}
+
+	if (to == NULL || text == NULL)
+		return -EINVAL;
+
+	memset(&s, 0, sizeof(struct cdma_sms));
+
+	s.type = CDMA_SMS_TP_MSG_TYPE_P2P;
+	s.p2p_msg.teleservice_id = CDMA_SMS_TELESERVICE_ID_WMT;
+	set_bitmap(&s.p2p_msg.param_bitmap,
+			CDMA_SMS_PARAM_ID_TELESERVICE_IDENTIFIER);
+
+	if (cdma_sms_address_from_string(&s.p2p_msg.daddr, to) == FALSE)
+		return -EBADMSG;
+
+	set_bitmap(&s.p2p_msg.param_bitmap,
+			CDMA_SMS_PARAM_ID_DESTINATION_ADDRESS);
+	set_bitmap(&s.p2p_msg.param_bitmap, CDMA_SMS_PARAM_ID_BEARER_DATA);
+
+	bd->id.msg_type = CDMA_SMS_MSG_TYPE_SUBMIT;
+	bd->id.msg_id = cdma_sms->next_msg_id;
+	set_bitmap(&bd->subparam_bitmap, CDMA_SMS_SUBPARAM_ID_MESSAGE_ID);
+
+	/* TODO: Segmentation of long messages */
+	if (cdma_sms_encode_text(text, &bd->wmt_submit.ud) == FALSE)
+		return -EBADMSG;
+
+	set_bitmap(&bd->subparam_bitmap, CDMA_SMS_SUBPARAM_ID_USER_DATA);
+
+	if (priority >= 0) {
+		bd->wmt_submit.priority = priority;
+		set_bitmap(&bd->subparam_bitmap,
+				CDMA_SMS_SUBPARAM_ID_PRIORITY_INDICATOR);
+	}
+
+	if (privacy >= 0) {
+		bd->wmt_submit.privacy = privacy;
+		set_bitmap(&bd->subparam_bitmap,
+				CDMA_SMS_SUBPARAM_ID_PRIVACY_INDICATOR);
+	}
+
+	if (cdma_sms_encode(&s, entry->pdu, &entry->pdu_len) == FALSE)
+		return -EBADMSG;
+
+	/* Message Identifiers wrap around, C.S0015-B v2.0 Section 4.5.1 */
+	cdma_sms->next_msg_id += 1;
+
+	return 0;
+}
+
+static DBusMessage *prepare_error(DBusMessage *msg, int err)
+{
+	if (err == -EBADMSG)
+		return __ofono_error_invalid_format(msg);
+
+	return __ofono_error_invalid_args(msg);
+}
+
+static DBusMessage *cdma_sms_send_message(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	struct ofono_cdma_sms *cdma_sms = data;
+	struct tx_queue_entry *entry;
+	DBusMessageIter iter;
+	DBusMessageIter dict;
+	int err;
+
+	if (cdma_sms->driver->submit == NULL)
+		return __ofono_error_not_implemented(msg);
+
+	if (!dbus_message_iter_init(msg, &iter))
+		return __ofono_error_invalid_args(msg);
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
+		return __ofono_error_invalid_args(msg);
+
+	dbus_message_iter_recurse(&iter, &dict);
+
+	entry = g_new0(struct tx_queue_entry, 1);
+
+	err = tx_queue_entry_prepare(cdma_sms, &dict, entry);
+	if (err < 0) {
+		g_free(entry);
+		return prepare_error(msg, err);
+	}
+
+	/* As for GSM, reply once queued, SubmitStatus reports the outcome */
+	entry->id = ++cdma_sms->next_submit_id;
+
+	g_queue_push_tail(cdma_sms->txq, entry);
+	tx_queue_start(cdma_sms);
+
+	return g_dbus_create_reply(msg, DBUS_TYPE_UINT32, &entry->id,
+					DBUS_TYPE_INVALID);
+}
+
+/*
+ * Queue a batch of text messages [D-Bus SendMessages()]
+ *
+ * All messages are encoded before any of them is queued, so a malformed
+ * entry rejects the whole batch.  The messages are then sent back to
+ * back, with progress reported through BatchProgress.
+ */
+static DBusMessage *cdma_sms_send_messages(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	struct ofono_cdma_sms *cdma_sms = data;
+	struct cdma_sms_batch *batch;
+	DBusMessageIter iter;
+	DBusMessageIter array;
+	GSList *entries = NULL;
+	GSList *l;
+	unsigned int count = 0;
+	int err;
+
+	if (cdma_sms->driver->submit == NULL)
+		return __ofono_error_not_implemented(msg);
+
+	if (!dbus_message_iter_init(msg, &iter))
+		return __ofono_error_invalid_args(msg);
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY ||
+			dbus_message_iter_get_element_type(&iter) !=
+							DBUS_TYPE_ARRAY)
+		return __ofono_error_invalid_args(msg);
+
+	dbus_message_iter_recurse(&iter, &array);
+
+	while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_ARRAY) {
+		struct tx_queue_entry *entry;
+		DBusMessageIter dict;
+
+		if (++count > CDMA_SMS_BATCH_MAX) {
+			err = -EINVAL;
+			goto error;
+		}
+
+		dbus_message_iter_recurse(&array, &dict);
+
+		entry = g_new0(struct tx_queue_entry, 1);
+
+		err = tx_queue_entry_prepare(cdma_sms, &dict, entry);
+		if (err < 0) {
+			g_free(entry);
+			goto error;
+		}
+
+		entries = g_slist_prepend(entries, entry);
+
+		dbus_message_iter_next(&array);
+	}
+
+	if (entries == NULL)
+		return __ofono_error_invalid_args(msg);
+
+	batch = g_new0(struct cdma_sms_batch, 1);
+	batch->cdma_sms = cdma_sms;
+	batch->id = ++cdma_sms->next_batch_id;
+	batch->total = count;
+
+	cdma_sms->batches = g_slist_prepend(cdma_sms->batches, batch);
+
+	entries = g_slist_reverse(entries);
+
+	for (l = entries; l; l = l->next) {
+		struct tx_queue_entry *entry = l->data;
+
+		entry->batch = batch;
+		g_queue_push_tail(cdma_sms->txq, entry);
+	}
+
+	g_slist_free(entries);
+
+	tx_queue_start(cdma_sms);
+
+	return g_dbus_create_reply(msg, DBUS_TYPE_UINT32, &batch->id,
+					DBUS_TYPE_INVALID);
+
+error:
+	g_slist_free_full(entries, g_free);
+	return prepare_error(msg, err);
+}
+
 static const GDBusMethodTable cdma_sms_manager_methods[] = {
+	{ GDBUS_METHOD("SendMessage",
+			GDBUS_ARGS({ "message_info", "a{sv}" }),
+			GDBUS_ARGS({ "id", "u" }),
+			cdma_sms_send_message) },
+	{ GDBUS_METHOD("SendMessages",
+			GDBUS_ARGS({ "messages", "aa{sv}" }),
+			GDBUS_ARGS({ "batch", "u" }),
+			cdma_sms_send_messages) },
 	/* TODO */
 	{ }
 };
@@ -51,6 +547,10 @@ static const GDBusMethodTable cdma_sms_manager_methods[] = {
 static const GDBusSignalTable cdma_sms_manager_signals[] = {
 	{ GDBUS_SIGNAL("IncomingMessage",
 			GDBUS_ARGS({ "message", "s"}, { "info", "a{sv}" })) },
+	{ GDBUS_SIGNAL("BatchProgress",
+			GDBUS_ARGS({ "batch", "u" }, { "info", "a{sv}" })) },
+	{ GDBUS_SIGNAL("SubmitStatus",
+			GDBUS_ARGS({ "id", "u" }, { "submitted", "b" })) },
 	/* TODO */
 	{ }
 };
@@ -239,6 +739,22 @@ static void cdma_sms_remove(struct ofono_atom *atom)
 	if (cdma_sms->driver && cdma_sms->driver->remove)
 		cdma_sms->driver->remove(cdma_sms);
 
+	if (cdma_sms->tx_source) {
+		g_source_remove(cdma_sms->tx_source);
+		cdma_sms->tx_source = 0;
+	}
+
+	if (cdma_sms->retry_source) {
+		timer_wheel_remove(cdma_sms->retry_source);
+		cdma_sms->retry_source = 0;
+	}
+
+	/* The interface is gone already, there is nobody to report to */
+	g_slist_free_full(cdma_sms->batches, cdma_sms_batch_free);
+	cdma_sms->batches = NULL;
+
+	g_queue_free_full(cdma_sms->txq, g_free);
+
 	g_free(cdma_sms);
 }
 
@@ -267,6 +783,8 @@ struct ofono_cdma_sms *ofono_cdma_sms_create(struct ofono_modem *modem,
 	if (cdma_sms == NULL)
 		return NULL;
 
+	cdma_sms->txq = g_queue_new();
+
 	cdma_sms->atom = __ofono_modem_add_atom(modem,
 						OFONO_ATOM_TYPE_CDMA_SMS,
 						cdma_sms_remove, cdma_sms);
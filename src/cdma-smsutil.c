@@ -25,6 +25,7 @@
 
 #define _GNU_SOURCE
 #include <string.h>
+#include <stddef.h>
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -34,13 +35,46 @@
 
 #include "cdma-smsutil.h"
 
-#define uninitialized_var(x) x = x
-
 enum cdma_sms_rec_flag {
 	CDMA_SMS_REC_FLAG_MANDATORY =	1,
+	CDMA_SMS_REC_FLAG_SKIP_INVALID = 2,	/* Ignore if malformed */
 };
 
 typedef gboolean (*rec_handler)(const guint8 *, guint8, void *);
+typedef int (*rec_encoder)(const void *, guint8 *, int);
+
+/*
+ * Parameter and subparameter records are decoded and encoded according
+ * to tables of these, in table order.  The offset locates the value of
+ * the record within the structure the table applies to.
+ */
+struct rec_entry {
+	guint8 id;
+	int flags;
+	rec_handler decode;
+	rec_encoder encode;
+	size_t offset;
+};
+
+/* First occurrence of each record in a PDU, indexed by record id */
+struct rec_index {
+	guint32 bitmap;
+	const guint8 *data[CDMA_SMS_SUBPARAM_ID_ENHANCED_VMN_ACK + 1];
+	guint8 len[CDMA_SMS_SUBPARAM_ID_ENHANCED_VMN_ACK + 1];
+};
+
+/*
+ * Character sets of User Data, C.R1001-G_v1.0 Table 9.1-1.  Unicode
+ * fields are 16 bits wide and stored as pairs of octets.  The maximum
+ * number of fields is the limit of a single message when encoding, it
+ * is 0 for character sets only supported on decoding.
+ */
+struct ud_codec {
+	guint8 field_bits;
+	guint8 max_fields;
+	gunichar max_char;
+	char *(*to_utf8)(const struct cdma_sms_ud *ud);
+};
 
 struct simple_iter {
 	guint8 max;
@@ -107,11 +141,6 @@ static const guint8 *simple_iter_get_data(struct simple_iter *iter)
 	return iter->data;
 }
 
-static inline void set_bitmap(guint32 *bitmap, guint8 pos)
-{
-	*bitmap = *bitmap | (1 << pos);
-}
-
 /* Unpacks the byte stream. The field has to be <= 8 bits. */
 static guint8 bit_field_unpack(const guint8 *buf, guint16 offset, guint8 nbit)
 {
@@ -134,18 +163,195 @@ static guint8 bit_field_unpack(const guint8 *buf, guint16 offset, guint8 nbit)
 	return (val << nbit) | (*pdu >> (8 - nbit));
 }
 
+/*
+ * Unpacks count consecutive fields of nbit <= 8 bits.  Input octets are
+ * read once each through an accumulator instead of locating every field
+ * on its own, and octet aligned 8 bit fields are simply copied.
+ */
+static void bit_field_unpack_array(const guint8 *buf, guint16 offset,
+					guint8 nbit, guint8 *out, guint16 count)
+{
+	const guint8 *pdu = buf + (offset >> 3);
+	guint8 avail = 8 - (offset & 0x7);
+	guint32 acc;
+	guint16 i;
+
+	if (count == 0)
+		return;
+
+	if (nbit == 8 && avail == 8) {
+		memcpy(out, pdu, count);
+		return;
+	}
+
+	acc = *pdu++ & ((1 << avail) - 1);
+
+	for (i = 0; i < count; i++) {
+		if (avail < nbit) {
+			acc = (acc << 8) | *pdu++;
+			avail += 8;
+		}
+
+		avail -= nbit;
+		out[i] = acc >> avail;
+		acc &= (1 << avail) - 1;
+	}
+}
+
+/* Packs a field of nbit <= 8 bits into a zero initialized buffer */
+static void bit_field_pack(guint8 *buf, guint16 offset, guint8 nbit,
+				guint8 val)
+{
+	guint8 *pdu = buf + (offset >> 3);
+	guint8 bit_pos = 8 - (offset & 0x7);
+
+	val &= (1 << nbit) - 1;
+
+	/* Field to be packed is within current byte */
+	if (nbit <= bit_pos) {
+		*pdu |= val << (bit_pos - nbit);
+		return;
+	}
+
+	/* Field to be packed crossing two bytes */
+	nbit -= bit_pos;
+	pdu[0] |= val >> nbit;
+	pdu[1] |= val << (8 - nbit);
+}
+
+/* Counterpart of bit_field_unpack_array, the buffer is zero initialized */
+static void bit_field_pack_array(guint8 *buf, guint16 offset, guint8 nbit,
+					const guint8 *in, guint16 count)
+{
+	guint8 *pdu = buf + (offset >> 3);
+	guint8 fill = offset & 0x7;
+	guint32 acc;
+	guint16 i;
+
+	if (nbit == 8 && fill == 0) {
+		memcpy(pdu, in, count);
+		return;
+	}
+
+	/* Bits of the current octet already in use */
+	acc = *pdu >> (8 - fill);
+
+	for (i = 0; i < count; i++) {
+		acc = (acc << nbit) | (in[i] & ((1 << nbit) - 1));
+		fill += nbit;
+
+		if (fill >= 8) {
+			fill -= 8;
+			*pdu++ = acc >> fill;
+			acc &= (1 << fill) - 1;
+		}
+	}
+
+	if (fill > 0)
+		*pdu = acc << (8 - fill);
+}
+
+static void rec_index_init(struct rec_index *index,
+				const guint8 *pdu, guint8 len)
+{
+	struct simple_iter iter;
+
+	index->bitmap = 0;
+
+	simple_iter_init(&iter, pdu, len);
+
+	while (simple_iter_next(&iter) == TRUE) {
+		guint8 id = simple_iter_get_id(&iter);
+
+		/* Ignore unknown and repeated records */
+		if (id >= G_N_ELEMENTS(index->data) ||
+				check_bitmap(index->bitmap, id) == TRUE)
+			continue;
+
+		set_bitmap(&index->bitmap, id);
+		index->data[id] = simple_iter_get_data(&iter);
+		index->len[id] = simple_iter_get_length(&iter);
+	}
+}
+
+static gboolean decode_records(const struct rec_index *index,
+				const struct rec_entry *table, unsigned int n,
+				guint32 *bitmap, void *base)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		const struct rec_entry *rec = &table[i];
+
+		if (check_bitmap(index->bitmap, rec->id) == FALSE) {
+			if (rec->flags & CDMA_SMS_REC_FLAG_MANDATORY)
+				return FALSE;
+
+			continue;
+		}
+
+		if (rec->decode(index->data[rec->id], index->len[rec->id],
+				(guint8 *) base + rec->offset) == FALSE) {
+			if (rec->flags & CDMA_SMS_REC_FLAG_SKIP_INVALID)
+				continue;
+
+			return FALSE; /* Stop if decoding failed */
+		}
+
+		set_bitmap(bitmap, rec->id);
+	}
+
+	return TRUE;
+}
+
+/* Returns the number of octets written to buf, or -1 if it is too short */
+static int encode_records(const struct rec_entry *table, unsigned int n,
+				guint32 bitmap, const void *base,
+				guint8 *buf, int max)
+{
+	unsigned int i;
+	int pos = 0;
+
+	for (i = 0; i < n; i++) {
+		const struct rec_entry *rec = &table[i];
+		int len;
+
+		if (check_bitmap(bitmap, rec->id) == FALSE) {
+			if (rec->flags & CDMA_SMS_REC_FLAG_MANDATORY)
+				return -1;
+
+			continue;
+		}
+
+		if (pos + 2 > max)
+			return -1;
+
+		len = rec->encode((const guint8 *) base + rec->offset,
+					buf + pos + 2, MIN(max - pos - 2, 255));
+		if (len < 0)
+			return -1;
+
+		buf[pos] = rec->id;
+		buf[pos + 1] = len;
+		pos += len + 2;
+	}
+
+	return pos;
+}
+
+/*
+ * Mapping from binary DTMF code to the digit it represents.
+ * As defined in Table 2.7.1.3.2.4-4 of 3GPP2 C.S0005-E v2.0.
+ * Note, 0 is NOT a valid value and not mapped to
+ * any valid DTMF digit.
+ */
+static const char dtmf_digits[13] = {0, '1', '2', '3', '4', '5', '6',
+					'7', '8', '9', '0', '*', '#'};
+
 /* Convert CDMA DTMF digits into a string */
 static gboolean dtmf_to_ascii(char *buf, const guint8 *addr,
 					guint8 num_fields)
 {
-	/*
-	 * Mapping from binary DTMF code to the digit it represents.
-	 * As defined in Table 2.7.1.3.2.4-4 of 3GPP2 C.S0005-E v2.0.
-	 * Note, 0 is NOT a valid value and not mapped to
-	 * any valid DTMF digit.
-	 */
-	static const char dtmf_digits[13] = {0, '1', '2', '3', '4', '5', '6',
-						'7', '8', '9', '0', '*', '#'};
 	guint8 index;
 	guint8 value;
 
@@ -162,11 +368,23 @@ static gboolean dtmf_to_ascii(char *buf, const guint8 *addr,
 	return TRUE;
 }
 
+static guint8 ascii_to_dtmf(char c)
+{
+	guint8 value;
+
+	for (value = 1; value < G_N_ELEMENTS(dtmf_digits); value++)
+		if (dtmf_digits[value] == c)
+			return value;
+
+	return 0;
+}
+
 const char *cdma_sms_address_to_string(const struct cdma_sms_address *addr)
 {
 	static char buf[CDMA_SMS_MAX_ADDR_FIELDS + 1];
+	char *p = buf;
+	guint8 i;
 
-	/* TODO: Only support CDMA_SMS_DIGIT_MODE_4BIT_DTMF currently */
 	switch (addr->digit_mode) {
 	case CDMA_SMS_DIGIT_MODE_4BIT_DTMF:
 		if (dtmf_to_ascii(buf, addr->address,
@@ -175,18 +393,84 @@ const char *cdma_sms_address_to_string(const struct cdma_sms_address *addr)
 		else
 			return NULL;
 	case CDMA_SMS_DIGIT_MODE_8BIT_ASCII:
-		return NULL;
+		if (addr->number_mode == CDMA_SMS_NUM_MODE_DIGIT &&
+				addr->digi_num_type ==
+					CDMA_SMS_DIGI_NUM_TYPE_INTERNATIONAL)
+			*p++ = '+';
+		else if (addr->number_mode == CDMA_SMS_NUM_MODE_DATA_NW &&
+				addr->data_nw_num_type !=
+				CDMA_SMS_DATA_NW_NUM_TYPE_INTERNET_EMAIL_ADDRESS)
+			return NULL; /* TODO: Binary network addresses */
+
+		/* Only printable ASCII, the string ends up on D-Bus */
+		for (i = 0; i < addr->num_fields; i++) {
+			if (addr->address[i] < 0x20 || addr->address[i] > 0x7e)
+				return NULL;
+
+			*p++ = addr->address[i];
+		}
+
+		*p = '\0';
+
+		return buf;
 	}
 
 	return NULL;
 }
 
+/*
+ * Plain numbers are sent as DTMF digits.  A leading plus can only be
+ * conveyed by the number type, which requires the ASCII digit mode.
+ */
+gboolean cdma_sms_address_from_string(struct cdma_sms_address *addr,
+					const char *str)
+{
+	gboolean international = FALSE;
+	size_t len;
+	size_t i;
+
+	if (str[0] == '+') {
+		international = TRUE;
+		str++;
+	}
+
+	len = strlen(str);
+	if (len == 0 || len >= CDMA_SMS_MAX_ADDR_FIELDS)
+		return FALSE;
+
+	memset(addr, 0, sizeof(*addr));
+
+	if (international) {
+		addr->digit_mode = CDMA_SMS_DIGIT_MODE_8BIT_ASCII;
+		addr->number_mode = CDMA_SMS_NUM_MODE_DIGIT;
+		addr->digi_num_type = CDMA_SMS_DIGI_NUM_TYPE_INTERNATIONAL;
+		addr->number_plan = CDMA_SMS_NUMBERING_PLAN_ISDN;
+	} else
+		addr->digit_mode = CDMA_SMS_DIGIT_MODE_4BIT_DTMF;
+
+	for (i = 0; i < len; i++) {
+		guint8 value = ascii_to_dtmf(str[i]);
+
+		if (value == 0)
+			return FALSE;
+
+		addr->address[i] = international ? str[i] : value;
+	}
+
+	addr->num_fields = len;
+
+	return TRUE;
+}
+
 /* Decode Teleservice ID */
 static gboolean cdma_sms_decode_teleservice(const guint8 *buf, guint8 len,
 								void *data)
 {
 	enum cdma_sms_teleservice_id *id = data;
 
+	if (len < 2)
+		return FALSE;
+
 	*id = bit_field_unpack(buf, 0, 8) << 8 |
 				bit_field_unpack(buf, 8, 8);
 
@@ -205,6 +489,19 @@ static gboolean cdma_sms_decode_teleservice(const guint8 *buf, guint8 len,
 	return FALSE; /* Invalid teleservice type */
 }
 
+static int cdma_sms_encode_teleservice(const void *data, guint8 *buf, int max)
+{
+	const enum cdma_sms_teleservice_id *id = data;
+
+	if (max < 2)
+		return -1;
+
+	buf[0] = *id >> 8;
+	buf[1] = *id & 0xff;
+
+	return 2;
+}
+
 /* Decode Address parameter record */
 static gboolean cdma_sms_decode_addr(const guint8 *buf, guint8 len,
 							void *data)
@@ -213,7 +510,10 @@ static gboolean cdma_sms_decode_addr(const guint8 *buf, guint8 len,
 	guint16 bit_offset = 0;
 	guint8  chari_len;
 	guint16 total_num_bits = len * 8;
-	guint8  index;
+
+	/* Mode bits and the number of fields at the very least */
+	if (total_num_bits < 10)
+		return FALSE;
 
 	addr->digit_mode = bit_field_unpack(buf, bit_offset, 1);
 	bit_offset += 1;
@@ -255,16 +555,68 @@ static gboolean cdma_sms_decode_addr(const guint8 *buf, guint8 len,
 	if ((bit_offset + chari_len * addr->num_fields) > total_num_bits)
 		return FALSE;
 
-	for (index = 0; index < addr->num_fields; index++) {
-		addr->address[index] = bit_field_unpack(buf,
-							bit_offset,
-							chari_len);
-		bit_offset += chari_len;
-	}
+	bit_field_unpack_array(buf, bit_offset, chari_len, addr->address,
+						addr->num_fields);
 
 	return TRUE;
 }
 
+static int cdma_sms_encode_addr(const void *data, guint8 *buf, int max)
+{
+	const struct cdma_sms_address *addr = data;
+	guint16 bit_offset = 0;
+	guint8 chari_len;
+	int len;
+
+	if (addr->digit_mode == CDMA_SMS_DIGIT_MODE_4BIT_DTMF)
+		chari_len = 4;
+	else
+		chari_len = 8;
+
+	len = 2 + 8 + chari_len * addr->num_fields;
+
+	if (addr->digit_mode == CDMA_SMS_DIGIT_MODE_8BIT_ASCII) {
+		len += 3;
+
+		if (addr->number_mode == CDMA_SMS_NUM_MODE_DIGIT)
+			len += 4;
+	}
+
+	len = (len + 7) / 8;
+	if (len > max)
+		return -1;
+
+	bit_field_pack(buf, bit_offset, 1, addr->digit_mode);
+	bit_offset += 1;
+
+	bit_field_pack(buf, bit_offset, 1, addr->number_mode);
+	bit_offset += 1;
+
+	if (addr->digit_mode == CDMA_SMS_DIGIT_MODE_8BIT_ASCII) {
+		if (addr->number_mode == CDMA_SMS_NUM_MODE_DIGIT)
+			bit_field_pack(buf, bit_offset, 3,
+						addr->digi_num_type);
+		else
+			bit_field_pack(buf, bit_offset, 3,
+						addr->data_nw_num_type);
+
+		bit_offset += 3;
+
+		if (addr->number_mode == CDMA_SMS_NUM_MODE_DIGIT) {
+			bit_field_pack(buf, bit_offset, 4, addr->number_plan);
+			bit_offset += 4;
+		}
+	}
+
+	bit_field_pack(buf, bit_offset, 8, addr->num_fields);
+	bit_offset += 8;
+
+	bit_field_pack_array(buf, bit_offset, chari_len, addr->address,
+						addr->num_fields);
+
+	return len;
+}
+
 static char *decode_text_7bit_ascii(const struct cdma_sms_ud *ud)
 {
 	char *buf;
@@ -279,37 +631,161 @@ static char *decode_text_7bit_ascii(const struct cdma_sms_ud *ud)
 	return buf;
 }
 
+/* ISO 8859-1 maps directly onto the first 256 Unicode code points */
+static char *decode_text_latin(const struct cdma_sms_ud *ud)
+{
+	char *buf;
+	char *out;
+	guint8 index;
+
+	buf = g_new(char, ud->num_fields * 2 + 1);
+	if (buf == NULL)
+		return NULL;
+
+	out = buf;
+
+	for (index = 0; index < ud->num_fields; index++)
+		out += g_unichar_to_utf8(ud->chari[index], out);
+
+	*out = 0; /* Make it NULL terminated string */
+
+	return buf;
+}
+
+/* Fields are UTF-16 code units, most significant octet first */
+static char *decode_text_unicode(const struct cdma_sms_ud *ud)
+{
+	gunichar2 utf16[CDMA_SMS_UD_LEN / 2];
+	guint8 index;
+
+	for (index = 0; index < ud->num_fields; index++)
+		utf16[index] = ud->chari[index * 2] << 8 |
+					ud->chari[index * 2 + 1];
+
+	return g_utf16_to_utf8(utf16, ud->num_fields, NULL, NULL, NULL);
+}
+
+/* TODO: Add support for all other encoding types */
+static const struct ud_codec ud_codecs[] = {
+	[CDMA_SMS_MSG_ENCODING_OCTET] =		{ 8, 0, 0, NULL },
+	[CDMA_SMS_MSG_ENCODING_7BIT_ASCII] =	{ 7, 160, 0x7f,
+						decode_text_7bit_ascii },
+	[CDMA_SMS_MSG_ENCODING_IA5] =		{ 7, 0, 0,
+						decode_text_7bit_ascii },
+	[CDMA_SMS_MSG_ENCODING_UNICODE] =	{ 16, 70, 0x10ffff,
+						decode_text_unicode },
+	[CDMA_SMS_MSG_ENCODING_LATIN_HEBREW] =	{ 8, 0, 0, NULL },
+	[CDMA_SMS_MSG_ENCODING_LATIN] =		{ 8, 140, 0xff,
+						decode_text_latin },
+	[CDMA_SMS_MSG_ENCODING_GSM_7BIT] =	{ 7, 0, 0, NULL },
+};
+
+/* Candidates for encoding text, the most compact one that fits wins */
+static const enum cdma_sms_msg_encoding text_encodings[] = {
+	CDMA_SMS_MSG_ENCODING_7BIT_ASCII,
+	CDMA_SMS_MSG_ENCODING_LATIN,
+	CDMA_SMS_MSG_ENCODING_UNICODE,
+};
+
+static const struct ud_codec *ud_codec_for_encoding(
+					enum cdma_sms_msg_encoding encoding)
+{
+	if ((unsigned int) encoding >= G_N_ELEMENTS(ud_codecs))
+		return NULL;
+
+	if (ud_codecs[encoding].field_bits == 0)
+		return NULL;
+
+	return &ud_codecs[encoding];
+}
+
 char *cdma_sms_decode_text(const struct cdma_sms_ud *ud)
 {
-	switch (ud->msg_encoding) {
-	case CDMA_SMS_MSG_ENCODING_OCTET:
-	case CDMA_SMS_MSG_ENCODING_EXTENDED_PROTOCOL_MSG:
-		return NULL; /* TODO */
-	case CDMA_SMS_MSG_ENCODING_7BIT_ASCII:
-		return decode_text_7bit_ascii(ud);
-	case CDMA_SMS_MSG_ENCODING_IA5:
-	case CDMA_SMS_MSG_ENCODING_UNICODE:
-	case CDMA_SMS_MSG_ENCODING_SHIFT_JIS:
-	case CDMA_SMS_MSG_ENCODING_KOREAN:
-	case CDMA_SMS_MSG_ENCODING_LATIN_HEBREW:
-	case CDMA_SMS_MSG_ENCODING_LATIN:
-	case CDMA_SMS_MSG_ENCODING_GSM_7BIT:
-	case CDMA_SMS_MSG_ENCODING_GSM_DATA_CODING:
+	const struct ud_codec *codec = ud_codec_for_encoding(ud->msg_encoding);
+
+	if (codec == NULL || codec->to_utf8 == NULL)
 		return NULL; /* TODO */
+
+	return codec->to_utf8(ud);
+}
+
+gboolean cdma_sms_encode_text(const char *utf8, struct cdma_sms_ud *ud)
+{
+	enum cdma_sms_msg_encoding encoding;
+	const struct ud_codec *codec;
+	gunichar max_char = 0;
+	unsigned int num_chars = 0;
+	unsigned int num_units = 0;
+	unsigned int num_fields;
+	unsigned int i;
+	const char *p;
+
+	if (g_utf8_validate(utf8, -1, NULL) == FALSE)
+		return FALSE;
+
+	for (p = utf8; *p; p = g_utf8_next_char(p)) {
+		gunichar c = g_utf8_get_char(p);
+
+		max_char = MAX(max_char, c);
+		num_chars += 1;
+		num_units += c > 0xffff ? 2 : 1;
 	}
 
-	return NULL;
+	for (i = 0; i < G_N_ELEMENTS(text_encodings); i++)
+		if (ud_codecs[text_encodings[i]].max_char >= max_char)
+			break;
+
+	if (i == G_N_ELEMENTS(text_encodings))
+		return FALSE;
+
+	encoding = text_encodings[i];
+	codec = &ud_codecs[encoding];
+
+	if (encoding == CDMA_SMS_MSG_ENCODING_UNICODE)
+		num_fields = num_units;
+	else
+		num_fields = num_chars;
+
+	/* TODO: Segmentation into several messages */
+	if (num_fields > codec->max_fields)
+		return FALSE;
+
+	ud->msg_encoding = encoding;
+	ud->num_fields = num_fields;
+
+	for (p = utf8, i = 0; *p; p = g_utf8_next_char(p)) {
+		gunichar c = g_utf8_get_char(p);
+
+		if (encoding != CDMA_SMS_MSG_ENCODING_UNICODE) {
+			ud->chari[i++] = c;
+			continue;
+		}
+
+		if (c > 0xffff) {
+			c -= 0x10000;
+
+			ud->chari[i++] = 0xd8 | (c >> 18);
+			ud->chari[i++] = (c >> 10) & 0xff;
+			c = 0xdc00 | (c & 0x3ff);
+		}
+
+		ud->chari[i++] = c >> 8;
+		ud->chari[i++] = c & 0xff;
+	}
+
+	return TRUE;
 }
 
 /* Decode User Data */
 static gboolean cdma_sms_decode_ud(const guint8 *buf, guint8 len, void *data)
 {
 	guint16 bit_offset = 0;
-	guint8  chari_len = 0;
 	guint16 total_num_bits = len * 8;
-	guint8  index;
 	enum cdma_sms_msg_encoding  msg_encoding;
 	struct cdma_sms_ud *ud = data;
+	const struct ud_codec *codec;
+	guint8 chari_len;
+	guint16 count;
 
 	if (total_num_bits < 13)
 		return FALSE;
@@ -333,48 +809,58 @@ static gboolean cdma_sms_decode_ud(const guint8 *buf, guint8 len, void *data)
 	ud->num_fields = bit_field_unpack(buf, bit_offset, 8);
 	bit_offset += 8;
 
-	switch (msg_encoding) {
-	case CDMA_SMS_MSG_ENCODING_OCTET:
-		chari_len = 8;
-		break;
-	case CDMA_SMS_MSG_ENCODING_EXTENDED_PROTOCOL_MSG:
-		return FALSE; /* TODO */
-	case CDMA_SMS_MSG_ENCODING_7BIT_ASCII:
-	case CDMA_SMS_MSG_ENCODING_IA5:
-		chari_len = 7;
-		break;
-	case CDMA_SMS_MSG_ENCODING_UNICODE:
-	case CDMA_SMS_MSG_ENCODING_SHIFT_JIS:
-	case CDMA_SMS_MSG_ENCODING_KOREAN:
-		return FALSE; /* TODO */
-	case CDMA_SMS_MSG_ENCODING_LATIN_HEBREW:
-	case CDMA_SMS_MSG_ENCODING_LATIN:
-		chari_len = 8;
-		break;
-	case CDMA_SMS_MSG_ENCODING_GSM_7BIT:
-		chari_len = 7;
-		break;
-	case CDMA_SMS_MSG_ENCODING_GSM_DATA_CODING:
-		return FALSE; /* TODO */
-	}
-
-	/* TODO: Add support for all other encoding types */
-	if (chari_len == 0)
+	codec = ud_codec_for_encoding(msg_encoding);
+	if (codec == NULL)
 		return FALSE;
 
-	if (bit_offset + chari_len * ud->num_fields > total_num_bits)
+	if (bit_offset + codec->field_bits * ud->num_fields > total_num_bits)
 		return FALSE;
 
-	for (index = 0; index < ud->num_fields; index++) {
-		ud->chari[index] = bit_field_unpack(buf,
-						bit_offset,
-						chari_len);
-		bit_offset += chari_len;
+	chari_len = codec->field_bits;
+	count = ud->num_fields;
+
+	if (chari_len == 16) {
+		chari_len = 8;
+		count *= 2;
 	}
 
+	bit_field_unpack_array(buf, bit_offset, chari_len, ud->chari, count);
+
 	return TRUE;
 }
 
+static int cdma_sms_encode_ud(const void *data, guint8 *buf, int max)
+{
+	const struct cdma_sms_ud *ud = data;
+	const struct ud_codec *codec;
+	guint8 chari_len;
+	guint16 count;
+	int len;
+
+	/* Encodings with a message type field are not supported */
+	codec = ud_codec_for_encoding(ud->msg_encoding);
+	if (codec == NULL)
+		return -1;
+
+	chari_len = codec->field_bits;
+	count = ud->num_fields;
+
+	if (chari_len == 16) {
+		chari_len = 8;
+		count *= 2;
+	}
+
+	len = (5 + 8 + chari_len * count + 7) / 8;
+	if (len > max)
+		return -1;
+
+	bit_field_pack(buf, 0, 5, ud->msg_encoding);
+	bit_field_pack(buf, 5, 8, ud->num_fields);
+	bit_field_pack_array(buf, 13, chari_len, ud->chari, count);
+
+	return len;
+}
+
 /* Decode Message Identifier */
 static gboolean cdma_sms_decode_message_id(const guint8 *buf, guint8 len,
 						void *data)
@@ -398,215 +884,338 @@ static gboolean cdma_sms_decode_message_id(const guint8 *buf, guint8 len,
 	return TRUE;
 }
 
-static gboolean find_and_decode(struct simple_iter *iter, guint8 rec_id,
-					rec_handler handler, void *data)
+static int cdma_sms_encode_message_id(const void *data, guint8 *buf, int max)
 {
-	guint8 id;
-	guint8 len;
-	const guint8 *buf;
+	const struct cdma_sms_identifier *id = data;
 
-	while (simple_iter_next(iter) == TRUE) {
-		id = simple_iter_get_id(iter);
-		if (id != rec_id)
-			continue;
+	if (max < 3)
+		return -1;
 
-		len = simple_iter_get_length(iter);
-		buf = simple_iter_get_data(iter);
+	bit_field_pack(buf, 0, 4, id->msg_type);
+	bit_field_pack(buf, 4, 8, id->msg_id >> 8);
+	bit_field_pack(buf, 12, 8, id->msg_id & 0xff);
+	bit_field_pack(buf, 20, 1, id->header_ind);
 
-		return handler(buf, len, data);
-	}
+	return 3;
+}
 
-	return FALSE;
+static guint8 bcd_to_dec(guint8 bcd)
+{
+	if ((bcd >> 4) > 9 || (bcd & 0xf) > 9)
+		return 0xff;
+
+	return (bcd >> 4) * 10 + (bcd & 0xf);
 }
 
-static rec_handler subparam_handler_for_id(enum cdma_sms_subparam_id id)
-{
-	switch (id) {
-	case CDMA_SMS_SUBPARAM_ID_MESSAGE_ID:
-		return cdma_sms_decode_message_id;
-	case CDMA_SMS_SUBPARAM_ID_USER_DATA:
-		return cdma_sms_decode_ud;
-	case CDMA_SMS_SUBPARAM_ID_USER_RESPONSE_CODE:
-	case CDMA_SMS_SUBPARAM_ID_MC_TIME_STAMP:
-	case CDMA_SMS_SUBPARAM_ID_VALIDITY_PERIOD_ABSOLUTE:
-	case CDMA_SMS_SUBPARAM_ID_VALIDITY_PERIOD_RELATIVE:
-	case CDMA_SMS_SUBPARAM_ID_DEFERRED_DELIVERY_TIME_ABSOLUTE:
-	case CDMA_SMS_SUBPARAM_ID_DEFERRED_DELIVERY_TIME_RELATIVE:
-	case CDMA_SMS_SUBPARAM_ID_PRIORITY_INDICATOR:
-	case CDMA_SMS_SUBPARAM_ID_PRIVACY_INDICATOR:
-	case CDMA_SMS_SUBPARAM_ID_REPLY_OPTION:
-	case CDMA_SMS_SUBPARAM_ID_NUMBER_OF_MESSAGES:
-	case CDMA_SMS_SUBPARAM_ID_ALERT_ON_MESSAGE_DELIVERY:
-	case CDMA_SMS_SUBPARAM_ID_LANGUAGE_INDICATOR:
-	case CDMA_SMS_SUBPARAM_ID_CALL_BACK_NUMBER:
-	case CDMA_SMS_SUBPARAM_ID_MESSAGE_DISPLAY_MODE:
-	case CDMA_SMS_SUBPARAM_ID_MULTIPLE_ENCODING_USER_DATA:
-	case CDMA_SMS_SUBPARAM_ID_MESSAGE_DEPOSIT_INDEX:
-	case CDMA_SMS_SUBPARAM_ID_SERVICE_CATEGORY_PROGRAM_DATA:
-	case CDMA_SMS_SUBPARAM_ID_SERVICE_CATEGORY_PROGRAM_RESULT:
-	case CDMA_SMS_SUBPARAM_ID_MESSAGE_STATUS:
-	case CDMA_SMS_SUBPARAM_ID_TP_FAILURE_CAUSE:
-	case CDMA_SMS_SUBPARAM_ID_ENHANCED_VMN:
-	case CDMA_SMS_SUBPARAM_ID_ENHANCED_VMN_ACK:
-		return NULL; /* TODO */
+static guint8 dec_to_bcd(guint8 dec)
+{
+	return (dec / 10) << 4 | dec % 10;
+}
+
+/* Decode Message Center Time Stamp, six BCD octets */
+static gboolean cdma_sms_decode_time_stamp(const guint8 *buf, guint8 len,
+						void *data)
+{
+	struct cdma_sms_time_stamp *ts = data;
+	guint8 fields[6];
+	unsigned int i;
+
+	if (len < 6)
+		return FALSE;
+
+	for (i = 0; i < 6; i++) {
+		fields[i] = bcd_to_dec(buf[i]);
+
+		if (fields[i] == 0xff)
+			return FALSE;
 	}
 
-	return NULL;
+	ts->year = fields[0];
+	ts->month = fields[1];
+	ts->day = fields[2];
+	ts->hour = fields[3];
+	ts->minute = fields[4];
+	ts->second = fields[5];
+
+	return TRUE;
 }
 
-struct subparam_handler_entry {
-	enum cdma_sms_subparam_id id;
-	int flags;
-	gboolean found;
-	void *data;
-};
+static int cdma_sms_encode_time_stamp(const void *data, guint8 *buf, int max)
+{
+	const struct cdma_sms_time_stamp *ts = data;
+
+	if (max < 6)
+		return -1;
 
-static gboolean decode_subparams(struct simple_iter *iter, guint32 *bitmap,
-					void *data, ...)
+	buf[0] = dec_to_bcd(ts->year % 100);
+	buf[1] = dec_to_bcd(ts->month);
+	buf[2] = dec_to_bcd(ts->day);
+	buf[3] = dec_to_bcd(ts->hour);
+	buf[4] = dec_to_bcd(ts->minute);
+	buf[5] = dec_to_bcd(ts->second);
+
+	return 6;
+}
+
+/* Decode Validity Period - Relative */
+static gboolean cdma_sms_decode_octet(const guint8 *buf, guint8 len,
+						void *data)
 {
-	GSList *entries = NULL;
-	GSList *l;
-	va_list args;
-	gboolean decode_result = TRUE;
+	guint8 *value = data;
 
-	va_start(args, data);
+	if (len < 1)
+		return FALSE;
 
-	while (data != NULL) {
-		struct subparam_handler_entry *entry;
+	*value = buf[0];
 
-		entry = g_new0(struct subparam_handler_entry, 1);
+	return TRUE;
+}
 
-		entry->data = data;
-		entry->id = va_arg(args, enum cdma_sms_subparam_id);
-		entry->flags = va_arg(args, int);
+static int cdma_sms_encode_octet(const void *data, guint8 *buf, int max)
+{
+	const guint8 *value = data;
 
-		data = va_arg(args, void *);
-		entries = g_slist_prepend(entries, entry);
-	}
+	if (max < 1)
+		return -1;
 
-	va_end(args);
+	buf[0] = *value;
 
-	entries = g_slist_reverse(entries);
+	return 1;
+}
 
-	l = entries;
-	while (simple_iter_next(iter) == TRUE) {
-		rec_handler handler;
-		struct subparam_handler_entry *entry;
-		guint8 subparam_len;
-		const guint8 *subparam_buf;
-		GSList *l2;
+/* Decode Priority Indicator */
+static gboolean cdma_sms_decode_priority(const guint8 *buf, guint8 len,
+						void *data)
+{
+	enum cdma_sms_priority *priority = data;
 
-		for (l2 = l; l2; l2 = l2->next) {
-			entry = l2->data;
+	if (len < 1)
+		return FALSE;
 
-			if (simple_iter_get_id(iter) == entry->id)
-				break;
-		}
+	*priority = bit_field_unpack(buf, 0, 2);
 
-		/* Ignore unexpected subparameter record */
-		if (l2 == NULL)
-			continue;
+	return TRUE;
+}
 
-		entry->found = TRUE;
+static int cdma_sms_encode_priority(const void *data, guint8 *buf, int max)
+{
+	const enum cdma_sms_priority *priority = data;
 
-		subparam_len = simple_iter_get_length(iter);
-		subparam_buf = simple_iter_get_data(iter);
+	if (max < 1)
+		return -1;
 
-		handler = subparam_handler_for_id(entry->id);
+	bit_field_pack(buf, 0, 2, *priority);
 
-		decode_result = handler(subparam_buf,
-					subparam_len,
-					entry->data);
-		if (decode_result == FALSE)
-			break; /* Stop if decoding failed */
+	return 1;
+}
 
-		set_bitmap(bitmap, entry->id);
-	}
+/* Decode Privacy Indicator */
+static gboolean cdma_sms_decode_privacy(const guint8 *buf, guint8 len,
+						void *data)
+{
+	enum cdma_sms_privacy *privacy = data;
 
-	for (; l; l = l->next) {
-		struct subparam_handler_entry *entry = l->data;
+	if (len < 1)
+		return FALSE;
 
-		if ((entry->flags & CDMA_SMS_REC_FLAG_MANDATORY) &&
-			(entry->found == FALSE)) {
-			decode_result = FALSE;
-			break;
-		}
-	}
+	*privacy = bit_field_unpack(buf, 0, 2);
 
-	g_slist_foreach(entries, (GFunc) g_free, NULL);
-	g_slist_free(entries);
+	return TRUE;
+}
 
-	return decode_result;
+static int cdma_sms_encode_privacy(const void *data, guint8 *buf, int max)
+{
+	const enum cdma_sms_privacy *privacy = data;
+
+	if (max < 1)
+		return -1;
+
+	bit_field_pack(buf, 0, 2, *privacy);
+
+	return 1;
 }
 
-/* Decode WMT */
-static gboolean cdma_sms_decode_wmt(struct simple_iter *iter,
-					struct cdma_sms_bearer_data *bd)
+/* Decode Reply Option */
+static gboolean cdma_sms_decode_reply_option(const guint8 *buf, guint8 len,
+						void *data)
+{
+	struct cdma_sms_reply_option *opt = data;
+
+	if (len < 1)
+		return FALSE;
+
+	opt->user_ack_req = bit_field_unpack(buf, 0, 1);
+	opt->dak_req = bit_field_unpack(buf, 1, 1);
+	opt->read_ack_req = bit_field_unpack(buf, 2, 1);
+	opt->report_req = bit_field_unpack(buf, 3, 1);
+
+	return TRUE;
+}
+
+static int cdma_sms_encode_reply_option(const void *data, guint8 *buf,
+						int max)
+{
+	const struct cdma_sms_reply_option *opt = data;
+
+	if (max < 1)
+		return -1;
+
+	bit_field_pack(buf, 0, 1, opt->user_ack_req);
+	bit_field_pack(buf, 1, 1, opt->dak_req);
+	bit_field_pack(buf, 2, 1, opt->read_ack_req);
+	bit_field_pack(buf, 3, 1, opt->report_req);
+
+	return 1;
+}
+
+#define BD_FIELD(field) offsetof(struct cdma_sms_bearer_data, field)
+
+/* Message Identifier is mandatory, Section 4 of C.S0015-B v2.0 */
+static const struct rec_entry bd_header_recs[] = {
+	{ CDMA_SMS_SUBPARAM_ID_MESSAGE_ID, CDMA_SMS_REC_FLAG_MANDATORY,
+		cdma_sms_decode_message_id, cdma_sms_encode_message_id,
+		BD_FIELD(id) },
+};
+
+/*
+ * WMT DELIVER, table 4.3.4-1 of C.S0015-B v2.0.  A malformed informational
+ * subparameter doesn't cost the user the message.
+ * TODO: Not all optional subparameters supported.
+ */
+static const struct rec_entry wmt_deliver_recs[] = {
+	{ CDMA_SMS_SUBPARAM_ID_USER_DATA, 0,
+		cdma_sms_decode_ud, cdma_sms_encode_ud,
+		BD_FIELD(wmt_deliver.ud) },
+	{ CDMA_SMS_SUBPARAM_ID_MC_TIME_STAMP,
+		CDMA_SMS_REC_FLAG_SKIP_INVALID,
+		cdma_sms_decode_time_stamp, cdma_sms_encode_time_stamp,
+		BD_FIELD(wmt_deliver.mc_time) },
+	{ CDMA_SMS_SUBPARAM_ID_PRIORITY_INDICATOR,
+		CDMA_SMS_REC_FLAG_SKIP_INVALID,
+		cdma_sms_decode_priority, cdma_sms_encode_priority,
+		BD_FIELD(wmt_deliver.priority) },
+	{ CDMA_SMS_SUBPARAM_ID_PRIVACY_INDICATOR,
+		CDMA_SMS_REC_FLAG_SKIP_INVALID,
+		cdma_sms_decode_privacy, cdma_sms_encode_privacy,
+		BD_FIELD(wmt_deliver.privacy) },
+};
+
+/*
+ * WMT SUBMIT, table 4.3.4-2 of C.S0015-B v2.0
+ * TODO: Not all optional subparameters supported.
+ */
+static const struct rec_entry wmt_submit_recs[] = {
+	{ CDMA_SMS_SUBPARAM_ID_USER_DATA, 0,
+		cdma_sms_decode_ud, cdma_sms_encode_ud,
+		BD_FIELD(wmt_submit.ud) },
+	{ CDMA_SMS_SUBPARAM_ID_VALIDITY_PERIOD_RELATIVE, 0,
+		cdma_sms_decode_octet, cdma_sms_encode_octet,
+		BD_FIELD(wmt_submit.validity_period) },
+	{ CDMA_SMS_SUBPARAM_ID_PRIORITY_INDICATOR, 0,
+		cdma_sms_decode_priority, cdma_sms_encode_priority,
+		BD_FIELD(wmt_submit.priority) },
+	{ CDMA_SMS_SUBPARAM_ID_PRIVACY_INDICATOR, 0,
+		cdma_sms_decode_privacy, cdma_sms_encode_privacy,
+		BD_FIELD(wmt_submit.privacy) },
+	{ CDMA_SMS_SUBPARAM_ID_REPLY_OPTION, 0,
+		cdma_sms_decode_reply_option, cdma_sms_encode_reply_option,
+		BD_FIELD(wmt_submit.reply_option) },
+};
+
+static const struct rec_entry *wmt_recs(enum cdma_sms_msg_type type,
+						unsigned int *n)
 {
-	switch (bd->id.msg_type) {
+	switch (type) {
 	case CDMA_SMS_MSG_TYPE_RESERVED:
-		return FALSE; /* Invalid */
+		return NULL; /* Invalid */
 	case CDMA_SMS_MSG_TYPE_DELIVER:
-		/*
-		 * WMT DELIVER, table 4.3.4-1 of C.S0015-B v2.0
-		 * TODO: Not all optional subparameters supported.
-		 */
-		return decode_subparams(iter,
-					&bd->subparam_bitmap,
-					&bd->wmt_deliver.ud,
-					CDMA_SMS_SUBPARAM_ID_USER_DATA,
-					0,
-					NULL);
-		break;
+		*n = G_N_ELEMENTS(wmt_deliver_recs);
+		return wmt_deliver_recs;
 	case CDMA_SMS_MSG_TYPE_SUBMIT:
+		*n = G_N_ELEMENTS(wmt_submit_recs);
+		return wmt_submit_recs;
 	case CDMA_SMS_MSG_TYPE_CANCEL:
-		return FALSE; /* Invalid for MT WMT */
 	case CDMA_SMS_MSG_TYPE_DELIVER_ACK:
 	case CDMA_SMS_MSG_TYPE_USER_ACK:
 	case CDMA_SMS_MSG_TYPE_READ_ACK:
-		return FALSE; /* TODO: Not supported yet */
+		return NULL; /* TODO: Not supported yet */
 	case CDMA_SMS_MSG_TYPE_DELIVER_REPORT:
 	case CDMA_SMS_MSG_TYPE_SUBMIT_REPORT:
-		return FALSE; /* Invalid for MT WMT */
+		return NULL; /* Invalid for WMT */
 	}
 
-	return FALSE;
+	return NULL;
 }
 
-static gboolean p2p_decode_bearer_data(const guint8 *buf, guint8 len,
+static const struct rec_entry *p2p_bearer_data_recs(
 					enum cdma_sms_teleservice_id tele_id,
-					struct cdma_sms_bearer_data *bd)
+					enum cdma_sms_msg_type type,
+					unsigned int *n)
 {
-	struct simple_iter iter;
-
-	simple_iter_init(&iter, buf, len);
-
-	/* Message Identifier is mandatory, * Section 4 of C.S0015-B v2.0 */
-	if (find_and_decode(&iter,
-				CDMA_SMS_SUBPARAM_ID_MESSAGE_ID,
-				cdma_sms_decode_message_id,
-				&bd->id) != TRUE)
-		return FALSE;
-
-	set_bitmap(&bd->subparam_bitmap, CDMA_SMS_SUBPARAM_ID_MESSAGE_ID);
-
-	simple_iter_init(&iter, buf, len);
-
 	switch (tele_id) {
 	case CDMA_SMS_TELESERVICE_ID_CMT91:
 	case CDMA_SMS_TELESERVICE_ID_WPT:
-		return FALSE; /* TODO */
+		return NULL; /* TODO */
 	case CDMA_SMS_TELESERVICE_ID_WMT:
-		return cdma_sms_decode_wmt(&iter, bd);
+		return wmt_recs(type, n);
 	case CDMA_SMS_TELESERVICE_ID_VMN:
 	case CDMA_SMS_TELESERVICE_ID_WAP:
 	case CDMA_SMS_TELESERVICE_ID_WEMT:
 	case CDMA_SMS_TELESERVICE_ID_SCPT:
 	case CDMA_SMS_TELESERVICE_ID_CATPT:
-		return FALSE; /* TODO */
+		return NULL; /* TODO */
 	}
 
-	return FALSE;
+	return NULL;
+}
+
+static gboolean p2p_decode_bearer_data(const guint8 *buf, guint8 len,
+					enum cdma_sms_teleservice_id tele_id,
+					struct cdma_sms_bearer_data *bd)
+{
+	struct rec_index index;
+	const struct rec_entry *recs;
+	unsigned int n;
+
+	rec_index_init(&index, buf, len);
+
+	if (decode_records(&index, bd_header_recs,
+				G_N_ELEMENTS(bd_header_recs),
+				&bd->subparam_bitmap, bd) == FALSE)
+		return FALSE;
+
+	recs = p2p_bearer_data_recs(tele_id, bd->id.msg_type, &n);
+	if (recs == NULL)
+		return FALSE;
+
+	return decode_records(&index, recs, n, &bd->subparam_bitmap, bd);
+}
+
+static int p2p_encode_bearer_data(const struct cdma_sms_bearer_data *bd,
+					enum cdma_sms_teleservice_id tele_id,
+					guint8 *buf, int max)
+{
+	const struct rec_entry *recs;
+	unsigned int n;
+	int header_len;
+	int len;
+
+	recs = p2p_bearer_data_recs(tele_id, bd->id.msg_type, &n);
+	if (recs == NULL)
+		return -1;
+
+	header_len = encode_records(bd_header_recs,
+					G_N_ELEMENTS(bd_header_recs),
+					bd->subparam_bitmap, bd, buf, max);
+	if (header_len < 0)
+		return -1;
+
+	len = encode_records(recs, n, bd->subparam_bitmap, bd,
+				buf + header_len, max - header_len);
+	if (len < 0)
+		return -1;
+
+	return header_len + len;
 }
 
 /* Decode Bearer Data */
@@ -629,95 +1238,96 @@ static gboolean cdma_sms_decode_bearer_data(const guint8 *buf, guint8 len,
 	return FALSE;
 }
 
-static rec_handler param_handler_for_id(enum cdma_sms_param_id id,
-						struct cdma_sms *incoming,
-						void **data)
+static int cdma_sms_encode_bearer_data(const void *data, guint8 *buf, int max)
 {
-	if (incoming->type != CDMA_SMS_TP_MSG_TYPE_P2P)
-		return NULL; /* TODO: Other types not supported yet */
+	const struct cdma_sms *msg = data;
 
-	switch (id) {
-	case CDMA_SMS_PARAM_ID_TELESERVICE_IDENTIFIER:
-		*data = &incoming->p2p_msg.teleservice_id;
-		return cdma_sms_decode_teleservice;
-	case CDMA_SMS_PARAM_ID_SERVICE_CATEGORY:
-		return NULL; /* TODO */
-	case CDMA_SMS_PARAM_ID_ORIGINATING_ADDRESS:
-		*data = &incoming->p2p_msg.oaddr;
-		return cdma_sms_decode_addr;
-	case CDMA_SMS_PARAM_ID_ORIGINATING_SUBADDRESS:
-	case CDMA_SMS_PARAM_ID_DESTINATION_ADDRESS:
-	case CDMA_SMS_PARAM_ID_DESTINATION_SUBADDRESS:
-	case CDMA_SMS_PARAM_ID_BEARER_REPLY_OPTION:
-	case CDMA_SMS_PARAM_ID_CAUSE_CODE:
-		return NULL; /* TODO */
-	case CDMA_SMS_PARAM_ID_BEARER_DATA:
-		*data = incoming;
-		return cdma_sms_decode_bearer_data;
+	switch (msg->type) {
+	case CDMA_SMS_TP_MSG_TYPE_P2P:
+		return p2p_encode_bearer_data(&msg->p2p_msg.bd,
+						msg->p2p_msg.teleservice_id,
+						buf, max);
+	case CDMA_SMS_TP_MSG_TYPE_BCAST:
+		return -1; /* TODO */
+	case CDMA_SMS_TP_MSG_TYPE_ACK:
+		return -1; /* Invalid */
 	}
 
-	return NULL;
+	return -1;
 }
 
-static gboolean cdma_sms_p2p_decode(const guint8 *pdu, guint8 len,
-					struct cdma_sms *incoming)
-{
-	struct simple_iter iter;
+#define MSG_FIELD(field) offsetof(struct cdma_sms, field)
 
-	simple_iter_init(&iter, pdu, len);
-
-	/*
-	 * Teleservice Identifier is mandatory,
-	 * Table 3.4.2.1-1 of C.S0015-B v2.0
-	 */
-	if (find_and_decode(&iter,
-				CDMA_SMS_PARAM_ID_TELESERVICE_IDENTIFIER,
-				cdma_sms_decode_teleservice,
-				&incoming->p2p_msg.teleservice_id) != TRUE)
-		return FALSE;
+/*
+ * Table 3.4.2.1-1 of C.S0015-B v2.0.  Bearer Data is decoded according
+ * to the Teleservice Identifier, so it has to come last.
+ * TODO: Not all parameter records supported yet.
+ */
+static const struct rec_entry p2p_recs[] = {
+	{ CDMA_SMS_PARAM_ID_TELESERVICE_IDENTIFIER, CDMA_SMS_REC_FLAG_MANDATORY,
+		cdma_sms_decode_teleservice, cdma_sms_encode_teleservice,
+		MSG_FIELD(p2p_msg.teleservice_id) },
+	{ CDMA_SMS_PARAM_ID_ORIGINATING_ADDRESS, 0,
+		cdma_sms_decode_addr, cdma_sms_encode_addr,
+		MSG_FIELD(p2p_msg.oaddr) },
+	{ CDMA_SMS_PARAM_ID_DESTINATION_ADDRESS, 0,
+		cdma_sms_decode_addr, cdma_sms_encode_addr,
+		MSG_FIELD(p2p_msg.daddr) },
+	{ CDMA_SMS_PARAM_ID_BEARER_DATA, 0,
+		cdma_sms_decode_bearer_data, cdma_sms_encode_bearer_data, 0 },
+};
 
-	set_bitmap(&incoming->p2p_msg.param_bitmap,
-			CDMA_SMS_PARAM_ID_TELESERVICE_IDENTIFIER);
+/* Table 4.5.1-1 of C.S0015-B v2.0 */
+static gboolean msg_type_is_mo(enum cdma_sms_msg_type type)
+{
+	switch (type) {
+	case CDMA_SMS_MSG_TYPE_SUBMIT:
+	case CDMA_SMS_MSG_TYPE_CANCEL:
+	case CDMA_SMS_MSG_TYPE_USER_ACK:
+	case CDMA_SMS_MSG_TYPE_READ_ACK:
+	case CDMA_SMS_MSG_TYPE_DELIVER_REPORT:
+		return TRUE;
+	case CDMA_SMS_MSG_TYPE_RESERVED:
+	case CDMA_SMS_MSG_TYPE_DELIVER:
+	case CDMA_SMS_MSG_TYPE_DELIVER_ACK:
+	case CDMA_SMS_MSG_TYPE_SUBMIT_REPORT:
+		break;
+	}
 
-	simple_iter_init(&iter, pdu, len);
+	return FALSE;
+}
 
-	while (simple_iter_next(&iter) == TRUE) {
-		rec_handler handler;
-		enum cdma_sms_param_id rec_id;
-		guint8 rec_len;
-		const guint8 *rec_buf;
-		void *uninitialized_var(dataobj);
-
-		rec_id = simple_iter_get_id(&iter);
-		if (rec_id == CDMA_SMS_PARAM_ID_TELESERVICE_IDENTIFIER)
-			continue;
+static gboolean cdma_sms_p2p_decode(const guint8 *pdu, guint8 len,
+					struct cdma_sms *incoming)
+{
+	struct rec_index index;
+	guint32 *bitmap = &incoming->p2p_msg.param_bitmap;
 
-		rec_len = simple_iter_get_length(&iter);
-		rec_buf = simple_iter_get_data(&iter);
+	rec_index_init(&index, pdu, len);
 
-		handler = param_handler_for_id(rec_id, incoming, &dataobj);
-		if (handler != NULL) {
-			if (handler(rec_buf, rec_len, dataobj) == FALSE)
-				return FALSE;
-
-			set_bitmap(&incoming->p2p_msg.param_bitmap, rec_id);
-		}
-	}
+	if (decode_records(&index, p2p_recs, G_N_ELEMENTS(p2p_recs),
+				bitmap, incoming) == FALSE)
+		return FALSE;
 
 	/*
-	 * Originating Address is mandatory field,
+	 * Originating Address is mandatory for messages to the mobile
+	 * station and Destination Address for messages from it,
 	 * Table 3.4.2.1-1 of C.S0015-B v2.0
 	 */
-	if ((incoming->p2p_msg.param_bitmap &
-			(1 << CDMA_SMS_PARAM_ID_ORIGINATING_ADDRESS)) == 0)
-		return FALSE;
+	if (check_bitmap(*bitmap, CDMA_SMS_PARAM_ID_BEARER_DATA) &&
+			msg_type_is_mo(incoming->p2p_msg.bd.id.msg_type))
+		return check_bitmap(*bitmap,
+					CDMA_SMS_PARAM_ID_DESTINATION_ADDRESS);
 
-	return TRUE;
+	return check_bitmap(*bitmap, CDMA_SMS_PARAM_ID_ORIGINATING_ADDRESS);
 }
 
 gboolean cdma_sms_decode(const guint8 *pdu, guint8 len,
 				struct cdma_sms *incoming)
 {
+	if (len < 1)
+		return FALSE;
+
 	incoming->type = bit_field_unpack(pdu, 0, 8);
 	pdu += 1;
 	len -= 1;
@@ -733,3 +1343,35 @@ gboolean cdma_sms_decode(const guint8 *pdu, guint8 len,
 
 	return FALSE;
 }
+
+/*
+ * Encodes the records flagged in the parameter and subparameter bitmaps
+ * into pdu, which has to hold CDMA_SMS_PDU_MAX_LEN octets.
+ */
+gboolean cdma_sms_encode(const struct cdma_sms *in, guint8 *pdu, int *len)
+{
+	int ret;
+
+	memset(pdu, 0, CDMA_SMS_PDU_MAX_LEN);
+
+	switch (in->type) {
+	case CDMA_SMS_TP_MSG_TYPE_P2P:
+		pdu[0] = in->type;
+
+		ret = encode_records(p2p_recs, G_N_ELEMENTS(p2p_recs),
+					in->p2p_msg.param_bitmap, in,
+					pdu + 1, CDMA_SMS_PDU_MAX_LEN - 1);
+		if (ret < 0)
+			return FALSE;
+
+		*len = ret + 1;
+
+		return TRUE;
+	case CDMA_SMS_TP_MSG_TYPE_BCAST:
+	case CDMA_SMS_TP_MSG_TYPE_ACK:
+		/* TODO: Not supported yet */
+		return FALSE;
+	}
+
+	return FALSE;
+}
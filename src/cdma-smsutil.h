@@ -22,6 +22,9 @@
 #define CDMA_SMS_MAX_ADDR_FIELDS 256
 #define CDMA_SMS_UD_LEN 512
 
+/* Parameter lengths are a single octet, so is the transport layer PDU */
+#define CDMA_SMS_PDU_MAX_LEN 255
+
 /* 3GPP2 C.S0015-B v2.0, Table 3.4-1 */
 enum cdma_sms_tp_msg_type {
 	CDMA_SMS_TP_MSG_TYPE_P2P =	0,
@@ -196,6 +199,22 @@ enum cdma_sms_digit_mode {
 	CDMA_SMS_DIGIT_MODE_8BIT_ASCII =	1
 };
 
+/* 3GPP2 C.S0015-B v2.0 Table 4.5.9-1 */
+enum cdma_sms_priority {
+	CDMA_SMS_PRIORITY_NORMAL =	0,
+	CDMA_SMS_PRIORITY_INTERACTIVE =	1,
+	CDMA_SMS_PRIORITY_URGENT =	2,
+	CDMA_SMS_PRIORITY_EMERGENCY =	3
+};
+
+/* 3GPP2 C.S0015-B v2.0 Table 4.5.10-1 */
+enum cdma_sms_privacy {
+	CDMA_SMS_PRIVACY_NOT_RESTRICTED =	0,
+	CDMA_SMS_PRIVACY_RESTRICTED =		1,
+	CDMA_SMS_PRIVACY_CONFIDENTIAL =		2,
+	CDMA_SMS_PRIVACY_SECRET =		3
+};
+
 /* 3GPP2 C.S0015-B v2.0 Section 3.4.3.3 */
 struct cdma_sms_address {
 	enum cdma_sms_digit_mode digit_mode;
@@ -230,6 +249,24 @@ struct cdma_sms_ud {
 	guint8 chari[CDMA_SMS_UD_LEN];
 };
 
+/* 3GPP2 C.S0015-B v2.0 Section 4.5.4, the year is given modulo 100 */
+struct cdma_sms_time_stamp {
+	guint8 year;
+	guint8 month;
+	guint8 day;
+	guint8 hour;
+	guint8 minute;
+	guint8 second;
+};
+
+/* 3GPP2 C.S0015-B v2.0 Section 4.5.11 */
+struct cdma_sms_reply_option {
+	gboolean user_ack_req;
+	gboolean dak_req;
+	gboolean read_ack_req;
+	gboolean report_req;
+};
+
 /*
  * 3GPP2 C.S0015-B v2.0 Table 4.3.4-1.
  * TODO: Not all subparameter records defined
@@ -237,6 +274,22 @@ struct cdma_sms_ud {
  */
 struct cdma_sms_wmt_deliver {
 	struct cdma_sms_ud ud;
+	struct cdma_sms_time_stamp mc_time;
+	enum cdma_sms_priority priority;
+	enum cdma_sms_privacy privacy;
+};
+
+/*
+ * 3GPP2 C.S0015-B v2.0 Table 4.3.4-2.
+ * TODO: Not all subparameter records defined
+ *       and supported yet.
+ */
+struct cdma_sms_wmt_submit {
+	struct cdma_sms_ud ud;
+	guint8 validity_period;
+	enum cdma_sms_priority priority;
+	enum cdma_sms_privacy privacy;
+	struct cdma_sms_reply_option reply_option;
 };
 
 /* 3GPP2 C.S0015-B v2.0 Section 4.5 */
@@ -245,6 +298,7 @@ struct cdma_sms_bearer_data {
 	struct cdma_sms_identifier id;
 	union {
 		struct cdma_sms_wmt_deliver wmt_deliver;
+		struct cdma_sms_wmt_submit wmt_submit;
 	};
 };
 
@@ -257,6 +311,7 @@ struct cdma_sms_p2p_msg {
 	guint32 param_bitmap;
 	enum cdma_sms_teleservice_id teleservice_id;
 	struct cdma_sms_address oaddr;
+	struct cdma_sms_address daddr;
 	struct cdma_sms_bearer_data bd;
 };
 
@@ -293,7 +348,16 @@ static inline gboolean check_bitmap(guint32 bitmap, guint32 pos)
 	return bitmap & mask ? TRUE : FALSE;
 }
 
+static inline void set_bitmap(guint32 *bitmap, guint32 pos)
+{
+	*bitmap = *bitmap | (0x1 << pos);
+}
+
 gboolean cdma_sms_decode(const guint8 *pdu, guint8 len,
 				struct cdma_sms *out);
+gboolean cdma_sms_encode(const struct cdma_sms *in, guint8 *pdu, int *len);
 char *cdma_sms_decode_text(const struct cdma_sms_ud *ud);
+gboolean cdma_sms_encode_text(const char *utf8, struct cdma_sms_ud *ud);
 const char *cdma_sms_address_to_string(const struct cdma_sms_address *addr);
+gboolean cdma_sms_address_from_string(struct cdma_sms_address *addr,
+					const char *str);
@@ -0,0 +1,270 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+#include <gdbus.h>
+
+#include "ofono.h"
+
+struct diag_channel {
+	unsigned int id;
+	char *name;
+	ofono_diagnostics_append_cb_t append;
+	void *data;
+};
+
+struct diagnostics {
+	struct ofono_modem *modem;
+	GSList *channels;
+	unsigned int next_id;
+};
+
+static GSList *g_diagnostics;
+static unsigned int modemwatch_id;
+
+static struct diagnostics *diagnostics_find(struct ofono_modem *modem)
+{
+	GSList *l;
+
+	for (l = g_diagnostics; l; l = l->next) {
+		struct diagnostics *diag = l->data;
+
+		if (diag->modem == modem)
+			return diag;
+	}
+
+	return NULL;
+}
+
+static void channel_free(gpointer data)
+{
+	struct diag_channel *channel = data;
+
+	g_free(channel->name);
+	g_free(channel);
+}
+
+void ofono_diagnostics_append_histogram(DBusMessageIter *dict,
+					const char *key,
+					const unsigned int *buckets,
+					unsigned int n_buckets)
+{
+	DBusMessageIter entry, variant, array;
+	const dbus_uint32_t *values = buckets;
+
+	dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY,
+						NULL, &entry);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+	dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT,
+						"au", &variant);
+	dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY,
+						DBUS_TYPE_UINT32_AS_STRING,
+						&array);
+	dbus_message_iter_append_fixed_array(&array, DBUS_TYPE_UINT32,
+						&values, n_buckets);
+	dbus_message_iter_close_container(&variant, &array);
+	dbus_message_iter_close_container(&entry, &variant);
+	dbus_message_iter_close_container(dict, &entry);
+}
+
+static DBusMessage *diagnostics_get_channels(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	struct diagnostics *diag = data;
+	DBusMessage *reply;
+	DBusMessageIter iter, array;
+	GSList *l;
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_ARRAY_AS_STRING
+					OFONO_PROPERTIES_ARRAY_SIGNATURE
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&array);
+
+	for (l = diag->channels; l; l = l->next) {
+		struct diag_channel *channel = l->data;
+		DBusMessageIter entry, dict;
+
+		dbus_message_iter_open_container(&array, DBUS_TYPE_DICT_ENTRY,
+							NULL, &entry);
+		dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING,
+							&channel->name);
+		dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY,
+					OFONO_PROPERTIES_ARRAY_SIGNATURE,
+					&dict);
+
+		channel->append(&dict, channel->data);
+
+		dbus_message_iter_close_container(&entry, &dict);
+		dbus_message_iter_close_container(&array, &entry);
+	}
+
+	dbus_message_iter_close_container(&iter, &array);
+
+	return reply;
+}
+
+static const GDBusMethodTable diagnostics_methods[] = {
+	{ GDBUS_METHOD("GetChannels",
+			NULL, GDBUS_ARGS({ "channels", "a{sa{sv}}" }),
+			diagnostics_get_channels) },
+	{ }
+};
+
+static void diagnostics_free(struct diagnostics *diag)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+	const char *path = ofono_modem_get_path(diag->modem);
+
+	g_dbus_unregister_interface(conn, path, OFONO_DIAGNOSTICS_INTERFACE);
+	ofono_modem_remove_interface(diag->modem, OFONO_DIAGNOSTICS_INTERFACE);
+
+	g_slist_free_full(diag->channels, channel_free);
+	g_diagnostics = g_slist_remove(g_diagnostics, diag);
+	g_free(diag);
+}
+
+static struct diagnostics *diagnostics_create(struct ofono_modem *modem)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+	const char *path = ofono_modem_get_path(modem);
+	struct diagnostics *diag;
+
+	diag = g_try_new0(struct diagnostics, 1);
+	if (diag == NULL)
+		return NULL;
+
+	diag->modem = modem;
+	diag->next_id = 1;
+
+	if (!g_dbus_register_interface(conn, path,
+					OFONO_DIAGNOSTICS_INTERFACE,
+					diagnostics_methods, NULL, NULL,
+					diag, NULL)) {
+		ofono_error("Could not create %s interface",
+					OFONO_DIAGNOSTICS_INTERFACE);
+		g_free(diag);
+		return NULL;
+	}
+
+	ofono_modem_add_interface(modem, OFONO_DIAGNOSTICS_INTERFACE);
+	g_diagnostics = g_slist_prepend(g_diagnostics, diag);
+
+	return diag;
+}
+
+unsigned int ofono_diagnostics_add_channel(struct ofono_modem *modem,
+					const char *name,
+					ofono_diagnostics_append_cb_t append,
+					void *data)
+{
+	struct diagnostics *diag;
+	struct diag_channel *channel;
+
+	if (modem == NULL || name == NULL || append == NULL)
+		return 0;
+
+	if (ofono_modem_is_registered(modem) == FALSE)
+		return 0;
+
+	diag = diagnostics_find(modem);
+	if (diag == NULL) {
+		diag = diagnostics_create(modem);
+		if (diag == NULL)
+			return 0;
+	}
+
+	channel = g_new0(struct diag_channel, 1);
+	channel->id = diag->next_id++;
+	channel->name = g_strdup(name);
+	channel->append = append;
+	channel->data = data;
+
+	diag->channels = g_slist_append(diag->channels, channel);
+
+	DBG("%s: %s", ofono_modem_get_path(modem), name);
+
+	return channel->id;
+}
+
+void ofono_diagnostics_remove_channel(struct ofono_modem *modem,
+					unsigned int id)
+{
+	struct diagnostics *diag = diagnostics_find(modem);
+	GSList *l;
+
+	if (diag == NULL)
+		return;
+
+	for (l = diag->channels; l; l = l->next) {
+		struct diag_channel *channel = l->data;
+
+		if (channel->id != id)
+			continue;
+
+		diag->channels = g_slist_remove(diag->channels, channel);
+		channel_free(channel);
+		break;
+	}
+
+	if (diag->channels == NULL)
+		diagnostics_free(diag);
+}
+
+static void diagnostics_modemwatch(struct ofono_modem *modem,
+					gboolean added, void *user)
+{
+	struct diagnostics *diag;
+
+	if (added)
+		return;
+
+	/* Drop channels the driver did not remove before going away */
+	diag = diagnostics_find(modem);
+	if (diag != NULL)
+		diagnostics_free(diag);
+}
+
+void __ofono_diagnostics_init(void)
+{
+	modemwatch_id = __ofono_modemwatch_add(diagnostics_modemwatch,
+						NULL, NULL);
+}
+
+void __ofono_diagnostics_cleanup(void)
+{
+	__ofono_modemwatch_remove(modemwatch_id);
+	modemwatch_id = 0;
+
+	while (g_diagnostics)
+		diagnostics_free(g_diagnostics->data);
+}
@@ -41,6 +41,18 @@
 
 #define RING_TIMEOUT 3
 
+/* Room for the +CIND: status of up to 16 indicators */
+#define CIND_STATUS_SIZE (7 + 1 + 16 * 4)
+
+/*
+ * Changes to indicators not related to calls are collected for
+ * INDICATOR_WINDOW ms and only the final value is reported.  Signal and
+ * battery are additionally reported at most once per interval.
+ */
+#define INDICATOR_WINDOW 100
+#define SIGNAL_INTERVAL 1000
+#define BATTERY_INTERVAL 5000
+
 #define CVSD_OFFSET 0
 #define MSBC_OFFSET 1
 #define CODECS_COUNT (MSBC_OFFSET + 1)
@@ -66,6 +78,9 @@ struct ofono_emulator {
 	int l_features;
 	int r_features;
 	GSList *indicators;
+	guint indicator_window;
+	guint indicator_source;
+	gint64 indicator_due;
 	guint callsetup_source;
 	int pns_id;
 	struct ofono_handsfree_card *card;
@@ -95,6 +110,11 @@ struct indicator {
 	gboolean deferred;
 	gboolean active;
 	gboolean mandatory;
+	gboolean coalesce;		/* Report through the window */
+	gboolean pending;		/* Waiting for the window to close */
+	guint interval;			/* Min ms between reports */
+	gint64 last_sent;		/* Monotonic time of last report */
+	int sent_value;			/* Value last seen by the HF */
 };
 
 static void emulator_debug(const char *str, void *data)
@@ -380,11 +400,30 @@ static struct ofono_call *find_call_with_status(struct ofono_emulator *em,
 	return __ofono_voicecall_find_call_with_status(vc, status);
 }
 
+static gboolean indicator_reportable(struct ofono_emulator *em,
+					struct indicator *ind)
+{
+	return em->events_mode == 3 && em->events_ind && em->slc &&
+			ind->active;
+}
+
+static void send_ciev(struct ofono_emulator *em, struct indicator *ind,
+			int index)
+{
+	char buf[20];
+
+	sprintf(buf, "+CIEV: %d,%d", index, ind->value);
+	g_at_server_send_unsolicited(em->server, buf);
+
+	ind->pending = FALSE;
+	ind->sent_value = ind->value;
+	ind->last_sent = g_get_monotonic_time();
+}
+
 static void notify_deferred_indicators(GAtServer *server, void *user_data)
 {
 	struct ofono_emulator *em = user_data;
 	int i;
-	char buf[20];
 	GSList *l;
 	struct indicator *ind;
 
@@ -394,16 +433,101 @@ static void notify_deferred_indicators(GAtServer *server, void *user_data)
 		if (!ind->deferred)
 			continue;
 
-		if (em->events_mode == 3 && em->events_ind && em->slc &&
-				ind->active) {
-			sprintf(buf, "+CIEV: %d,%d", i, ind->value);
-			g_at_server_send_unsolicited(em->server, buf);
-		}
+		if (indicator_reportable(em, ind))
+			send_ciev(em, ind, i);
 
 		ind->deferred = FALSE;
 	}
 }
 
+static gboolean flush_indicators(gpointer user_data)
+{
+	struct ofono_emulator *em = user_data;
+	gint64 now = g_get_monotonic_time();
+	gint64 next = G_MAXINT64;
+	GSList *l;
+	int i;
+
+	em->indicator_source = 0;
+
+	for (i = 1, l = em->indicators; l; l = l->next, i++) {
+		struct indicator *ind = l->data;
+		gint64 due;
+
+		if (!ind->pending)
+			continue;
+
+		if (!indicator_reportable(em, ind) ||
+				ind->value == ind->sent_value) {
+			ind->pending = FALSE;
+			continue;
+		}
+
+		/* Sent along with the reply once the command completes */
+		if (g_at_server_command_pending(em->server)) {
+			ind->pending = FALSE;
+			ind->deferred = TRUE;
+			continue;
+		}
+
+		due = ind->last_sent + (gint64) ind->interval * 1000;
+
+		if (ind->last_sent == 0 || due <= now) {
+			send_ciev(em, ind, i);
+			continue;
+		}
+
+		next = MIN(next, due);
+	}
+
+	/* Some indicators are still held back by their rate cap */
+	if (next != G_MAXINT64) {
+		em->indicator_due = next;
+		em->indicator_source = g_timeout_add((next - now + 999) / 1000,
+							flush_indicators, em);
+	}
+
+	return FALSE;
+}
+
+static void notify_indicator(struct ofono_emulator *em, struct indicator *ind,
+				int index)
+{
+	gint64 due;
+
+	if (!indicator_reportable(em, ind))
+		return;
+
+	if (g_at_server_command_pending(em->server)) {
+		ind->deferred = TRUE;
+		return;
+	}
+
+	if (!ind->coalesce || em->indicator_window == 0) {
+		send_ciev(em, ind, index);
+		return;
+	}
+
+	ind->pending = TRUE;
+
+	due = g_get_monotonic_time() + (gint64) em->indicator_window * 1000;
+
+	/*
+	 * The flush may be armed for a rate capped indicator, seconds away.
+	 * Don't let this one wait for longer than the coalescing window.
+	 */
+	if (em->indicator_source) {
+		if (em->indicator_due <= due)
+			return;
+
+		g_source_remove(em->indicator_source);
+	}
+
+	em->indicator_due = due;
+	em->indicator_source = g_timeout_add(em->indicator_window,
+						flush_indicators, em);
+}
+
 static gboolean notify_ccwa(void *user_data)
 {
 	struct ofono_emulator *em = user_data;
@@ -513,6 +637,7 @@ static void cind_cb(GAtServer *server, GAtServerRequestType type,
 	struct ofono_emulator *em = user_data;
 	GSList *l;
 	struct indicator *ind;
+	char status[CIND_STATUS_SIZE];
 	gsize size;
 	int len;
 	char *buf;
@@ -525,12 +650,11 @@ static void cind_cb(GAtServer *server, GAtServerRequestType type,
 		 * (max of 3 digits in the value + separator)
 		 */
 		size = 7 + 1 + (g_slist_length(em->indicators) * 4);
-		buf = g_try_malloc0(size);
-		if (buf == NULL)
+		if (size > sizeof(status))
 			goto fail;
 
-		len = sprintf(buf, "+CIND: ");
-		tmp = buf + len;
+		len = sprintf(status, "+CIND: ");
+		tmp = status + len;
 
 		for (l = em->indicators; l; l = l->next) {
 			ind = l->data;
@@ -538,10 +662,12 @@ static void cind_cb(GAtServer *server, GAtServerRequestType type,
 					l == em->indicators ? "" : ",",
 					ind->value);
 			tmp = tmp + len;
+
+			/* The HF is now up to date */
+			ind->sent_value = ind->value;
 		}
 
-		g_at_server_send_info(em->server, buf, TRUE);
-		g_free(buf);
+		g_at_server_send_info(em->server, status, TRUE);
 		g_at_server_send_final(server, G_AT_SERVER_RESULT_OK);
 		break;
 
@@ -1157,9 +1283,20 @@ static void emulator_add_indicator(struct ofono_emulator *em, const char* name,
 	ind->min = min;
 	ind->max = max;
 	ind->value = dflt;
+	ind->sent_value = dflt;
 	ind->active = TRUE;
 	ind->mandatory = mandatory;
 
+	/* Call state changes are always reported right away */
+	ind->coalesce = !g_str_equal(name, OFONO_EMULATOR_IND_CALL) &&
+			!g_str_equal(name, OFONO_EMULATOR_IND_CALLSETUP) &&
+			!g_str_equal(name, OFONO_EMULATOR_IND_CALLHELD);
+
+	if (g_str_equal(name, OFONO_EMULATOR_IND_SIGNAL))
+		ind->interval = SIGNAL_INTERVAL;
+	else if (g_str_equal(name, OFONO_EMULATOR_IND_BATTERY))
+		ind->interval = BATTERY_INTERVAL;
+
 	em->indicators = g_slist_append(em->indicators, ind);
 }
 
@@ -1198,6 +1335,11 @@ static void emulator_unregister(struct ofono_atom *atom)
 		em->callsetup_source = 0;
 	}
 
+	if (em->indicator_source) {
+		g_source_remove(em->indicator_source);
+		em->indicator_source = 0;
+	}
+
 	for (l = em->indicators; l; l = l->next) {
 		struct indicator *ind = l->data;
 
@@ -1253,6 +1395,7 @@ void ofono_emulator_register(struct ofono_emulator *em, int fd)
 
 	if (em->type == OFONO_EMULATOR_TYPE_HFP) {
 		em->ddr_active = true;
+		em->indicator_window = INDICATOR_WINDOW;
 
 		emulator_add_indicator(em, OFONO_EMULATOR_IND_SERVICE, 0, 1, 0,
 									FALSE);
@@ -1722,7 +1865,6 @@ void ofono_emulator_set_indicator(struct ofono_atom *atom,
 						const char *name, int value)
 {
 	int i;
-	char buf[20];
 	struct indicator *ind;
 	struct indicator *call_ind;
 	struct indicator *cs_ind;
@@ -1772,13 +1914,7 @@ void ofono_emulator_set_indicator(struct ofono_atom *atom,
 	if (waiting)
 		notify_ccwa(em);
 
-	if (em->events_mode == 3 && em->events_ind && em->slc && ind->active) {
-		if (!g_at_server_command_pending(em->server)) {
-			sprintf(buf, "+CIEV: %d,%d", i, ind->value);
-			g_at_server_send_unsolicited(em->server, buf);
-		} else
-			ind->deferred = TRUE;
-	}
+	notify_indicator(em, ind, i);
 
 	/*
 	 * Ring timer should be started when:
@@ -1820,7 +1956,6 @@ void __ofono_emulator_set_indicator_forced(struct ofono_atom *atom,
 {
 	int i;
 	struct indicator *ind;
-	char buf[20];
 	struct ofono_emulator *em = __ofono_atom_get_data(atom);
 
 	if (!valid_indication(em, atom, name))
@@ -1833,11 +1968,10 @@ void __ofono_emulator_set_indicator_forced(struct ofono_atom *atom,
 
 	ind->value = value;
 
-	if (em->events_mode == 3 && em->events_ind && em->slc && ind->active) {
-		if (!g_at_server_command_pending(em->server)) {
-			sprintf(buf, "+CIEV: %d,%d", i, ind->value);
-			g_at_server_send_unsolicited(em->server, buf);
-		} else
+	if (indicator_reportable(em, ind)) {
+		if (!g_at_server_command_pending(em->server))
+			send_ciev(em, ind, i);
+		else
 			ind->deferred = TRUE;
 	}
 }
@@ -49,6 +49,7 @@
 #include "simutil.h"
 #include "util.h"
 #include "dns-client.h"
+#include "timerwheel.h"
 
 #define GPRS_FLAG_ATTACHING 0x1
 #define GPRS_FLAG_RECHECK 0x2
@@ -1588,7 +1589,7 @@ static void update_suspended_property(struct ofono_gprs *gprs,
 	dbus_bool_t value = suspended;
 
 	if (gprs->suspend_timeout) {
-		g_source_remove(gprs->suspend_timeout);
+		timer_wheel_remove(gprs->suspend_timeout);
 		gprs->suspend_timeout = 0;
 	}
 
@@ -1627,8 +1628,8 @@ void ofono_gprs_suspend_notify(struct ofono_gprs *gprs, int cause)
 	case GPRS_SUSPENDED_SIGNALLING:
 	case GPRS_SUSPENDED_UNKNOWN_CAUSE:
 		if (gprs->suspend_timeout)
-			g_source_remove(gprs->suspend_timeout);
-		gprs->suspend_timeout = g_timeout_add_seconds(SUSPEND_TIMEOUT,
+			timer_wheel_remove(gprs->suspend_timeout);
+		gprs->suspend_timeout = timer_wheel_add_seconds(SUSPEND_TIMEOUT,
 							suspend_timeout,
 							gprs);
 		break;
@@ -1715,6 +1716,9 @@ static void gprs_attached_update(struct ofono_gprs *gprs)
 
 	gprs->attached = attached;
 
+	__ofono_timeline_mark(__ofono_atom_get_modem(gprs->atom), "gprs",
+					attached ? "attached" : "detached");
+
 	path = __ofono_atom_get_path(gprs->atom);
 	value = attached;
 	ofono_dbus_signal_property_changed(conn, path,
@@ -3097,7 +3101,7 @@ static void gprs_remove(struct ofono_atom *atom)
 		return;
 
 	if (gprs->suspend_timeout)
-		g_source_remove(gprs->suspend_timeout);
+		timer_wheel_remove(gprs->suspend_timeout);
 
 	if (gprs->pid_map) {
 		idmap_free(gprs->pid_map);
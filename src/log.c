@@ -29,7 +29,10 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <syslog.h>
+#include <sys/uio.h>
 #ifdef __GLIBC__
 #include <execinfo.h>
 #endif
@@ -40,6 +43,371 @@
 static const char *program_exec;
 static const char *program_path;
 
+/*
+ * Asynchronous log sink.  Producers claim slots of a bounded ring with a
+ * compare-and-swap on the head index (Vyukov style sequence numbers), so
+ * the main loop never blocks on syslog or the trace file.  A single
+ * writer thread drains the ring in order.
+ */
+#define LOG_SLOT_DATA		480
+#define LOG_TRACE_TAG		16
+#define LOG_TRACE_MAGIC		"OFTRACE1"
+#define LOG_TRUNCATED		" [...]"
+
+#define LOG_FLAG_TRACE		0x01
+#define LOG_FLAG_TRACE_IN	0x02
+#define LOG_FLAG_TRACE_MORE	0x04
+
+struct log_slot {
+	volatile gint seq;
+	guint8 flags;
+	guint8 priority;
+	guint16 len;
+	gint64 timestamp;
+	char tag[LOG_TRACE_TAG];
+	char data[LOG_SLOT_DATA];
+};
+
+struct trace_record {
+	guint64 timestamp;
+	guint32 len;
+	guint8 flags;
+	guint8 reserved[3];
+	char tag[LOG_TRACE_TAG];
+} __attribute__((packed));
+
+static struct log_slot *log_ring;
+static guint log_ring_mask;
+static volatile gint log_head;
+static guint log_tail;
+static enum ofono_log_drop_policy log_policy;
+static volatile gint log_dropped;
+static volatile gint log_dropped_total;
+
+static GThread *log_writer;
+static GMutex log_lock;
+static GCond log_cond;
+static volatile gint log_writer_idle;
+static volatile gint log_writer_quit;
+
+static int trace_fd = -1;
+static GMutex trace_lock;
+static gboolean trace_chained;
+
+/* Called with trace_lock held, one writev per chunk */
+static void trace_write(const struct log_slot *slot)
+{
+	struct trace_record rec;
+	struct iovec iov[2];
+
+	memset(&rec, 0, sizeof(rec));
+	rec.timestamp = GUINT64_TO_LE(slot->timestamp);
+	rec.len = GUINT32_TO_LE(slot->len);
+	rec.flags = slot->flags;
+	memcpy(rec.tag, slot->tag, LOG_TRACE_TAG);
+
+	iov[0].iov_base = &rec;
+	iov[0].iov_len = sizeof(rec);
+	iov[1].iov_base = (void *) slot->data;
+	iov[1].iov_len = slot->len;
+
+	if (writev(trace_fd, iov, 2) < 0)
+		syslog(LOG_ERR, "Trace write failed: %s", strerror(errno));
+}
+
+/*
+ * Producers claim @n consecutive slots at once, so the slots of a split
+ * trace record are never interleaved with other records, and a record
+ * either fits as a whole or not at all.
+ */
+static gboolean log_ring_reserve(guint n, guint *out)
+{
+	struct log_slot *slot;
+	guint pos;
+	gint diff;
+
+	if (n > log_ring_mask + 1)
+		return FALSE;
+
+	pos = g_atomic_int_get(&log_head);
+
+	for (;;) {
+		slot = &log_ring[pos & log_ring_mask];
+		diff = (gint) ((guint) g_atomic_int_get(&slot->seq) - pos);
+
+		if (diff < 0)
+			return FALSE;
+
+		if (diff > 0) {
+			pos = g_atomic_int_get(&log_head);
+			continue;
+		}
+
+		/* The writer frees slots in order, checking the last will do */
+		slot = &log_ring[(pos + n - 1) & log_ring_mask];
+		diff = (gint) ((guint) g_atomic_int_get(&slot->seq) -
+							(pos + n - 1));
+		if (diff < 0)
+			return FALSE;
+
+		if (g_atomic_int_compare_and_exchange(&log_head, pos, pos + n))
+			break;
+
+		pos = g_atomic_int_get(&log_head);
+	}
+
+	*out = pos;
+
+	return TRUE;
+}
+
+static void log_ring_publish(guint pos, const struct log_slot *src)
+{
+	struct log_slot *slot = &log_ring[pos & log_ring_mask];
+
+	slot->flags = src->flags;
+	slot->priority = src->priority;
+	slot->len = src->len;
+	slot->timestamp = src->timestamp;
+	memcpy(slot->tag, src->tag, LOG_TRACE_TAG);
+	memcpy(slot->data, src->data, src->len);
+
+	g_atomic_int_set(&slot->seq, pos + 1);
+}
+
+static void log_ring_wake(void)
+{
+	if (g_atomic_int_get(&log_writer_idle)) {
+		g_mutex_lock(&log_lock);
+		g_cond_signal(&log_cond);
+		g_mutex_unlock(&log_lock);
+	}
+}
+
+static gboolean log_ring_push(const struct log_slot *src)
+{
+	guint pos;
+
+	if (log_ring_reserve(1, &pos) == FALSE)
+		return FALSE;
+
+	log_ring_publish(pos, src);
+	log_ring_wake();
+
+	return TRUE;
+}
+
+static gboolean log_ring_pop(struct log_slot *dst)
+{
+	struct log_slot *slot = &log_ring[log_tail & log_ring_mask];
+	gint diff;
+
+	diff = (gint) ((guint) g_atomic_int_get(&slot->seq) - (log_tail + 1));
+	if (diff != 0)
+		return FALSE;
+
+	memcpy(dst, slot, sizeof(*dst));
+	g_atomic_int_set(&slot->seq, log_tail + log_ring_mask + 1);
+	log_tail += 1;
+
+	return TRUE;
+}
+
+static void log_report_dropped(void)
+{
+	gint dropped;
+
+	dropped = g_atomic_int_and(&log_dropped, 0);
+	if (dropped == 0)
+		return;
+
+	syslog(LOG_WARNING, "Log buffer overrun, %d messages dropped",
+								dropped);
+}
+
+static gboolean log_ring_empty(void)
+{
+	struct log_slot *slot = &log_ring[log_tail & log_ring_mask];
+
+	return (guint) g_atomic_int_get(&slot->seq) != log_tail + 1;
+}
+
+/*
+ * Trace records may also be written synchronously when the ring is
+ * full, so the writer holds trace_lock until the last chunk of a split
+ * record is out.  Its chunks are consecutive in the ring.
+ */
+static void log_writer_output(const struct log_slot *slot)
+{
+	if (!(slot->flags & LOG_FLAG_TRACE)) {
+		syslog(slot->priority, "%.*s", slot->len, slot->data);
+		return;
+	}
+
+	if (trace_fd < 0)
+		return;
+
+	if (trace_chained == FALSE)
+		g_mutex_lock(&trace_lock);
+
+	trace_write(slot);
+
+	trace_chained = (slot->flags & LOG_FLAG_TRACE_MORE) != 0;
+	if (trace_chained == FALSE)
+		g_mutex_unlock(&trace_lock);
+}
+
+static gpointer log_writer_thread(gpointer user_data)
+{
+	struct log_slot slot;
+
+	for (;;) {
+		while (log_ring_pop(&slot) == TRUE)
+			log_writer_output(&slot);
+
+		log_report_dropped();
+
+		if (g_atomic_int_get(&log_writer_quit))
+			break;
+
+		g_mutex_lock(&log_lock);
+		g_atomic_int_set(&log_writer_idle, 1);
+
+		if (g_atomic_int_get(&log_writer_quit) == 0 &&
+				log_ring_empty() == TRUE)
+			g_cond_wait(&log_cond, &log_lock);
+
+		g_atomic_int_set(&log_writer_idle, 0);
+		g_mutex_unlock(&log_lock);
+	}
+
+	/* A record cut short at shutdown, its remaining chunks never came */
+	if (trace_chained == TRUE) {
+		trace_chained = FALSE;
+		g_mutex_unlock(&trace_lock);
+	}
+
+	return NULL;
+}
+
+static void log_drop(void)
+{
+	g_atomic_int_inc(&log_dropped);
+	g_atomic_int_inc(&log_dropped_total);
+}
+
+static void log_vsubmit(int priority, const char *format, va_list ap)
+{
+	struct log_slot slot;
+	int len;
+
+	if (log_ring == NULL) {
+		vsyslog(priority, format, ap);
+		return;
+	}
+
+	len = vsnprintf(slot.data, sizeof(slot.data), format, ap);
+	if (len < 0)
+		return;
+
+	/* Mark lines that did not fit into a slot */
+	if ((unsigned int) len >= sizeof(slot.data)) {
+		len = sizeof(slot.data) - 1;
+		memcpy(slot.data + len - strlen(LOG_TRUNCATED), LOG_TRUNCATED,
+						strlen(LOG_TRUNCATED));
+	}
+
+	slot.flags = 0;
+	slot.priority = priority;
+	slot.len = len;
+	slot.timestamp = 0;
+
+	if (log_ring_push(&slot) == TRUE)
+		return;
+
+	if (log_policy == OFONO_LOG_DROP_NEWEST) {
+		log_drop();
+		return;
+	}
+
+	syslog(priority, "%.*s", slot.len, slot.data);
+}
+
+/**
+ * ofono_log_trace:
+ * @tag: short channel identifier, truncated to 15 characters
+ * @in: TRUE for data received from the modem
+ * @data: raw bytes
+ * @len: number of bytes
+ *
+ * Record raw modem I/O in the binary trace file, if one was configured.
+ * Records are timestamped with the monotonic clock and can be decoded
+ * offline with tools/trace-decode.
+ */
+void ofono_log_trace(const char *tag, ofono_bool_t in,
+					const void *data, size_t len)
+{
+	const unsigned char *buf = data;
+	struct log_slot slot;
+	gboolean queued = FALSE;
+	guint pos;
+	gint64 now;
+
+	if (trace_fd < 0 || len == 0)
+		return;
+
+	now = g_get_monotonic_time();
+
+	/* A split record is queued or dropped as a whole */
+	if (log_ring != NULL) {
+		queued = log_ring_reserve((len + LOG_SLOT_DATA - 1) /
+							LOG_SLOT_DATA, &pos);
+
+		if (queued == FALSE && log_policy == OFONO_LOG_DROP_NEWEST) {
+			log_drop();
+			return;
+		}
+	}
+
+	if (queued == FALSE)
+		g_mutex_lock(&trace_lock);
+
+	do {
+		size_t chunk = MIN(len, sizeof(slot.data));
+
+		slot.flags = LOG_FLAG_TRACE;
+		if (in)
+			slot.flags |= LOG_FLAG_TRACE_IN;
+		if (chunk < len)
+			slot.flags |= LOG_FLAG_TRACE_MORE;
+
+		slot.priority = 0;
+		slot.len = chunk;
+		slot.timestamp = now;
+		strncpy(slot.tag, tag ? tag : "", sizeof(slot.tag) - 1);
+		slot.tag[sizeof(slot.tag) - 1] = '\0';
+		memcpy(slot.data, buf, chunk);
+
+		if (queued)
+			log_ring_publish(pos++, &slot);
+		else
+			trace_write(&slot);
+
+		buf += chunk;
+		len -= chunk;
+	} while (len > 0);
+
+	if (queued)
+		log_ring_wake();
+	else
+		g_mutex_unlock(&trace_lock);
+}
+
+ofono_bool_t ofono_log_trace_enabled(void)
+{
+	return trace_fd >= 0;
+}
+
 /**
  * ofono_info:
  * @format: format string
@@ -53,7 +421,7 @@ void ofono_info(const char *format, ...)
 
 	va_start(ap, format);
 
-	vsyslog(LOG_INFO, format, ap);
+	log_vsubmit(LOG_INFO, format, ap);
 
 	va_end(ap);
 }
@@ -71,7 +439,7 @@ void ofono_warn(const char *format, ...)
 
 	va_start(ap, format);
 
-	vsyslog(LOG_WARNING, format, ap);
+	log_vsubmit(LOG_WARNING, format, ap);
 
 	va_end(ap);
 }
@@ -89,7 +457,7 @@ void ofono_error(const char *format, ...)
 
 	va_start(ap, format);
 
-	vsyslog(LOG_ERR, format, ap);
+	log_vsubmit(LOG_ERR, format, ap);
 
 	va_end(ap);
 }
@@ -110,7 +478,7 @@ void ofono_debug(const char *format, ...)
 
 	va_start(ap, format);
 
-	vsyslog(LOG_DEBUG, format, ap);
+	log_vsubmit(LOG_DEBUG, format, ap);
 
 	va_end(ap);
 }
@@ -220,6 +588,9 @@ static void print_backtrace(unsigned int offset)
 
 static void signal_handler(int signo)
 {
+	/* The writer thread may be gone, report the crash synchronously */
+	log_ring = NULL;
+
 	ofono_error("Aborting (signal %d) [%s]", signo, program_exec);
 
 	print_backtrace(2);
@@ -320,8 +691,108 @@ int __ofono_log_init(const char *program, const char *debug,
 	return 0;
 }
 
+int __ofono_log_async_init(unsigned int slots,
+				enum ofono_log_drop_policy policy,
+				const char *trace_path)
+{
+	unsigned int i;
+
+	if (trace_path != NULL) {
+		trace_fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC |
+							O_CLOEXEC, 0600);
+		if (trace_fd < 0) {
+			syslog(LOG_ERR, "Unable to open trace file %s: %s",
+						trace_path, strerror(errno));
+			return -errno;
+		}
+
+		if (write(trace_fd, LOG_TRACE_MAGIC,
+				strlen(LOG_TRACE_MAGIC)) < 0) {
+			close(trace_fd);
+			trace_fd = -1;
+			return -EIO;
+		}
+
+		g_mutex_init(&trace_lock);
+	}
+
+	if (slots == 0)
+		return 0;
+
+	/* Round up to a power of two so that the index can be masked */
+	for (i = 2; i < slots; i <<= 1)
+		;
+
+	log_ring = g_try_new0(struct log_slot, i);
+	if (log_ring == NULL)
+		return -ENOMEM;
+
+	log_ring_mask = i - 1;
+	log_policy = policy;
+	log_head = 0;
+	log_tail = 0;
+
+	for (i = 0; i <= log_ring_mask; i++)
+		log_ring[i].seq = i;
+
+	g_mutex_init(&log_lock);
+	g_cond_init(&log_cond);
+
+	log_writer = g_thread_try_new("ofono-log", log_writer_thread,
+							NULL, NULL);
+	if (log_writer == NULL) {
+		g_free(log_ring);
+		log_ring = NULL;
+		return -EIO;
+	}
+
+	syslog(LOG_INFO, "Asynchronous logging enabled, %u slots, %s policy",
+				log_ring_mask + 1,
+				policy == OFONO_LOG_DROP_NEWEST ? "drop" : "sync");
+
+	return 0;
+}
+
+unsigned int __ofono_log_get_dropped(void)
+{
+	return g_atomic_int_get(&log_dropped_total);
+}
+
+static void log_async_cleanup(void)
+{
+	struct log_slot *ring = log_ring;
+
+	if (log_writer != NULL) {
+		g_mutex_lock(&log_lock);
+		g_atomic_int_set(&log_writer_quit, 1);
+		g_cond_signal(&log_cond);
+		g_mutex_unlock(&log_lock);
+
+		g_thread_join(log_writer);
+		log_writer = NULL;
+
+		g_mutex_clear(&log_lock);
+		g_cond_clear(&log_cond);
+	}
+
+	log_ring = NULL;
+	g_free(ring);
+
+	if (log_dropped_total > 0)
+		syslog(LOG_INFO, "%d log messages dropped in total",
+							log_dropped_total);
+
+	if (trace_fd >= 0) {
+		close(trace_fd);
+		trace_fd = -1;
+		g_mutex_clear(&trace_lock);
+	}
+}
+
 void __ofono_log_cleanup(void)
 {
+	log_async_cleanup();
+
 	syslog(LOG_INFO, "Exit");
 
 	closelog();
@@ -34,6 +34,8 @@
 
 #include "ofono.h"
 
+#include "timerwheel.h"
+
 #define SHUTDOWN_GRACE_SECONDS 10
 
 static GMainLoop *event_loop;
@@ -133,6 +135,9 @@ static gchar *option_plugin = NULL;
 static gchar *option_noplugin = NULL;
 static gboolean option_detach = TRUE;
 static gboolean option_version = FALSE;
+static gint option_log_buffer = 0;
+static gchar *option_log_drop = NULL;
+static gchar *option_trace = NULL;
 
 static gboolean parse_debug(const char *key, const char *value,
 					gpointer user_data, GError **error)
@@ -156,6 +161,14 @@ static GOptionEntry options[] = {
 	{ "nodetach", 'n', G_OPTION_FLAG_REVERSE,
 				G_OPTION_ARG_NONE, &option_detach,
 				"Don't run as daemon in background" },
+	{ "log-buffer", 'b', 0, G_OPTION_ARG_INT, &option_log_buffer,
+				"Log asynchronously through a ring buffer",
+				"SLOTS" },
+	{ "log-drop", 0, 0, G_OPTION_ARG_STRING, &option_log_drop,
+				"Policy when the log buffer is full",
+				"drop|sync" },
+	{ "trace", 't', 0, G_OPTION_ARG_FILENAME, &option_trace,
+				"Write binary modem I/O trace to file", "FILE" },
 	{ "version", 'v', 0, G_OPTION_ARG_NONE, &option_version,
 				"Show version information and exit" },
 	{ NULL },
@@ -215,6 +228,21 @@ int main(int argc, char **argv)
 
 	__ofono_log_init(argv[0], option_debug, option_detach);
 
+	__ofono_timeline_init();
+
+	if (option_log_buffer > 0 || option_trace != NULL) {
+		enum ofono_log_drop_policy policy = OFONO_LOG_DROP_NEWEST;
+
+		if (g_strcmp0(option_log_drop, "sync") == 0)
+			policy = OFONO_LOG_DROP_SYNC;
+
+		__ofono_log_async_init(MAX(option_log_buffer, 0), policy,
+							option_trace);
+	}
+
+	g_free(option_log_drop);
+	g_free(option_trace);
+
 	dbus_error_init(&error);
 
 	conn = g_dbus_setup_bus(DBUS_BUS_SYSTEM, OFONO_SERVICE, &error);
@@ -239,6 +267,8 @@ int main(int argc, char **argv)
 
 	__ofono_manager_init();
 
+	__ofono_diagnostics_init();
+
 	__ofono_plugin_init(option_plugin, option_noplugin);
 
 	g_free(option_plugin);
@@ -252,6 +282,10 @@ int main(int argc, char **argv)
 
 	__ofono_plugin_cleanup();
 
+	timer_wheel_cleanup();
+
+	__ofono_diagnostics_cleanup();
+
 	__ofono_manager_cleanup();
 
 	__ofono_modemwatch_cleanup();
@@ -264,6 +298,8 @@ cleanup:
 
 	g_main_loop_unref(event_loop);
 
+	__ofono_timeline_cleanup();
+
 	__ofono_log_cleanup();
 
 	return 0;
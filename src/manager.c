@@ -80,10 +80,28 @@ static DBusMessage *manager_get_modems(DBusConnection *conn,
 	return reply;
 }
 
+static DBusMessage *manager_get_timeline(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	DBusMessage *reply;
+	char *json;
+
+	json = __ofono_timeline_to_json();
+
+	reply = g_dbus_create_reply(msg, DBUS_TYPE_STRING, &json,
+					DBUS_TYPE_INVALID);
+	g_free(json);
+
+	return reply;
+}
+
 static const GDBusMethodTable manager_methods[] = {
 	{ GDBUS_METHOD("GetModems",
 				NULL, GDBUS_ARGS({ "modems", "a(oa{sv})" }),
 				manager_get_modems) },
+	{ GDBUS_METHOD("GetTimeline",
+				NULL, GDBUS_ARGS({ "timeline", "s" }),
+				manager_get_timeline) },
 	{ }
 };
 
@@ -38,7 +38,7 @@ struct message {
 	void *data;
 };
 
-static const char *message_state_to_string(enum message_state s)
+const char *message_state_to_string(enum message_state s)
 {
 	switch (s) {
 	case MESSAGE_STATE_PENDING:
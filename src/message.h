@@ -31,6 +31,8 @@ enum message_state {
 struct ofono_atom;
 struct message;
 
+const char *message_state_to_string(enum message_state s);
+
 struct message *message_create(const struct ofono_uuid *uuid,
 						struct ofono_atom *atom);
 
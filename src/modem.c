@@ -61,8 +61,9 @@ enum modem_state {
 struct ofono_modem {
 	char			*path;
 	enum modem_state	modem_state;
-	GSList			*atoms;
-	struct ofono_watchlist	*atom_watches;
+	GList			*atoms;
+	GList			*typed_atoms[OFONO_ATOM_TYPE_COUNT];
+	struct ofono_watchlist	*atom_watches[OFONO_ATOM_TYPE_COUNT];
 	GSList			*interface_list;
 	GSList			*feature_list;
 	unsigned int		call_ids;
@@ -75,6 +76,8 @@ struct ofono_modem {
 	char			*lock_owner;
 	guint			lock_watch;
 	guint			timeout;
+	gint64			powered_start;
+	gint64			online_start;
 	ofono_bool_t		online;
 	struct ofono_watchlist	*online_watches;
 	struct ofono_watchlist	*powered_watches;
@@ -108,6 +111,8 @@ struct ofono_atom {
 	void (*unregister)(struct ofono_atom *atom);
 	void *data;
 	struct ofono_modem *modem;
+	GList *link;
+	GList *typed_link;
 };
 
 struct atom_watch {
@@ -120,6 +125,23 @@ struct modem_property {
 	void *value;
 };
 
+static const char *atom_type_names[] = {
+	"devinfo", "call-barring", "call-forwarding", "call-meter",
+	"call-settings", "netreg", "phonebook", "sms", "sim", "ussd",
+	"voicecall", "history", "ssn", "message-waiting", "cbs",
+	"call-volume", "gprs", "gprs-context", "radio-settings",
+	"audio-settings", "stk", "nettime", "ctm", "cdma-voicecall",
+	"cdma-connman", "sim-auth", "emulator-dun", "emulator-hfp",
+	"location-reporting", "gnss", "cdma-sms", "cdma-netreg",
+	"handsfree", "siri",
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(atom_type_names) == OFONO_ATOM_TYPE_COUNT);
+
+static const char *modem_state_names[] = {
+	"power-off", "pre-sim", "offline", "online",
+};
+
 static const char *modem_type_to_string(enum ofono_modem_type type)
 {
 	switch (type) {
@@ -202,11 +224,26 @@ struct ofono_atom *__ofono_modem_add_atom(struct ofono_modem *modem,
 	atom->data = data;
 	atom->modem = modem;
 
-	modem->atoms = g_slist_prepend(modem->atoms, atom);
+	modem->atoms = g_list_prepend(modem->atoms, atom);
+	atom->link = modem->atoms;
+
+	modem->typed_atoms[type] = g_list_prepend(modem->typed_atoms[type],
+							atom);
+	atom->typed_link = modem->typed_atoms[type];
 
 	return atom;
 }
 
+static void atom_unlink(struct ofono_atom *atom)
+{
+	struct ofono_modem *modem = atom->modem;
+
+	modem->atoms = g_list_delete_link(modem->atoms, atom->link);
+	modem->typed_atoms[atom->type] =
+		g_list_delete_link(modem->typed_atoms[atom->type],
+							atom->typed_link);
+}
+
 struct ofono_atom *__ofono_modem_add_atom_offline(struct ofono_modem *modem,
 					enum ofono_atom_type type,
 					void (*destruct)(struct ofono_atom *),
@@ -236,21 +273,29 @@ struct ofono_modem *__ofono_atom_get_modem(struct ofono_atom *atom)
 	return atom->modem;
 }
 
+/*
+ * Atom watches are kept in one watchlist per atom type, the type being
+ * folded into the low bits of the watch id handed out to the callers.
+ */
+#define ATOM_WATCH_TYPE_BITS 6
+#define ATOM_WATCH_TYPE_MASK ((1 << ATOM_WATCH_TYPE_BITS) - 1)
+
+G_STATIC_ASSERT(OFONO_ATOM_TYPE_COUNT <= ATOM_WATCH_TYPE_MASK + 1);
+
 static void call_watches(struct ofono_atom *atom,
 				enum ofono_atom_watch_condition cond)
 {
 	struct ofono_modem *modem = atom->modem;
-	GSList *atom_watches = modem->atom_watches->items;
+	struct ofono_watchlist *watchlist = modem->atom_watches[atom->type];
 	GSList *l;
 	struct atom_watch *watch;
 	ofono_atom_watch_func notify;
 
-	for (l = atom_watches; l; l = l->next) {
-		watch = l->data;
-
-		if (watch->type != atom->type)
-			continue;
+	if (watchlist == NULL)
+		return;
 
+	for (l = watchlist->items; l; l = l->next) {
+		watch = l->data;
 		notify = watch->item.notify;
 		notify(atom, cond, watch->item.notify_data);
 	}
@@ -264,6 +309,9 @@ void __ofono_atom_register(struct ofono_atom *atom,
 
 	atom->unregister = unregister;
 
+	__ofono_timeline_mark(atom->modem, "atom", "%s registered",
+					atom_type_names[atom->type]);
+
 	call_watches(atom, OFONO_ATOM_WATCH_CONDITION_REGISTERED);
 }
 
@@ -290,12 +338,15 @@ unsigned int __ofono_modem_add_atom_watch(struct ofono_modem *modem,
 {
 	struct atom_watch *watch;
 	unsigned int id;
-	GSList *l;
+	GList *l;
 	struct ofono_atom *atom;
 
 	if (notify == NULL)
 		return 0;
 
+	if (modem->atom_watches[type] == NULL)
+		modem->atom_watches[type] = __ofono_watchlist_new(g_free);
+
 	watch = g_new0(struct atom_watch, 1);
 
 	watch->type = type;
@@ -303,40 +354,47 @@ unsigned int __ofono_modem_add_atom_watch(struct ofono_modem *modem,
 	watch->item.destroy = destroy;
 	watch->item.notify_data = data;
 
-	id = __ofono_watchlist_add_item(modem->atom_watches,
+	id = __ofono_watchlist_add_item(modem->atom_watches[type],
 					(struct ofono_watchlist_item *)watch);
 
-	for (l = modem->atoms; l; l = l->next) {
+	for (l = modem->typed_atoms[type]; l; l = l->next) {
 		atom = l->data;
 
-		if (atom->type != type || atom->unregister == NULL)
+		if (atom->unregister == NULL)
 			continue;
 
 		notify(atom, OFONO_ATOM_WATCH_CONDITION_REGISTERED, data);
 	}
 
-	return id;
+	return (id << ATOM_WATCH_TYPE_BITS) | type;
 }
 
 gboolean __ofono_modem_remove_atom_watch(struct ofono_modem *modem,
 						unsigned int id)
 {
-	return __ofono_watchlist_remove_item(modem->atom_watches, id);
+	struct ofono_watchlist *watchlist;
+
+	watchlist = modem->atom_watches[id & ATOM_WATCH_TYPE_MASK];
+	if (watchlist == NULL)
+		return FALSE;
+
+	return __ofono_watchlist_remove_item(watchlist,
+						id >> ATOM_WATCH_TYPE_BITS);
 }
 
 struct ofono_atom *__ofono_modem_find_atom(struct ofono_modem *modem,
 						enum ofono_atom_type type)
 {
-	GSList *l;
+	GList *l;
 	struct ofono_atom *atom;
 
 	if (modem == NULL)
 		return NULL;
 
-	for (l = modem->atoms; l; l = l->next) {
+	for (l = modem->typed_atoms[type]; l; l = l->next) {
 		atom = l->data;
 
-		if (atom->type == type && atom->unregister != NULL)
+		if (atom->unregister != NULL)
 			return atom;
 	}
 
@@ -347,18 +405,14 @@ void __ofono_modem_foreach_atom(struct ofono_modem *modem,
 				enum ofono_atom_type type,
 				ofono_atom_func callback, void *data)
 {
-	GSList *l;
+	GList *l;
 	struct ofono_atom *atom;
 
 	if (modem == NULL)
 		return;
 
-	for (l = modem->atoms; l; l = l->next) {
+	for (l = modem->typed_atoms[type]; l; l = l->next) {
 		atom = l->data;
-
-		if (atom->type != type)
-			continue;
-
 		callback(atom, data);
 	}
 }
@@ -368,18 +422,15 @@ void __ofono_modem_foreach_registered_atom(struct ofono_modem *modem,
 						ofono_atom_func callback,
 						void *data)
 {
-	GSList *l;
+	GList *l;
 	struct ofono_atom *atom;
 
 	if (modem == NULL)
 		return;
 
-	for (l = modem->atoms; l; l = l->next) {
+	for (l = modem->typed_atoms[type]; l; l = l->next) {
 		atom = l->data;
 
-		if (atom->type != type)
-			continue;
-
 		if (atom->unregister == NULL)
 			continue;
 
@@ -389,9 +440,7 @@ void __ofono_modem_foreach_registered_atom(struct ofono_modem *modem,
 
 void __ofono_atom_free(struct ofono_atom *atom)
 {
-	struct ofono_modem *modem = atom->modem;
-
-	modem->atoms = g_slist_remove(modem->atoms, atom);
+	atom_unlink(atom);
 
 	__ofono_atom_unregister(atom);
 
@@ -403,20 +452,17 @@ void __ofono_atom_free(struct ofono_atom *atom)
 
 static void flush_atoms(struct ofono_modem *modem, enum modem_state new_state)
 {
-	GSList *cur;
-	GSList *prev;
-	GSList *tmp;
+	GList *cur;
+	GList *next;
 
 	DBG("");
 
-	prev = NULL;
 	cur = modem->atoms;
 
 	while (cur) {
 		struct ofono_atom *atom = cur->data;
 
 		if (atom->modem_state <= new_state) {
-			prev = cur;
 			cur = cur->next;
 			continue;
 		}
@@ -426,16 +472,11 @@ static void flush_atoms(struct ofono_modem *modem, enum modem_state new_state)
 		if (atom->destruct)
 			atom->destruct(atom);
 
+		next = cur->next;
+		atom_unlink(atom);
 		g_free(atom);
 
-		if (prev)
-			prev->next = cur->next;
-		else
-			modem->atoms = cur->next;
-
-		tmp = cur;
-		cur = cur->next;
-		g_slist_free_1(tmp);
+		cur = next;
 	}
 }
 
@@ -501,6 +542,9 @@ static void modem_change_state(struct ofono_modem *modem,
 
 	modem->modem_state = new_state;
 
+	__ofono_timeline_mark(modem, "modem", "%s",
+					modem_state_names[new_state]);
+
 	if (old_state > new_state)
 		flush_atoms(modem, new_state);
 
@@ -583,17 +627,7 @@ void __ofono_modem_remove_powered_watch(struct ofono_modem *modem,
 
 static gboolean modem_has_sim(struct ofono_modem *modem)
 {
-	GSList *l;
-	struct ofono_atom *atom;
-
-	for (l = modem->atoms; l; l = l->next) {
-		atom = l->data;
-
-		if (atom->type == OFONO_ATOM_TYPE_SIM)
-			return TRUE;
-	}
-
-	return FALSE;
+	return modem->typed_atoms[OFONO_ATOM_TYPE_SIM] != NULL;
 }
 
 static gboolean modem_is_always_online(struct ofono_modem *modem)
@@ -611,6 +645,12 @@ static void common_online_cb(const struct ofono_error *error, void *data)
 {
 	struct ofono_modem *modem = data;
 
+	if (modem->online_start) {
+		__ofono_timeline_span(modem, "modem", modem->online_start,
+					"set online");
+		modem->online_start = 0;
+	}
+
 	if (error->type != OFONO_ERROR_TYPE_NO_ERROR)
 		return;
 
@@ -713,6 +753,8 @@ static void sim_state_watch(enum ofono_sim_state new_state, void *user)
 			modem_change_state(modem, MODEM_STATE_PRE_SIM);
 		break;
 	case OFONO_SIM_STATE_READY:
+		__ofono_timeline_mark(modem, "sim", "sim ready");
+
 		/* Avoid state regressions */
 		if (modem->modem_state != MODEM_STATE_ONLINE) {
 			modem_change_state(modem, MODEM_STATE_OFFLINE);
@@ -723,9 +765,11 @@ static void sim_state_watch(enum ofono_sim_state new_state, void *user)
 
 			if (modem->online == TRUE)
 				modem_change_state(modem, MODEM_STATE_ONLINE);
-			else if (modem->get_online)
+			else if (modem->get_online) {
+				modem->online_start = g_get_monotonic_time();
 				modem->driver->set_online(modem, 1,
 						common_online_cb, modem);
+			}
 
 			modem->get_online = FALSE;
 		}
@@ -763,6 +807,9 @@ static DBusMessage *set_property_online(struct ofono_modem *modem,
 
 	modem->pending = dbus_message_ref(msg);
 
+	if (online)
+		modem->online_start = g_get_monotonic_time();
+
 	driver->set_online(modem, online,
 				online ? online_cb : offline_cb, modem);
 
@@ -884,6 +931,8 @@ static int set_powered(struct ofono_modem *modem, ofono_bool_t powered)
 	if (driver == NULL)
 		return -EINVAL;
 
+	modem->powered_start = g_get_monotonic_time();
+
 	if (powered == TRUE) {
 		if (driver->enable)
 			err = driver->enable(modem);
@@ -893,6 +942,10 @@ static int set_powered(struct ofono_modem *modem, ofono_bool_t powered)
 	}
 
 	if (err == 0) {
+		__ofono_timeline_span(modem, "modem", modem->powered_start,
+					powered ? "enable" : "disable");
+		modem->powered_start = 0;
+
 		modem->powered = powered;
 		notify_powered_watches(modem);
 	} else if (err != -EINPROGRESS)
@@ -924,6 +977,11 @@ static gboolean set_powered_timeout(gpointer user)
 
 	modem->timeout = 0;
 
+	__ofono_timeline_span(modem, "modem", modem->powered_start,
+				"%s timed out",
+				modem->powered_pending ? "enable" : "disable");
+	modem->powered_start = 0;
+
 	if (modem->powered_pending == FALSE) {
 		DBusConnection *conn = ofono_dbus_get_connection();
 		dbus_bool_t powered = FALSE;
@@ -1179,6 +1237,12 @@ void ofono_modem_set_powered(struct ofono_modem *modem, ofono_bool_t powered)
 
 	modem->powered_pending = powered;
 
+	if (modem->powered_start) {
+		__ofono_timeline_span(modem, "modem", modem->powered_start,
+					powered ? "enable" : "disable");
+		modem->powered_start = 0;
+	}
+
 	if (modem->powered == powered)
 		goto out;
 
@@ -2015,10 +2079,12 @@ int ofono_modem_register(struct ofono_modem *modem)
 	g_free(modem->driver_type);
 	modem->driver_type = NULL;
 
-	modem->atom_watches = __ofono_watchlist_new(g_free);
 	modem->online_watches = __ofono_watchlist_new(g_free);
 	modem->powered_watches = __ofono_watchlist_new(g_free);
 
+	__ofono_timeline_mark(modem, "modem", "registered (%s)",
+					modem->driver->name);
+
 	emit_modem_added(modem);
 	call_modemwatches(modem, TRUE);
 
@@ -2044,14 +2110,20 @@ static void emit_modem_removed(struct ofono_modem *modem)
 static void modem_unregister(struct ofono_modem *modem)
 {
 	DBusConnection *conn = ofono_dbus_get_connection();
+	int i;
 
 	DBG("%p", modem);
 
 	if (modem->powered == TRUE)
 		set_powered(modem, FALSE);
 
-	__ofono_watchlist_free(modem->atom_watches);
-	modem->atom_watches = NULL;
+	for (i = 0; i < OFONO_ATOM_TYPE_COUNT; i++) {
+		if (modem->atom_watches[i] == NULL)
+			continue;
+
+		__ofono_watchlist_free(modem->atom_watches[i]);
+		modem->atom_watches[i] = NULL;
+	}
 
 	__ofono_watchlist_free(modem->online_watches);
 	modem->online_watches = NULL;
@@ -1382,6 +1382,11 @@ void ofono_netreg_status_notify(struct ofono_netreg *netreg, int status,
 		set_registration_status(netreg, status);
 
 		modem = __ofono_atom_get_modem(netreg->atom);
+
+		if (status == NETWORK_REGISTRATION_STATUS_REGISTERED ||
+				status == NETWORK_REGISTRATION_STATUS_ROAMING)
+			__ofono_timeline_mark(modem, "netreg", "%s",
+					registration_status_to_string(status));
 		__ofono_modem_foreach_registered_atom(modem,
 					OFONO_ATOM_TYPE_EMULATOR_HFP,
 					notify_emulator_status,
@@ -40,6 +40,16 @@ void __ofono_modem_shutdown(void);
 int __ofono_log_init(const char *program, const char *debug,
 						ofono_bool_t detach);
 void __ofono_log_cleanup(void);
+
+enum ofono_log_drop_policy {
+	OFONO_LOG_DROP_NEWEST = 0,	/* Discard and count */
+	OFONO_LOG_DROP_SYNC,		/* Fall back to a blocking write */
+};
+
+int __ofono_log_async_init(unsigned int slots,
+				enum ofono_log_drop_policy policy,
+				const char *trace_path);
+unsigned int __ofono_log_get_dropped(void);
 void __ofono_log_enable(struct ofono_debug_desc *start,
 					struct ofono_debug_desc *stop);
 
@@ -152,6 +162,7 @@ enum ofono_atom_type {
 	OFONO_ATOM_TYPE_CDMA_NETREG,
 	OFONO_ATOM_TYPE_HANDSFREE,
 	OFONO_ATOM_TYPE_SIRI,
+	OFONO_ATOM_TYPE_COUNT,	/* Not a type, keep it last */
 };
 
 enum ofono_atom_watch_condition {
@@ -315,6 +326,7 @@ enum ofono_sms_submit_flag {
 	OFONO_SMS_SUBMIT_FLAG_RETRY =		0x4,
 	OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS =	0x8,
 	OFONO_SMS_SUBMIT_FLAG_REUSE_UUID =	0x10,
+	OFONO_SMS_SUBMIT_FLAG_COMPACT =		0x20,
 };
 
 typedef void (*ofono_sms_txq_submit_cb_t)(gboolean ok, void *data);
@@ -537,3 +549,19 @@ int __ofono_sim_mnclength_get_mnclength(const char *imsi);
 
 int __ofono_wakelock_init(void);
 void __ofono_wakelock_cleanup(void);
+
+#include <ofono/diagnostics.h>
+
+void __ofono_diagnostics_init(void);
+void __ofono_diagnostics_cleanup(void);
+
+void __ofono_timeline_init(void);
+void __ofono_timeline_cleanup(void);
+
+void __ofono_timeline_mark(struct ofono_modem *modem, const char *category,
+				const char *fmt, ...)
+				__attribute__((format(printf, 3, 4)));
+void __ofono_timeline_span(struct ofono_modem *modem, const char *category,
+				gint64 start, const char *fmt, ...)
+				__attribute__((format(printf, 4, 5)));
+char *__ofono_timeline_to_json(void);
@@ -36,11 +36,21 @@
 #include "ofono.h"
 
 #include "common.h"
+#include "storage.h"
 
 #define LEN_MAX 128
 #define TYPE_INTERNATIONAL 145
 
 #define PHONEBOOK_FLAG_CACHED 0x1
+#define PHONEBOOK_FLAG_EXPORT_FAILED 0x2
+
+/*
+ * Exported vCards are cached per ICCID.  The file starts with the SHA1
+ * of the entries in hex followed by a newline, then the entries.
+ */
+#define PHONEBOOK_CACHE_PATH STORAGEDIR "/%s/phonebook"
+#define PHONEBOOK_CACHE_MODE 0600
+#define PHONEBOOK_HASH_LEN 40
 
 static GSList *g_drivers = NULL;
 
@@ -57,7 +67,12 @@ struct ofono_phonebook {
 	int storage_index; /* go through all supported storage */
 	int flags;
 	GString *vcards; /* entries with vcard 3.0 format */
-	GSList *merge_list; /* cache the entries that may need a merge */
+	gsize flushed; /* vcards already sent with EntriesReceived */
+	char *cache; /* last complete export, returned by Import */
+	char *cache_hash;
+	char *iccid;
+	GPtrArray *merge_list; /* entries that may need a merge, in order */
+	GHashTable *merge_index; /* merge_list entries by name */
 	const struct ofono_phonebook_driver *driver;
 	void *driver_data;
 	struct ofono_atom *atom;
@@ -70,7 +85,7 @@ struct phonebook_number {
 };
 
 struct phonebook_person {
-	GSList *number_list; /* one person may have more than one numbers */
+	GArray *numbers; /* one person may have more than one numbers */
 	char *text;
 	int hidden;
 	char *group;
@@ -86,17 +101,23 @@ static void vcard_printf(GString *str, const char *fmt, ...)
 {
 	char buf[1024];
 	va_list ap;
-	int len_temp, line_number, i;
-	unsigned int line_delimit = 75;
+	int len, len_temp, line_number, i;
+	int line_delimit = 75;
 
 	va_start(ap, fmt);
-	vsnprintf(buf, sizeof(buf), fmt, ap);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
 	va_end(ap);
 
-	line_number = strlen(buf) / line_delimit + 1;
+	if (len < 0)
+		return;
+
+	if (len >= (int) sizeof(buf))
+		len = sizeof(buf) - 1;
+
+	line_number = len / line_delimit + 1;
 
 	for (i = 0; i < line_number; i++) {
-		len_temp = MIN(line_delimit, strlen(buf) - line_delimit * i);
+		len_temp = MIN(line_delimit, len - line_delimit * i);
 		g_string_append_len(str,  buf + line_delimit * i, len_temp);
 		if (i != line_number - 1)
 			g_string_append(str, "\r\n ");
@@ -233,23 +254,20 @@ static void vcard_printf_end(GString *vcards)
 	vcard_printf(vcards, "");
 }
 
-static void print_number(struct phonebook_number *pn, GString *vcards)
-{
-	vcard_printf_number(vcards, pn->number, pn->type, pn->category);
-}
-
-static void destroy_number(struct phonebook_number *pn)
-{
-	g_free(pn->number);
-	g_free(pn);
-}
-
 static void print_merged_entry(struct phonebook_person *person, GString *vcards)
 {
+	unsigned int i;
+
 	vcard_printf_begin(vcards);
 	vcard_printf_text(vcards, person->text);
 
-	g_slist_foreach(person->number_list, (GFunc) print_number, vcards);
+	for (i = 0; i < person->numbers->len; i++) {
+		struct phonebook_number *pn = &g_array_index(person->numbers,
+						struct phonebook_number, i);
+
+		vcard_printf_number(vcards, pn->number, pn->type,
+					pn->category);
+	}
 
 	vcard_printf_group(vcards, person->group);
 	vcard_printf_email(vcards, person->email);
@@ -259,18 +277,23 @@ static void print_merged_entry(struct phonebook_person *person, GString *vcards)
 
 static void destroy_merged_entry(struct phonebook_person *person)
 {
+	unsigned int i;
+
 	g_free(person->text);
 	g_free(person->group);
 	g_free(person->email);
 	g_free(person->sip_uri);
 
-	g_slist_foreach(person->number_list, (GFunc) destroy_number, NULL);
-	g_slist_free(person->number_list);
+	for (i = 0; i < person->numbers->len; i++)
+		g_free(g_array_index(person->numbers,
+					struct phonebook_number, i).number);
+
+	g_array_free(person->numbers, TRUE);
 
 	g_free(person);
 }
 
-static DBusMessage *generate_export_entries_reply(struct ofono_phonebook *pb,
+static DBusMessage *generate_export_entries_reply(const char *entries,
 							DBusMessage *msg)
 {
 	DBusMessage *reply;
@@ -281,7 +304,7 @@ static DBusMessage *generate_export_entries_reply(struct ofono_phonebook *pb,
 		return NULL;
 
 	dbus_message_iter_init_append(reply, &iter);
-	dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, pb->vcards);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &entries);
 
 	return reply;
 }
@@ -314,13 +337,18 @@ static void merge_field_generic(char **str1, const char *str2)
 		*str1 = g_strdup(str2);
 }
 
-static void merge_field_number(GSList **l, const char *number, int type, char c)
+static void merge_field_number(GArray *numbers, const char *number, int type,
+				char c)
 {
-	struct phonebook_number *pn = g_new0(struct phonebook_number, 1);
+	struct phonebook_number pn;
 	enum phonebook_number_type category;
 
-	pn->number = g_strdup(number);
-	pn->type = type;
+	/* These would not make it into the vCard anyway */
+	if (number == NULL || number[0] == '\0' || type == 0)
+		return;
+
+	pn.number = g_strdup(number);
+	pn.type = type;
 	switch (tolower(c)) {
 	case 'w':
 		category = TEL_TYPE_WORK;
@@ -339,8 +367,8 @@ static void merge_field_number(GSList **l, const char *number, int type, char c)
 		category = TEL_TYPE_OTHER;
 		break;
 	}
-	pn->category = category;
-	*l = g_slist_append(*l, pn);
+	pn.category = category;
+	g_array_append_val(numbers, pn);
 }
 
 void ofono_phonebook_entry(struct ofono_phonebook *phonebook, int index,
@@ -363,27 +391,28 @@ void ofono_phonebook_entry(struct ofono_phonebook *phonebook, int index,
 	 * are deemed as entries of one person.
 	 */
 	if (need_merge(text)) {
-		GSList *l;
 		size_t len_text = strlen(text) - 2;
 		struct phonebook_person *person;
+		char *name = g_strndup(text, len_text);
 
-		for (l = phonebook->merge_list; l; l = l->next) {
-			person = l->data;
-			if (!strncmp(text, person->text, len_text) &&
-					(strlen(person->text) == len_text))
-				break;
-		}
+		person = g_hash_table_lookup(phonebook->merge_index, name);
 
-		if (l == NULL) {
+		if (person == NULL) {
 			person = g_new0(struct phonebook_person, 1);
-			phonebook->merge_list =
-				g_slist_prepend(phonebook->merge_list, person);
-			person->text = g_strndup(text, len_text);
+			person->text = name;
+			person->numbers = g_array_sized_new(FALSE, FALSE,
+					sizeof(struct phonebook_number), 4);
+
+			g_ptr_array_add(phonebook->merge_list, person);
+			g_hash_table_insert(phonebook->merge_index,
+						person->text, person);
+		} else {
+			g_free(name);
 		}
 
-		merge_field_number(&(person->number_list), number, type,
+		merge_field_number(person->numbers, number, type,
 					text[len_text + 1]);
-		merge_field_number(&(person->number_list), adnumber, adtype,
+		merge_field_number(person->numbers, adnumber, adtype,
 					text[len_text + 1]);
 
 		merge_field_generic(&(person->group), group);
@@ -409,22 +438,156 @@ void ofono_phonebook_entry(struct ofono_phonebook *phonebook, int index,
 	vcard_printf_end(phonebook->vcards);
 }
 
+void ofono_phonebook_entries_flush(struct ofono_phonebook *pb)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+	const char *path = __ofono_atom_get_path(pb->atom);
+	const char *entries;
+
+	if (pb->pending == NULL)
+		return;
+
+	if (pb->vcards->len == pb->flushed)
+		return;
+
+	entries = pb->vcards->str + pb->flushed;
+	pb->flushed = pb->vcards->len;
+
+	g_dbus_emit_signal(conn, path, OFONO_PHONEBOOK_INTERFACE,
+				"EntriesReceived",
+				DBUS_TYPE_STRING, &entries,
+				DBUS_TYPE_INVALID);
+}
+
+static const char *phonebook_get_iccid(struct ofono_phonebook *pb)
+{
+	struct ofono_modem *modem;
+	struct ofono_atom *sim_atom;
+
+	if (pb->iccid)
+		return pb->iccid;
+
+	modem = __ofono_atom_get_modem(pb->atom);
+	sim_atom = __ofono_modem_find_atom(modem, OFONO_ATOM_TYPE_SIM);
+	if (sim_atom == NULL)
+		return NULL;
+
+	pb->iccid = g_strdup(ofono_sim_get_iccid(
+					__ofono_atom_get_data(sim_atom)));
+
+	return pb->iccid;
+}
+
+static gboolean phonebook_cache_load(struct ofono_phonebook *pb)
+{
+	const char *iccid = phonebook_get_iccid(pb);
+	char *path;
+	char *contents;
+	gsize len;
+	char *hash;
+
+	if (iccid == NULL)
+		return FALSE;
+
+	path = g_strdup_printf(PHONEBOOK_CACHE_PATH, iccid);
+
+	if (!g_file_get_contents(path, &contents, &len, NULL)) {
+		g_free(path);
+		return FALSE;
+	}
+
+	g_free(path);
+
+	if (len <= PHONEBOOK_HASH_LEN ||
+			contents[PHONEBOOK_HASH_LEN] != '\n')
+		goto corrupt;
+
+	hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1,
+					contents + PHONEBOOK_HASH_LEN + 1,
+					len - PHONEBOOK_HASH_LEN - 1);
+
+	if (strncmp(hash, contents, PHONEBOOK_HASH_LEN)) {
+		g_free(hash);
+		goto corrupt;
+	}
+
+	g_free(pb->cache);
+	g_free(pb->cache_hash);
+
+	pb->cache = g_strdup(contents + PHONEBOOK_HASH_LEN + 1);
+	pb->cache_hash = hash;
+	g_free(contents);
+
+	DBG("Loaded %zu bytes of cached entries for %s", len, iccid);
+
+	return TRUE;
+
+corrupt:
+	ofono_warn("Ignoring corrupt phonebook cache for %s", iccid);
+	g_free(contents);
+	return FALSE;
+}
+
+static void phonebook_cache_store(struct ofono_phonebook *pb)
+{
+	const char *iccid = phonebook_get_iccid(pb);
+	char *hash;
+	char *contents;
+
+	hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1,
+						pb->vcards->str,
+						pb->vcards->len);
+
+	/* Nothing changed since the entries were last exported */
+	if (pb->cache && g_strcmp0(hash, pb->cache_hash) == 0) {
+		g_free(hash);
+		return;
+	}
+
+	g_free(pb->cache);
+	g_free(pb->cache_hash);
+
+	pb->cache = g_strndup(pb->vcards->str, pb->vcards->len);
+	pb->cache_hash = hash;
+
+	if (iccid == NULL)
+		return;
+
+	contents = g_strconcat(hash, "\n", pb->cache, NULL);
+
+	if (write_file((unsigned char *) contents, strlen(contents),
+				PHONEBOOK_CACHE_MODE, PHONEBOOK_CACHE_PATH,
+				iccid) < 0)
+		ofono_warn("Unable to write phonebook cache for %s", iccid);
+
+	g_free(contents);
+}
+
 static void export_phonebook_cb(const struct ofono_error *error, void *data)
 {
 	struct ofono_phonebook *phonebook = data;
+	unsigned int i;
 
-	if (error->type != OFONO_ERROR_TYPE_NO_ERROR)
+	if (error->type != OFONO_ERROR_TYPE_NO_ERROR) {
 		ofono_error("export_entries_one_storage_cb with %s failed",
 				storage_support[phonebook->storage_index]);
+		phonebook->flags |= PHONEBOOK_FLAG_EXPORT_FAILED;
+	}
 
 	/* convert the collected entries that are already merged to vcard */
-	phonebook->merge_list = g_slist_reverse(phonebook->merge_list);
-	g_slist_foreach(phonebook->merge_list, (GFunc) print_merged_entry,
-				phonebook->vcards);
-	g_slist_foreach(phonebook->merge_list, (GFunc) destroy_merged_entry,
-				NULL);
-	g_slist_free(phonebook->merge_list);
-	phonebook->merge_list = NULL;
+	g_hash_table_remove_all(phonebook->merge_index);
+
+	for (i = 0; i < phonebook->merge_list->len; i++) {
+		struct phonebook_person *person =
+				g_ptr_array_index(phonebook->merge_list, i);
+
+		print_merged_entry(person, phonebook->vcards);
+		destroy_merged_entry(person);
+	}
+
+	g_ptr_array_set_size(phonebook->merge_list, 0);
+
+	ofono_phonebook_entries_flush(phonebook);
 
 	phonebook->storage_index++;
 	export_phonebook(phonebook);
@@ -434,6 +597,7 @@ static void export_phonebook_cb(const struct ofono_error *error, void *data)
 static void export_phonebook(struct ofono_phonebook *phonebook)
 {
 	DBusMessage *reply;
+	const char *entries;
 	const char *pb = storage_support[phonebook->storage_index];
 
 	if (pb) {
@@ -442,14 +606,57 @@ static void export_phonebook(struct ofono_phonebook *phonebook)
 		return;
 	}
 
-	reply = generate_export_entries_reply(phonebook, phonebook->pending);
+	/* A partial export must not replace the cache of a complete one */
+	if (!(phonebook->flags & PHONEBOOK_FLAG_EXPORT_FAILED)) {
+		phonebook_cache_store(phonebook);
+		phonebook->flags |= PHONEBOOK_FLAG_CACHED;
+	}
+
+	/* A background refresh has nobody waiting for it */
+	if (phonebook->pending == NULL) {
+		g_string_set_size(phonebook->vcards, 0);
+		return;
+	}
+
+	/* Without a complete export, the caller gets what could be read */
+	if (phonebook->flags & PHONEBOOK_FLAG_EXPORT_FAILED)
+		entries = phonebook->vcards->str;
+	else
+		entries = phonebook->cache;
+
+	reply = generate_export_entries_reply(entries, phonebook->pending);
+	g_string_set_size(phonebook->vcards, 0);
+
 	if (reply == NULL) {
 		dbus_message_unref(phonebook->pending);
+		phonebook->pending = NULL;
 		return;
 	}
 
 	__ofono_dbus_pending_reply(&phonebook->pending, reply);
-	phonebook->flags |= PHONEBOOK_FLAG_CACHED;
+}
+
+static void start_export(struct ofono_phonebook *phonebook)
+{
+	/*
+	 * The previous export is a good estimate of the size of this one,
+	 * so reserve the space up front instead of growing step by step
+	 */
+	if (phonebook->cache) {
+		gsize hint = strlen(phonebook->cache) + 1;
+
+		if (phonebook->vcards->allocated_len < hint) {
+			g_string_free(phonebook->vcards, TRUE);
+			phonebook->vcards = g_string_sized_new(hint);
+		}
+	}
+
+	g_string_set_size(phonebook->vcards, 0);
+	phonebook->flushed = 0;
+	phonebook->storage_index = 0;
+	phonebook->flags &= ~PHONEBOOK_FLAG_EXPORT_FAILED;
+
+	export_phonebook(phonebook);
 }
 
 static DBusMessage *import_entries(DBusConnection *conn, DBusMessage *msg,
@@ -465,16 +672,28 @@ static DBusMessage *import_entries(DBusConnection *conn, DBusMessage *msg,
 	}
 
 	if (phonebook->flags & PHONEBOOK_FLAG_CACHED) {
-		reply = generate_export_entries_reply(phonebook, msg);
+		reply = generate_export_entries_reply(phonebook->cache, msg);
 		g_dbus_send_message(conn, reply);
 		return NULL;
 	}
 
-	g_string_set_size(phonebook->vcards, 0);
-	phonebook->storage_index = 0;
+	/*
+	 * Answer from the on-disk cache of this SIM right away and re-read
+	 * the phonebook in the background, the cache is only rewritten if
+	 * the entries turn out to have changed
+	 */
+	if (phonebook_cache_load(phonebook)) {
+		phonebook->flags |= PHONEBOOK_FLAG_CACHED;
+
+		reply = generate_export_entries_reply(phonebook->cache, msg);
+		g_dbus_send_message(conn, reply);
+
+		start_export(phonebook);
+		return NULL;
+	}
 
 	phonebook->pending = dbus_message_ref(msg);
-	export_phonebook(phonebook);
+	start_export(phonebook);
 
 	return NULL;
 }
@@ -487,6 +706,8 @@ static const GDBusMethodTable phonebook_methods[] = {
 };
 
 static const GDBusSignalTable phonebook_signals[] = {
+	{ GDBUS_SIGNAL("EntriesReceived",
+			GDBUS_ARGS({ "entries", "s" })) },
 	{ }
 };
 
@@ -533,6 +754,12 @@ static void phonebook_remove(struct ofono_atom *atom)
 		pb->driver->remove(pb);
 
 	g_string_free(pb->vcards, TRUE);
+	g_hash_table_destroy(pb->merge_index);
+	g_ptr_array_foreach(pb->merge_list, (GFunc) destroy_merged_entry, NULL);
+	g_ptr_array_free(pb->merge_list, TRUE);
+	g_free(pb->cache);
+	g_free(pb->cache_hash);
+	g_free(pb->iccid);
 	g_free(pb);
 }
 
@@ -552,6 +779,8 @@ struct ofono_phonebook *ofono_phonebook_create(struct ofono_modem *modem,
 		return NULL;
 
 	pb->vcards = g_string_new(NULL);
+	pb->merge_list = g_ptr_array_new();
+	pb->merge_index = g_hash_table_new(g_str_hash, g_str_equal);
 	pb->atom = __ofono_modem_add_atom(modem, OFONO_ATOM_TYPE_PHONEBOOK,
 						phonebook_remove, pb);
 
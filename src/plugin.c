@@ -29,11 +29,21 @@
 
 #include "ofono.h"
 
+/* Init calls taking longer than this are always logged, in us */
+#define PLUGIN_SLOW_INIT 100000
+
 static GSList *plugins = NULL;
+static GSList *active_plugins = NULL;
+static GSList *deferred_plugins = NULL;
+static guint deferred_source = 0;
+static gint64 startup_time;
 
 struct ofono_plugin {
 	void *handle;
 	gboolean active;
+	gboolean sorted;
+	gboolean deferred;
+	gint64 init_time;
 	struct ofono_plugin_desc *desc;
 };
 
@@ -99,6 +109,173 @@ static gboolean check_plugin(struct ofono_plugin_desc *desc,
 	return TRUE;
 }
 
+static struct ofono_plugin *find_plugin(const char *name)
+{
+	GSList *list;
+
+	for (list = plugins; list; list = list->next) {
+		struct ofono_plugin *plugin = list->data;
+
+		if (g_str_equal(plugin->desc->name, name))
+			return plugin;
+	}
+
+	return NULL;
+}
+
+/*
+ * Calls @func for each plugin @plugin depends on, stopping as soon as
+ * it returns FALSE.  Dependencies that are not loaded are passed as
+ * NULL.
+ */
+static gboolean foreach_dependency(struct ofono_plugin *plugin,
+				gboolean (*func)(struct ofono_plugin *plugin,
+						const char *name,
+						struct ofono_plugin *dep))
+{
+	gchar **depends;
+	gboolean ret = TRUE;
+	int i;
+
+	if (plugin->desc->depends == NULL)
+		return TRUE;
+
+	depends = g_strsplit_set(plugin->desc->depends, ":, ", -1);
+
+	for (i = 0; depends[i] && ret; i++) {
+		if (*depends[i] == '\0')
+			continue;
+
+		ret = func(plugin, depends[i], find_plugin(depends[i]));
+	}
+
+	g_strfreev(depends);
+
+	return ret;
+}
+
+static gboolean dependency_sorted(struct ofono_plugin *plugin,
+					const char *name,
+					struct ofono_plugin *dep)
+{
+	return dep == NULL || dep->sorted;
+}
+
+static gboolean dependency_deferred(struct ofono_plugin *plugin,
+					const char *name,
+					struct ofono_plugin *dep)
+{
+	return dep == NULL || dep->deferred == FALSE;
+}
+
+static gboolean dependency_active(struct ofono_plugin *plugin,
+					const char *name,
+					struct ofono_plugin *dep)
+{
+	if (dep != NULL && dep->active == TRUE)
+		return TRUE;
+
+	ofono_info("Skipping %s, %s is not available",
+				plugin->desc->description, name);
+
+	return FALSE;
+}
+
+/*
+ * Orders the plugins so that each one comes after the plugins it
+ * depends on, keeping the priority order otherwise.  A plugin depending
+ * on a deferred one gets deferred as well.
+ */
+static GSList *sort_plugins(void)
+{
+	GSList *pending = g_slist_copy(plugins);
+	GSList *order = NULL;
+	GSList *list;
+
+	while (pending) {
+		struct ofono_plugin *plugin;
+
+		for (list = pending; list; list = list->next)
+			if (foreach_dependency(list->data, dependency_sorted))
+				break;
+
+		if (list == NULL) {
+			for (list = pending; list; list = list->next) {
+				plugin = list->data;
+				ofono_error("Circular dependency for %s",
+						plugin->desc->description);
+			}
+
+			break;
+		}
+
+		plugin = list->data;
+		plugin->sorted = TRUE;
+
+		if (plugin->desc->flags & OFONO_PLUGIN_FLAG_DEFERRED ||
+				!foreach_dependency(plugin,
+							dependency_deferred))
+			plugin->deferred = TRUE;
+
+		pending = g_slist_delete_link(pending, list);
+		order = g_slist_prepend(order, plugin);
+	}
+
+	g_slist_free(pending);
+
+	return g_slist_reverse(order);
+}
+
+static void init_plugin(struct ofono_plugin *plugin)
+{
+	gint64 start;
+	int err;
+
+	if (foreach_dependency(plugin, dependency_active) == FALSE)
+		return;
+
+	start = g_get_monotonic_time();
+	err = plugin->desc->init();
+	plugin->init_time = g_get_monotonic_time() - start;
+
+	__ofono_timeline_span(NULL, "plugin", start, "%s", plugin->desc->name);
+
+	DBG("%s: %d, %" G_GINT64_FORMAT " us", plugin->desc->name, err,
+							plugin->init_time);
+
+	if (plugin->init_time >= PLUGIN_SLOW_INIT)
+		ofono_info("%s took %" G_GINT64_FORMAT " ms to initialize",
+						plugin->desc->description,
+						plugin->init_time / 1000);
+
+	if (err < 0)
+		return;
+
+	plugin->active = TRUE;
+	active_plugins = g_slist_prepend(active_plugins, plugin);
+}
+
+/* Deferred plugins are initialized one per main loop iteration */
+static gboolean init_deferred(gpointer user_data)
+{
+	struct ofono_plugin *plugin = deferred_plugins->data;
+
+	deferred_plugins = g_slist_delete_link(deferred_plugins,
+						deferred_plugins);
+
+	init_plugin(plugin);
+
+	if (deferred_plugins)
+		return TRUE;
+
+	DBG("Deferred plugins done, %" G_GINT64_FORMAT " ms after startup",
+			(g_get_monotonic_time() - startup_time) / 1000);
+
+	deferred_source = 0;
+
+	return FALSE;
+}
+
 #include "builtin.h"
 
 int __ofono_plugin_init(const char *pattern, const char *exclude)
@@ -106,6 +283,7 @@ int __ofono_plugin_init(const char *pattern, const char *exclude)
 	gchar **patterns = NULL;
 	gchar **excludes = NULL;
 	GSList *list;
+	GSList *order;
 	GDir *dir;
 	const gchar *file;
 	gchar *filename;
@@ -113,6 +291,8 @@ int __ofono_plugin_init(const char *pattern, const char *exclude)
 
 	DBG("");
 
+	startup_time = g_get_monotonic_time();
+
 	if (pattern)
 		patterns = g_strsplit_set(pattern, ":, ", -1);
 
@@ -169,13 +349,31 @@ int __ofono_plugin_init(const char *pattern, const char *exclude)
 		g_dir_close(dir);
 	}
 
-	for (list = plugins; list; list = list->next) {
+	order = sort_plugins();
+
+	for (list = order; list; list = list->next) {
 		struct ofono_plugin *plugin = list->data;
 
-		if (plugin->desc->init() < 0)
+		if (plugin->deferred == TRUE) {
+			deferred_plugins = g_slist_prepend(deferred_plugins,
+								plugin);
 			continue;
+		}
+
+		init_plugin(plugin);
+	}
 
-		plugin->active = TRUE;
+	g_slist_free(order);
+
+	DBG("Plugins initialized in %" G_GINT64_FORMAT " ms, %u deferred",
+			(g_get_monotonic_time() - startup_time) / 1000,
+			g_slist_length(deferred_plugins));
+
+	if (deferred_plugins) {
+		deferred_plugins = g_slist_reverse(deferred_plugins);
+		deferred_source = g_idle_add_full(G_PRIORITY_LOW,
+							init_deferred,
+							NULL, NULL);
 	}
 
 	g_strfreev(patterns);
@@ -190,11 +388,27 @@ void __ofono_plugin_cleanup(void)
 
 	DBG("");
 
-	for (list = plugins; list; list = list->next) {
+	if (deferred_source) {
+		g_source_remove(deferred_source);
+		deferred_source = 0;
+	}
+
+	g_slist_free(deferred_plugins);
+	deferred_plugins = NULL;
+
+	/* Plugins exit in the reverse order of their initialization */
+	for (list = active_plugins; list; list = list->next) {
 		struct ofono_plugin *plugin = list->data;
 
-		if (plugin->active == TRUE && plugin->desc->exit)
+		if (plugin->desc->exit)
 			plugin->desc->exit();
+	}
+
+	g_slist_free(active_plugins);
+	active_plugins = NULL;
+
+	for (list = plugins; list; list = list->next) {
+		struct ofono_plugin *plugin = list->data;
 
 		if (plugin->handle)
 			dlclose(plugin->handle);
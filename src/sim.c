@@ -103,6 +103,7 @@ struct ofono_sim {
 	unsigned int cphs_spn_short_watch;
 
 	struct sim_fs *simfs;
+	unsigned int max_pending_reads;
 	struct ofono_sim_context *context;
 	struct ofono_sim_context *early_context;
 
@@ -1418,6 +1419,68 @@ static void sim_ready(enum ofono_sim_state new_state, void *user)
 					sim_efimg_changed, sim, NULL);
 }
 
+/*
+ * EFs the core atoms read right after the SIM becomes ready.  They are
+ * queued up front so that drivers able to keep several requests in
+ * flight overlap them instead of waiting for each atom in turn.
+ */
+static const struct {
+	int id;
+	enum ofono_sim_file_structure structure;
+} sim_prefetch_plan[] = {
+	{ SIM_EFMSISDN_FILEID,		OFONO_SIM_FILE_STRUCTURE_FIXED },
+	{ SIM_EFSDN_FILEID,		OFONO_SIM_FILE_STRUCTURE_FIXED },
+	{ SIM_EFIMG_FILEID,		OFONO_SIM_FILE_STRUCTURE_FIXED },
+	{ SIM_EFSPN_FILEID,		OFONO_SIM_FILE_STRUCTURE_TRANSPARENT },
+	{ SIM_EFPNN_FILEID,		OFONO_SIM_FILE_STRUCTURE_FIXED },
+	{ SIM_EFOPL_FILEID,		OFONO_SIM_FILE_STRUCTURE_FIXED },
+	{ SIM_EF_CPHS_CSP_FILEID,	OFONO_SIM_FILE_STRUCTURE_TRANSPARENT },
+	{ SIM_EFCBMID_FILEID,		OFONO_SIM_FILE_STRUCTURE_TRANSPARENT },
+	{ SIM_EFMWIS_FILEID,		OFONO_SIM_FILE_STRUCTURE_FIXED },
+	{ SIM_EFMBI_FILEID,		OFONO_SIM_FILE_STRUCTURE_FIXED },
+	{ SIM_EF_CPHS_MWIS_FILEID,	OFONO_SIM_FILE_STRUCTURE_TRANSPARENT },
+};
+
+static void sim_prefetch(struct ofono_sim *sim)
+{
+	unsigned int i;
+
+	if (sim->max_pending_reads < 2)
+		return;
+
+	for (i = 0; i < G_N_ELEMENTS(sim_prefetch_plan); i++)
+		sim_fs_prefetch(sim->simfs, sim_prefetch_plan[i].id,
+					sim_prefetch_plan[i].structure);
+
+	if (__ofono_sim_service_available(sim,
+				SIM_UST_SERVICE_PROVIDER_DISPLAY_INFO,
+				SIM_SST_SERVICE_PROVIDER_DISPLAY_INFO))
+		sim_fs_prefetch(sim->simfs, SIM_EFSPDI_FILEID,
+					OFONO_SIM_FILE_STRUCTURE_TRANSPARENT);
+
+	if (__ofono_sim_service_available(sim, SIM_UST_SERVICE_CFIS,
+						SIM_SST_SERVICE_CFIS))
+		sim_fs_prefetch(sim->simfs, SIM_EFCFIS_FILEID,
+					OFONO_SIM_FILE_STRUCTURE_FIXED);
+	else
+		sim_fs_prefetch(sim->simfs, SIM_EF_CPHS_CFF_FILEID,
+					OFONO_SIM_FILE_STRUCTURE_TRANSPARENT);
+
+	if (__ofono_sim_service_available(sim,
+				SIM_UST_SERVICE_GROUP_ID_LEVEL_1,
+				SIM_SST_SERVICE_GROUP_ID_LEVEL_1))
+		sim_fs_prefetch(sim->simfs, SIM_EFGID1_FILEID,
+					OFONO_SIM_FILE_STRUCTURE_TRANSPARENT);
+
+	/* EFecc is linear fixed on a USIM and transparent on a 2G SIM */
+	if (sim->phase == OFONO_SIM_PHASE_3G)
+		sim_fs_prefetch(sim->simfs, SIM_EFECC_FILEID,
+					OFONO_SIM_FILE_STRUCTURE_FIXED);
+	else
+		sim_fs_prefetch(sim->simfs, SIM_EFECC_FILEID,
+					OFONO_SIM_FILE_STRUCTURE_TRANSPARENT);
+}
+
 static void sim_set_ready(struct ofono_sim *sim)
 {
 	if (sim == NULL)
@@ -1430,6 +1493,7 @@ static void sim_set_ready(struct ofono_sim *sim)
 	sim->state = OFONO_SIM_STATE_READY;
 
 	sim_fs_check_version(sim->simfs);
+	sim_prefetch(sim);
 
 	call_state_watches(sim);
 }
@@ -2276,6 +2340,14 @@ const char *ofono_sim_get_imsi(struct ofono_sim *sim)
 	return sim->imsi;
 }
 
+const char *ofono_sim_get_iccid(struct ofono_sim *sim)
+{
+	if (sim == NULL)
+		return NULL;
+
+	return sim->iccid;
+}
+
 const char *ofono_sim_get_mcc(struct ofono_sim *sim)
 {
 	if (sim == NULL)
@@ -2439,6 +2511,8 @@ static void sim_free_main_state(struct ofono_sim *sim)
 		sim->imsi = NULL;
 	}
 
+	sim_fs_prefetch_cancel(sim->simfs);
+
 	sim->mcc[0] = '\0';
 	sim->mnc[0] = '\0';
 
@@ -3041,7 +3115,8 @@ void ofono_sim_register(struct ofono_sim *sim)
 
 	ofono_modem_add_interface(modem, OFONO_SIM_MANAGER_INTERFACE);
 	sim->state_watches = __ofono_watchlist_new(g_free);
-	sim->simfs = sim_fs_new(sim, sim->driver);
+	sim->simfs = sim_fs_new(sim, modem, sim->driver);
+	sim_fs_set_max_pending(sim->simfs, sim->max_pending_reads);
 
 	__ofono_atom_register(sim->atom, sim_unregister);
 
@@ -3070,6 +3145,14 @@ void *ofono_sim_get_data(struct ofono_sim *sim)
 	return sim->driver_data;
 }
 
+void ofono_sim_set_max_pending_reads(struct ofono_sim *sim, unsigned int count)
+{
+	sim->max_pending_reads = count;
+
+	if (sim->simfs)
+		sim_fs_set_max_pending(sim->simfs, count);
+}
+
 static ofono_bool_t is_valid_pin(const char *pin, unsigned int min,
 					unsigned int max)
 {
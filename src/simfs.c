@@ -40,6 +40,7 @@
 #include "simfs.h"
 #include "simutil.h"
 #include "storage.h"
+#include "timerwheel.h"
 
 #define SIM_CACHE_MODE 0600
 #define SIM_CACHE_BASEPATH STORAGEDIR "/%s-%i"
@@ -52,6 +53,12 @@
 
 #define SIM_FS_VERSION 2
 
+/* Upper bound on the data requested by one multi-record read */
+#define SIM_FS_RECORD_RANGE_SIZE 2048
+
+/* Prefetched contents nobody asked for are dropped after this long */
+#define SIM_FS_PREFETCH_TIMEOUT 60
+
 static gboolean sim_fs_op_next(gpointer user_data);
 static gboolean sim_fs_op_read_record(gpointer user);
 static gboolean sim_fs_op_read_block(gpointer user_data);
@@ -72,22 +79,58 @@ struct sim_fs_op {
 	gboolean is_read;
 	void *userdata;
 	struct ofono_sim_context *context;
+	struct sim_fs *fs;
+	unsigned char bitmap[32];
+	int fd;
+	guint source;
+	gint64 start;
 };
 
 static void sim_fs_op_free(struct sim_fs_op *node)
 {
+	if (node->source)
+		g_source_remove(node->source);
+
+	if (node->fd != -1)
+		TFR(close(node->fd));
+
 	g_free(node->buffer);
 	g_free(node);
 }
 
+/*
+ * Contents of an EF read ahead of its users.  An entry is handed out
+ * once, to the first whole-file read of the same EF and structure.
+ */
+struct sim_fs_prefetch {
+	int id;
+	enum ofono_sim_file_structure structure;
+	gboolean done;
+	gboolean stale;
+	int length;
+	int record_length;
+	unsigned char *data;
+	struct sim_fs *fs;
+};
+
+static void sim_fs_prefetch_free(struct sim_fs_prefetch *entry)
+{
+	g_free(entry->data);
+	g_free(entry);
+}
+
 struct sim_fs {
 	GQueue *op_q;
-	gint op_source;
-	unsigned char bitmap[32];
-	int fd;
+	GSList *active;
+	guint op_source;
+	unsigned int max_pending;
 	struct ofono_sim *sim;
+	struct ofono_modem *modem;
 	const struct ofono_sim_driver *driver;
 	GSList *contexts;
+	struct ofono_sim_context *prefetch_context;
+	GSList *prefetched;
+	guint prefetch_source;
 };
 
 void sim_fs_free(struct sim_fs *fs)
@@ -100,10 +143,15 @@ void sim_fs_free(struct sim_fs *fs)
 		fs->op_source = 0;
 	}
 
+	sim_fs_prefetch_cancel(fs);
+
 	/*
 	 * Note: users of sim_fs must not assume that the callback happens
 	 * for operations still in progress
 	 */
+	g_slist_free_full(fs->active, (GDestroyNotify) sim_fs_op_free);
+	fs->active = NULL;
+
 	if (fs->op_q) {
 		g_queue_foreach(fs->op_q, (GFunc) sim_fs_op_free, NULL);
 		g_queue_free(fs->op_q);
@@ -126,7 +174,7 @@ struct ofono_sim_context {
 	struct ofono_watchlist *file_watches;
 };
 
-struct sim_fs *sim_fs_new(struct ofono_sim *sim,
+struct sim_fs *sim_fs_new(struct ofono_sim *sim, struct ofono_modem *modem,
 				const struct ofono_sim_driver *driver)
 {
 	struct sim_fs *fs;
@@ -136,12 +184,18 @@ struct sim_fs *sim_fs_new(struct ofono_sim *sim,
 		return NULL;
 
 	fs->sim = sim;
+	fs->modem = modem;
 	fs->driver = driver;
-	fs->fd = -1;
+	fs->max_pending = 1;
 
 	return fs;
 }
 
+void sim_fs_set_max_pending(struct sim_fs *fs, unsigned int count)
+{
+	fs->max_pending = count > 0 ? count : 1;
+}
+
 struct ofono_sim_context *sim_fs_context_new(struct sim_fs *fs)
 {
 	struct ofono_sim_context *context =
@@ -161,6 +215,15 @@ void sim_fs_context_free(struct ofono_sim_context *context)
 	struct sim_fs *fs = context->fs;
 	int n = 0;
 	struct sim_fs_op *op;
+	GSList *l;
+
+	/* Operations already handed to the driver finish silently */
+	for (l = fs->active; l; l = l->next) {
+		op = l->data;
+
+		if (op->context == context)
+			op->cb = NULL;
+	}
 
 	if (fs->op_q) {
 		while ((op = g_queue_peek_nth(fs->op_q, n)) != NULL) {
@@ -169,13 +232,6 @@ void sim_fs_context_free(struct ofono_sim_context *context)
 				continue;
 			}
 
-			if (n == 0) {
-				op->cb = NULL;
-
-				n += 1;
-				continue;
-			}
-
 			sim_fs_op_free(op);
 			g_queue_remove(fs->op_q, op);
 		}
@@ -226,6 +282,9 @@ void sim_fs_notify_file_watches(struct sim_fs *fs, int id)
 		struct ofono_sim_context *context = l->data;
 		GSList *k;
 
+		if (context->file_watches == NULL)
+			continue;
+
 		for (k = context->file_watches->items; k; k = k->next) {
 			struct file_watch *w = k->data;
 			ofono_sim_file_changed_cb_t notify = w->item.notify;
@@ -237,29 +296,35 @@ void sim_fs_notify_file_watches(struct sim_fs *fs, int id)
 
 }
 
-static void sim_fs_end_current(struct sim_fs *fs)
+static void sim_fs_schedule(struct sim_fs *fs)
 {
-	struct sim_fs_op *op = g_queue_pop_head(fs->op_q);
+	if (fs->op_source > 0)
+		return;
 
-	if (g_queue_get_length(fs->op_q) > 0)
-		fs->op_source = g_idle_add(sim_fs_op_next, fs);
+	if (fs->op_q == NULL || g_queue_get_length(fs->op_q) == 0)
+		return;
 
-	if (fs->fd != -1) {
-		TFR(close(fs->fd));
-		fs->fd = -1;
-	}
+	fs->op_source = g_idle_add(sim_fs_op_next, fs);
+}
+
+static void sim_fs_end_current(struct sim_fs_op *op)
+{
+	struct sim_fs *fs = op->fs;
 
-	memset(fs->bitmap, 0, sizeof(fs->bitmap));
+	__ofono_timeline_span(fs->modem, "simfs", op->start, "%s %04X",
+				op->is_read == FALSE ? "write" :
+				op->info_only ? "info" : "read", op->id);
 
+	fs->active = g_slist_remove(fs->active, op);
 	sim_fs_op_free(op);
+
+	sim_fs_schedule(fs);
 }
 
-static void sim_fs_op_error(struct sim_fs *fs)
+static void sim_fs_op_error(struct sim_fs_op *op)
 {
-	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
-
 	if (op->cb == NULL) {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 		return;
 	}
 
@@ -273,10 +338,10 @@ static void sim_fs_op_error(struct sim_fs *fs)
 		((ofono_sim_file_write_cb_t) op->cb)
 			(0, op->userdata);
 
-	sim_fs_end_current(fs);
+	sim_fs_end_current(op);
 }
 
-static gboolean cache_block(struct sim_fs *fs, int block, int block_len,
+static gboolean cache_block(struct sim_fs_op *op, int block, int block_len,
 				const unsigned char *data, int num_bytes)
 {
 	int offset;
@@ -284,14 +349,14 @@ static gboolean cache_block(struct sim_fs *fs, int block, int block_len,
 	ssize_t r;
 	unsigned char b;
 
-	if (fs->fd == -1)
+	if (op->fd == -1)
 		return FALSE;
 
-	if (lseek(fs->fd, block * block_len +
+	if (lseek(op->fd, block * block_len +
 				SIM_CACHE_HEADER_SIZE, SEEK_SET) == (off_t) -1)
 		return FALSE;
 
-	r = TFR(write(fs->fd, data, num_bytes));
+	r = TFR(write(op->fd, data, num_bytes));
 
 	if (r != num_bytes)
 		return FALSE;
@@ -301,29 +366,28 @@ static gboolean cache_block(struct sim_fs *fs, int block, int block_len,
 	bit = block % 8;
 
 	/* lseek to correct byte (skip file info) */
-	lseek(fs->fd, offset + SIM_FILE_INFO_SIZE, SEEK_SET);
+	lseek(op->fd, offset + SIM_FILE_INFO_SIZE, SEEK_SET);
 
-	b = fs->bitmap[offset];
+	b = op->bitmap[offset];
 	b |= 1 << bit;
 
-	r = TFR(write(fs->fd, &b, sizeof(b)));
+	r = TFR(write(op->fd, &b, sizeof(b)));
 
 	if (r != sizeof(b))
 		return FALSE;
 
-	fs->bitmap[offset] = b;
+	op->bitmap[offset] = b;
 
 	return TRUE;
 }
 
 static void sim_fs_op_write_cb(const struct ofono_error *error, void *data)
 {
-	struct sim_fs *fs = data;
-	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
+	struct sim_fs_op *op = data;
 	ofono_sim_file_write_cb_t cb = op->cb;
 
 	if (cb == NULL) {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 		return;
 	}
 
@@ -332,19 +396,18 @@ static void sim_fs_op_write_cb(const struct ofono_error *error, void *data)
 	else
 		cb(0, op->userdata);
 
-	sim_fs_end_current(fs);
+	sim_fs_end_current(op);
 }
 
 static void sim_fs_op_read_record_cb(const struct ofono_error *error,
 					const unsigned char *sdata, int length,
 					void *data)
 {
-	struct sim_fs *fs = data;
-	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
+	struct sim_fs_op *op = data;
 	ofono_sim_file_read_cb_t cb = op->cb;
 
 	if (cb == NULL) {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 		return;
 	}
 
@@ -353,15 +416,14 @@ static void sim_fs_op_read_record_cb(const struct ofono_error *error,
 	else
 		cb(0, -1, op->current, NULL, 0, op->userdata);
 
-	sim_fs_end_current(fs);
+	sim_fs_end_current(op);
 }
 
 static void sim_fs_op_read_block_cb(const struct ofono_error *error,
 					const unsigned char *data, int len,
 					void *user)
 {
-	struct sim_fs *fs = user;
-	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
+	struct sim_fs_op *op = user;
 	int start_block;
 	int end_block;
 	int bufoff;
@@ -369,7 +431,7 @@ static void sim_fs_op_read_block_cb(const struct ofono_error *error,
 	int tocopy;
 
 	if (error->type != OFONO_ERROR_TYPE_NO_ERROR) {
-		sim_fs_op_error(fs);
+		sim_fs_op_error(op);
 		return;
 	}
 
@@ -392,10 +454,10 @@ static void sim_fs_op_read_block_cb(const struct ofono_error *error,
 				bufoff, dataoff, tocopy);
 
 	memcpy(op->buffer + bufoff, data + dataoff, tocopy);
-	cache_block(fs, op->current, 256, data, len);
+	cache_block(op, op->current, 256, data, len);
 
 	if (op->cb == NULL) {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 		return;
 	}
 
@@ -407,24 +469,24 @@ static void sim_fs_op_read_block_cb(const struct ofono_error *error,
 		cb(1, op->num_bytes, 0, op->buffer,
 				op->record_length, op->userdata);
 
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 	} else {
-		fs->op_source = g_idle_add(sim_fs_op_read_block, fs);
+		op->source = g_idle_add(sim_fs_op_read_block, op);
 	}
 }
 
 static gboolean sim_fs_op_read_block(gpointer user_data)
 {
-	struct sim_fs *fs = user_data;
-	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
+	struct sim_fs_op *op = user_data;
+	struct sim_fs *fs = op->fs;
 	int start_block;
 	int end_block;
 	unsigned short read_bytes;
 
-	fs->op_source = 0;
+	op->source = 0;
 
 	if (op->cb == NULL) {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 		return FALSE;
 	}
 
@@ -435,19 +497,19 @@ static gboolean sim_fs_op_read_block(gpointer user_data)
 		op->buffer = g_try_new0(unsigned char, op->num_bytes);
 
 		if (op->buffer == NULL) {
-			sim_fs_op_error(fs);
+			sim_fs_op_error(op);
 			return FALSE;
 		}
 	}
 
-	while (fs->fd != -1 && op->current <= end_block) {
+	while (op->fd != -1 && op->current <= end_block) {
 		int offset = op->current / 8;
 		int bit = 1 << op->current % 8;
 		int bufoff;
 		int seekoff;
 		int toread;
 
-		if ((fs->bitmap[offset] & bit) == 0)
+		if ((op->bitmap[offset] & bit) == 0)
 			break;
 
 		if (op->current == start_block) {
@@ -466,10 +528,10 @@ static gboolean sim_fs_op_read_block(gpointer user_data)
 		DBG("bufoff: %d, seekoff: %d, toread: %d",
 				bufoff, seekoff, toread);
 
-		if (lseek(fs->fd, seekoff, SEEK_SET) == (off_t) -1)
+		if (lseek(op->fd, seekoff, SEEK_SET) == (off_t) -1)
 			break;
 
-		if (TFR(read(fs->fd, op->buffer + bufoff, toread)) != toread)
+		if (TFR(read(op->fd, op->buffer + bufoff, toread)) != toread)
 			break;
 
 		op->current += 1;
@@ -481,13 +543,13 @@ static gboolean sim_fs_op_read_block(gpointer user_data)
 		cb(1, op->num_bytes, 0, op->buffer,
 				op->record_length, op->userdata);
 
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 
 		return FALSE;
 	}
 
 	if (fs->driver->read_file_transparent == NULL) {
-		sim_fs_op_error(fs);
+		sim_fs_op_error(op);
 		return FALSE;
 	}
 
@@ -497,7 +559,7 @@ static gboolean sim_fs_op_read_block(gpointer user_data)
 						read_bytes,
 						op->path_len ? op->path : NULL,
 						op->path_len,
-						sim_fs_op_read_block_cb, fs);
+						sim_fs_op_read_block_cb, op);
 
 	return FALSE;
 }
@@ -506,21 +568,20 @@ static void sim_fs_op_retrieve_cb(const struct ofono_error *error,
 					const unsigned char *data, int len,
 					void *user)
 {
-	struct sim_fs *fs = user;
-	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
+	struct sim_fs_op *op = user;
 	int total = op->length / op->record_length;
 	ofono_sim_file_read_cb_t cb = op->cb;
 
 	if (error->type != OFONO_ERROR_TYPE_NO_ERROR) {
-		sim_fs_op_error(fs);
+		sim_fs_op_error(op);
 		return;
 	}
 
-	cache_block(fs, op->current - 1, op->record_length,
+	cache_block(op, op->current - 1, op->record_length,
 			data, op->record_length);
 
 	if (cb == NULL) {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 		return;
 	}
 
@@ -528,40 +589,88 @@ static void sim_fs_op_retrieve_cb(const struct ofono_error *error,
 
 	if (op->current < total) {
 		op->current += 1;
-		fs->op_source = g_idle_add(sim_fs_op_read_record, fs);
+		op->source = g_idle_add(sim_fs_op_read_record, op);
 	} else {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 	}
 }
 
+static void sim_fs_op_retrieve_range_cb(const struct ofono_error *error,
+					const unsigned char *data, int len,
+					void *user)
+{
+	struct sim_fs_op *op = user;
+	int total = op->length / op->record_length;
+	int count;
+	int i;
+
+	if (error->type != OFONO_ERROR_TYPE_NO_ERROR) {
+		sim_fs_op_error(op);
+		return;
+	}
+
+	count = len / op->record_length;
+
+	if (count == 0) {
+		sim_fs_op_error(op);
+		return;
+	}
+
+	for (i = 0; i < count && op->current <= total; i++) {
+		const unsigned char *record = data + i * op->record_length;
+		ofono_sim_file_read_cb_t cb;
+
+		cache_block(op, op->current - 1, op->record_length,
+				record, op->record_length);
+
+		/* The callback may have cancelled the rest of the read */
+		cb = op->cb;
+		if (cb == NULL) {
+			sim_fs_end_current(op);
+			return;
+		}
+
+		cb(1, op->length, op->current, record, op->record_length,
+			op->userdata);
+
+		op->current += 1;
+	}
+
+	if (op->current <= total)
+		op->source = g_idle_add(sim_fs_op_read_record, op);
+	else
+		sim_fs_end_current(op);
+}
+
 static gboolean sim_fs_op_read_record(gpointer user)
 {
-	struct sim_fs *fs = user;
-	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
+	struct sim_fs_op *op = user;
+	struct sim_fs *fs = op->fs;
 	const struct ofono_sim_driver *driver = fs->driver;
 	int total = op->length / op->record_length;
 	unsigned char buf[256];
+	int count;
 
-	fs->op_source = 0;
+	op->source = 0;
 
 	if (op->cb == NULL) {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 		return FALSE;
 	}
 
-	while (fs->fd != -1 && op->current <= total) {
+	while (op->fd != -1 && op->current <= total) {
 		int offset = (op->current - 1) / 8;
 		int bit = 1 << ((op->current - 1) % 8);
 		ofono_sim_file_read_cb_t cb = op->cb;
 
-		if ((fs->bitmap[offset] & bit) == 0)
+		if ((op->bitmap[offset] & bit) == 0)
 			break;
 
-		if (lseek(fs->fd, (op->current - 1) * op->record_length +
+		if (lseek(op->fd, (op->current - 1) * op->record_length +
 				SIM_CACHE_HEADER_SIZE, SEEK_SET) == (off_t) -1)
 			break;
 
-		if (TFR(read(fs->fd, buf, op->record_length)) !=
+		if (TFR(read(op->fd, buf, op->record_length)) !=
 				op->record_length)
 			break;
 
@@ -572,15 +681,29 @@ static gboolean sim_fs_op_read_record(gpointer user)
 	}
 
 	if (op->current > total) {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 
 		return FALSE;
 	}
 
 	switch (op->structure) {
 	case OFONO_SIM_FILE_STRUCTURE_FIXED:
+		count = MIN(total - op->current + 1,
+				SIM_FS_RECORD_RANGE_SIZE / op->record_length);
+
+		if (count > 1 && driver->read_file_linear_records) {
+			driver->read_file_linear_records(fs->sim, op->id,
+						op->current, count,
+						op->record_length,
+						op->path_len ? op->path : NULL,
+						op->path_len,
+						sim_fs_op_retrieve_range_cb,
+						op);
+			break;
+		}
+
 		if (driver->read_file_linear == NULL) {
-			sim_fs_op_error(fs);
+			sim_fs_op_error(op);
 			return FALSE;
 		}
 
@@ -588,11 +711,11 @@ static gboolean sim_fs_op_read_record(gpointer user)
 						op->record_length,
 						op->path_len ? op->path : NULL,
 						op->path_len,
-						sim_fs_op_retrieve_cb, fs);
+						sim_fs_op_retrieve_cb, op);
 		break;
 	case OFONO_SIM_FILE_STRUCTURE_CYCLIC:
 		if (driver->read_file_cyclic == NULL) {
-			sim_fs_op_error(fs);
+			sim_fs_op_error(op);
 			return FALSE;
 		}
 
@@ -600,7 +723,7 @@ static gboolean sim_fs_op_read_record(gpointer user)
 						op->record_length,
 						op->path_len ? op->path : NULL,
 						op->path_len,
-						sim_fs_op_retrieve_cb, fs);
+						sim_fs_op_retrieve_cb, op);
 		break;
 	default:
 		ofono_error("Unrecognized file structure, this can't happen");
@@ -609,7 +732,7 @@ static gboolean sim_fs_op_read_record(gpointer user)
 	return FALSE;
 }
 
-static void sim_fs_op_cache_fileinfo(struct sim_fs *fs,
+static void sim_fs_op_cache_fileinfo(struct sim_fs_op *op,
 					const struct ofono_error *error,
 					int length,
 					enum ofono_sim_file_structure structure,
@@ -617,7 +740,7 @@ static void sim_fs_op_cache_fileinfo(struct sim_fs *fs,
 					const unsigned char access[3],
 					unsigned char file_status)
 {
-	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
+	struct sim_fs *fs = op->fs;
 	const char *imsi = ofono_sim_get_imsi(fs->sim);
 	enum ofono_sim_phase phase = ofono_sim_get_phase(fs->sim);
 	enum sim_file_access update;
@@ -654,18 +777,18 @@ static void sim_fs_op_cache_fileinfo(struct sim_fs *fs,
 	fileinfo[6] = file_status;
 
 	path = g_strdup_printf(SIM_CACHE_PATH, imsi, phase, op->id);
-	fs->fd = TFR(open(path, O_WRONLY | O_CREAT | O_TRUNC, SIM_CACHE_MODE));
+	op->fd = TFR(open(path, O_WRONLY | O_CREAT | O_TRUNC, SIM_CACHE_MODE));
 	g_free(path);
 
-	if (fs->fd == -1)
+	if (op->fd == -1)
 		return;
 
-	if (TFR(write(fs->fd, fileinfo, SIM_CACHE_HEADER_SIZE)) ==
+	if (TFR(write(op->fd, fileinfo, SIM_CACHE_HEADER_SIZE)) ==
 			SIM_CACHE_HEADER_SIZE)
 		return;
 
-	TFR(close(fs->fd));
-	fs->fd = -1;
+	TFR(close(op->fd));
+	op->fd = -1;
 }
 
 static void sim_fs_op_info_cb(const struct ofono_error *error, int length,
@@ -675,26 +798,25 @@ static void sim_fs_op_info_cb(const struct ofono_error *error, int length,
 				unsigned char file_status,
 				void *data)
 {
-	struct sim_fs *fs = data;
-	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
+	struct sim_fs_op *op = data;
 
 	if (error->type != OFONO_ERROR_TYPE_NO_ERROR) {
-		sim_fs_op_error(fs);
+		sim_fs_op_error(op);
 		return;
 	}
 
-	sim_fs_op_cache_fileinfo(fs, error, length, structure, record_length,
+	sim_fs_op_cache_fileinfo(op, error, length, structure, record_length,
 					access, file_status);
 
 	if (structure != op->structure) {
 		ofono_error("Requested file structure differs from SIM: %x",
 				op->id);
-		sim_fs_op_error(fs);
+		sim_fs_op_error(op);
 		return;
 	}
 
 	if (op->cb == NULL) {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 		return;
 	}
 
@@ -709,13 +831,13 @@ static void sim_fs_op_info_cb(const struct ofono_error *error, int length,
 		op->current = op->offset / 256;
 
 		if (op->info_only == FALSE)
-			fs->op_source = g_idle_add(sim_fs_op_read_block, fs);
+			op->source = g_idle_add(sim_fs_op_read_block, op);
 	} else {
 		op->record_length = record_length;
 		op->current = 1;
 
 		if (op->info_only == FALSE)
-			fs->op_source = g_idle_add(sim_fs_op_read_record, fs);
+			op->source = g_idle_add(sim_fs_op_read_record, op);
 	}
 
 	if (op->info_only == TRUE) {
@@ -728,15 +850,15 @@ static void sim_fs_op_info_cb(const struct ofono_error *error, int length,
 		cb(1, file_status, op->length,
 			op->record_length, op->userdata);
 
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 	}
 }
 
-static gboolean sim_fs_op_check_cached(struct sim_fs *fs)
+static gboolean sim_fs_op_check_cached(struct sim_fs_op *op)
 {
+	struct sim_fs *fs = op->fs;
 	const char *imsi = ofono_sim_get_imsi(fs->sim);
 	enum ofono_sim_phase phase = ofono_sim_get_phase(fs->sim);
-	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
 	char *path;
 	int fd;
 	ssize_t len;
@@ -786,13 +908,13 @@ static gboolean sim_fs_op_check_cached(struct sim_fs *fs)
 
 	op->length = file_length;
 	op->record_length = record_length;
-	memcpy(fs->bitmap, fileinfo + SIM_FILE_INFO_SIZE,
+	memcpy(op->bitmap, fileinfo + SIM_FILE_INFO_SIZE,
 			SIM_CACHE_HEADER_SIZE - SIM_FILE_INFO_SIZE);
-	fs->fd = fd;
+	op->fd = fd;
 
 	if (error_type != OFONO_ERROR_TYPE_NO_ERROR ||
 			structure != op->structure) {
-		sim_fs_op_error(fs);
+		sim_fs_op_error(op);
 		return TRUE;
 	}
 
@@ -806,16 +928,16 @@ static gboolean sim_fs_op_check_cached(struct sim_fs *fs)
 		cb(1, file_status, op->length,
 			op->record_length, op->userdata);
 
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 	} else if (structure == OFONO_SIM_FILE_STRUCTURE_TRANSPARENT) {
 		if (op->num_bytes == 0)
 			op->num_bytes = op->length;
 
 		op->current = op->offset / 256;
-		fs->op_source = g_idle_add(sim_fs_op_read_block, fs);
+		op->source = g_idle_add(sim_fs_op_read_block, op);
 	} else {
 		op->current = 1;
-		fs->op_source = g_idle_add(sim_fs_op_read_record, fs);
+		op->source = g_idle_add(sim_fs_op_read_record, op);
 	}
 
 	return TRUE;
@@ -825,21 +947,73 @@ error:
 	return FALSE;
 }
 
-static gboolean sim_fs_op_next(gpointer user_data)
+static struct sim_fs_prefetch *prefetch_find(struct sim_fs *fs, int id,
+				enum ofono_sim_file_structure structure)
 {
-	struct sim_fs *fs = user_data;
-	const struct ofono_sim_driver *driver = fs->driver;
-	struct sim_fs_op *op;
+	GSList *l;
 
-	fs->op_source = 0;
+	for (l = fs->prefetched; l; l = l->next) {
+		struct sim_fs_prefetch *entry = l->data;
 
-	if (fs->op_q == NULL)
+		if (entry->id == id && entry->structure == structure)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static gboolean sim_fs_op_check_prefetched(struct sim_fs_op *op)
+{
+	struct sim_fs *fs = op->fs;
+	struct sim_fs_prefetch *entry;
+	int total;
+	int i;
+
+	if (op->context == fs->prefetch_context || op->info_only == TRUE)
+		return FALSE;
+
+	if (op->offset != 0 || op->num_bytes != 0 || op->path_len != 0)
+		return FALSE;
+
+	entry = prefetch_find(fs, op->id, op->structure);
+	if (entry == NULL || entry->done == FALSE)
 		return FALSE;
 
-	op = g_queue_peek_head(fs->op_q);
+	fs->prefetched = g_slist_remove(fs->prefetched, entry);
+
+	if (op->structure == OFONO_SIM_FILE_STRUCTURE_TRANSPARENT) {
+		ofono_sim_file_read_cb_t cb = op->cb;
+
+		cb(1, entry->length, 0, entry->data,
+				entry->record_length, op->userdata);
+	} else {
+		total = entry->length / entry->record_length;
+
+		for (i = 0; i < total && op->cb; i++) {
+			ofono_sim_file_read_cb_t cb = op->cb;
+
+			cb(1, entry->length, i + 1,
+				entry->data + i * entry->record_length,
+				entry->record_length, op->userdata);
+		}
+	}
+
+	sim_fs_prefetch_free(entry);
+	sim_fs_end_current(op);
+
+	return TRUE;
+}
+
+static gboolean sim_fs_op_start(gpointer user_data)
+{
+	struct sim_fs_op *op = user_data;
+	struct sim_fs *fs = op->fs;
+	const struct ofono_sim_driver *driver = fs->driver;
+
+	op->source = 0;
 
 	if (op->cb == NULL) {
-		sim_fs_end_current(fs);
+		sim_fs_end_current(op);
 		return FALSE;
 	}
 
@@ -850,14 +1024,14 @@ static gboolean sim_fs_op_next(gpointer user_data)
 						op->current, op->record_length,
 						op->path_len ? op->path : NULL,
 						op->path_len,
-						sim_fs_op_read_record_cb, fs);
+						sim_fs_op_read_record_cb, op);
 			break;
 		case OFONO_SIM_FILE_STRUCTURE_CYCLIC:
 			driver->read_file_cyclic(fs->sim, op->id,
 						op->current, op->record_length,
 						op->path_len ? op->path : NULL,
 						op->path_len,
-						sim_fs_op_read_record_cb, fs);
+						sim_fs_op_read_record_cb, op);
 			break;
 		case OFONO_SIM_FILE_STRUCTURE_TRANSPARENT:
 		default:
@@ -865,29 +1039,32 @@ static gboolean sim_fs_op_next(gpointer user_data)
 			break;
 		}
 	} else if (op->is_read == TRUE) {
-		if (sim_fs_op_check_cached(fs))
+		if (sim_fs_op_check_prefetched(op))
+			return FALSE;
+
+		if (sim_fs_op_check_cached(op))
 			return FALSE;
 
 		driver->read_file_info(fs->sim, op->id,
 					op->path_len ? op->path : NULL,
 					op->path_len,
-					sim_fs_op_info_cb, fs);
+					sim_fs_op_info_cb, op);
 	} else {
 		switch (op->structure) {
 		case OFONO_SIM_FILE_STRUCTURE_TRANSPARENT:
 			driver->write_file_transparent(fs->sim, op->id, 0,
 					op->length, op->buffer,
-					NULL, 0, sim_fs_op_write_cb, fs);
+					NULL, 0, sim_fs_op_write_cb, op);
 			break;
 		case OFONO_SIM_FILE_STRUCTURE_FIXED:
 			driver->write_file_linear(fs->sim, op->id, op->current,
 					op->length, op->buffer,
-					NULL, 0, sim_fs_op_write_cb, fs);
+					NULL, 0, sim_fs_op_write_cb, op);
 			break;
 		case OFONO_SIM_FILE_STRUCTURE_CYCLIC:
 			driver->write_file_cyclic(fs->sim, op->id,
 					op->length, op->buffer,
-					NULL, 0, sim_fs_op_write_cb, fs);
+					NULL, 0, sim_fs_op_write_cb, op);
 			break;
 		default:
 			ofono_error("Unrecognized file structure, "
@@ -901,6 +1078,96 @@ static gboolean sim_fs_op_next(gpointer user_data)
 	return FALSE;
 }
 
+/*
+ * Reads of the same EF share its cache file, so they run one after
+ * another, in the order they were queued.
+ */
+static gboolean sim_fs_op_blocked(struct sim_fs *fs, struct sim_fs_op *op,
+					int n)
+{
+	GSList *l;
+	int i;
+
+	for (l = fs->active; l; l = l->next) {
+		struct sim_fs_op *other = l->data;
+
+		if (other->id == op->id)
+			return TRUE;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct sim_fs_op *other = g_queue_peek_nth(fs->op_q, i);
+
+		if (other->id == op->id)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean sim_fs_op_next(gpointer user_data)
+{
+	struct sim_fs *fs = user_data;
+	struct sim_fs_op *op;
+	int n = 0;
+
+	fs->op_source = 0;
+
+	if (fs->op_q == NULL)
+		return FALSE;
+
+	while (g_slist_length(fs->active) < fs->max_pending) {
+		op = g_queue_peek_nth(fs->op_q, n);
+		if (op == NULL)
+			break;
+
+		/* Writes wait for everything queued before them */
+		if (op->is_read == FALSE && (n > 0 || fs->active != NULL))
+			break;
+
+		if (op->is_read == TRUE && sim_fs_op_blocked(fs, op, n)) {
+			n += 1;
+			continue;
+		}
+
+		g_queue_pop_nth(fs->op_q, n);
+		fs->active = g_slist_append(fs->active, op);
+		op->start = g_get_monotonic_time();
+
+		/*
+		 * Start from a fresh main loop iteration, callbacks can
+		 * complete synchronously and modify the queue
+		 */
+		op->source = g_idle_add(sim_fs_op_start, op);
+	}
+
+	return FALSE;
+}
+
+static struct sim_fs_op *sim_fs_op_new(struct ofono_sim_context *context)
+{
+	struct sim_fs_op *op;
+
+	op = g_try_new0(struct sim_fs_op, 1);
+	if (op == NULL)
+		return NULL;
+
+	op->context = context;
+	op->fs = context->fs;
+	op->fd = -1;
+
+	return op;
+}
+
+static void sim_fs_op_queue(struct sim_fs *fs, struct sim_fs_op *op)
+{
+	if (fs->op_q == NULL)
+		fs->op_q = g_queue_new();
+
+	g_queue_push_tail(fs->op_q, op);
+	sim_fs_schedule(fs);
+}
+
 int sim_fs_read_info(struct ofono_sim_context *context, int id,
 			enum ofono_sim_file_structure expected_type,
 			const unsigned char *path, unsigned int pth_len,
@@ -918,10 +1185,7 @@ int sim_fs_read_info(struct ofono_sim_context *context, int id,
 	if (fs->driver->read_file_info == NULL)
 		return -ENOSYS;
 
-	if (fs->op_q == NULL)
-		fs->op_q = g_queue_new();
-
-	op = g_try_new0(struct sim_fs_op, 1);
+	op = sim_fs_op_new(context);
 	if (op == NULL)
 		return -ENOMEM;
 
@@ -931,14 +1195,10 @@ int sim_fs_read_info(struct ofono_sim_context *context, int id,
 	op->userdata = data;
 	op->is_read = TRUE;
 	op->info_only = TRUE;
-	op->context = context;
 	memcpy(op->path, path, pth_len);
 	op->path_len = pth_len;
 
-	g_queue_push_tail(fs->op_q, op);
-
-	if (g_queue_get_length(fs->op_q) == 1)
-		fs->op_source = g_idle_add(sim_fs_op_next, fs);
+	sim_fs_op_queue(fs, op);
 
 	return 0;
 }
@@ -963,10 +1223,7 @@ int sim_fs_read(struct ofono_sim_context *context, int id,
 		return -ENOSYS;
 	}
 
-	if (fs->op_q == NULL)
-		fs->op_q = g_queue_new();
-
-	op = g_try_new0(struct sim_fs_op, 1);
+	op = sim_fs_op_new(context);
 	if (op == NULL)
 		return -ENOMEM;
 
@@ -978,14 +1235,10 @@ int sim_fs_read(struct ofono_sim_context *context, int id,
 	op->offset = offset;
 	op->num_bytes = num_bytes;
 	op->info_only = FALSE;
-	op->context = context;
 	memcpy(op->path, path, path_len);
 	op->path_len = path_len;
 
-	g_queue_push_tail(fs->op_q, op);
-
-	if (g_queue_get_length(fs->op_q) == 1)
-		fs->op_source = g_idle_add(sim_fs_op_next, fs);
+	sim_fs_op_queue(fs, op);
 
 	return 0;
 }
@@ -1016,10 +1269,7 @@ int sim_fs_read_record(struct ofono_sim_context *context, int id,
 		return -ENOSYS;
 	}
 
-	if (fs->op_q == NULL)
-		fs->op_q = g_queue_new();
-
-	op = g_try_new0(struct sim_fs_op, 1);
+	op = sim_fs_op_new(context);
 	if (op == NULL)
 		return -ENOMEM;
 
@@ -1029,20 +1279,39 @@ int sim_fs_read_record(struct ofono_sim_context *context, int id,
 	op->userdata = data;
 	op->is_read = TRUE;
 	op->info_only = FALSE;
-	op->context = context;
 	op->record_length = record_length;
 	op->current = record;
 	memcpy(op->path, path, path_len);
 	op->path_len = path_len;
 
-	g_queue_push_tail(fs->op_q, op);
-
-	if (g_queue_get_length(fs->op_q) == 1)
-		fs->op_source = g_idle_add(sim_fs_op_next, fs);
+	sim_fs_op_queue(fs, op);
 
 	return 0;
 }
 
+static void prefetch_drop(struct sim_fs *fs, int id)
+{
+	GSList *l = fs->prefetched;
+
+	while (l) {
+		struct sim_fs_prefetch *entry = l->data;
+
+		l = l->next;
+
+		if (entry->id != id)
+			continue;
+
+		/* Still being read, let the read callback dispose of it */
+		if (entry->done == FALSE) {
+			entry->stale = TRUE;
+			continue;
+		}
+
+		fs->prefetched = g_slist_remove(fs->prefetched, entry);
+		sim_fs_prefetch_free(entry);
+	}
+}
+
 int sim_fs_write(struct ofono_sim_context *context, int id,
 			ofono_sim_file_write_cb_t cb,
 			enum ofono_sim_file_structure structure, int record,
@@ -1075,10 +1344,7 @@ int sim_fs_write(struct ofono_sim_context *context, int id,
 	if (fn == NULL)
 		return -ENOSYS;
 
-	if (fs->op_q == NULL)
-		fs->op_q = g_queue_new();
-
-	op = g_try_new0(struct sim_fs_op, 1);
+	op = sim_fs_op_new(context);
 	if (op == NULL)
 		return -ENOMEM;
 
@@ -1090,16 +1356,130 @@ int sim_fs_write(struct ofono_sim_context *context, int id,
 	op->structure = structure;
 	op->length = length;
 	op->current = record;
-	op->context = context;
 
-	g_queue_push_tail(fs->op_q, op);
+	prefetch_drop(fs, id);
+	sim_fs_op_queue(fs, op);
+
+	return 0;
+}
+
+static void prefetch_read_cb(int ok, int length, int record,
+				const unsigned char *data,
+				int record_length, void *userdata)
+{
+	struct sim_fs_prefetch *entry = userdata;
+	struct sim_fs *fs = entry->fs;
+
+	/* Failures are not remembered, the real reader will retry */
+	if (!ok || entry->stale) {
+		if (entry->structure != OFONO_SIM_FILE_STRUCTURE_TRANSPARENT &&
+				ok && record < length / record_length)
+			return;
+
+		fs->prefetched = g_slist_remove(fs->prefetched, entry);
+		sim_fs_prefetch_free(entry);
+		return;
+	}
+
+	if (entry->structure == OFONO_SIM_FILE_STRUCTURE_TRANSPARENT) {
+		entry->data = g_memdup(data, length);
+		entry->length = length;
+		entry->record_length = record_length;
+		entry->done = TRUE;
+		return;
+	}
+
+	if (entry->data == NULL) {
+		entry->data = g_malloc0(length);
+		entry->length = length;
+		entry->record_length = record_length;
+	}
+
+	memcpy(entry->data + (record - 1) * record_length, data,
+			record_length);
+
+	if (record == length / record_length)
+		entry->done = TRUE;
+}
 
-	if (g_queue_get_length(fs->op_q) == 1)
-		fs->op_source = g_idle_add(sim_fs_op_next, fs);
+static gboolean prefetch_timeout(gpointer user_data)
+{
+	struct sim_fs *fs = user_data;
+
+	fs->prefetch_source = 0;
+	sim_fs_prefetch_cancel(fs);
+
+	return FALSE;
+}
+
+int sim_fs_prefetch(struct sim_fs *fs, int id,
+			enum ofono_sim_file_structure structure)
+{
+	struct sim_fs_prefetch *entry;
+	int err;
+
+	/*
+	 * With a single operation in flight reading ahead only reorders
+	 * the queue, it can't save any round trips
+	 */
+	if (fs->max_pending < 2)
+		return -ENOTSUP;
+
+	if (prefetch_find(fs, id, structure) != NULL)
+		return -EALREADY;
+
+	if (fs->prefetch_context == NULL) {
+		fs->prefetch_context = sim_fs_context_new(fs);
+		if (fs->prefetch_context == NULL)
+			return -ENOMEM;
+	}
+
+	entry = g_try_new0(struct sim_fs_prefetch, 1);
+	if (entry == NULL)
+		return -ENOMEM;
+
+	entry->id = id;
+	entry->structure = structure;
+	entry->fs = fs;
+
+	err = sim_fs_read(fs->prefetch_context, id, structure, 0, 0,
+				NULL, 0, prefetch_read_cb, entry);
+	if (err < 0) {
+		g_free(entry);
+		return err;
+	}
+
+	fs->prefetched = g_slist_prepend(fs->prefetched, entry);
+
+	if (fs->prefetch_source == 0)
+		fs->prefetch_source = timer_wheel_add_seconds(
+						SIM_FS_PREFETCH_TIMEOUT,
+						prefetch_timeout, fs);
 
 	return 0;
 }
 
+void sim_fs_prefetch_cancel(struct sim_fs *fs)
+{
+	if (fs == NULL)
+		return;
+
+	if (fs->prefetch_source) {
+		timer_wheel_remove(fs->prefetch_source);
+		fs->prefetch_source = 0;
+	}
+
+	/* No read callbacks can reach the entries past this point */
+	if (fs->prefetch_context) {
+		sim_fs_context_free(fs->prefetch_context);
+		fs->prefetch_context = NULL;
+	}
+
+	g_slist_free_full(fs->prefetched,
+				(GDestroyNotify) sim_fs_prefetch_free);
+	fs->prefetched = NULL;
+}
+
 void sim_fs_cache_image(struct sim_fs *fs, const char *image, int id)
 {
 	const char *imsi;
@@ -1244,6 +1624,7 @@ void sim_fs_cache_flush(struct sim_fs *fs)
 		g_free(entries);
 	}
 
+	sim_fs_prefetch_cancel(fs);
 	sim_fs_image_cache_flush(fs);
 }
 
@@ -1255,6 +1636,8 @@ void sim_fs_cache_flush_file(struct sim_fs *fs, int id)
 
 	remove(path);
 	g_free(path);
+
+	prefetch_drop(fs, id);
 }
 
 void sim_fs_image_cache_flush(struct sim_fs *fs)
@@ -21,10 +21,13 @@
 
 struct sim_fs;
 
-struct sim_fs *sim_fs_new(struct ofono_sim *sim,
+struct sim_fs *sim_fs_new(struct ofono_sim *sim, struct ofono_modem *modem,
 				const struct ofono_sim_driver *driver);
 struct ofono_sim_context *sim_fs_context_new(struct sim_fs *fs);
 
+/* Number of operations handed to the driver at once, defaults to 1 */
+void sim_fs_set_max_pending(struct sim_fs *fs, unsigned int count);
+
 unsigned int sim_fs_file_watch_add(struct ofono_sim_context *context,
 					int id, ofono_sim_file_changed_cb_t cb,
 					void *userdata,
@@ -52,6 +55,10 @@ int sim_fs_read_info(struct ofono_sim_context *context, int id,
 		const unsigned char *path, unsigned int pth_len,
 		ofono_sim_read_info_cb_t cb, void *data);
 
+int sim_fs_prefetch(struct sim_fs *fs, int id,
+			enum ofono_sim_file_structure structure);
+void sim_fs_prefetch_cancel(struct sim_fs *fs);
+
 void sim_fs_check_version(struct sim_fs *fs);
 
 int sim_fs_write(struct ofono_sim_context *context, int id,
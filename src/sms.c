@@ -43,6 +43,7 @@
 
 #define MESSAGE_MANAGER_FLAG_CACHED 0x1
 #define MESSAGE_MANAGER_FLAG_TXQ_ACTIVE 0x2
+#define MESSAGE_MANAGER_FLAG_TXQ_SUBMITTING 0x4
 
 #define SETTINGS_STORE "sms"
 #define SETTINGS_GROUP "Settings"
@@ -50,8 +51,30 @@
 #define TXQ_MAX_RETRIES 4
 #define NETWORK_TIMEOUT 332
 
+#define SMS_BATCH_MAX 1000
+#define SMS_BATCH_PROGRESS_INTERVAL 1000
+
+#define SMS_CHANGES_INTERVAL 500
+#define SMS_CHANGES_MAX 256
+#define SMS_MESSAGES_PAGE_MAX 256
+
+#define MESSAGE_ENTRY_SIGNATURE DBUS_STRUCT_BEGIN_CHAR_AS_STRING \
+					DBUS_TYPE_OBJECT_PATH_AS_STRING \
+					DBUS_TYPE_ARRAY_AS_STRING \
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING \
+					DBUS_TYPE_STRING_AS_STRING \
+					DBUS_TYPE_VARIANT_AS_STRING \
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING \
+					DBUS_STRUCT_END_CHAR_AS_STRING
+
 static gboolean tx_next(gpointer user_data);
 
+struct sms_batch;
+static int sms_txq_submit(struct ofono_sms *sms, GSList *list,
+				unsigned int flags, struct sms_batch *batch,
+				struct ofono_uuid *uuid,
+				ofono_sms_txq_queued_cb_t cb, void *data);
+
 static GSList *g_drivers = NULL;
 
 struct sms_handler {
@@ -69,6 +92,10 @@ struct ofono_sms {
 	GQueue *txq;
 	unsigned long tx_counter;
 	guint tx_source;
+	GSList *tx_backup_queue;
+	guint tx_backup_source;
+	GSList *batches;
+	unsigned int next_batch_id;
 	struct ofono_message_waiting *mw;
 	unsigned int mw_watch;
 	ofono_bool_t registered;
@@ -85,10 +112,27 @@ struct ofono_sms {
 	ofono_bool_t use_delivery_reports;
 	struct status_report_assembly *sr_assembly;
 	GHashTable *messages;
+	unsigned int num_messages;
+	GArray *changes;
+	guint changes_source;
 	struct ofono_watchlist *text_handlers;
 	struct ofono_watchlist *datagram_handlers;
 };
 
+struct sms_batch {
+	struct ofono_sms *sms;
+	unsigned int id;
+	unsigned int total;
+	unsigned int sent;
+	unsigned int failed;
+	guint progress_source;
+};
+
+struct message_change {
+	struct ofono_uuid uuid;
+	enum message_state state;
+};
+
 struct pending_pdu {
 	unsigned char pdu[176];
 	int tpdu_len;
@@ -107,6 +151,9 @@ struct tx_queue_entry {
 	void *data;
 	ofono_destroy_func destroy;
 	unsigned long id;
+	struct sms_batch *batch;
+	gboolean backup_pending;
+	gboolean compact;
 };
 
 static gboolean uuid_equal(gconstpointer v1, gconstpointer v2)
@@ -615,6 +662,237 @@ static void tx_queue_entry_destroy_foreach(gpointer _entry, gpointer unused)
 	tx_queue_entry_destroy(_entry);
 }
 
+static void sms_batch_free(struct sms_batch *batch)
+{
+	if (batch->progress_source)
+		g_source_remove(batch->progress_source);
+
+	g_free(batch);
+}
+
+static void sms_batch_emit_progress(struct sms_batch *batch)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+	const char *path = __ofono_atom_get_path(batch->sms->atom);
+	DBusMessage *signal;
+	DBusMessageIter iter;
+	DBusMessageIter dict;
+
+	signal = dbus_message_new_signal(path, OFONO_MESSAGE_MANAGER_INTERFACE,
+						"BatchProgress");
+	if (signal == NULL)
+		return;
+
+	dbus_message_iter_init_append(signal, &iter);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &batch->id);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					OFONO_PROPERTIES_ARRAY_SIGNATURE,
+					&dict);
+	ofono_dbus_dict_append(&dict, "Total", DBUS_TYPE_UINT32,
+				&batch->total);
+	ofono_dbus_dict_append(&dict, "Sent", DBUS_TYPE_UINT32, &batch->sent);
+	ofono_dbus_dict_append(&dict, "Failed", DBUS_TYPE_UINT32,
+				&batch->failed);
+	dbus_message_iter_close_container(&iter, &dict);
+
+	g_dbus_send_message(conn, signal);
+}
+
+static gboolean sms_batch_progress_timeout(gpointer user_data)
+{
+	struct sms_batch *batch = user_data;
+
+	batch->progress_source = 0;
+	sms_batch_emit_progress(batch);
+
+	return FALSE;
+}
+
+/*
+ * Progress of a batch is reported at most once per interval while it
+ * is running, and once more when its last message reaches a final state
+ */
+static void sms_batch_entry_done(struct sms_batch *batch, gboolean sent)
+{
+	struct ofono_sms *sms = batch->sms;
+
+	if (sent)
+		batch->sent += 1;
+	else
+		batch->failed += 1;
+
+	if (batch->sent + batch->failed < batch->total) {
+		if (batch->progress_source == 0)
+			batch->progress_source =
+				g_timeout_add(SMS_BATCH_PROGRESS_INTERVAL,
+						sms_batch_progress_timeout,
+						batch);
+		return;
+	}
+
+	sms_batch_emit_progress(batch);
+
+	sms->batches = g_slist_remove(sms->batches, batch);
+	sms_batch_free(batch);
+}
+
+static void sms_append_message(DBusMessageIter *array, const char *path,
+				struct message *m, enum message_state state)
+{
+	DBusMessageIter entry;
+	DBusMessageIter dict;
+	const char *str;
+
+	dbus_message_iter_open_container(array, DBUS_TYPE_STRUCT, NULL, &entry);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_OBJECT_PATH, &path);
+	dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY,
+					OFONO_PROPERTIES_ARRAY_SIGNATURE,
+					&dict);
+
+	if (m != NULL)
+		message_append_properties(m, &dict);
+	else {
+		str = message_state_to_string(state);
+		ofono_dbus_dict_append(&dict, "State", DBUS_TYPE_STRING, &str);
+	}
+
+	dbus_message_iter_close_container(&entry, &dict);
+	dbus_message_iter_close_container(array, &entry);
+}
+
+static gboolean sms_changes_flush(gpointer user_data)
+{
+	struct ofono_sms *sms = user_data;
+	const char *path = __ofono_atom_get_path(sms->atom);
+	DBusMessage *signal;
+	DBusMessageIter iter;
+	DBusMessageIter array;
+	unsigned int i;
+
+	sms->changes_source = 0;
+
+	signal = dbus_message_new_signal(path, OFONO_MESSAGE_MANAGER_INTERFACE,
+						"MessagesChanged");
+	if (signal == NULL)
+		goto out;
+
+	dbus_message_iter_init_append(signal, &iter);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					MESSAGE_ENTRY_SIGNATURE, &array);
+
+	for (i = 0; i < sms->changes->len; i++) {
+		struct message_change *change = &g_array_index(sms->changes,
+							struct message_change, i);
+
+		path = message_path_from_uuid(sms->atom, &change->uuid);
+		sms_append_message(&array, path, NULL, change->state);
+	}
+
+	dbus_message_iter_close_container(&iter, &array);
+
+	g_dbus_send_message(ofono_dbus_get_connection(), signal);
+
+out:
+	g_array_set_size(sms->changes, 0);
+
+	return FALSE;
+}
+
+/*
+ * Additions and state changes of messages queued in compact mode are
+ * collected and reported together by a single MessagesChanged signal.
+ * A message that changes again before the signal went out is only
+ * reported once, with its latest state.
+ */
+static void sms_message_changed(struct ofono_sms *sms,
+				const struct ofono_uuid *uuid,
+				enum message_state state)
+{
+	struct message_change change;
+	int i;
+
+	for (i = sms->changes->len - 1; i >= 0; i--) {
+		struct message_change *old = &g_array_index(sms->changes,
+							struct message_change, i);
+
+		if (memcmp(&old->uuid, uuid, sizeof(*uuid)))
+			continue;
+
+		old->state = state;
+		return;
+	}
+
+	memcpy(&change.uuid, uuid, sizeof(*uuid));
+	change.state = state;
+	g_array_append_val(sms->changes, change);
+
+	if (sms->changes->len >= SMS_CHANGES_MAX) {
+		if (sms->changes_source) {
+			g_source_remove(sms->changes_source);
+			sms->changes_source = 0;
+		}
+
+		sms_changes_flush(sms);
+		return;
+	}
+
+	if (sms->changes_source == 0)
+		sms->changes_source = g_timeout_add(SMS_CHANGES_INTERVAL,
+							sms_changes_flush, sms);
+}
+
+static void tx_backup_store_entry(struct ofono_sms *sms,
+					struct tx_queue_entry *entry)
+{
+	const char *uuid_str = ofono_uuid_to_str(&entry->uuid);
+	unsigned char i;
+
+	/* PDUs sent before the backup got written need no backup */
+	for (i = entry->cur_pdu; i < entry->num_pdus; i++) {
+		struct pending_pdu *pdu = &entry->pdus[i];
+
+		sms_tx_backup_store(sms->imsi, entry->id, entry->flags,
+					uuid_str, i, pdu->pdu,
+					pdu->pdu_len, pdu->tpdu_len);
+	}
+}
+
+static gboolean tx_backup_flush(gpointer user_data)
+{
+	struct ofono_sms *sms = user_data;
+	GSList *l;
+
+	sms->tx_backup_source = 0;
+
+	for (l = sms->tx_backup_queue; l; l = l->next) {
+		struct tx_queue_entry *entry = l->data;
+
+		entry->backup_pending = FALSE;
+		tx_backup_store_entry(sms, entry);
+	}
+
+	g_slist_free(sms->tx_backup_queue);
+	sms->tx_backup_queue = NULL;
+
+	return FALSE;
+}
+
+/*
+ * Backups of newly queued messages are written together from an idle
+ * callback, so a burst of submissions costs a single pass over the
+ * storage instead of one per message.
+ */
+static void tx_backup_queue_entry(struct ofono_sms *sms,
+					struct tx_queue_entry *entry)
+{
+	entry->backup_pending = TRUE;
+	sms->tx_backup_queue = g_slist_prepend(sms->tx_backup_queue, entry);
+
+	if (sms->tx_backup_source == 0)
+		sms->tx_backup_source = g_idle_add(tx_backup_flush, sms);
+}
+
 static void sms_tx_queue_remove_entry(struct ofono_sms *sms, GList *entry_list,
 					enum message_state tx_state)
 {
@@ -653,24 +931,60 @@ static void sms_tx_queue_remove_entry(struct ofono_sms *sms, GList *entry_list,
 	if (entry->flags & OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS) {
 		struct message *m;
 
-		sms_tx_backup_free(sms->imsi, entry->id, entry->flags,
+		if (entry->backup_pending)
+			sms->tx_backup_queue =
+				g_slist_remove(sms->tx_backup_queue, entry);
+		else
+			sms_tx_backup_free(sms->imsi, entry->id, entry->flags,
 					ofono_uuid_to_str(&entry->uuid));
 
+		sms->num_messages -= 1;
+
 		m = g_hash_table_lookup(sms->messages, &entry->uuid);
 
 		if (m != NULL) {
 			message_set_state(m, tx_state);
 			g_hash_table_remove(sms->messages, &entry->uuid);
-			message_emit_removed(m,
+
+			/*
+			 * Batches report through BatchProgress instead, and
+			 * compact messages never announced their object
+			 */
+			if (entry->batch == NULL && !entry->compact)
+				message_emit_removed(m,
 					OFONO_MESSAGE_MANAGER_INTERFACE);
+
 			message_dbus_unregister(m);
 		}
+
+		if (entry->compact)
+			sms_message_changed(sms, &entry->uuid, tx_state);
 	}
 
 done:
+	if (entry->batch)
+		sms_batch_entry_done(entry->batch,
+					tx_state == MESSAGE_STATE_SENT);
+
 	tx_queue_entry_destroy(entry);
 }
 
+/*
+ * The next PDU is handed to the driver straight from the completion of
+ * the previous one, keeping the modem busy without a main loop round
+ * trip in between.  Completions reported from within the submit call
+ * itself still go through the main loop to bound the recursion.
+ */
+static void tx_schedule_next(struct ofono_sms *sms)
+{
+	if (sms->flags & MESSAGE_MANAGER_FLAG_TXQ_SUBMITTING) {
+		sms->tx_source = g_timeout_add(0, tx_next, sms);
+		return;
+	}
+
+	tx_next(sms);
+}
+
 static void tx_finished(const struct ofono_error *error, int mr, void *data)
 {
 	struct ofono_sms *sms = data;
@@ -712,7 +1026,8 @@ static void tx_finished(const struct ofono_error *error, int mr, void *data)
 		goto next_q;
 	}
 
-	if (entry->flags & OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS)
+	if ((entry->flags & OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS) &&
+			!entry->backup_pending)
 		sms_tx_backup_remove(sms->imsi, entry->id, entry->flags,
 						ofono_uuid_to_str(&entry->uuid),
 						entry->cur_pdu);
@@ -728,7 +1043,7 @@ static void tx_finished(const struct ofono_error *error, int mr, void *data)
 							entry->num_pdus);
 
 	if (entry->cur_pdu < entry->num_pdus) {
-		sms->tx_source = g_timeout_add(0, tx_next, sms);
+		tx_schedule_next(sms);
 		return;
 	}
 
@@ -743,7 +1058,7 @@ next_q:
 
 	if (g_queue_peek_head(sms->txq)) {
 		DBG("Scheduling next");
-		sms->tx_source = g_timeout_add(0, tx_next, sms);
+		tx_schedule_next(sms);
 	}
 }
 
@@ -753,6 +1068,8 @@ static gboolean tx_next(gpointer user_data)
 	int send_mms = 0;
 	struct tx_queue_entry *entry = g_queue_peek_head(sms->txq);
 	struct pending_pdu *pdu = &entry->pdus[entry->cur_pdu];
+	unsigned int remaining = 0;
+	GList *l;
 
 	DBG("tx_next: %p", entry);
 
@@ -761,15 +1078,32 @@ static gboolean tx_next(gpointer user_data)
 	if (sms->registered == FALSE)
 		return FALSE;
 
-	if (g_queue_get_length(sms->txq) > 1
-			|| (entry->num_pdus - entry->cur_pdu) > 1)
+	/* Count the PDUs following this one, we only care up to two */
+	for (l = g_queue_peek_head_link(sms->txq); l && remaining < 3;
+								l = l->next) {
+		struct tx_queue_entry *e = l->data;
+
+		remaining += e->num_pdus - e->cur_pdu;
+	}
+
+	/*
+	 * Values follow 27.005 +CMMS: keep the link up for the whole burst
+	 * while more than one PDU follows, drop back to the self-expiring
+	 * mode for the last but one.
+	 */
+	if (remaining > 2)
+		send_mms = 2;
+	else if (remaining == 2)
 		send_mms = 1;
 
 	sms->flags |= MESSAGE_MANAGER_FLAG_TXQ_ACTIVE;
+	sms->flags |= MESSAGE_MANAGER_FLAG_TXQ_SUBMITTING;
 
 	sms->driver->submit(sms, pdu->pdu, pdu->pdu_len, pdu->tpdu_len,
 				send_mms, tx_finished, sms);
 
+	sms->flags &= ~MESSAGE_MANAGER_FLAG_TXQ_SUBMITTING;
+
 	return FALSE;
 }
 
@@ -1000,6 +1334,246 @@ static DBusMessage *sms_send_message(DBusConnection *conn, DBusMessage *msg,
 	return NULL;
 }
 
+static void sms_batch_prepared_free(GSList *prepared)
+{
+	GSList *l;
+
+	for (l = prepared; l; l = l->next)
+		g_slist_free_full(l->data, g_free);
+
+	g_slist_free(prepared);
+}
+
+/*
+ * Queue a batch of text messages [D-Bus SendMessages() and
+ * SendMessagesCompact()]
+ *
+ * All messages are validated and segmented before any of them is
+ * queued, so a malformed entry rejects the whole batch.  Segmentation
+ * uses the current concatenation reference, which sms_txq_submit()
+ * bumps after every queued multi-part message, so later multi-part
+ * messages are segmented again with the reference they are queued with.
+ */
+static DBusMessage *sms_queue_batch(struct ofono_sms *sms, DBusMessage *msg,
+					gboolean compact)
+{
+	struct ofono_modem *modem = __ofono_atom_get_modem(sms->atom);
+	DBusMessageIter iter;
+	DBusMessageIter array;
+	DBusMessageIter reply_iter;
+	DBusMessageIter paths;
+	DBusMessage *reply;
+	struct sms_batch *batch;
+	GSList *prepared = NULL;
+	GSList *texts = NULL;
+	GSList *l;
+	GSList *t;
+	unsigned int count = 0;
+	unsigned int flags;
+	guint ref = sms->ref;
+	const char *fail_path = "/";
+
+	if (!dbus_message_iter_init(msg, &iter))
+		return __ofono_error_invalid_args(msg);
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY ||
+			dbus_message_iter_get_element_type(&iter) !=
+							DBUS_TYPE_STRUCT)
+		return __ofono_error_invalid_args(msg);
+
+	dbus_message_iter_recurse(&iter, &array);
+
+	while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRUCT) {
+		DBusMessageIter entry;
+		const char *to;
+		const char *text;
+		GSList *msg_list;
+
+		if (++count > SMS_BATCH_MAX)
+			goto invalid_args;
+
+		dbus_message_iter_recurse(&array, &entry);
+
+		if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_STRING)
+			goto invalid_args;
+
+		dbus_message_iter_get_basic(&entry, &to);
+		dbus_message_iter_next(&entry);
+
+		if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_STRING)
+			goto invalid_args;
+
+		dbus_message_iter_get_basic(&entry, &text);
+
+		if (valid_phone_number_format(to) == FALSE)
+			goto invalid_format;
+
+		msg_list = sms_text_prepare_with_alphabet(to, text, ref, FALSE,
+						sms->use_delivery_reports,
+						sms->alphabet);
+		if (msg_list == NULL)
+			goto invalid_format;
+
+		prepared = g_slist_prepend(prepared, msg_list);
+		texts = g_slist_prepend(texts, (char *) text);
+
+		dbus_message_iter_next(&array);
+	}
+
+	if (prepared == NULL)
+		return __ofono_error_invalid_args(msg);
+
+	prepared = g_slist_reverse(prepared);
+	texts = g_slist_reverse(texts);
+
+	batch = g_try_new0(struct sms_batch, 1);
+	if (batch == NULL)
+		goto failed;
+
+	batch->sms = sms;
+	batch->id = ++sms->next_batch_id;
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL) {
+		g_free(batch);
+		goto failed;
+	}
+
+	dbus_message_iter_init_append(reply, &reply_iter);
+	dbus_message_iter_append_basic(&reply_iter, DBUS_TYPE_UINT32,
+					&batch->id);
+	dbus_message_iter_open_container(&reply_iter, DBUS_TYPE_ARRAY,
+					DBUS_TYPE_OBJECT_PATH_AS_STRING,
+					&paths);
+
+	flags = OFONO_SMS_SUBMIT_FLAG_RECORD_HISTORY;
+	flags |= OFONO_SMS_SUBMIT_FLAG_RETRY;
+	flags |= OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS;
+	if (sms->use_delivery_reports)
+		flags |= OFONO_SMS_SUBMIT_FLAG_REQUEST_SR;
+	if (compact)
+		flags |= OFONO_SMS_SUBMIT_FLAG_COMPACT;
+
+	/* Count up front, nothing completes before we return */
+	batch->total = count;
+
+	for (l = prepared, t = texts; l; l = l->next, t = t->next) {
+		GSList *msg_list = l->data;
+		struct sms *head = msg_list->data;
+		struct ofono_uuid uuid;
+		const char *path;
+
+		/* Re-segment if the reference moved on since validation */
+		if (msg_list->next != NULL && ref != sms->ref) {
+			msg_list = sms_text_prepare_with_alphabet(
+				sms_address_to_string(&head->submit.daddr),
+				t->data, sms->ref, FALSE,
+				sms->use_delivery_reports, sms->alphabet);
+
+			if (msg_list != NULL) {
+				g_slist_free_full(l->data, g_free);
+				l->data = msg_list;
+				head = msg_list->data;
+			}
+		}
+
+		/* Failed entries keep their slot, with "/" as the path */
+		if (msg_list == NULL || sms_txq_submit(sms, msg_list, flags,
+						batch, &uuid, NULL, NULL) < 0) {
+			batch->failed += 1;
+			dbus_message_iter_append_basic(&paths,
+							DBUS_TYPE_OBJECT_PATH,
+							&fail_path);
+			continue;
+		}
+
+		path = __ofono_sms_message_path_from_uuid(sms, &uuid);
+		dbus_message_iter_append_basic(&paths, DBUS_TYPE_OBJECT_PATH,
+						&path);
+
+		__ofono_history_sms_send_pending(modem, &uuid,
+				sms_address_to_string(&head->submit.daddr),
+				time(NULL), t->data);
+	}
+
+	dbus_message_iter_close_container(&reply_iter, &paths);
+
+	sms_batch_prepared_free(prepared);
+	g_slist_free(texts);
+
+	if (batch->failed == batch->total) {
+		g_free(batch);
+		dbus_message_unref(reply);
+		return __ofono_error_failed(msg);
+	}
+
+	sms->batches = g_slist_prepend(sms->batches, batch);
+
+	return reply;
+
+invalid_args:
+	sms_batch_prepared_free(prepared);
+	g_slist_free(texts);
+	return __ofono_error_invalid_args(msg);
+
+invalid_format:
+	sms_batch_prepared_free(prepared);
+	g_slist_free(texts);
+	return __ofono_error_invalid_format(msg);
+
+failed:
+	sms_batch_prepared_free(prepared);
+	g_slist_free(texts);
+	return __ofono_error_failed(msg);
+}
+
+static DBusMessage *sms_send_messages(DBusConnection *conn, DBusMessage *msg,
+					void *data)
+{
+	return sms_queue_batch(data, msg, FALSE);
+}
+
+static DBusMessage *sms_send_messages_compact(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	return sms_queue_batch(data, msg, TRUE);
+}
+
+/*
+ * Appends up to @count pending messages in queue order, skipping the
+ * first @offset ones.  Only messages exposed via D-Bus are counted, and
+ * with @registered_only set only those with a Message object.
+ */
+static void sms_append_messages(struct ofono_sms *sms, DBusMessageIter *array,
+				unsigned int offset, unsigned int count,
+				gboolean registered_only)
+{
+	GList *l;
+
+	for (l = g_queue_peek_head_link(sms->txq); l && count; l = l->next) {
+		struct tx_queue_entry *entry = l->data;
+		struct message *m;
+		const char *path;
+
+		if (!(entry->flags & OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS))
+			continue;
+
+		m = g_hash_table_lookup(sms->messages, &entry->uuid);
+		if (m == NULL && registered_only)
+			continue;
+
+		if (offset > 0) {
+			offset -= 1;
+			continue;
+		}
+
+		/* Messages without an object are pending while queued */
+		path = __ofono_sms_message_path_from_uuid(sms, &entry->uuid);
+		sms_append_message(array, path, m, MESSAGE_STATE_PENDING);
+		count -= 1;
+	}
+}
+
 static DBusMessage *sms_get_messages(DBusConnection *conn, DBusMessage *msg,
 					void *data)
 {
@@ -1007,12 +1581,6 @@ static DBusMessage *sms_get_messages(DBusConnection *conn, DBusMessage *msg,
 	DBusMessage *reply;
 	DBusMessageIter iter;
 	DBusMessageIter array;
-	DBusMessageIter entry, dict;
-	const char *path;
-	GHashTableIter hashiter;
-	gpointer key, value;
-	struct message *m;
-	const struct ofono_uuid *uuid;
 
 	reply = dbus_message_new_method_return(msg);
 	if (reply == NULL)
@@ -1021,37 +1589,42 @@ static DBusMessage *sms_get_messages(DBusConnection *conn, DBusMessage *msg,
 	dbus_message_iter_init_append(reply, &iter);
 
 	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
-					DBUS_STRUCT_BEGIN_CHAR_AS_STRING
-					DBUS_TYPE_OBJECT_PATH_AS_STRING
-					DBUS_TYPE_ARRAY_AS_STRING
-					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
-					DBUS_TYPE_STRING_AS_STRING
-					DBUS_TYPE_VARIANT_AS_STRING
-					DBUS_DICT_ENTRY_END_CHAR_AS_STRING
-					DBUS_STRUCT_END_CHAR_AS_STRING,
-					&array);
-
-	g_hash_table_iter_init(&hashiter, sms->messages);
-
-	while (g_hash_table_iter_next(&hashiter, &key, &value)) {
-		m = value;
-		uuid = message_get_uuid(m);
-
-		path = __ofono_sms_message_path_from_uuid(sms, uuid);
-
-		dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT,
-							NULL, &entry);
-		dbus_message_iter_append_basic(&entry, DBUS_TYPE_OBJECT_PATH,
-						&path);
-		dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY,
-					OFONO_PROPERTIES_ARRAY_SIGNATURE,
-					&dict);
+					MESSAGE_ENTRY_SIGNATURE, &array);
+	sms_append_messages(sms, &array, 0, sms->num_messages, TRUE);
+	dbus_message_iter_close_container(&iter, &array);
 
-		message_append_properties(m, &dict);
-		dbus_message_iter_close_container(&entry, &dict);
-		dbus_message_iter_close_container(&array, &entry);
-	}
+	return reply;
+}
+
+static DBusMessage *sms_get_messages_paged(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	struct ofono_sms *sms = data;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter array;
+	dbus_uint32_t offset;
+	dbus_uint32_t count;
 
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_UINT32, &offset,
+					DBUS_TYPE_UINT32, &count,
+					DBUS_TYPE_INVALID))
+		return __ofono_error_invalid_args(msg);
+
+	if (count == 0 || count > SMS_MESSAGES_PAGE_MAX)
+		return __ofono_error_invalid_args(msg);
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32,
+					&sms->num_messages);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					MESSAGE_ENTRY_SIGNATURE, &array);
+	sms_append_messages(sms, &array, offset, count, FALSE);
 	dbus_message_iter_close_container(&iter, &array);
 
 	return reply;
@@ -1065,6 +1638,66 @@ static gint entry_compare_by_uuid(gconstpointer a, gconstpointer b)
 	return memcmp(&entry->uuid, uuid, sizeof(entry->uuid));
 }
 
+/*
+ * Registers the Message object of a pending message on request, for
+ * clients that want to track or cancel a message queued with
+ * SendMessagesCompact() individually.  The object goes away once the
+ * message reaches a final state, like any other Message object.
+ */
+static DBusMessage *sms_expose_message(DBusConnection *conn, DBusMessage *msg,
+					void *data)
+{
+	struct ofono_sms *sms = data;
+	const char *atompath = __ofono_atom_get_path(sms->atom);
+	size_t len = strlen(atompath);
+	struct tx_queue_entry *entry;
+	struct ofono_uuid uuid;
+	struct message *m;
+	const char *path;
+	long written;
+	GList *l;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
+					DBUS_TYPE_INVALID))
+		return __ofono_error_invalid_args(msg);
+
+	if (strncmp(path, atompath, len) ||
+			strncmp(path + len, "/message_", 9))
+		return __ofono_error_not_found(msg);
+
+	path += len + 9;
+
+	if (strlen(path) != OFONO_SHA1_UUID_LEN * 2)
+		return __ofono_error_not_found(msg);
+
+	if (decode_hex_own_buf(path, -1, &written, 0, uuid.uuid) == NULL)
+		return __ofono_error_not_found(msg);
+
+	l = g_queue_find_custom(sms->txq, &uuid, entry_compare_by_uuid);
+	if (l == NULL)
+		return __ofono_error_not_found(msg);
+
+	entry = l->data;
+
+	if (!(entry->flags & OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS))
+		return __ofono_error_not_found(msg);
+
+	if (g_hash_table_lookup(sms->messages, &entry->uuid))
+		return dbus_message_new_method_return(msg);
+
+	m = message_create(&entry->uuid, sms->atom);
+	if (m == NULL)
+		return __ofono_error_failed(msg);
+
+	if (message_dbus_register(m) == FALSE)
+		return __ofono_error_failed(msg);
+
+	message_set_data(m, entry);
+	g_hash_table_insert(sms->messages, &entry->uuid, m);
+
+	return dbus_message_new_method_return(msg);
+}
+
 int __ofono_sms_txq_cancel(struct ofono_sms *sms, const struct ofono_uuid *uuid)
 {
 	GList *l;
@@ -1117,9 +1750,25 @@ static const GDBusMethodTable sms_manager_methods[] = {
 			GDBUS_ARGS({ "to", "s" }, { "text", "s" }),
 			GDBUS_ARGS({ "path", "o" }),
 			sms_send_message) },
+	{ GDBUS_METHOD("SendMessages",
+			GDBUS_ARGS({ "messages", "a(ss)" }),
+			GDBUS_ARGS({ "batch", "u" }, { "paths", "ao" }),
+			sms_send_messages) },
+	{ GDBUS_METHOD("SendMessagesCompact",
+			GDBUS_ARGS({ "messages", "a(ss)" }),
+			GDBUS_ARGS({ "batch", "u" }, { "paths", "ao" }),
+			sms_send_messages_compact) },
 	{ GDBUS_METHOD("GetMessages",
 			NULL, GDBUS_ARGS({ "messages", "a(oa{sv})" }),
 			sms_get_messages) },
+	{ GDBUS_METHOD("GetMessagesPaged",
+			GDBUS_ARGS({ "offset", "u" }, { "count", "u" }),
+			GDBUS_ARGS({ "total", "u" },
+					{ "messages", "a(oa{sv})" }),
+			sms_get_messages_paged) },
+	{ GDBUS_METHOD("ExposeMessage",
+			GDBUS_ARGS({ "path", "o" }), NULL,
+			sms_expose_message) },
 	{ }
 };
 
@@ -1135,6 +1784,10 @@ static const GDBusSignalTable sms_manager_signals[] = {
 						{ "properties", "a{sv}" })) },
 	{ GDBUS_SIGNAL("MessageRemoved",
 			GDBUS_ARGS({ "path", "o" })) },
+	{ GDBUS_SIGNAL("BatchProgress",
+			GDBUS_ARGS({ "batch", "u" }, { "info", "a{sv}" })) },
+	{ GDBUS_SIGNAL("MessagesChanged",
+			GDBUS_ARGS({ "messages", "a(oa{sv})" })) },
 	{ }
 };
 
@@ -1677,6 +2330,13 @@ static void sms_unregister(struct ofono_atom *atom)
 					OFONO_MESSAGE_MANAGER_INTERFACE);
 	ofono_modem_remove_interface(modem, OFONO_MESSAGE_MANAGER_INTERFACE);
 
+	if (sms->changes_source) {
+		g_source_remove(sms->changes_source);
+		sms->changes_source = 0;
+	}
+
+	g_array_set_size(sms->changes, 0);
+
 	if (sms->mw_watch) {
 		__ofono_modem_remove_atom_watch(modem, sms->mw_watch);
 		sms->mw_watch = 0;
@@ -1736,6 +2396,23 @@ static void sms_remove(struct ofono_atom *atom)
 		sms->tx_source = 0;
 	}
 
+	/* Whatever is still queued has to survive until the next start */
+	if (sms->tx_backup_source) {
+		g_source_remove(sms->tx_backup_source);
+		tx_backup_flush(sms);
+	}
+
+	g_slist_free_full(sms->batches, (GDestroyNotify) sms_batch_free);
+	sms->batches = NULL;
+
+	if (sms->changes_source) {
+		g_source_remove(sms->changes_source);
+		sms->changes_source = 0;
+	}
+
+	g_array_free(sms->changes, TRUE);
+	sms->changes = NULL;
+
 	if (sms->assembly) {
 		sms_assembly_free(sms->assembly);
 		sms->assembly = NULL;
@@ -1804,6 +2481,7 @@ struct ofono_sms *ofono_sms_create(struct ofono_modem *modem,
 	sms->ref = 1;
 	sms->txq = g_queue_new();
 	sms->messages = g_hash_table_new(uuid_hash, uuid_equal);
+	sms->changes = g_array_new(FALSE, FALSE, sizeof(struct message_change));
 
 	sms->atom = __ofono_modem_add_atom(modem, OFONO_ATOM_TYPE_SMS,
 						sms_remove, sms);
@@ -1926,6 +2604,11 @@ static void sms_restore_tx_queue(struct ofono_sms *sms)
 		memcpy(&txq_entry->uuid.uuid, &backup_entry->uuid,
 								SMS_MSGID_LEN);
 
+		if (txq_entry->flags & OFONO_SMS_SUBMIT_FLAG_COMPACT) {
+			txq_entry->compact = TRUE;
+			goto push;
+		}
+
 		m = message_create(&txq_entry->uuid, sms->atom);
 		if (m == NULL) {
 			tx_queue_entry_destroy(txq_entry);
@@ -1942,8 +2625,10 @@ static void sms_restore_tx_queue(struct ofono_sms *sms)
 		message_set_data(m, txq_entry);
 		g_hash_table_insert(sms->messages, &txq_entry->uuid, m);
 
+push:
 		txq_entry->id = sms->tx_counter++;
 		g_queue_push_tail(sms->txq, txq_entry);
+		sms->num_messages += 1;
 
 loop_out:
 		g_slist_foreach(backup_entry->msg_list, (GFunc)g_free, NULL);
@@ -2045,8 +2730,8 @@ unsigned short __ofono_sms_get_next_ref(struct ofono_sms *sms)
 	return sms->ref;
 }
 
-int __ofono_sms_txq_submit(struct ofono_sms *sms, GSList *list,
-				unsigned int flags,
+static int sms_txq_submit(struct ofono_sms *sms, GSList *list,
+				unsigned int flags, struct sms_batch *batch,
 				struct ofono_uuid *uuid,
 				ofono_sms_txq_queued_cb_t cb, void *data)
 {
@@ -2057,7 +2742,12 @@ int __ofono_sms_txq_submit(struct ofono_sms *sms, GSList *list,
 	if (entry == NULL)
 		return -ENOMEM;
 
-	if (flags & OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS) {
+	entry->batch = batch;
+
+	if ((flags & OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS) &&
+			(flags & OFONO_SMS_SUBMIT_FLAG_COMPACT))
+		entry->compact = TRUE;
+	else if (flags & OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS) {
 		m = message_create(&entry->uuid, sms->atom);
 		if (m == NULL)
 			goto err;
@@ -2088,27 +2778,17 @@ int __ofono_sms_txq_submit(struct ofono_sms *sms, GSList *list,
 		memcpy(uuid, &entry->uuid, sizeof(*uuid));
 
 	if (flags & OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS) {
-		const char *uuid_str;
-		unsigned char i;
-
-		uuid_str = ofono_uuid_to_str(&entry->uuid);
-
-		for (i = 0; i < entry->num_pdus; i++) {
-			struct pending_pdu *pdu;
-
-			pdu = &entry->pdus[i];
-
-			sms_tx_backup_store(sms->imsi, entry->id, entry->flags,
-						uuid_str, i, pdu->pdu,
-						pdu->pdu_len, pdu->tpdu_len);
-		}
+		sms->num_messages += 1;
+		tx_backup_queue_entry(sms, entry);
 	}
 
 	if (cb)
 		cb(sms, &entry->uuid, data);
 
-	if (m && (flags & OFONO_SMS_SUBMIT_FLAG_EXPOSE_DBUS))
+	if (batch == NULL && m)
 		message_emit_added(m, OFONO_MESSAGE_MANAGER_INTERFACE);
+	else if (entry->compact)
+		sms_message_changed(sms, &entry->uuid, MESSAGE_STATE_PENDING);
 
 	return 0;
 
@@ -2118,6 +2798,14 @@ err:
 	return -EINVAL;
 }
 
+int __ofono_sms_txq_submit(struct ofono_sms *sms, GSList *list,
+				unsigned int flags,
+				struct ofono_uuid *uuid,
+				ofono_sms_txq_queued_cb_t cb, void *data)
+{
+	return sms_txq_submit(sms, list, flags, NULL, uuid, cb, data);
+}
+
 int __ofono_sms_txq_set_submit_notify(struct ofono_sms *sms,
 					struct ofono_uuid *uuid,
 					ofono_sms_txq_submit_cb_t cb,
@@ -4209,105 +4209,94 @@ static inline gboolean cbs_is_update_newer(unsigned int n, unsigned int o)
 	return FALSE;
 }
 
-struct cbs_assembly *cbs_assembly_new(void)
+#define CBS_SERIAL_KEY(serial) GUINT_TO_POINTER((serial) & (~0xf))
+
+static void cbs_assembly_node_free(struct cbs_assembly_node *node)
 {
-	return g_new0(struct cbs_assembly, 1);
+	g_slist_free_full(node->pages, g_free);
+	g_free(node);
 }
 
-void cbs_assembly_free(struct cbs_assembly *assembly)
+static void cbs_assembly_bucket_free(gpointer data)
 {
-	GSList *l;
-
-	for (l = assembly->assembly_list; l; l = l->next) {
-		struct cbs_assembly_node *node = l->data;
-
-		g_slist_foreach(node->pages, (GFunc) g_free, 0);
-		g_slist_free(node->pages);
-		g_free(node);
-	}
-
-	g_slist_free(assembly->assembly_list);
-	g_slist_free(assembly->recv_plmn);
-	g_slist_free(assembly->recv_loc);
-	g_slist_free(assembly->recv_cell);
-
-	g_free(assembly);
+	g_slist_free_full(data, (GDestroyNotify) cbs_assembly_node_free);
 }
 
-static gint cbs_compare_node_by_gs(gconstpointer a, gconstpointer b)
+struct cbs_assembly *cbs_assembly_new(void)
 {
-	const struct cbs_assembly_node *node = a;
-	unsigned int gs = GPOINTER_TO_UINT(b);
+	struct cbs_assembly *assembly = g_new0(struct cbs_assembly, 1);
 
-	if (((node->serial >> 14) & 0x3) == gs)
-		return 0;
+	assembly->assembly_index = g_hash_table_new_full(g_direct_hash,
+						g_direct_equal, NULL,
+						cbs_assembly_bucket_free);
+	assembly->recv_plmn = g_hash_table_new(g_direct_hash, g_direct_equal);
+	assembly->recv_loc = g_hash_table_new(g_direct_hash, g_direct_equal);
+	assembly->recv_cell = g_hash_table_new(g_direct_hash, g_direct_equal);
 
-	return 1;
+	return assembly;
 }
 
-static gint cbs_compare_node_by_update(gconstpointer a, gconstpointer b)
+void cbs_assembly_free(struct cbs_assembly *assembly)
 {
-	const struct cbs_assembly_node *node = a;
-	unsigned int serial = GPOINTER_TO_UINT(b);
-
-	if ((serial & (~0xf)) != (node->serial & (~0xf)))
-		return 1;
-
-	if (cbs_is_update_newer(node->serial, serial))
-		return 1;
+	g_hash_table_destroy(assembly->assembly_index);
+	g_hash_table_destroy(assembly->recv_plmn);
+	g_hash_table_destroy(assembly->recv_loc);
+	g_hash_table_destroy(assembly->recv_cell);
 
-	return 0;
+	g_free(assembly);
 }
 
-static gint cbs_compare_recv_by_serial(gconstpointer a, gconstpointer b)
+static gboolean cbs_expire_bucket_by_gs(gpointer key, gpointer value,
+					gpointer user_data)
 {
-	unsigned int old_serial = GPOINTER_TO_UINT(a);
-	unsigned int new_serial = GPOINTER_TO_UINT(b);
+	unsigned int serial = GPOINTER_TO_UINT(key);
+	unsigned int gs = GPOINTER_TO_UINT(user_data);
 
-	if ((old_serial & (~0xf)) == (new_serial & (~0xf)))
-		return 0;
+	/* All nodes in a bucket share the geographical scope */
+	return ((serial >> 14) & 0x3) == gs;
+}
 
-	return 1;
+static void cbs_assembly_expire_gs(struct cbs_assembly *assembly,
+					unsigned int gs)
+{
+	g_hash_table_foreach_remove(assembly->assembly_index,
+					cbs_expire_bucket_by_gs,
+					GUINT_TO_POINTER(gs));
 }
 
-static void cbs_assembly_expire(struct cbs_assembly *assembly,
-				GCompareFunc func, gconstpointer *userdata)
+/*
+ * Take care of the case where several updates are being reassembled at
+ * the same time.  If the newer one is assembled first, then the
+ * subsequent old update is discarded, make sure that we're also
+ * discarding the assembly node for the partially assembled ones
+ */
+static void cbs_assembly_expire_updates(struct cbs_assembly *assembly,
+					unsigned int serial)
 {
+	GSList *bucket;
 	GSList *l;
-	GSList *prev;
-	GSList *tmp;
+	GSList *next;
 
-	/*
-	 * Take care of the case where several updates are being
-	 * reassembled at the same time. If the newer one is assembled
-	 * first, then the subsequent old update is discarded, make
-	 * sure that we're also discarding the assembly node for the
-	 * partially assembled ones
-	 */
-	prev = NULL;
-	l = assembly->assembly_list;
+	bucket = g_hash_table_lookup(assembly->assembly_index,
+					CBS_SERIAL_KEY(serial));
 
-	while (l) {
+	for (l = bucket; l; l = next) {
 		struct cbs_assembly_node *node = l->data;
 
-		if (func(node, userdata) != 0) {
-			prev = l;
-			l = l->next;
-			continue;
-		}
+		next = l->next;
 
-		if (prev)
-			prev->next = l->next;
-		else
-			assembly->assembly_list = l->next;
+		if (cbs_is_update_newer(node->serial, serial))
+			continue;
 
-		g_slist_foreach(node->pages, (GFunc) g_free, NULL);
-		g_slist_free(node->pages);
-		g_free(node->pages);
-		tmp = l;
-		l = l->next;
-		g_slist_free_1(tmp);
+		cbs_assembly_node_free(node);
+		bucket = g_slist_delete_link(bucket, l);
 	}
+
+	g_hash_table_steal(assembly->assembly_index, CBS_SERIAL_KEY(serial));
+
+	if (bucket)
+		g_hash_table_insert(assembly->assembly_index,
+					CBS_SERIAL_KEY(serial), bucket);
 }
 
 void cbs_assembly_location_changed(struct cbs_assembly *assembly, gboolean plmn,
@@ -4324,36 +4313,30 @@ void cbs_assembly_location_changed(struct cbs_assembly *assembly, gboolean plmn,
 	 * next cell according to whether the next cell is in the same Service
 	 * Area as the current cell)
 	 *
-	 * NOTE 4: According to 3GPP TS 23.003 [2] a Service Area consists of
+	 * NOTE 4: According to 3GPP TS 23.003 [2] a Service Area consists of
 	 * one cell only.
 	 */
 
 	if (plmn) {
 		lac = TRUE;
-		g_slist_free(assembly->recv_plmn);
-		assembly->recv_plmn = NULL;
+		g_hash_table_remove_all(assembly->recv_plmn);
 
-		cbs_assembly_expire(assembly, cbs_compare_node_by_gs,
-				GUINT_TO_POINTER(CBS_GEO_SCOPE_PLMN));
+		cbs_assembly_expire_gs(assembly, CBS_GEO_SCOPE_PLMN);
 	}
 
 	if (lac) {
 		/* If LAC changed, then cell id has changed */
 		ci = TRUE;
-		g_slist_free(assembly->recv_loc);
-		assembly->recv_loc = NULL;
+		g_hash_table_remove_all(assembly->recv_loc);
 
-		cbs_assembly_expire(assembly, cbs_compare_node_by_gs,
-				GUINT_TO_POINTER(CBS_GEO_SCOPE_SERVICE_AREA));
+		cbs_assembly_expire_gs(assembly, CBS_GEO_SCOPE_SERVICE_AREA);
 	}
 
 	if (ci) {
-		g_slist_free(assembly->recv_cell);
-		assembly->recv_cell = NULL;
-		cbs_assembly_expire(assembly, cbs_compare_node_by_gs,
-				GUINT_TO_POINTER(CBS_GEO_SCOPE_CELL_IMMEDIATE));
-		cbs_assembly_expire(assembly, cbs_compare_node_by_gs,
-				GUINT_TO_POINTER(CBS_GEO_SCOPE_CELL_NORMAL));
+		g_hash_table_remove_all(assembly->recv_cell);
+
+		cbs_assembly_expire_gs(assembly, CBS_GEO_SCOPE_CELL_IMMEDIATE);
+		cbs_assembly_expire_gs(assembly, CBS_GEO_SCOPE_CELL_NORMAL);
 	}
 }
 
@@ -4364,10 +4347,12 @@ GSList *cbs_assembly_add_page(struct cbs_assembly *assembly,
 	struct cbs_assembly_node *node;
 	GSList *completed;
 	unsigned int new_serial;
-	GSList **recv;
+	GHashTable *recv;
+	gpointer old_serial;
+	GSList *bucket;
 	GSList *l;
-	GSList *prev;
 	int position;
+	int j;
 
 	new_serial = cbs->gs << 14;
 	new_serial |= cbs->message_code << 4;
@@ -4375,27 +4360,23 @@ GSList *cbs_assembly_add_page(struct cbs_assembly *assembly,
 	new_serial |= cbs->message_identifier << 16;
 
 	if (cbs->gs == CBS_GEO_SCOPE_PLMN)
-		recv = &assembly->recv_plmn;
+		recv = assembly->recv_plmn;
 	else if (cbs->gs == CBS_GEO_SCOPE_SERVICE_AREA)
-		recv = &assembly->recv_loc;
+		recv = assembly->recv_loc;
 	else
-		recv = &assembly->recv_cell;
-
-	/* Have we seen this message before? */
-	l = g_slist_find_custom(*recv, GUINT_TO_POINTER(new_serial),
-				cbs_compare_recv_by_serial);
+		recv = assembly->recv_cell;
 
-	/* If we have, is the message newer? */
-	if (l && !cbs_is_update_newer(new_serial, GPOINTER_TO_UINT(l->data)))
+	/* Have we seen this message before?  If we have, is it newer? */
+	if (g_hash_table_lookup_extended(recv, CBS_SERIAL_KEY(new_serial),
+						NULL, &old_serial) &&
+			!cbs_is_update_newer(new_serial,
+					GPOINTER_TO_UINT(old_serial)))
 		return NULL;
 
 	/* Easy case first, page 1 of 1 */
 	if (cbs->max_pages == 1 && cbs->page == 1) {
-		if (l)
-			l->data = GUINT_TO_POINTER(new_serial);
-		else
-			*recv = g_slist_prepend(*recv,
-						GUINT_TO_POINTER(new_serial));
+		g_hash_table_insert(recv, CBS_SERIAL_KEY(new_serial),
+					GUINT_TO_POINTER(new_serial));
 
 		newcbs = g_new(struct cbs, 1);
 		memcpy(newcbs, cbs, sizeof(struct cbs));
@@ -4404,37 +4385,36 @@ GSList *cbs_assembly_add_page(struct cbs_assembly *assembly,
 		return completed;
 	}
 
-	prev = NULL;
-	position = 0;
+	bucket = g_hash_table_lookup(assembly->assembly_index,
+					CBS_SERIAL_KEY(new_serial));
 
-	for (l = assembly->assembly_list; l; prev = l, l = l->next) {
-		int j;
+	for (l = bucket; l; l = l->next) {
 		node = l->data;
 
-		if (new_serial != node->serial)
-			continue;
-
-		if (node->bitmap & (1 << cbs->page))
-			return NULL;
+		if (new_serial == node->serial)
+			break;
+	}
 
-		for (j = 1; j < cbs->page; j++)
-			if (node->bitmap & (1 << j))
-				position += 1;
+	if (l == NULL) {
+		node = g_new0(struct cbs_assembly_node, 1);
+		node->serial = new_serial;
 
-		goto out;
+		g_hash_table_steal(assembly->assembly_index,
+					CBS_SERIAL_KEY(new_serial));
+		bucket = g_slist_prepend(bucket, node);
+		g_hash_table_insert(assembly->assembly_index,
+					CBS_SERIAL_KEY(new_serial), bucket);
 	}
 
-	node = g_new0(struct cbs_assembly_node, 1);
-	node->serial = new_serial;
-
-	assembly->assembly_list = g_slist_prepend(assembly->assembly_list,
-							node);
+	if (node->bitmap & (1 << cbs->page))
+		return NULL;
 
-	prev = NULL;
-	l = assembly->assembly_list;
 	position = 0;
 
-out:
+	for (j = 1; j < cbs->page; j++)
+		if (node->bitmap & (1 << j))
+			position += 1;
+
 	newcbs = g_new(struct cbs, 1);
 	memcpy(newcbs, cbs, sizeof(struct cbs));
 	node->pages = g_slist_insert(node->pages, newcbs, position);
@@ -4443,19 +4423,13 @@ out:
 	if (g_slist_length(node->pages) < cbs->max_pages)
 		return NULL;
 
+	/* Hand the pages over and let the expiry below drop the node */
 	completed = node->pages;
+	node->pages = NULL;
 
-	if (prev)
-		prev->next = l->next;
-	else
-		assembly->assembly_list = l->next;
-
-	g_free(node);
-	g_slist_free_1(l);
-
-	cbs_assembly_expire(assembly, cbs_compare_node_by_update,
+	cbs_assembly_expire_updates(assembly, new_serial);
+	g_hash_table_insert(recv, CBS_SERIAL_KEY(new_serial),
 				GUINT_TO_POINTER(new_serial));
-	*recv = g_slist_prepend(*recv, GUINT_TO_POINTER(new_serial));
 
 	return completed;
 }
@@ -4701,6 +4675,87 @@ gboolean cbs_topic_in_range(unsigned int topic, GSList *ranges)
 					cbs_topic_compare) != NULL;
 }
 
+static int cbs_topic_range_compare(const void *a, const void *b)
+{
+	const struct cbs_topic_range *ra = a;
+	const struct cbs_topic_range *rb = b;
+
+	return (int) ra->min - (int) rb->min;
+}
+
+struct cbs_topic_index *cbs_topic_index_new(GSList *ranges)
+{
+	struct cbs_topic_index *index = g_new0(struct cbs_topic_index, 1);
+	unsigned int n = g_slist_length(ranges);
+	unsigned int i;
+	GSList *l;
+
+	if (n == 0)
+		return index;
+
+	index->ranges = g_new(struct cbs_topic_range, n);
+
+	for (l = ranges, i = 0; l; l = l->next, i++)
+		index->ranges[i] = *(struct cbs_topic_range *) l->data;
+
+	qsort(index->ranges, n, sizeof(struct cbs_topic_range),
+		cbs_topic_range_compare);
+
+	/* Merge overlapping and adjacent ranges */
+	index->len = 1;
+
+	for (i = 1; i < n; i++) {
+		struct cbs_topic_range *last = &index->ranges[index->len - 1];
+		struct cbs_topic_range *cur = &index->ranges[i];
+
+		if (cur->min <= last->max + 1) {
+			if (cur->max > last->max)
+				last->max = cur->max;
+
+			continue;
+		}
+
+		index->ranges[index->len++] = *cur;
+	}
+
+	return index;
+}
+
+void cbs_topic_index_free(struct cbs_topic_index *index)
+{
+	if (index == NULL)
+		return;
+
+	g_free(index->ranges);
+	g_free(index);
+}
+
+gboolean cbs_topic_index_contains(const struct cbs_topic_index *index,
+					unsigned int topic)
+{
+	unsigned int lo = 0;
+	unsigned int hi;
+
+	if (index == NULL)
+		return FALSE;
+
+	hi = index->len;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		const struct cbs_topic_range *range = &index->ranges[mid];
+
+		if (topic < range->min)
+			hi = mid;
+		else if (topic > range->max)
+			lo = mid + 1;
+		else
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
 char *ussd_decode(int dcs, int len, const unsigned char *data)
 {
 	gboolean udhi;
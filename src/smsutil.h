@@ -407,11 +407,17 @@ struct cbs_assembly_node {
 	GSList *pages;
 };
 
+/*
+ * Partially assembled messages are indexed by their serial number without
+ * the update number, each entry holding the list of nodes for the updates
+ * being assembled.  The received tables map the same key to the full
+ * serial number last received.
+ */
 struct cbs_assembly {
-	GSList *assembly_list;
-	GSList *recv_plmn;
-	GSList *recv_loc;
-	GSList *recv_cell;
+	GHashTable *assembly_index;
+	GHashTable *recv_plmn;
+	GHashTable *recv_loc;
+	GHashTable *recv_cell;
 };
 
 struct cbs_topic_range {
@@ -419,6 +425,12 @@ struct cbs_topic_range {
 	unsigned short max;
 };
 
+/* Sorted array of non-overlapping ranges, for fast topic lookups */
+struct cbs_topic_index {
+	unsigned int len;
+	struct cbs_topic_range *ranges;
+};
+
 struct txq_backup_entry {
 	GSList *msg_list;
 	unsigned char uuid[SMS_MSGID_LEN];
@@ -585,6 +597,11 @@ GSList *cbs_extract_topic_ranges(const char *ranges);
 GSList *cbs_optimize_ranges(GSList *ranges);
 gboolean cbs_topic_in_range(unsigned int topic, GSList *ranges);
 
+struct cbs_topic_index *cbs_topic_index_new(GSList *ranges);
+void cbs_topic_index_free(struct cbs_topic_index *index);
+gboolean cbs_topic_index_contains(const struct cbs_topic_index *index,
+					unsigned int topic);
+
 char *ussd_decode(int dcs, int len, const unsigned char *data);
 gboolean ussd_encode(const char *str, long *items_written, unsigned char *pdu);
 gboolean ussd_dcs_encode(const char *str, int *dcs,
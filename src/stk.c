@@ -41,6 +41,7 @@
 #include "smsutil.h"
 #include "stkutil.h"
 #include "stkagent.h"
+#include "timerwheel.h"
 #include "util.h"
 
 static GSList *g_drivers = NULL;
@@ -50,13 +51,39 @@ struct stk_timer {
 	time_t start;
 };
 
+/*
+ * Envelopes triggered by the user or by call and SMS control are sent
+ * ahead of proactive session housekeeping, which in turn goes ahead of
+ * data downloads from the network.
+ */
+enum envelope_priority {
+	ENVELOPE_PRIORITY_HIGH = 0,
+	ENVELOPE_PRIORITY_NORMAL,
+	ENVELOPE_PRIORITY_LOW,
+	ENVELOPE_PRIORITY_COUNT,
+};
+
+#define ENVELOPE_STATS_BUCKETS 16
+
+struct envelope_stats {
+	unsigned int sent;
+	unsigned int coalesced;
+	unsigned int depth_max;
+	unsigned int queue_time[ENVELOPE_PRIORITY_COUNT]
+					[ENVELOPE_STATS_BUCKETS];
+	unsigned int response_time[ENVELOPE_STATS_BUCKETS];
+};
+
 struct ofono_stk {
 	const struct ofono_stk_driver *driver;
 	void *driver_data;
 	struct ofono_atom *atom;
 	struct stk_command *pending_cmd;
 	void (*cancel_cmd)(struct ofono_stk *stk);
-	GQueue *envelope_q;
+	GQueue *envelope_q[ENVELOPE_PRIORITY_COUNT];
+	struct envelope_op *envelope_current;
+	struct envelope_stats envelope_stats;
+	unsigned int diag_id;
 	DBusMessage *pending;
 
 	struct stk_timer timers[8];
@@ -84,6 +111,10 @@ struct ofono_stk {
 struct envelope_op {
 	uint8_t tlv[256];
 	unsigned int tlv_len;
+	enum stk_envelope_type type;
+	enum envelope_priority priority;
+	gint64 queued;
+	gint64 sent;
 	int retries;
 	void (*cb)(struct ofono_stk *stk, gboolean ok,
 			const unsigned char *data, int length);
@@ -181,26 +212,65 @@ static void send_simple_response(struct ofono_stk *stk,
 		stk_command_cb(&error, stk);
 }
 
+static enum envelope_priority envelope_priority(enum stk_envelope_type type)
+{
+	switch (type) {
+	case STK_ENVELOPE_TYPE_MENU_SELECTION:
+	case STK_ENVELOPE_TYPE_CALL_CONTROL:
+	case STK_ENVELOPE_TYPE_MO_SMS_CONTROL:
+		return ENVELOPE_PRIORITY_HIGH;
+	case STK_ENVELOPE_TYPE_SMS_PP_DOWNLOAD:
+	case STK_ENVELOPE_TYPE_CBS_PP_DOWNLOAD:
+	case STK_ENVELOPE_TYPE_USSD_DOWNLOAD:
+	case STK_ENVELOPE_TYPE_MMS_NOTIFICATION:
+		return ENVELOPE_PRIORITY_LOW;
+	default:
+		return ENVELOPE_PRIORITY_NORMAL;
+	}
+}
+
+static unsigned int envelope_queue_depth(struct ofono_stk *stk)
+{
+	unsigned int depth = stk->envelope_current ? 1 : 0;
+	int i;
+
+	for (i = 0; i < ENVELOPE_PRIORITY_COUNT; i++)
+		depth += g_queue_get_length(stk->envelope_q[i]);
+
+	return depth;
+}
+
 static void envelope_cb(const struct ofono_error *error, const uint8_t *data,
 			int length, void *user_data)
 {
 	struct ofono_stk *stk = user_data;
-	struct envelope_op *op = g_queue_peek_head(stk->envelope_q);
+	struct envelope_op *op = stk->envelope_current;
 	gboolean result = TRUE;
 
 	DBG("length %d", length);
 
+	if (op == NULL)
+		return;
+
+	stk->envelope_current = NULL;
+	ofono_histogram_add(stk->envelope_stats.response_time,
+					ENVELOPE_STATS_BUCKETS,
+					g_get_monotonic_time() - op->sent);
+
+	/*
+	 * The UICC is busy, retry once anything more urgent queued in
+	 * the meantime has been sent
+	 */
 	if (op->retries > 0 && error->type == OFONO_ERROR_TYPE_SIM &&
 			error->error == 0x9300) {
 		op->retries--;
+		g_queue_push_head(stk->envelope_q[op->priority], op);
 		goto out;
 	}
 
 	if (error->type != OFONO_ERROR_TYPE_NO_ERROR)
 		result = FALSE;
 
-	g_queue_pop_head(stk->envelope_q);
-
 	if (op->cb)
 		op->cb(stk, result, data, length);
 
@@ -212,12 +282,58 @@ out:
 
 static void envelope_queue_run(struct ofono_stk *stk)
 {
-	if (g_queue_get_length(stk->envelope_q) > 0) {
-		struct envelope_op *op = g_queue_peek_head(stk->envelope_q);
+	struct envelope_op *op = NULL;
+	gint64 now;
+	int i;
+
+	if (stk->envelope_current)
+		return;
 
-		stk->driver->envelope(stk, op->tlv_len, op->tlv,
-					envelope_cb, stk);
+	for (i = 0; i < ENVELOPE_PRIORITY_COUNT && op == NULL; i++)
+		op = g_queue_pop_head(stk->envelope_q[i]);
+
+	if (op == NULL)
+		return;
+
+	now = g_get_monotonic_time();
+
+	/* Retries don't count as time spent waiting in the queue */
+	if (op->sent == 0)
+		ofono_histogram_add(
+			stk->envelope_stats.queue_time[op->priority],
+			ENVELOPE_STATS_BUCKETS, now - op->queued);
+
+	op->sent = now;
+	stk->envelope_stats.sent += 1;
+	stk->envelope_current = op;
+
+	stk->driver->envelope(stk, op->tlv_len, op->tlv,
+				envelope_cb, stk);
+}
+
+/*
+ * Cell Broadcast pages are repeated by the network and a page already
+ * waiting to be downloaded doesn't need to be sent to the UICC again.
+ */
+static gboolean envelope_coalesce(struct ofono_stk *stk,
+					struct envelope_op *op)
+{
+	GList *l;
+
+	if (op->type != STK_ENVELOPE_TYPE_CBS_PP_DOWNLOAD)
+		return FALSE;
+
+	for (l = stk->envelope_q[op->priority]->head; l; l = l->next) {
+		struct envelope_op *queued = l->data;
+
+		if (queued->type != op->type || queued->tlv_len != op->tlv_len)
+			continue;
+
+		if (memcmp(queued->tlv, op->tlv, op->tlv_len) == 0)
+			return TRUE;
 	}
+
+	return FALSE;
 }
 
 static int stk_send_envelope(struct ofono_stk *stk, struct stk_envelope *e,
@@ -228,6 +344,7 @@ static int stk_send_envelope(struct ofono_stk *stk, struct stk_envelope *e,
 	const uint8_t *tlv;
 	unsigned int tlv_len;
 	struct envelope_op *op;
+	unsigned int depth;
 
 	DBG("");
 
@@ -245,11 +362,24 @@ static int stk_send_envelope(struct ofono_stk *stk, struct stk_envelope *e,
 	op->retries = retries;
 	memcpy(op->tlv, tlv, tlv_len);
 	op->tlv_len = tlv_len;
+	op->type = e->type;
+	op->priority = envelope_priority(e->type);
+	op->queued = g_get_monotonic_time();
 
-	g_queue_push_tail(stk->envelope_q, op);
+	if (envelope_coalesce(stk, op)) {
+		DBG("Coalesced with a queued envelope");
+		stk->envelope_stats.coalesced += 1;
+		g_free(op);
+		return 0;
+	}
 
-	if (g_queue_get_length(stk->envelope_q) == 1)
-		envelope_queue_run(stk);
+	g_queue_push_tail(stk->envelope_q[op->priority], op);
+
+	depth = envelope_queue_depth(stk);
+	if (depth > stk->envelope_stats.depth_max)
+		stk->envelope_stats.depth_max = depth;
+
+	envelope_queue_run(stk);
 
 	return 0;
 }
@@ -1055,7 +1185,7 @@ static void timers_update(struct ofono_stk *stk)
 	int i;
 
 	if (stk->timers_source) {
-		g_source_remove(stk->timers_source);
+		timer_wheel_remove(stk->timers_source);
 		stk->timers_source = 0;
 	}
 
@@ -1092,7 +1222,8 @@ static void timers_update(struct ofono_stk *stk)
 	}
 
 	if (min)
-		stk->timers_source = g_timeout_add_seconds(min, timers_cb, stk);
+		stk->timers_source = timer_wheel_add_seconds(min, timers_cb,
+									stk);
 }
 
 static gboolean handle_command_timer_mgmt(const struct stk_command *cmd,
@@ -3137,6 +3268,7 @@ static void stk_unregister(struct ofono_atom *atom)
 	DBusConnection *conn = ofono_dbus_get_connection();
 	struct ofono_modem *modem = __ofono_atom_get_modem(atom);
 	const char *path = __ofono_atom_get_path(atom);
+	int i;
 
 	if (stk->session_agent)
 		stk_agent_free(stk->session_agent);
@@ -3154,7 +3286,7 @@ static void stk_unregister(struct ofono_atom *atom)
 	stk->idle_mode_text = NULL;
 
 	if (stk->timers_source) {
-		g_source_remove(stk->timers_source);
+		timer_wheel_remove(stk->timers_source);
 		stk->timers_source = 0;
 	}
 
@@ -3163,8 +3295,19 @@ static void stk_unregister(struct ofono_atom *atom)
 		stk->main_menu = NULL;
 	}
 
-	g_queue_foreach(stk->envelope_q, (GFunc) g_free, NULL);
-	g_queue_free(stk->envelope_q);
+	for (i = 0; i < ENVELOPE_PRIORITY_COUNT; i++) {
+		g_queue_foreach(stk->envelope_q[i], (GFunc) g_free, NULL);
+		g_queue_free(stk->envelope_q[i]);
+		stk->envelope_q[i] = NULL;
+	}
+
+	g_free(stk->envelope_current);
+	stk->envelope_current = NULL;
+
+	if (stk->diag_id) {
+		ofono_diagnostics_remove_channel(modem, stk->diag_id);
+		stk->diag_id = 0;
+	}
 
 	ofono_modem_remove_interface(modem, OFONO_STK_INTERFACE);
 	g_dbus_unregister_interface(conn, path, OFONO_STK_INTERFACE);
@@ -3220,11 +3363,49 @@ struct ofono_stk *ofono_stk_create(struct ofono_modem *modem,
 	return stk;
 }
 
+static void stk_diagnostics_append(DBusMessageIter *dict, void *user_data)
+{
+	static const char *queue_time_keys[] = {
+		"QueueTime.High", "QueueTime.Normal", "QueueTime.Low",
+	};
+	static const char *depth_keys[] = {
+		"QueueDepth.High", "QueueDepth.Normal", "QueueDepth.Low",
+	};
+	struct ofono_stk *stk = user_data;
+	struct envelope_stats *stats = &stk->envelope_stats;
+	dbus_uint32_t depth;
+	int i;
+
+	ofono_dbus_dict_append(dict, "EnvelopesSent", DBUS_TYPE_UINT32,
+					&stats->sent);
+	ofono_dbus_dict_append(dict, "EnvelopesCoalesced", DBUS_TYPE_UINT32,
+					&stats->coalesced);
+
+	depth = envelope_queue_depth(stk);
+	ofono_dbus_dict_append(dict, "QueueDepth", DBUS_TYPE_UINT32, &depth);
+	ofono_dbus_dict_append(dict, "QueueDepthMax", DBUS_TYPE_UINT32,
+					&stats->depth_max);
+
+	for (i = 0; i < ENVELOPE_PRIORITY_COUNT; i++) {
+		depth = g_queue_get_length(stk->envelope_q[i]);
+		ofono_dbus_dict_append(dict, depth_keys[i], DBUS_TYPE_UINT32,
+					&depth);
+		ofono_diagnostics_append_histogram(dict, queue_time_keys[i],
+						stats->queue_time[i],
+						ENVELOPE_STATS_BUCKETS);
+	}
+
+	ofono_diagnostics_append_histogram(dict, "ResponseTime",
+						stats->response_time,
+						ENVELOPE_STATS_BUCKETS);
+}
+
 void ofono_stk_register(struct ofono_stk *stk)
 {
 	DBusConnection *conn = ofono_dbus_get_connection();
 	struct ofono_modem *modem = __ofono_atom_get_modem(stk->atom);
 	const char *path = __ofono_atom_get_path(stk->atom);
+	int i;
 
 	if (!g_dbus_register_interface(conn, path, OFONO_STK_INTERFACE,
 					stk_methods, stk_signals, NULL,
@@ -3241,7 +3422,12 @@ void ofono_stk_register(struct ofono_stk *stk)
 
 	stk->timeout = 180; /* 3 minutes */
 	stk->short_timeout = 25; /* 25 seconds */
-	stk->envelope_q = g_queue_new();
+
+	for (i = 0; i < ENVELOPE_PRIORITY_COUNT; i++)
+		stk->envelope_q[i] = g_queue_new();
+
+	stk->diag_id = ofono_diagnostics_add_channel(modem, "STK",
+						stk_diagnostics_append, stk);
 }
 
 void ofono_stk_remove(struct ofono_stk *stk)
@@ -0,0 +1,352 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <glib.h>
+
+#include "strtable.h"
+
+/*
+ * All fields are 32 bit little endian words:
+ *
+ *	magic, version, count, pool size, stamp low, stamp high
+ *	count x (key, offset of the value in the pool)
+ *	pool
+ */
+#define STR_TABLE_MAGIC		0x4c425453	/* "STBL" */
+#define STR_TABLE_VERSION	1
+#define STR_TABLE_HEADER_WORDS	6
+
+/* Keys hold the digits in the low 24 bits and the digit count above */
+#define STR_TABLE_MAX_DIGITS	7
+
+struct str_table {
+	const guint32 *entries;
+	const char *pool;
+	guint32 count;
+	guint32 pool_size;
+	guint64 stamp;
+	void *data;
+	size_t len;
+	gboolean mapped;
+};
+
+struct str_table_builder {
+	GHashTable *entries;
+};
+
+static guint32 numeric_to_key(const char *numeric)
+{
+	guint32 value = 0;
+	unsigned int len;
+
+	for (len = 0; numeric[len]; len++) {
+		if (len == STR_TABLE_MAX_DIGITS)
+			return 0;
+
+		if (!g_ascii_isdigit(numeric[len]))
+			return 0;
+
+		value = value * 10 + numeric[len] - '0';
+	}
+
+	if (len == 0)
+		return 0;
+
+	return len << 24 | value;
+}
+
+struct str_table_builder *str_table_builder_new(void)
+{
+	struct str_table_builder *builder;
+
+	builder = g_new0(struct str_table_builder, 1);
+	builder->entries = g_hash_table_new_full(g_direct_hash,
+						g_direct_equal, NULL, g_free);
+
+	return builder;
+}
+
+/* Later additions of the same key replace the earlier ones */
+gboolean str_table_builder_add(struct str_table_builder *builder,
+				const char *numeric, const char *value)
+{
+	guint32 key = numeric_to_key(numeric);
+
+	if (key == 0)
+		return FALSE;
+
+	g_hash_table_insert(builder->entries, GUINT_TO_POINTER(key),
+							g_strdup(value));
+
+	return TRUE;
+}
+
+void str_table_builder_free(struct str_table_builder *builder)
+{
+	if (builder == NULL)
+		return;
+
+	g_hash_table_destroy(builder->entries);
+	g_free(builder);
+}
+
+static gint key_compare(gconstpointer a, gconstpointer b)
+{
+	guint32 ka = *(const guint32 *) a;
+	guint32 kb = *(const guint32 *) b;
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+static void put_word(GByteArray *out, guint32 word)
+{
+	word = GUINT32_TO_LE(word);
+	g_byte_array_append(out, (guint8 *) &word, sizeof(word));
+}
+
+/*
+ * Serializes the table and frees the builder.  Identical values share
+ * a single copy in the pool.
+ */
+unsigned char *str_table_builder_finish(struct str_table_builder *builder,
+					guint64 stamp, size_t *out_len)
+{
+	guint32 count = g_hash_table_size(builder->entries);
+	GArray *keys = g_array_sized_new(FALSE, FALSE, sizeof(guint32), count);
+	GHashTable *offsets = g_hash_table_new(g_str_hash, g_str_equal);
+	GByteArray *pool = g_byte_array_new();
+	GByteArray *out;
+	GHashTableIter iter;
+	gpointer key, value;
+	guint32 i;
+
+	g_hash_table_iter_init(&iter, builder->entries);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		guint32 k = GPOINTER_TO_UINT(key);
+
+		g_array_append_val(keys, k);
+	}
+
+	g_array_sort(keys, key_compare);
+
+	out = g_byte_array_sized_new(STR_TABLE_HEADER_WORDS * 4 + count * 8);
+
+	/* The pool size is patched in once the pool has been built */
+	put_word(out, STR_TABLE_MAGIC);
+	put_word(out, STR_TABLE_VERSION);
+	put_word(out, count);
+	put_word(out, 0);
+	put_word(out, stamp & 0xffffffff);
+	put_word(out, stamp >> 32);
+
+	for (i = 0; i < count; i++) {
+		guint32 k = g_array_index(keys, guint32, i);
+		const char *str;
+		gpointer offset;
+
+		value = g_hash_table_lookup(builder->entries,
+						GUINT_TO_POINTER(k));
+		str = value;
+
+		if (!g_hash_table_lookup_extended(offsets, str, NULL,
+								&offset)) {
+			offset = GUINT_TO_POINTER(pool->len);
+			g_hash_table_insert(offsets, (gpointer) str, offset);
+			g_byte_array_append(pool, (guint8 *) str,
+							strlen(str) + 1);
+		}
+
+		put_word(out, k);
+		put_word(out, GPOINTER_TO_UINT(offset));
+	}
+
+	((guint32 *) out->data)[3] = GUINT32_TO_LE(pool->len);
+	g_byte_array_append(out, pool->data, pool->len);
+
+	g_byte_array_free(pool, TRUE);
+	g_hash_table_destroy(offsets);
+	g_array_free(keys, TRUE);
+	str_table_builder_free(builder);
+
+	*out_len = out->len;
+
+	return g_byte_array_free(out, FALSE);
+}
+
+static gboolean str_table_parse(struct str_table *table)
+{
+	const guint32 *words = table->data;
+	guint32 count;
+	guint32 pool_size;
+	guint32 prev = 0;
+	guint32 i;
+
+	if (table->len < STR_TABLE_HEADER_WORDS * 4)
+		return FALSE;
+
+	if (GUINT32_FROM_LE(words[0]) != STR_TABLE_MAGIC ||
+			GUINT32_FROM_LE(words[1]) != STR_TABLE_VERSION)
+		return FALSE;
+
+	count = GUINT32_FROM_LE(words[2]);
+	pool_size = GUINT32_FROM_LE(words[3]);
+
+	if (count > (table->len - STR_TABLE_HEADER_WORDS * 4) / 8)
+		return FALSE;
+
+	if (table->len - STR_TABLE_HEADER_WORDS * 4 - count * 8 != pool_size)
+		return FALSE;
+
+	table->entries = words + STR_TABLE_HEADER_WORDS;
+	table->pool = (const char *) (table->entries + count * 2);
+	table->count = count;
+	table->pool_size = pool_size;
+	table->stamp = GUINT32_FROM_LE(words[4]) |
+			(guint64) GUINT32_FROM_LE(words[5]) << 32;
+
+	if (pool_size > 0 && table->pool[pool_size - 1] != '\0')
+		return FALSE;
+
+	/* Lookups rely on sorted keys and in-bounds offsets */
+	for (i = 0; i < count; i++) {
+		guint32 key = GUINT32_FROM_LE(table->entries[i * 2]);
+		guint32 offset = GUINT32_FROM_LE(table->entries[i * 2 + 1]);
+
+		if (key <= prev || offset >= pool_size)
+			return FALSE;
+
+		prev = key;
+	}
+
+	return TRUE;
+}
+
+/* Takes ownership of data, which must have been allocated with g_malloc */
+struct str_table *str_table_new(unsigned char *data, size_t len)
+{
+	struct str_table *table;
+
+	table = g_new0(struct str_table, 1);
+	table->data = data;
+	table->len = len;
+
+	if (!str_table_parse(table)) {
+		str_table_free(table);
+		return NULL;
+	}
+
+	return table;
+}
+
+struct str_table *str_table_open(const char *path)
+{
+	struct str_table *table;
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	table = g_new0(struct str_table, 1);
+	table->data = data;
+	table->len = st.st_size;
+	table->mapped = TRUE;
+
+	if (!str_table_parse(table)) {
+		str_table_free(table);
+		return NULL;
+	}
+
+	return table;
+}
+
+void str_table_free(struct str_table *table)
+{
+	if (table == NULL)
+		return;
+
+	if (table->mapped)
+		munmap(table->data, table->len);
+	else
+		g_free(table->data);
+
+	g_free(table);
+}
+
+guint64 str_table_get_stamp(struct str_table *table)
+{
+	return table->stamp;
+}
+
+unsigned int str_table_get_size(struct str_table *table)
+{
+	return table->count;
+}
+
+const char *str_table_lookup(struct str_table *table, const char *numeric)
+{
+	guint32 key = numeric_to_key(numeric);
+	guint32 low = 0;
+	guint32 high;
+
+	if (table == NULL || key == 0)
+		return NULL;
+
+	high = table->count;
+
+	while (low < high) {
+		guint32 mid = low + (high - low) / 2;
+		guint32 k = GUINT32_FROM_LE(table->entries[mid * 2]);
+
+		if (k == key)
+			return table->pool +
+				GUINT32_FROM_LE(table->entries[mid * 2 + 1]);
+
+		if (k < key)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,43 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Immutable tables mapping numeric strings, such as MCC/MNC pairs, to
+ * strings.  The serialized form is a header, the keys sorted for binary
+ * search and a pool of NUL terminated strings, so that a table can be
+ * used directly from a read-only mapping of its file.
+ */
+
+struct str_table;
+struct str_table_builder;
+
+struct str_table_builder *str_table_builder_new(void);
+gboolean str_table_builder_add(struct str_table_builder *builder,
+				const char *numeric, const char *value);
+unsigned char *str_table_builder_finish(struct str_table_builder *builder,
+					guint64 stamp, size_t *out_len);
+void str_table_builder_free(struct str_table_builder *builder);
+
+struct str_table *str_table_new(unsigned char *data, size_t len);
+struct str_table *str_table_open(const char *path);
+void str_table_free(struct str_table *table);
+
+guint64 str_table_get_stamp(struct str_table *table);
+unsigned int str_table_get_size(struct str_table *table);
+const char *str_table_lookup(struct str_table *table, const char *numeric);
@@ -0,0 +1,215 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "ofono.h"
+
+/*
+ * Lifecycle milestones are kept in a fixed size ring, the oldest ones
+ * being overwritten once it is full.  Events are attributed to a track
+ * per modem, track 0 holding the ones not related to any modem.
+ */
+#define TIMELINE_SIZE 4096
+#define TIMELINE_NAME_LEN 48
+
+struct timeline_event {
+	gint64 ts;
+	gint64 dur;		/* -1 for instant events */
+	const char *category;
+	unsigned int track;
+	char name[TIMELINE_NAME_LEN];
+};
+
+static struct timeline_event *events;
+static unsigned int events_head;
+static unsigned int events_count;
+static gint64 timeline_start;
+static GHashTable *tracks;
+static GPtrArray *track_names;
+
+static unsigned int timeline_track(struct ofono_modem *modem)
+{
+	const char *path;
+	gpointer track;
+	char *name;
+
+	if (modem == NULL)
+		return 0;
+
+	path = ofono_modem_get_path(modem);
+	if (path == NULL)
+		return 0;
+
+	track = g_hash_table_lookup(tracks, path);
+	if (track != NULL)
+		return GPOINTER_TO_UINT(track);
+
+	name = g_strdup(path);
+	g_ptr_array_add(track_names, name);
+	g_hash_table_insert(tracks, name,
+				GUINT_TO_POINTER(track_names->len - 1));
+
+	return track_names->len - 1;
+}
+
+static void timeline_add(struct ofono_modem *modem, const char *category,
+				gint64 ts, gint64 dur,
+				const char *fmt, va_list ap)
+{
+	struct timeline_event *event;
+
+	if (events == NULL)
+		return;
+
+	event = &events[(events_head + events_count) % TIMELINE_SIZE];
+
+	if (events_count < TIMELINE_SIZE)
+		events_count += 1;
+	else
+		events_head = (events_head + 1) % TIMELINE_SIZE;
+
+	event->ts = ts;
+	event->dur = dur;
+	event->category = category;
+	event->track = timeline_track(modem);
+	vsnprintf(event->name, sizeof(event->name), fmt, ap);
+}
+
+void __ofono_timeline_mark(struct ofono_modem *modem, const char *category,
+				const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	timeline_add(modem, category, g_get_monotonic_time(), -1, fmt, ap);
+	va_end(ap);
+}
+
+void __ofono_timeline_span(struct ofono_modem *modem, const char *category,
+				gint64 start, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	timeline_add(modem, category, start,
+				g_get_monotonic_time() - start, fmt, ap);
+	va_end(ap);
+}
+
+static void append_string(GString *json, const char *str)
+{
+	g_string_append_c(json, '"');
+
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			g_string_append_c(json, '\\');
+
+		if ((unsigned char) *str < 0x20)
+			g_string_append_printf(json, "\\u%04x", *str);
+		else
+			g_string_append_c(json, *str);
+	}
+
+	g_string_append_c(json, '"');
+}
+
+/*
+ * Returns the recorded events in the Chrome trace event format, which
+ * can be loaded into chrome://tracing or Perfetto.  Timestamps are in
+ * microseconds since ofonod started.
+ */
+char *__ofono_timeline_to_json(void)
+{
+	GString *json = g_string_sized_new(events_count * 96 + 256);
+	int pid = getpid();
+	unsigned int i;
+
+	g_string_append(json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	g_string_append_printf(json, "{\"name\":\"process_name\",\"ph\":\"M\","
+				"\"pid\":%d,\"tid\":0,"
+				"\"args\":{\"name\":\"ofonod\"}}", pid);
+
+	for (i = 0; track_names && i < track_names->len; i++) {
+		g_string_append_printf(json, ",{\"name\":\"thread_name\","
+					"\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+					"\"args\":{\"name\":", pid, i);
+		append_string(json, g_ptr_array_index(track_names, i));
+		g_string_append(json, "}}");
+	}
+
+	for (i = 0; i < events_count; i++) {
+		struct timeline_event *event =
+				&events[(events_head + i) % TIMELINE_SIZE];
+
+		g_string_append(json, ",{\"name\":");
+		append_string(json, event->name);
+		g_string_append_printf(json, ",\"cat\":\"%s\","
+					"\"pid\":%d,\"tid\":%u,"
+					"\"ts\":%" G_GINT64_FORMAT,
+					event->category, pid, event->track,
+					event->ts - timeline_start);
+
+		if (event->dur < 0)
+			g_string_append(json, ",\"ph\":\"i\",\"s\":\"t\"}");
+		else
+			g_string_append_printf(json, ",\"ph\":\"X\","
+						"\"dur\":%" G_GINT64_FORMAT "}",
+						event->dur);
+	}
+
+	g_string_append(json, "]}");
+
+	return g_string_free(json, FALSE);
+}
+
+void __ofono_timeline_init(void)
+{
+	timeline_start = g_get_monotonic_time();
+
+	events = g_new0(struct timeline_event, TIMELINE_SIZE);
+	events_head = 0;
+	events_count = 0;
+
+	tracks = g_hash_table_new(g_str_hash, g_str_equal);
+	track_names = g_ptr_array_new_with_free_func(g_free);
+	g_ptr_array_add(track_names, g_strdup("core"));
+}
+
+void __ofono_timeline_cleanup(void)
+{
+	g_free(events);
+	events = NULL;
+
+	g_hash_table_destroy(tracks);
+	tracks = NULL;
+
+	g_ptr_array_free(track_names, TRUE);
+	track_names = NULL;
+}
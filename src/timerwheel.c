@@ -0,0 +1,441 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "timerwheel.h"
+
+/*
+ * Timers are kept in a hierarchy of wheels of 64 slots each.  Level 0
+ * holds timers expiring within the next 64 ticks, one tick per slot,
+ * and each further level covers 64 times the range of the one below
+ * it.  Timers move down a level whenever the wheel reaches their slot,
+ * and a single GLib timeout is armed for the earliest expiry.
+ *
+ * With 16ms ticks, the five levels cover about 198 days, longer
+ * timeouts are shortened to that.
+ */
+#define WHEEL_TICK_US		16000
+#define WHEEL_LEVEL_BITS	6
+#define WHEEL_LEVEL_SIZE	(1 << WHEEL_LEVEL_BITS)
+#define WHEEL_LEVEL_MASK	(WHEEL_LEVEL_SIZE - 1)
+#define WHEEL_LEVELS		5
+#define WHEEL_RANGE(levels)	(G_GUINT64_CONSTANT(1) <<	\
+					(WHEEL_LEVEL_BITS * (levels)))
+#define WHEEL_MAX_TICKS		(WHEEL_RANGE(WHEEL_LEVELS) -	\
+					WHEEL_RANGE(WHEEL_LEVELS - 1))
+
+/* Matches the one second granularity of g_timeout_add_seconds */
+#define WHEEL_SECONDS_SLACK_MS	1000
+
+struct wheel_timer {
+	struct wheel_timer *next;
+	struct wheel_timer **pprev;
+	unsigned int id;
+	guint64 expires;
+	unsigned int interval;
+	unsigned int slack;
+	GSourceFunc func;
+	gpointer user_data;
+	gboolean running;
+	gboolean removed;
+};
+
+static struct wheel_timer *wheel[WHEEL_LEVELS][WHEEL_LEVEL_SIZE];
+static GHashTable *wheel_timers;
+static unsigned int wheel_next_id;
+static gint64 wheel_base;
+static guint64 wheel_now;
+static guint64 wheel_armed;
+static guint wheel_source;
+static gint64 (*wheel_clock)(void) = g_get_monotonic_time;
+static gboolean wheel_manual;
+
+static void timer_link(struct wheel_timer **head, struct wheel_timer *t)
+{
+	t->next = *head;
+
+	if (t->next)
+		t->next->pprev = &t->next;
+
+	*head = t;
+	t->pprev = head;
+}
+
+static void timer_unlink(struct wheel_timer *t)
+{
+	if (t->pprev == NULL)
+		return;
+
+	*t->pprev = t->next;
+
+	if (t->next)
+		t->next->pprev = t->pprev;
+
+	t->next = NULL;
+	t->pprev = NULL;
+}
+
+/* Moves a slot's list to a local head, which timer_unlink keeps valid */
+static void slot_detach(struct wheel_timer **slot, struct wheel_timer **head)
+{
+	*head = *slot;
+	*slot = NULL;
+
+	if (*head)
+		(*head)->pprev = head;
+}
+
+static guint64 wheel_current_tick(void)
+{
+	return (wheel_clock() - wheel_base) / WHEEL_TICK_US;
+}
+
+static guint64 timer_expiry(unsigned int timeout_ms, unsigned int slack_ms)
+{
+	gint64 elapsed = wheel_clock() - wheel_base;
+	guint64 slack = slack_ms * 1000ULL / WHEEL_TICK_US;
+	guint64 expires;
+
+	/* Round up, the timer must never run early */
+	expires = (elapsed + timeout_ms * 1000ULL + WHEEL_TICK_US - 1) /
+								WHEEL_TICK_US;
+
+	/*
+	 * Align the expiry on the largest power of two ticks within the
+	 * slack, timers with similar slack then tend to share a tick.
+	 */
+	if (slack > 1) {
+		guint64 align = G_GUINT64_CONSTANT(1) <<
+					g_bit_nth_msf(slack, -1);
+
+		expires = (expires + align - 1) & ~(align - 1);
+	}
+
+	if (expires - wheel_now > WHEEL_MAX_TICKS)
+		expires = wheel_now + WHEEL_MAX_TICKS;
+
+	return expires;
+}
+
+static void wheel_insert(struct wheel_timer *t)
+{
+	guint64 expires = MAX(t->expires, wheel_now);
+	unsigned int level;
+	unsigned int shift;
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+		shift = level * WHEEL_LEVEL_BITS;
+
+		if ((expires >> shift) - (wheel_now >> shift) <
+							WHEEL_LEVEL_SIZE)
+			break;
+	}
+
+	shift = level * WHEEL_LEVEL_BITS;
+
+	timer_link(&wheel[level][(expires >> shift) & WHEEL_LEVEL_MASK], t);
+}
+
+/*
+ * Returns the earliest expiry.  Within a level, slots are ordered by
+ * their distance from the current one, so only the first occupied slot
+ * of each level needs to be looked at.
+ */
+static guint64 wheel_next_expiry(void)
+{
+	guint64 next = G_MAXUINT64;
+	unsigned int level;
+	unsigned int i;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		unsigned int shift = level * WHEEL_LEVEL_BITS;
+		guint64 base = wheel_now >> shift;
+		struct wheel_timer *t;
+
+		for (i = 0; i < WHEEL_LEVEL_SIZE; i++) {
+			t = wheel[level][(base + i) & WHEEL_LEVEL_MASK];
+			if (t != NULL)
+				break;
+		}
+
+		if (t == NULL)
+			continue;
+
+		if (level == 0) {
+			next = MIN(next, wheel_now + i);
+			continue;
+		}
+
+		for (; t; t = t->next)
+			next = MIN(next, t->expires);
+	}
+
+	return next;
+}
+
+/*
+ * Only valid if no timer expires before tick, the slots the wheel moves
+ * past are then all empty except the current one of each level.
+ */
+static void wheel_advance(guint64 tick)
+{
+	struct wheel_timer *head;
+	struct wheel_timer *t;
+	unsigned int level;
+
+	wheel_now = tick;
+
+	for (level = WHEEL_LEVELS - 1; level > 0; level--) {
+		unsigned int shift = level * WHEEL_LEVEL_BITS;
+
+		slot_detach(&wheel[level][(tick >> shift) & WHEEL_LEVEL_MASK],
+									&head);
+
+		while ((t = head) != NULL) {
+			timer_unlink(t);
+			wheel_insert(t);
+		}
+	}
+}
+
+static void timer_free(struct wheel_timer *t)
+{
+	g_hash_table_remove(wheel_timers, GUINT_TO_POINTER(t->id));
+	g_free(t);
+}
+
+static void timer_run(struct wheel_timer *t)
+{
+	gboolean again;
+
+	t->running = TRUE;
+	again = t->func(t->user_data);
+	t->running = FALSE;
+
+	if (t->removed) {
+		g_free(t);
+		return;
+	}
+
+	if (again == FALSE) {
+		timer_free(t);
+		return;
+	}
+
+	t->expires = timer_expiry(t->interval, t->slack);
+	wheel_insert(t);
+}
+
+static gboolean wheel_dispatch(gpointer user_data);
+
+static void wheel_arm(void)
+{
+	guint64 next = wheel_next_expiry();
+	gint64 delay;
+
+	/* Driven by timer_wheel_dispatch instead */
+	if (wheel_manual)
+		return;
+
+	if (wheel_source > 0) {
+		if (next == wheel_armed)
+			return;
+
+		g_source_remove(wheel_source);
+		wheel_source = 0;
+	}
+
+	if (next == G_MAXUINT64)
+		return;
+
+	delay = wheel_base + (gint64) next * WHEEL_TICK_US - wheel_clock();
+
+	wheel_armed = next;
+	wheel_source = g_timeout_add(delay > 0 ? (delay + 999) / 1000 : 0,
+						wheel_dispatch, NULL);
+}
+
+static gboolean wheel_dispatch(gpointer user_data)
+{
+	guint64 tick = wheel_current_tick();
+	guint64 next;
+
+	wheel_source = 0;
+
+	while ((next = wheel_next_expiry()) <= tick) {
+		struct wheel_timer *head;
+		struct wheel_timer *t;
+
+		wheel_advance(next);
+
+		/*
+		 * Only run the timers detached here, the callbacks may add
+		 * or rearm timers on the same slot.
+		 */
+		slot_detach(&wheel[0][next & WHEEL_LEVEL_MASK], &head);
+
+		while ((t = head) != NULL) {
+			timer_unlink(t);
+			timer_run(t);
+		}
+	}
+
+	if (tick > wheel_now)
+		wheel_advance(tick);
+
+	wheel_arm();
+
+	return FALSE;
+}
+
+unsigned int timer_wheel_add(unsigned int timeout_ms, unsigned int slack_ms,
+				GSourceFunc func, gpointer user_data)
+{
+	struct wheel_timer *t;
+	guint64 tick;
+
+	if (func == NULL)
+		return 0;
+
+	if (wheel_timers == NULL) {
+		wheel_timers = g_hash_table_new(g_direct_hash, g_direct_equal);
+		wheel_base = wheel_clock();
+		wheel_now = 0;
+	}
+
+	/* Catch up with the clock unless some expired timer is pending */
+	tick = wheel_current_tick();
+	if (tick > wheel_now && wheel_next_expiry() > tick)
+		wheel_advance(tick);
+
+	t = g_new0(struct wheel_timer, 1);
+	t->interval = timeout_ms;
+	t->slack = slack_ms;
+	t->func = func;
+	t->user_data = user_data;
+	t->expires = timer_expiry(timeout_ms, slack_ms);
+
+	do {
+		wheel_next_id += 1;
+	} while (wheel_next_id == 0 || g_hash_table_lookup(wheel_timers,
+					GUINT_TO_POINTER(wheel_next_id)));
+
+	t->id = wheel_next_id;
+	g_hash_table_insert(wheel_timers, GUINT_TO_POINTER(t->id), t);
+
+	wheel_insert(t);
+	wheel_arm();
+
+	return t->id;
+}
+
+unsigned int timer_wheel_add_seconds(unsigned int seconds,
+				GSourceFunc func, gpointer user_data)
+{
+	return timer_wheel_add(seconds * 1000, WHEEL_SECONDS_SLACK_MS,
+							func, user_data);
+}
+
+gboolean timer_wheel_remove(unsigned int id)
+{
+	struct wheel_timer *t;
+
+	if (wheel_timers == NULL || id == 0)
+		return FALSE;
+
+	t = g_hash_table_lookup(wheel_timers, GUINT_TO_POINTER(id));
+	if (t == NULL)
+		return FALSE;
+
+	g_hash_table_remove(wheel_timers, GUINT_TO_POINTER(id));
+
+	/* Freed by timer_run once the callback returns */
+	if (t->running) {
+		t->removed = TRUE;
+		return TRUE;
+	}
+
+	timer_unlink(t);
+	g_free(t);
+
+	/* An early wakeup is harmless, only stop it once idle */
+	if (g_hash_table_size(wheel_timers) == 0 && wheel_source > 0) {
+		g_source_remove(wheel_source);
+		wheel_source = 0;
+	}
+
+	return TRUE;
+}
+
+void timer_wheel_set_clock(gint64 (*clock)(void))
+{
+	wheel_clock = clock ? clock : g_get_monotonic_time;
+	wheel_manual = clock != NULL;
+}
+
+gint64 timer_wheel_next_wakeup(void)
+{
+	guint64 next = wheel_next_expiry();
+
+	if (next == G_MAXUINT64)
+		return -1;
+
+	return wheel_base + (gint64) next * WHEEL_TICK_US;
+}
+
+void timer_wheel_dispatch(void)
+{
+	if (wheel_timers == NULL)
+		return;
+
+	wheel_dispatch(NULL);
+}
+
+void timer_wheel_cleanup(void)
+{
+	unsigned int level;
+	unsigned int i;
+
+	if (wheel_timers == NULL)
+		return;
+
+	if (wheel_source > 0) {
+		g_source_remove(wheel_source);
+		wheel_source = 0;
+	}
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		for (i = 0; i < WHEEL_LEVEL_SIZE; i++) {
+			struct wheel_timer *t;
+
+			while ((t = wheel[level][i]) != NULL) {
+				timer_unlink(t);
+				g_free(t);
+			}
+		}
+	}
+
+	g_hash_table_destroy(wheel_timers);
+	wheel_timers = NULL;
+}
@@ -0,0 +1,43 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Coarse timers sharing a single main loop source.  Like g_timeout_add,
+ * the callback is rearmed with the same interval for as long as it
+ * returns TRUE, and it never runs early.  It may however run up to
+ * slack_ms late, so that timers expiring close to each other are
+ * dispatched in one wakeup.
+ */
+
+unsigned int timer_wheel_add(unsigned int timeout_ms, unsigned int slack_ms,
+				GSourceFunc func, gpointer user_data);
+unsigned int timer_wheel_add_seconds(unsigned int seconds,
+				GSourceFunc func, gpointer user_data);
+gboolean timer_wheel_remove(unsigned int id);
+void timer_wheel_cleanup(void);
+
+/*
+ * For unit tests.  With a clock set, no main loop source is armed: the
+ * caller moves its clock to timer_wheel_next_wakeup, which is -1 when
+ * idle, and runs the expired timers with timer_wheel_dispatch.  Must be
+ * called before the first timer is added.
+ */
+void timer_wheel_set_clock(gint64 (*clock)(void));
+gint64 timer_wheel_next_wakeup(void);
+void timer_wheel_dispatch(void);
@@ -38,6 +38,7 @@
 #include "simutil.h"
 #include "smsutil.h"
 #include "storage.h"
+#include "timerwheel.h"
 #include "wakelock.h"
 
 #define MAX_VOICE_CALLS 16
@@ -2805,7 +2806,7 @@ static void voicecall_remove(struct ofono_atom *atom)
 		vc->driver->remove(vc);
 
 	if (vc->tone_source) {
-		g_source_remove(vc->tone_source);
+		timer_wheel_remove(vc->tone_source);
 		vc->tone_source = 0;
 	}
 
@@ -3857,7 +3858,8 @@ done:
 	 * although 27.007 claims this delay can be set using S8 and
 	 * defaults to 2 seconds.
 	 */
-	vc->tone_source = g_timeout_add_seconds(len * 3, tone_request_run, vc);
+	vc->tone_source = timer_wheel_add_seconds(len * 3,
+							tone_request_run, vc);
 }
 
 static gboolean tone_request_run(gpointer user_data)
@@ -3922,7 +3924,7 @@ void __ofono_voicecall_tone_cancel(struct ofono_voicecall *vc, int id)
 	 * now, else wake up when current tone finishes.
 	 */
 	if (n == 1 && vc->tone_source) {
-		g_source_remove(vc->tone_source);
+		timer_wheel_remove(vc->tone_source);
 		tone_request_run(vc);
 	}
 }
@@ -0,0 +1,587 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#define OFONO_API_SUBJECT_TO_CHANGE
+#include <ofono/types.h>
+
+#include "gatchat/gatchat.h"
+#include "gril/gril.h"
+#include "drivers/qmimodem/qmi.h"
+
+/* Must match the record layout written by src/log.c */
+#define TRACE_MAGIC		"OFTRACE1"
+#define TRACE_TAG		16
+
+#define TRACE_FLAG_IN		0x02
+#define TRACE_FLAG_MORE		0x04
+
+struct trace_record {
+	guint64 timestamp;
+	guint32 len;
+	guint8 flags;
+	guint8 reserved[3];
+	char tag[TRACE_TAG];
+} __attribute__((packed));
+
+/* Record layout of g_at_hdlc_set_recording / g_at_ppp_set_recording */
+#define RECORD_START		0x07
+#define RECORD_IN		0x02
+
+/* No catch-all for unsolicited RIL responses, cover the known ranges */
+#define RIL_UNSOL_RANGE		100
+#define MTK_UNSOL_BASE		3000
+
+enum replay_mode {
+	REPLAY_AT,
+	REPLAY_RIL,
+	REPLAY_QMI,
+};
+
+struct replay {
+	enum replay_mode mode;
+	GPtrArray *chunks;
+	guint64 bytes;
+	int fd;
+	guint64 write_ts;
+	guint64 messages;
+	GArray *latency;
+	GAtChat *chat;
+	GRil *ril;
+	struct qmi_device *qmi;
+};
+
+static struct replay replay;
+
+static gchar *option_mode = NULL;
+static gchar *option_tag = NULL;
+static gint option_loops = 1;
+static gint option_chunk = 4096;
+
+static GOptionEntry options[] = {
+	{ "mode", 'm', 0, G_OPTION_ARG_STRING, &option_mode,
+				"Protocol to replay: at, ril or qmi", "MODE" },
+	{ "tag", 't', 0, G_OPTION_ARG_STRING, &option_tag,
+				"Only replay trace records of the given channel",
+				"TAG" },
+	{ "loops", 'l', 0, G_OPTION_ARG_INT, &option_loops,
+				"Replay the input the given number of times",
+				"N" },
+	{ "chunk", 'c', 0, G_OPTION_ARG_INT, &option_chunk,
+				"Write size used for raw input files", "BYTES" },
+	{ NULL },
+};
+
+static inline guint64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (guint64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void add_sample(void)
+{
+	guint64 latency = now_ns() - replay.write_ts;
+
+	g_array_append_val(replay.latency, latency);
+	replay.messages += 1;
+}
+
+/* Chunks of a split record share the timestamp, tag and direction */
+static gboolean same_record(const struct trace_record *a,
+				const struct trace_record *b)
+{
+	return a->timestamp == b->timestamp &&
+		(a->flags & TRACE_FLAG_IN) == (b->flags & TRACE_FLAG_IN) &&
+		!memcmp(a->tag, b->tag, TRACE_TAG);
+}
+
+static gboolean load_trace(FILE *fp, GPtrArray *chunks)
+{
+	struct trace_record rec;
+	struct trace_record head;
+	GByteArray *payload = NULL;
+	gboolean chained = FALSE;
+
+	while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+		guint32 len = GUINT32_FROM_LE(rec.len);
+		gboolean wanted = (rec.flags & TRACE_FLAG_IN) &&
+				(option_tag == NULL ||
+				!strncmp(option_tag, rec.tag, TRACE_TAG));
+		gsize off;
+
+		if (payload == NULL)
+			payload = g_byte_array_new();
+
+		/* A new record, drop what is left of an incomplete one */
+		if (!chained || !same_record(&head, &rec)) {
+			g_byte_array_set_size(payload, 0);
+			head = rec;
+		}
+
+		chained = (rec.flags & TRACE_FLAG_MORE) != 0;
+
+		off = payload->len;
+		g_byte_array_set_size(payload, off + len);
+
+		if (len && fread(payload->data + off, len, 1, fp) != 1) {
+			g_byte_array_free(payload, TRUE);
+			return FALSE;
+		}
+
+		if (!wanted) {
+			g_byte_array_set_size(payload, off);
+			continue;
+		}
+
+		if (rec.flags & TRACE_FLAG_MORE)
+			continue;
+
+		g_ptr_array_add(chunks, payload);
+		payload = NULL;
+	}
+
+	if (payload)
+		g_byte_array_free(payload, TRUE);
+
+	return TRUE;
+}
+
+static gboolean load_recording(FILE *fp, GPtrArray *chunks)
+{
+	unsigned char hdr[8];
+
+	while (fread(hdr, sizeof(hdr), 1, fp) == 1) {
+		guint16 len = (hdr[6] << 8) | hdr[7];
+		GByteArray *payload;
+
+		if (hdr[0] != RECORD_START)
+			return FALSE;
+
+		payload = g_byte_array_sized_new(len);
+		g_byte_array_set_size(payload, len);
+
+		if (len && fread(payload->data, len, 1, fp) != 1) {
+			g_byte_array_free(payload, TRUE);
+			return FALSE;
+		}
+
+		if (hdr[5] != RECORD_IN) {
+			g_byte_array_free(payload, TRUE);
+			continue;
+		}
+
+		g_ptr_array_add(chunks, payload);
+	}
+
+	return TRUE;
+}
+
+static gboolean load_raw(FILE *fp, GPtrArray *chunks)
+{
+	GByteArray *payload;
+	size_t len;
+
+	do {
+		payload = g_byte_array_sized_new(option_chunk);
+		g_byte_array_set_size(payload, option_chunk);
+
+		len = fread(payload->data, 1, option_chunk, fp);
+		g_byte_array_set_size(payload, len);
+
+		if (len == 0) {
+			g_byte_array_free(payload, TRUE);
+			break;
+		}
+
+		g_ptr_array_add(chunks, payload);
+	} while (len == (size_t) option_chunk);
+
+	return ferror(fp) == 0;
+}
+
+static gboolean load_input(const char *path, GPtrArray *chunks)
+{
+	char magic[sizeof(TRACE_MAGIC) - 1];
+	gboolean ret;
+	FILE *fp;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		perror("Failed to open input");
+		return FALSE;
+	}
+
+	if (fread(magic, sizeof(magic), 1, fp) == 1 &&
+			memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0)
+		ret = load_trace(fp, chunks);
+	else {
+		rewind(fp);
+
+		if (fgetc(fp) == RECORD_START) {
+			rewind(fp);
+			ret = load_recording(fp, chunks);
+		} else {
+			rewind(fp);
+			ret = load_raw(fp, chunks);
+		}
+	}
+
+	fclose(fp);
+
+	if (!ret)
+		g_printerr("Malformed input file\n");
+
+	return ret;
+}
+
+static gboolean is_pdu_prefix(const char *line)
+{
+	return g_str_has_prefix(line, "+CMT:") ||
+		g_str_has_prefix(line, "+CBM:") ||
+		g_str_has_prefix(line, "+CDS:");
+}
+
+static void at_notify(GAtResult *result, gpointer user_data)
+{
+	const char *line = result->lines ? result->lines->data : NULL;
+
+	/* Counted once by the PDU aware notifier instead */
+	if (line && is_pdu_prefix(line))
+		return;
+
+	add_sample();
+}
+
+static void at_pdu_notify(GAtResult *result, gpointer user_data)
+{
+	add_sample();
+}
+
+static gboolean setup_at(int fd)
+{
+	GIOChannel *channel;
+	GAtSyntax *syntax;
+
+	channel = g_io_channel_unix_new(fd);
+
+	syntax = g_at_syntax_new_gsm_permissive();
+	replay.chat = g_at_chat_new(channel, syntax);
+	g_at_syntax_unref(syntax);
+	g_io_channel_unref(channel);
+
+	if (replay.chat == NULL)
+		return FALSE;
+
+	/* An empty prefix matches every unsolicited line */
+	g_at_chat_register(replay.chat, "", at_notify, FALSE, NULL, NULL);
+	g_at_chat_register(replay.chat, "+CMT:", at_pdu_notify, TRUE,
+								NULL, NULL);
+	g_at_chat_register(replay.chat, "+CBM:", at_pdu_notify, TRUE,
+								NULL, NULL);
+	g_at_chat_register(replay.chat, "+CDS:", at_pdu_notify, TRUE,
+								NULL, NULL);
+
+	return TRUE;
+}
+
+static void ril_notify(struct ril_msg *message, gpointer user_data)
+{
+	add_sample();
+}
+
+static int setup_ril(void)
+{
+	char dir[] = "/tmp/ofono-replay-XXXXXX";
+	struct sockaddr_un addr;
+	char *path;
+	int sk;
+	int fd;
+	int i;
+
+	if (mkdtemp(dir) == NULL)
+		return -1;
+
+	path = g_build_filename(dir, "rild", NULL);
+
+	sk = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sk < 0)
+		goto error;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	if (bind(sk, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+			listen(sk, 1) < 0)
+		goto error;
+
+	replay.ril = g_ril_new(path, OFONO_RIL_VENDOR_AOSP);
+	if (replay.ril == NULL)
+		goto error;
+
+	fd = accept(sk, NULL, NULL);
+
+	close(sk);
+	unlink(path);
+	rmdir(dir);
+	g_free(path);
+
+	for (i = 0; i < RIL_UNSOL_RANGE; i++) {
+		g_ril_register(replay.ril, RIL_UNSOL_RESPONSE_BASE + i,
+							ril_notify, NULL);
+		g_ril_register(replay.ril, MTK_UNSOL_BASE + i,
+							ril_notify, NULL);
+	}
+
+	return fd;
+
+error:
+	if (sk >= 0)
+		close(sk);
+
+	unlink(path);
+	rmdir(dir);
+	g_free(path);
+
+	return -1;
+}
+
+static gboolean setup_qmi(int fd)
+{
+	replay.qmi = qmi_device_new(fd);
+	if (replay.qmi == NULL)
+		return FALSE;
+
+	qmi_device_set_close_on_unref(replay.qmi, true);
+
+	return TRUE;
+}
+
+static void drain(void)
+{
+	while (g_main_context_iteration(NULL, FALSE))
+		;
+
+	/* QMI has no catch-all notifier, sample whole chunks instead */
+	if (replay.mode == REPLAY_QMI)
+		add_sample();
+}
+
+static gboolean write_chunk(const GByteArray *chunk)
+{
+	gsize off = 0;
+
+	while (off < chunk->len) {
+		ssize_t n = write(replay.fd, chunk->data + off,
+							chunk->len - off);
+
+		if (n < 0) {
+			if (errno != EAGAIN && errno != EINTR) {
+				perror("Failed to write");
+				return FALSE;
+			}
+
+			/* Socket is full, let the reader make progress */
+			g_main_context_iteration(NULL, TRUE);
+			continue;
+		}
+
+		replay.write_ts = now_ns();
+		off += n;
+	}
+
+	replay.bytes += chunk->len;
+
+	return TRUE;
+}
+
+static int compare_u64(gconstpointer a, gconstpointer b)
+{
+	guint64 x = *(const guint64 *) a;
+	guint64 y = *(const guint64 *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile(double p)
+{
+	guint n = replay.latency->len;
+
+	if (n == 0)
+		return 0;
+
+	return g_array_index(replay.latency, guint64,
+				(guint) ((n - 1) * p / 100.0)) / 1000.0;
+}
+
+static void report(guint64 elapsed)
+{
+	double secs = elapsed / 1e9;
+	struct rusage usage;
+	guint64 messages = replay.messages;
+
+	if (replay.mode == REPLAY_QMI) {
+		struct qmi_stats stats;
+
+		if (qmi_device_get_stats(replay.qmi, &stats))
+			messages = stats.indications;
+	}
+
+	g_array_sort(replay.latency, compare_u64);
+	getrusage(RUSAGE_SELF, &usage);
+
+	printf("Bytes:        %" G_GUINT64_FORMAT "\n", replay.bytes);
+	printf("Messages:     %" G_GUINT64_FORMAT "\n", messages);
+	printf("Elapsed:      %.3f s\n", secs);
+	printf("Parse rate:   %.2f MB/s, %.0f msg/s\n",
+				replay.bytes / secs / 1e6, messages / secs);
+	printf("Latency (us): p50 %.1f  p90 %.1f  p99 %.1f  max %.1f%s\n",
+				percentile(50), percentile(90),
+				percentile(99), percentile(100),
+				replay.mode == REPLAY_QMI ? " (per chunk)" : "");
+	printf("Peak RSS:     %ld kB\n", usage.ru_maxrss);
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *err = NULL;
+	int sk[2] = { -1, -1 };
+	guint64 start;
+	gboolean ok = TRUE;
+	int loop;
+	guint i;
+
+	context = g_option_context_new("FILE - replay modem traces at "
+							"maximum rate");
+	g_option_context_add_main_entries(context, options, NULL);
+
+	if (g_option_context_parse(context, &argc, &argv, &err) == FALSE) {
+		if (err != NULL) {
+			g_printerr("%s\n", err->message);
+			g_error_free(err);
+			return 1;
+		}
+
+		g_printerr("An unknown error occurred\n");
+		return 1;
+	}
+
+	g_option_context_free(context);
+
+	if (argc < 2) {
+		g_printerr("Missing input file\n");
+		return 1;
+	}
+
+	if (option_mode == NULL || g_str_equal(option_mode, "at"))
+		replay.mode = REPLAY_AT;
+	else if (g_str_equal(option_mode, "ril"))
+		replay.mode = REPLAY_RIL;
+	else if (g_str_equal(option_mode, "qmi"))
+		replay.mode = REPLAY_QMI;
+	else {
+		g_printerr("Unknown mode: %s\n", option_mode);
+		return 1;
+	}
+
+	if (option_chunk <= 0 || option_loops <= 0) {
+		g_printerr("Invalid chunk size or loop count\n");
+		return 1;
+	}
+
+	replay.chunks = g_ptr_array_new();
+	replay.latency = g_array_new(FALSE, FALSE, sizeof(guint64));
+
+	if (!load_input(argv[1], replay.chunks))
+		return 1;
+
+	if (replay.mode == REPLAY_RIL) {
+		replay.fd = setup_ril();
+		ok = replay.fd >= 0;
+	} else if (socketpair(AF_UNIX, SOCK_STREAM, 0, sk) < 0) {
+		ok = FALSE;
+	} else {
+		replay.fd = sk[0];
+
+		if (replay.mode == REPLAY_AT)
+			ok = setup_at(sk[1]);
+		else
+			ok = setup_qmi(sk[1]);
+	}
+
+	if (!ok) {
+		g_printerr("Failed to set up %s channel\n",
+					option_mode ? option_mode : "at");
+		return 1;
+	}
+
+	fcntl(replay.fd, F_SETFL, fcntl(replay.fd, F_GETFL) | O_NONBLOCK);
+
+	start = now_ns();
+
+	for (loop = 0; loop < option_loops && ok; loop++) {
+		for (i = 0; i < replay.chunks->len && ok; i++) {
+			ok = write_chunk(g_ptr_array_index(replay.chunks, i));
+			drain();
+		}
+	}
+
+	report(now_ns() - start);
+
+	if (replay.chat)
+		g_at_chat_unref(replay.chat);
+
+	if (replay.ril)
+		g_ril_unref(replay.ril);
+
+	if (replay.qmi)
+		qmi_device_unref(replay.qmi);
+
+	close(replay.fd);
+
+	for (i = 0; i < replay.chunks->len; i++)
+		g_byte_array_free(g_ptr_array_index(replay.chunks, i), TRUE);
+
+	g_ptr_array_free(replay.chunks, TRUE);
+	g_array_free(replay.latency, TRUE);
+	g_free(option_mode);
+	g_free(option_tag);
+
+	return ok ? 0 : 1;
+}
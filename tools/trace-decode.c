@@ -0,0 +1,207 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <glib.h>
+
+/* Must match the record layout written by src/log.c */
+#define TRACE_MAGIC		"OFTRACE1"
+#define TRACE_TAG		16
+
+#define TRACE_FLAG_IN		0x02
+#define TRACE_FLAG_MORE		0x04
+
+struct trace_record {
+	guint64 timestamp;
+	guint32 len;
+	guint8 flags;
+	guint8 reserved[3];
+	char tag[TRACE_TAG];
+} __attribute__((packed));
+
+static gboolean option_raw = FALSE;
+static gchar *option_tag = NULL;
+
+static GOptionEntry options[] = {
+	{ "raw", 'r', 0, G_OPTION_ARG_NONE, &option_raw,
+				"Write payload bytes to stdout unformatted" },
+	{ "tag", 't', 0, G_OPTION_ARG_STRING, &option_tag,
+				"Only show records of the given channel",
+				"TAG" },
+	{ NULL },
+};
+
+static void hexdump(const unsigned char *buf, gsize len)
+{
+	char ascii[17];
+	gsize i;
+
+	for (i = 0; i < len; i++) {
+		if (i % 16 == 0)
+			printf("    %04zx:", i);
+
+		printf(" %02x", buf[i]);
+		ascii[i % 16] = isprint(buf[i]) ? buf[i] : '.';
+
+		if (i % 16 == 15 || i == len - 1) {
+			ascii[i % 16 + 1] = '\0';
+			printf("%*s  %s\n", (int) (15 - i % 16) * 3, "", ascii);
+		}
+	}
+}
+
+static void output(const struct trace_record *rec, guint64 start,
+					const unsigned char *buf, gsize len)
+{
+	guint64 ts = GUINT64_FROM_LE(rec->timestamp);
+
+	if (option_tag && strncmp(option_tag, rec->tag, TRACE_TAG))
+		return;
+
+	if (option_raw) {
+		fwrite(buf, 1, len, stdout);
+		return;
+	}
+
+	printf("%8" G_GUINT64_FORMAT ".%06" G_GUINT64_FORMAT " %-15.15s %s %zu\n",
+			(ts - start) / 1000000, (ts - start) % 1000000,
+			rec->tag, rec->flags & TRACE_FLAG_IN ? "<" : ">", len);
+	hexdump(buf, len);
+}
+
+/* Chunks of a split record share the timestamp, tag and direction */
+static gboolean same_record(const struct trace_record *a,
+				const struct trace_record *b)
+{
+	return a->timestamp == b->timestamp &&
+		(a->flags & TRACE_FLAG_IN) == (b->flags & TRACE_FLAG_IN) &&
+		!memcmp(a->tag, b->tag, TRACE_TAG);
+}
+
+static int decode(FILE *fp)
+{
+	char magic[sizeof(TRACE_MAGIC) - 1];
+	struct trace_record rec;
+	struct trace_record head;
+	GByteArray *payload;
+	guint64 start = 0;
+	gboolean first = TRUE;
+	gboolean chained = FALSE;
+
+	if (fread(magic, sizeof(magic), 1, fp) != 1 ||
+			memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+		fprintf(stderr, "Not an oFono trace file\n");
+		return 1;
+	}
+
+	payload = g_byte_array_new();
+
+	while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+		guint32 len = GUINT32_FROM_LE(rec.len);
+		gsize off;
+
+		/* A new record, drop what is left of an incomplete one */
+		if (!chained || !same_record(&head, &rec)) {
+			if (chained)
+				fprintf(stderr,
+					"Discarding incomplete record\n");
+
+			g_byte_array_set_size(payload, 0);
+			head = rec;
+		}
+
+		off = payload->len;
+		g_byte_array_set_size(payload, off + len);
+
+		if (len && fread(payload->data + off, len, 1, fp) != 1) {
+			fprintf(stderr, "Truncated record\n");
+			break;
+		}
+
+		if (first) {
+			start = GUINT64_FROM_LE(rec.timestamp);
+			first = FALSE;
+		}
+
+		/* Large writes are split, the last chunk clears the flag */
+		chained = (rec.flags & TRACE_FLAG_MORE) != 0;
+		if (chained)
+			continue;
+
+		output(&rec, start, payload->data, payload->len);
+		g_byte_array_set_size(payload, 0);
+	}
+
+	if (chained)
+		fprintf(stderr, "Discarding incomplete record\n");
+
+	g_byte_array_free(payload, TRUE);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *err = NULL;
+	FILE *fp;
+	int ret;
+
+	context = g_option_context_new("FILE - decode binary modem traces");
+	g_option_context_add_main_entries(context, options, NULL);
+
+	if (g_option_context_parse(context, &argc, &argv, &err) == FALSE) {
+		if (err != NULL) {
+			g_printerr("%s\n", err->message);
+			g_error_free(err);
+			return 1;
+		}
+
+		g_printerr("An unknown error occurred\n");
+		return 1;
+	}
+
+	g_option_context_free(context);
+
+	if (argc < 2) {
+		g_printerr("Missing trace file\n");
+		return 1;
+	}
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		perror("Failed to open trace file");
+		return 1;
+	}
+
+	ret = decode(fp);
+
+	fclose(fp);
+	g_free(option_tag);
+
+	return ret;
+}
@@ -0,0 +1,160 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "cdma-smsutil.h"
+
+#include "bench.h"
+
+static const guint8 wmt_deliver[] = { 0x00, 0x00, 0x02, 0x10, 0x02, 0x02,
+				0x05, 0x01, 0xC4, 0x8D, 0x15, 0x9C, 0x08,
+				0x0D, 0x00, 0x03, 0x1B, 0xEE, 0xF0, 0x01,
+				0x06, 0x10, 0x2C, 0x8C, 0xBB, 0x36, 0x6F };
+
+static const guint8 wmt_deliver_time_stamp[] = { 0x00, 0x00, 0x02, 0x10,
+				0x02, 0x02, 0x07, 0x02, 0xA1, 0x62, 0x51,
+				0x55, 0xA6, 0x40, 0x08, 0x18, 0x00, 0x03,
+				0x10, 0x00, 0x40, 0x01, 0x06, 0x10, 0x25,
+				0x4C, 0xBC, 0xFA, 0x00, 0x03, 0x06, 0x03,
+				0x08, 0x20, 0x13, 0x43, 0x12, 0x0D, 0x01,
+				0x01 };
+
+static const char *ascii_text = "The quick brown fox jumps over the lazy "
+	"dog. The quick brown fox jumps over the lazy dog. The quick brown "
+	"fox jumps over the lazy dog. The quick brown fox jumps";
+
+static const char *ucs2_text = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5"
+	"\xd1\x82, \xd0\xbc\xd0\xb8\xd1\x80! \xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2"
+	"\xd0\xb5\xd1\x82, \xd0\xbc\xd0\xb8\xd1\x80!";
+
+struct pdu_data {
+	const guint8 *pdu;
+	guint8 len;
+};
+
+static void bench_decode(void *user_data)
+{
+	struct pdu_data *data = user_data;
+	struct cdma_sms s;
+
+	memset(&s, 0, sizeof(s));
+	cdma_sms_decode(data->pdu, data->len, &s);
+}
+
+static void bench_encode(void *user_data)
+{
+	struct cdma_sms *s = user_data;
+	guint8 pdu[CDMA_SMS_PDU_MAX_LEN];
+	int len;
+
+	cdma_sms_encode(s, pdu, &len);
+}
+
+static void bench_encode_text(void *user_data)
+{
+	const char *text = user_data;
+	struct cdma_sms_ud ud;
+
+	cdma_sms_encode_text(text, &ud);
+}
+
+static void bench_decode_text(void *user_data)
+{
+	struct cdma_sms_ud *ud = user_data;
+
+	g_free(cdma_sms_decode_text(ud));
+}
+
+static void prepare_submit(struct cdma_sms *s, const char *text)
+{
+	struct cdma_sms_bearer_data *bd = &s->p2p_msg.bd;
+
+	memset(s, 0, sizeof(*s));
+
+	s->type = CDMA_SMS_TP_MSG_TYPE_P2P;
+	s->p2p_msg.teleservice_id = CDMA_SMS_TELESERVICE_ID_WMT;
+	cdma_sms_address_from_string(&s->p2p_msg.daddr, "8589455699");
+
+	set_bitmap(&s->p2p_msg.param_bitmap,
+			CDMA_SMS_PARAM_ID_TELESERVICE_IDENTIFIER);
+	set_bitmap(&s->p2p_msg.param_bitmap,
+			CDMA_SMS_PARAM_ID_DESTINATION_ADDRESS);
+	set_bitmap(&s->p2p_msg.param_bitmap, CDMA_SMS_PARAM_ID_BEARER_DATA);
+
+	bd->id.msg_type = CDMA_SMS_MSG_TYPE_SUBMIT;
+	bd->id.msg_id = 1;
+	cdma_sms_encode_text(text, &bd->wmt_submit.ud);
+
+	set_bitmap(&bd->subparam_bitmap, CDMA_SMS_SUBPARAM_ID_MESSAGE_ID);
+	set_bitmap(&bd->subparam_bitmap, CDMA_SMS_SUBPARAM_ID_USER_DATA);
+}
+
+int main(int argc, char **argv)
+{
+	struct pdu_data deliver = { wmt_deliver, sizeof(wmt_deliver) };
+	struct pdu_data deliver_ts = { wmt_deliver_time_stamp,
+					sizeof(wmt_deliver_time_stamp) };
+	struct pdu_data submit_ascii;
+	struct pdu_data submit_ucs2;
+	struct cdma_sms ascii;
+	struct cdma_sms ucs2;
+	guint8 ascii_pdu[CDMA_SMS_PDU_MAX_LEN];
+	guint8 ucs2_pdu[CDMA_SMS_PDU_MAX_LEN];
+	int len;
+
+	bench_init(argc, argv);
+
+	prepare_submit(&ascii, ascii_text);
+	cdma_sms_encode(&ascii, ascii_pdu, &len);
+	submit_ascii.pdu = ascii_pdu;
+	submit_ascii.len = len;
+
+	prepare_submit(&ucs2, ucs2_text);
+	cdma_sms_encode(&ucs2, ucs2_pdu, &len);
+	submit_ucs2.pdu = ucs2_pdu;
+	submit_ucs2.len = len;
+
+	bench_run("cdma_sms_decode/wmt-deliver", bench_decode, &deliver);
+	bench_run("cdma_sms_decode/wmt-deliver-time-stamp", bench_decode,
+							&deliver_ts);
+	bench_run("cdma_sms_decode/wmt-submit-ascii-160", bench_decode,
+							&submit_ascii);
+	bench_run("cdma_sms_decode/wmt-submit-unicode", bench_decode,
+							&submit_ucs2);
+	bench_run("cdma_sms_encode/wmt-submit-ascii-160", bench_encode,
+							&ascii);
+	bench_run("cdma_sms_encode/wmt-submit-unicode", bench_encode, &ucs2);
+	bench_run("cdma_sms_encode_text/ascii-160", bench_encode_text,
+							(void *) ascii_text);
+	bench_run("cdma_sms_encode_text/unicode", bench_encode_text,
+							(void *) ucs2_text);
+	bench_run("cdma_sms_decode_text/ascii-160", bench_decode_text,
+						&ascii.p2p_msg.bd.wmt_submit.ud);
+	bench_run("cdma_sms_decode_text/unicode", bench_decode_text,
+						&ucs2.p2p_msg.bd.wmt_submit.ud);
+
+	return 0;
+}
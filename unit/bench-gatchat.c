@@ -0,0 +1,299 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "gatchat.h"
+#include "gathdlc.h"
+#include "gatserver.h"
+
+#include "bench.h"
+
+static const char *creg_line = "+CREG: 2,1,\"00C3\",\"0000AB12\",7";
+
+static const char *cops_line = "+COPS: (2,\"Operator A\",\"OpA\",\"23410\",7),"
+	"(1,\"Operator B\",\"OpB\",\"23415\",2),"
+	"(3,\"Operator C\",\"OpC\",\"23420\",0),"
+	"(1,\"Operator D\",\"OpD\",\"23430\",7),,(0-4),(0-2)";
+
+static const char *cmgl_line = "+CMGL: 1,1,,30";
+
+static const char *cmgl_pdu = "07911326040000F0040B911346610089F6000020806291"
+	"7314480CC8F71D14969741F977FD07";
+
+struct hdlc_data {
+	GAtHDLC *tx;
+	GAtHDLC *rx;
+	unsigned char frame[1500];
+	gboolean received;
+};
+
+static void bench_iter_creg(void *user_data)
+{
+	GAtResult *result = user_data;
+	GAtResultIter iter;
+	const char *lac;
+	const char *ci;
+	int mode;
+	int status;
+	int tech;
+
+	g_at_result_iter_init(&iter, result);
+	g_at_result_iter_next(&iter, "+CREG:");
+	g_at_result_iter_next_number(&iter, &mode);
+	g_at_result_iter_next_number(&iter, &status);
+	g_at_result_iter_next_string(&iter, &lac);
+	g_at_result_iter_next_string(&iter, &ci);
+	g_at_result_iter_next_number(&iter, &tech);
+}
+
+static void bench_iter_cops(void *user_data)
+{
+	GAtResult *result = user_data;
+	GAtResultIter iter;
+
+	g_at_result_iter_init(&iter, result);
+	g_at_result_iter_next(&iter, "+COPS:");
+
+	while (g_at_result_iter_open_list(&iter)) {
+		const char *l;
+		const char *s;
+		const char *num;
+		int stat;
+		int tech;
+
+		if (!g_at_result_iter_next_number(&iter, &stat))
+			break;
+
+		g_at_result_iter_next_string(&iter, &l);
+		g_at_result_iter_next_string(&iter, &s);
+		g_at_result_iter_next_string(&iter, &num);
+		g_at_result_iter_next_number_default(&iter, 0, &tech);
+		g_at_result_iter_close_list(&iter);
+	}
+}
+
+/* Mirrors the per-entry parsing done for PDU listings such as +CMGL */
+static void bench_iter_cmgl(void *user_data)
+{
+	GAtResult *result = user_data;
+	GAtResultIter iter;
+	const char *hexpdu;
+	int index;
+	int status;
+	int tpdu_len;
+
+	g_at_result_iter_init(&iter, result);
+
+	while (g_at_result_iter_next(&iter, "+CMGL:")) {
+		g_at_result_iter_next_number(&iter, &index);
+		g_at_result_iter_next_number(&iter, &status);
+		g_at_result_iter_skip_next(&iter);
+		g_at_result_iter_next_number(&iter, &tpdu_len);
+
+		hexpdu = g_at_result_pdu(result);
+		if (hexpdu == NULL)
+			break;
+	}
+}
+
+struct server_data {
+	GAtServer *server;
+	int fd;
+};
+
+static void server_cind_cb(GAtServer *server, GAtServerRequestType type,
+				GAtResult *result, gpointer user_data)
+{
+	g_at_server_send_info(server, "+CIND: 1,0,0,0,5,0,5", TRUE);
+	g_at_server_send_final(server, G_AT_SERVER_RESULT_OK);
+}
+
+/* An HFP style AT+CIND? query, up to the final OK reaching the client */
+static void bench_server_cind(void *user_data)
+{
+	static const char cmd[] = "AT+CIND?\r";
+	struct server_data *data = user_data;
+	char buf[256];
+	int len = 0;
+	ssize_t n;
+
+	if (write(data->fd, cmd, sizeof(cmd) - 1) != sizeof(cmd) - 1)
+		abort();
+
+	while (len < 6 || memcmp(buf + len - 6, "\r\nOK\r\n", 6) != 0) {
+		g_main_context_iteration(NULL, FALSE);
+
+		n = read(data->fd, buf + len, sizeof(buf) - len);
+		if (n > 0)
+			len += n;
+
+		if (len == sizeof(buf))
+			abort();
+	}
+}
+
+static gboolean setup_server(struct server_data *data)
+{
+	GIOChannel *channel;
+	int sk[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sk) < 0)
+		return FALSE;
+
+	fcntl(sk[1], F_SETFL, fcntl(sk[1], F_GETFL) | O_NONBLOCK);
+
+	channel = g_io_channel_unix_new(sk[0]);
+	data->server = g_at_server_new(channel);
+	g_io_channel_unref(channel);
+
+	if (data->server == NULL)
+		return FALSE;
+
+	g_at_server_set_echo(data->server, FALSE);
+	g_at_server_register(data->server, "+CIND", server_cind_cb,
+								NULL, NULL);
+
+	data->fd = sk[1];
+
+	return TRUE;
+}
+
+static void hdlc_received(const unsigned char *buf, gsize len, void *user_data)
+{
+	struct hdlc_data *data = user_data;
+
+	data->received = TRUE;
+}
+
+static void bench_hdlc_roundtrip(void *user_data)
+{
+	struct hdlc_data *data = user_data;
+
+	data->received = FALSE;
+	g_at_hdlc_send(data->tx, data->frame, sizeof(data->frame));
+
+	while (!data->received)
+		g_main_context_iteration(NULL, TRUE);
+}
+
+static GAtResult *build_result(const char *line, const char *final)
+{
+	GAtResult *result = g_new0(GAtResult, 1);
+
+	result->lines = g_slist_append(NULL, g_strdup(line));
+	result->final_or_pdu = g_strdup(final);
+
+	return result;
+}
+
+static void free_result(GAtResult *result)
+{
+	g_slist_free_full(result->lines, g_free);
+	g_free(result->final_or_pdu);
+	g_free(result);
+}
+
+static gboolean setup_hdlc(struct hdlc_data *data)
+{
+	GIOChannel *channel;
+	int sk[2];
+	unsigned int i;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sk) < 0)
+		return FALSE;
+
+	channel = g_io_channel_unix_new(sk[0]);
+	data->tx = g_at_hdlc_new(channel);
+	g_io_channel_unref(channel);
+
+	channel = g_io_channel_unix_new(sk[1]);
+	data->rx = g_at_hdlc_new(channel);
+	g_io_channel_unref(channel);
+
+	if (data->tx == NULL || data->rx == NULL)
+		return FALSE;
+
+	g_at_hdlc_set_receive(data->rx, hdlc_received, data);
+
+	/* Include some bytes that need escaping with the default ACCM */
+	for (i = 0; i < sizeof(data->frame); i++)
+		data->frame[i] = i * 7;
+
+	return TRUE;
+}
+
+int main(int argc, char **argv)
+{
+	GAtResult *creg_result;
+	GAtResult *cops_result;
+	GAtResult *cmgl_result;
+	struct hdlc_data hdlc;
+	struct server_data server;
+
+	bench_init(argc, argv);
+
+	creg_result = build_result(creg_line, "OK");
+	cops_result = build_result(cops_line, "OK");
+	cmgl_result = build_result(cmgl_line, cmgl_pdu);
+
+	bench_run("g_at_result_iter/creg", bench_iter_creg, creg_result);
+	bench_run("g_at_result_iter/cops-list", bench_iter_cops, cops_result);
+	bench_run("g_at_result_iter/cmgl-pdu", bench_iter_cmgl,
+							cmgl_result);
+
+	free_result(creg_result);
+	free_result(cops_result);
+	free_result(cmgl_result);
+
+	memset(&hdlc, 0, sizeof(hdlc));
+
+	if (!setup_hdlc(&hdlc)) {
+		fprintf(stderr, "Failed to set up HDLC socket pair\n");
+		return 1;
+	}
+
+	bench_run("g_at_hdlc/roundtrip-1500", bench_hdlc_roundtrip, &hdlc);
+
+	g_at_hdlc_unref(hdlc.tx);
+	g_at_hdlc_unref(hdlc.rx);
+
+	if (!setup_server(&server)) {
+		fprintf(stderr, "Failed to set up AT server socket pair\n");
+		return 1;
+	}
+
+	bench_run("g_at_server/cind-query", bench_server_cind, &server);
+
+	g_at_server_unref(server.server);
+	close(server.fd);
+
+	return 0;
+}
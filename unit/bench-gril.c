@@ -0,0 +1,127 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include <ofono/modem.h>
+#include <ofono/types.h>
+
+#include "common.h"
+#include "grilreply.h"
+
+#include "bench.h"
+
+/* Same wire data as the test-grilreply GET_CURRENT_CALLS case */
+static const guchar get_current_calls_parcel[] = {
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+	0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x09, 0x00, 0x00, 0x00, 0x36, 0x00, 0x38, 0x00, 0x36, 0x00, 0x37, 0x00,
+	0x33, 0x00, 0x32, 0x00, 0x32, 0x00, 0x32, 0x00, 0x32, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+	0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x09, 0x00, 0x00, 0x00, 0x39, 0x00, 0x31, 0x00, 0x37, 0x00, 0x35, 0x00,
+	0x32, 0x00, 0x35, 0x00, 0x35, 0x00, 0x35, 0x00, 0x35, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00
+};
+
+/* A DATA_REGISTRATION_STATE style reply: an array of strings */
+static const char *reg_state_strings[] = {
+	"1", "00C3", "0000AB12", "9", NULL, NULL, "20", NULL, NULL, NULL,
+	NULL, NULL, NULL, NULL, "1",
+};
+
+static void bench_parcel_ints(void *user_data)
+{
+	struct parcel *p = user_data;
+	int i;
+
+	p->offset = 0;
+	p->malformed = 0;
+
+	for (i = 0; i < 32; i++)
+		parcel_r_int32(p);
+}
+
+static void bench_parcel_str_array(void *user_data)
+{
+	struct parcel *p = user_data;
+
+	p->offset = 0;
+	p->malformed = 0;
+
+	parcel_free_str_array(parcel_r_str_array(p));
+}
+
+static void bench_reply_get_calls(void *user_data)
+{
+	const struct ril_msg *msg = user_data;
+	GSList *calls;
+
+	calls = g_ril_reply_parse_get_calls(NULL, msg);
+	g_slist_free_full(calls, g_free);
+}
+
+int main(int argc, char **argv)
+{
+	struct parcel ints;
+	struct parcel strings;
+	struct ril_msg msg;
+	unsigned int i;
+
+	bench_init(argc, argv);
+
+	parcel_init(&ints);
+
+	for (i = 0; i < 32; i++)
+		parcel_w_int32(&ints, i * 1000);
+
+	parcel_init(&strings);
+	parcel_w_int32(&strings, G_N_ELEMENTS(reg_state_strings));
+
+	for (i = 0; i < G_N_ELEMENTS(reg_state_strings); i++)
+		parcel_w_string(&strings, reg_state_strings[i]);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.buf = (gchar *) get_current_calls_parcel;
+	msg.buf_len = sizeof(get_current_calls_parcel);
+	msg.req = RIL_REQUEST_GET_CURRENT_CALLS;
+
+	bench_run("parcel_r_int32/32-ints", bench_parcel_ints, &ints);
+	bench_run("parcel_r_str_array/reg-state", bench_parcel_str_array,
+								&strings);
+	bench_run("g_ril_reply_parse_get_calls/2-calls",
+						bench_reply_get_calls, &msg);
+
+	parcel_free(&ints);
+	parcel_free(&strings);
+
+	return 0;
+}
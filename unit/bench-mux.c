@@ -0,0 +1,233 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "gatmux.h"
+#include "gsm0710.h"
+
+#include "bench.h"
+
+#define FRAME_SIZE	127
+#define FRAME_COUNT	32
+
+struct stream {
+	guint8 data[FRAME_COUNT * (FRAME_SIZE * 2 + 7)];
+	guint8 work[FRAME_COUNT * (FRAME_SIZE * 2 + 7)];
+	int len;
+	int payload;
+	int (*extract)(guint8 *data, int len, GSM0710FrameFunc func,
+							gpointer user_data);
+};
+
+struct mux_data {
+	GAtMux *mux;
+	GIOChannel *dlc;
+	int fd;
+	guint8 stream[FRAME_COUNT * (FRAME_SIZE + 7)];
+	int len;
+	int payload;
+	int received;
+};
+
+static void count_frame(guint8 dlc, guint8 control, const guint8 *frame,
+				int len, gpointer user_data)
+{
+	int *payload = user_data;
+
+	*payload += len;
+}
+
+/*
+ * The advanced decoder unquotes in place, so every iteration works on a
+ * fresh copy of the stream.  The basic one is given the same treatment
+ * to keep the numbers comparable.
+ */
+static void bench_extract(void *user_data)
+{
+	struct stream *s = user_data;
+	int payload = 0;
+
+	memcpy(s->work, s->data, s->len);
+	s->extract(s->work, s->len, count_frame, &payload);
+
+	if (payload != s->payload)
+		abort();
+}
+
+static void bench_fill_advanced(void *user_data)
+{
+	struct stream *s = user_data;
+
+	gsm0710_advanced_fill_frame(s->work, 1, GSM0710_DATA,
+					s->data, FRAME_SIZE);
+}
+
+static void fill_stream(struct stream *s, gboolean advanced)
+{
+	guint8 payload[FRAME_SIZE];
+	int i;
+
+	/* Roughly one byte in a hundred needs quoting in advanced mode */
+	for (i = 0; i < FRAME_SIZE; i++)
+		payload[i] = (i % 100) == 99 ? 0x7E : i;
+
+	s->len = 0;
+	s->payload = 0;
+
+	for (i = 0; i < FRAME_COUNT; i++) {
+		if (advanced)
+			s->len += gsm0710_advanced_fill_frame(s->data + s->len,
+							1, GSM0710_DATA,
+							payload, FRAME_SIZE);
+		else
+			s->len += gsm0710_basic_fill_frame(s->data + s->len,
+							1, GSM0710_DATA,
+							payload, FRAME_SIZE);
+
+		s->payload += FRAME_SIZE;
+	}
+
+	s->extract = advanced ? gsm0710_advanced_extract_frames :
+					gsm0710_basic_extract_frames;
+}
+
+static gboolean dlc_readable(GIOChannel *channel, GIOCondition cond,
+				gpointer user_data)
+{
+	struct mux_data *md = user_data;
+	char buf[4096];
+	gsize bytes_read;
+
+	if (cond & G_IO_NVAL)
+		return FALSE;
+
+	do {
+		bytes_read = 0;
+		g_io_channel_read_chars(channel, buf, sizeof(buf),
+						&bytes_read, NULL);
+		md->received += bytes_read;
+	} while (bytes_read > 0);
+
+	return TRUE;
+}
+
+/* Frames written to the mux socket up to data delivered on the DLC */
+static void bench_mux_throughput(void *user_data)
+{
+	struct mux_data *md = user_data;
+
+	md->received = 0;
+
+	if (write(md->fd, md->stream, md->len) != md->len)
+		abort();
+
+	while (md->received < md->payload)
+		g_main_context_iteration(NULL, TRUE);
+}
+
+static gboolean setup_mux(struct mux_data *md)
+{
+	GIOChannel *io;
+	guint8 payload[FRAME_SIZE];
+	int sk[2];
+	int i;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sk) < 0)
+		return FALSE;
+
+	fcntl(sk[0], F_SETFL, fcntl(sk[0], F_GETFL) | O_NONBLOCK);
+
+	io = g_io_channel_unix_new(sk[0]);
+	g_io_channel_set_encoding(io, NULL, NULL);
+	g_io_channel_set_buffered(io, FALSE);
+
+	md->mux = g_at_mux_new_gsm0710_basic(io, FRAME_SIZE);
+	g_io_channel_unref(io);
+
+	if (md->mux == NULL || !g_at_mux_start(md->mux))
+		return FALSE;
+
+	md->dlc = g_at_mux_create_channel(md->mux);
+	if (md->dlc == NULL)
+		return FALSE;
+
+	g_io_channel_set_encoding(md->dlc, NULL, NULL);
+	g_io_channel_set_buffered(md->dlc, FALSE);
+	g_io_add_watch(md->dlc, G_IO_IN, dlc_readable, md);
+
+	md->fd = sk[1];
+
+	/* Keep each batch below the per-DLC buffer size */
+	for (i = 0; i < FRAME_SIZE; i++)
+		payload[i] = i;
+
+	for (i = 0; i < 24; i++) {
+		md->len += gsm0710_basic_fill_frame(md->stream + md->len, 1,
+							GSM0710_DATA, payload,
+							FRAME_SIZE);
+		md->payload += FRAME_SIZE;
+	}
+
+	return TRUE;
+}
+
+int main(int argc, char **argv)
+{
+	static struct stream basic;
+	static struct stream advanced;
+	static struct mux_data md;
+
+	bench_init(argc, argv);
+
+	fill_stream(&basic, FALSE);
+	fill_stream(&advanced, TRUE);
+
+	bench_run("gsm0710_basic_extract_frames/32x127",
+					bench_extract, &basic);
+	bench_run("gsm0710_advanced_extract_frames/32x127",
+					bench_extract, &advanced);
+	bench_run("gsm0710_advanced_fill_frame/127",
+					bench_fill_advanced, &advanced);
+
+	if (!setup_mux(&md)) {
+		fprintf(stderr, "Failed to set up GSM 07.10 mux\n");
+		return 1;
+	}
+
+	bench_run("g_at_mux/basic-24x127", bench_mux_throughput, &md);
+
+	g_io_channel_unref(md.dlc);
+	g_at_mux_shutdown(md.mux);
+	g_at_mux_unref(md.mux);
+	close(md.fd);
+
+	return 0;
+}
@@ -0,0 +1,272 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "util.h"
+#include "smsutil.h"
+
+#include "bench.h"
+
+static const char *simple_deliver = "07911326040000F0"
+		"040B911346610089F60000208062917314480CC8F71D14969741F977FD07";
+
+static const char *assembly_pdus[] = {
+	"038121F340048155550119906041001222048C0500031E030104180442043004"
+	"3A002C00200410043B0435043A04410430043D04340440002000200441043B04"
+	"4304480430043B00200437043000200434043204350440044C044E0020002004"
+	"380020002004320441043500200431043E043B044C044804350020043F044004"
+	"3504380441043F043E043B043D044F043B0441044F002000200433043D0435",
+	"038121F340048155550119906041001222048C0500031E03020432043E043C00"
+	"2E000A041D0430043A043E043D04350446002C0020043D043500200432002004"
+	"410438043B04300445002004340430043B043504350020044204350440043F04"
+	"350442044C002C0020043E043D00200441044204400435043C04380442043504"
+	"3B044C043D043E002004320431043504360430043B002004320020043A043E",
+	"038121F340048155550119906041001222044A0500031E0303043C043D043004"
+	"420443002C0020043F043E043704300431044B0432000A043404300436043500"
+	"2C002004470442043E002000200431044B043B0020043D04300433002E",
+};
+
+static const int assembly_tpdu_len[] = { 155, 155, 89 };
+
+static const char *cbs1 = "011000320111C2327BFC76BBCBEE46A3D168341A8D46A3D1683"
+	"41A8D46A3D168341A8D46A3D168341A8D46A3D168341A8D46A3D168341A8D46A3D168"
+	"341A8D46A3D168341A8D46A3D168341A8D46A3D168341A8D46A3D100";
+
+static const char *long_text = "The quick brown fox jumps over the lazy "
+	"dog. The quick brown fox jumps over the lazy dog. The quick brown "
+	"fox jumps over the lazy dog. The quick brown fox jumps over the lazy "
+	"dog. The quick brown fox jumps over the lazy dog. The quick brown "
+	"fox jumps over the lazy dog.";
+
+static const char *ucs2_text = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5"
+	"\xd1\x82, \xd0\xbc\xd0\xb8\xd1\x80! \xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2"
+	"\xd0\xb5\xd1\x82, \xd0\xbc\xd0\xb8\xd1\x80!";
+
+struct pdu_data {
+	unsigned char pdu[640];
+	long len;
+	int tpdu_len;
+	struct sms sms;
+};
+
+static void bench_sms_decode(void *user_data)
+{
+	struct pdu_data *data = user_data;
+	struct sms sms;
+
+	sms_decode(data->pdu, data->len, FALSE, data->tpdu_len, &sms);
+}
+
+static void bench_sms_encode(void *user_data)
+{
+	struct pdu_data *data = user_data;
+	unsigned char pdu[176];
+	int len;
+	int tpdu_len;
+
+	sms_encode(&data->sms, &len, &tpdu_len, pdu);
+}
+
+static void bench_sms_text_prepare(void *user_data)
+{
+	const char *text = user_data;
+	GSList *l;
+
+	l = sms_text_prepare("+15554449999", text, 0, FALSE, FALSE);
+	g_slist_free_full(l, g_free);
+}
+
+static void bench_sms_assembly(void *user_data)
+{
+	struct pdu_data *data = user_data;
+	struct sms_assembly *assembly = sms_assembly_new(NULL);
+	guint16 ref;
+	guint8 max;
+	guint8 seq;
+	GSList *l = NULL;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		struct sms *sms = &data[i].sms;
+
+		sms_extract_concatenation(sms, &ref, &max, &seq);
+		l = sms_assembly_add_fragment(assembly, sms, 0,
+						&sms->deliver.oaddr,
+						ref, max, seq);
+	}
+
+	g_slist_free_full(l, g_free);
+	sms_assembly_free(assembly);
+}
+
+static void bench_cbs_decode(void *user_data)
+{
+	struct pdu_data *data = user_data;
+	struct cbs cbs;
+
+	cbs_decode(data->pdu, data->len, &cbs);
+}
+
+static void bench_cbs_assembly(void *user_data)
+{
+	struct pdu_data *data = user_data;
+	struct cbs_assembly *assembly = cbs_assembly_new();
+	struct cbs cbs;
+	GSList *l;
+
+	cbs_decode(data->pdu, data->len, &cbs);
+	l = cbs_assembly_add_page(assembly, &cbs);
+
+	g_slist_free_full(l, g_free);
+	cbs_assembly_free(assembly);
+}
+
+static void bench_cbs_topic_in_range(void *user_data)
+{
+	GSList *ranges = user_data;
+	unsigned int topic;
+
+	for (topic = 0; topic < 1000; topic += 7)
+		cbs_topic_in_range(topic, ranges);
+}
+
+static void bench_cbs_topic_index(void *user_data)
+{
+	const struct cbs_topic_index *index = user_data;
+	unsigned int topic;
+
+	for (topic = 0; topic < 1000; topic += 7)
+		cbs_topic_index_contains(index, topic);
+}
+
+static void bench_gsm_to_utf8(void *user_data)
+{
+	struct pdu_data *data = user_data;
+
+	g_free(convert_gsm_to_utf8(data->pdu, data->len, NULL, NULL, 0));
+}
+
+static void bench_utf8_to_gsm(void *user_data)
+{
+	const char *text = user_data;
+
+	g_free(convert_utf8_to_gsm(text, -1, NULL, NULL, 0));
+}
+
+static void bench_utf8_to_ucs2(void *user_data)
+{
+	const char *text = user_data;
+
+	g_free(g_convert(text, -1, "UCS-2BE", "UTF-8", NULL, NULL, NULL));
+}
+
+static void bench_ucs2_to_gsm(void *user_data)
+{
+	struct pdu_data *data = user_data;
+
+	g_free(convert_ucs2_to_gsm(data->pdu, data->len, NULL, NULL, 0));
+}
+
+static void load_pdu(struct pdu_data *data, const char *hex, int tpdu_len)
+{
+	decode_hex_own_buf(hex, -1, &data->len, 0, data->pdu);
+	data->tpdu_len = tpdu_len;
+}
+
+int main(int argc, char **argv)
+{
+	struct pdu_data deliver;
+	struct pdu_data fragments[3];
+	struct pdu_data cbs;
+	struct pdu_data gsm;
+	struct pdu_data ucs2;
+	unsigned char *buf;
+	long len;
+	gsize written;
+	GSList *ranges;
+	struct cbs_topic_index *index;
+	int i;
+
+	bench_init(argc, argv);
+
+	load_pdu(&deliver, simple_deliver, 30);
+	sms_decode(deliver.pdu, deliver.len, FALSE, deliver.tpdu_len,
+							&deliver.sms);
+
+	for (i = 0; i < 3; i++) {
+		load_pdu(&fragments[i], assembly_pdus[i], assembly_tpdu_len[i]);
+		sms_decode(fragments[i].pdu, fragments[i].len, FALSE,
+				fragments[i].tpdu_len, &fragments[i].sms);
+	}
+
+	load_pdu(&cbs, cbs1, 0);
+
+	buf = convert_utf8_to_gsm(long_text, -1, NULL, &len, 0);
+	memcpy(gsm.pdu, buf, MIN(len, (long) sizeof(gsm.pdu)));
+	gsm.len = MIN(len, (long) sizeof(gsm.pdu));
+	g_free(buf);
+
+	buf = (unsigned char *) g_convert(long_text, -1, "UCS-2BE", "UTF-8",
+						NULL, &written, NULL);
+	memcpy(ucs2.pdu, buf, MIN(written, sizeof(ucs2.pdu)));
+	ucs2.len = MIN(written, sizeof(ucs2.pdu));
+	g_free(buf);
+
+	ranges = cbs_extract_topic_ranges("0,1,5,20-23,50,100-200,300,"
+						"500-600,4352-4356,4370");
+
+	bench_run("sms_decode/deliver", bench_sms_decode, &deliver);
+	bench_run("sms_decode/concat-ucs2", bench_sms_decode, &fragments[0]);
+	bench_run("sms_encode/deliver", bench_sms_encode, &deliver);
+	bench_run("sms_encode/concat-ucs2", bench_sms_encode, &fragments[0]);
+	bench_run("sms_text_prepare/gsm-3-segments", bench_sms_text_prepare,
+						(void *) long_text);
+	bench_run("sms_text_prepare/ucs2", bench_sms_text_prepare,
+						(void *) ucs2_text);
+	bench_run("sms_assembly_add_fragment/3-segments",
+					bench_sms_assembly, fragments);
+	bench_run("cbs_decode", bench_cbs_decode, &cbs);
+	bench_run("cbs_assembly_add_page", bench_cbs_assembly, &cbs);
+	bench_run("cbs_topic_in_range/143-lookups", bench_cbs_topic_in_range,
+						ranges);
+
+	index = cbs_topic_index_new(ranges);
+	bench_run("cbs_topic_index_contains/143-lookups",
+					bench_cbs_topic_index, index);
+	cbs_topic_index_free(index);
+	bench_run("convert_gsm_to_utf8", bench_gsm_to_utf8, &gsm);
+	bench_run("convert_utf8_to_gsm", bench_utf8_to_gsm,
+						(void *) long_text);
+	bench_run("convert_utf8_to_ucs2", bench_utf8_to_ucs2,
+						(void *) ucs2_text);
+	bench_run("convert_ucs2_to_gsm", bench_ucs2_to_gsm, &ucs2);
+
+	g_slist_free_full(ranges, g_free);
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include <ofono/types.h>
+
+#include "smsutil.h"
+#include "stkutil.h"
+
+#include "stk-test-data.h"
+
+#include "bench.h"
+
+struct pdu {
+	const unsigned char *data;
+	unsigned int len;
+};
+
+static const unsigned char select_item_111[] = {
+	0xD0, 0x3D, 0x81, 0x03, 0x01, 0x24, 0x00, 0x82, 0x02, 0x81, 0x82,
+	0x85, 0x0E, 0x54, 0x6F, 0x6F, 0x6C, 0x6B, 0x69, 0x74, 0x20, 0x53,
+	0x65, 0x6C, 0x65, 0x63, 0x74, 0x8F, 0x07, 0x01, 0x49, 0x74, 0x65,
+	0x6D, 0x20, 0x31, 0x8F, 0x07, 0x02, 0x49, 0x74, 0x65, 0x6D, 0x20,
+	0x32, 0x8F, 0x07, 0x03, 0x49, 0x74, 0x65, 0x6D, 0x20, 0x33, 0x8F,
+	0x07, 0x04, 0x49, 0x74, 0x65, 0x6D, 0x20, 0x34,
+};
+
+static const unsigned char send_sms_111[] = {
+	0xD0, 0x37, 0x81, 0x03, 0x01, 0x13, 0x00, 0x82, 0x02, 0x81, 0x83,
+	0x85, 0x07, 0x53, 0x65, 0x6E, 0x64, 0x20, 0x53, 0x4D, 0x86, 0x09,
+	0x91, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0xF8, 0x8B, 0x18,
+	0x01, 0x00, 0x09, 0x91, 0x10, 0x32, 0x54, 0x76, 0xF8, 0x40, 0xF4,
+	0x0C, 0x54, 0x65, 0x73, 0x74, 0x20, 0x4D, 0x65, 0x73, 0x73, 0x61,
+	0x67, 0x65,
+};
+
+static const struct pdu display_text = {
+	display_text_111, sizeof(display_text_111)
+};
+
+static const struct pdu select_item = {
+	select_item_111, sizeof(select_item_111)
+};
+
+static const struct pdu send_sms = {
+	send_sms_111, sizeof(send_sms_111)
+};
+
+static void bench_command_parse(void *user_data)
+{
+	const struct pdu *pdu = user_data;
+	struct stk_command *command;
+
+	command = stk_command_new_from_pdu(pdu->data, pdu->len);
+	stk_command_free(command);
+}
+
+static void bench_envelope_build(void *user_data)
+{
+	const struct stk_envelope *envelope = user_data;
+	unsigned int len;
+
+	stk_pdu_from_envelope(envelope, &len);
+}
+
+int main(int argc, char **argv)
+{
+	struct stk_envelope menu_selection;
+	struct stk_command *command;
+
+	bench_init(argc, argv);
+
+	/* Sanity check the inputs, a parse failure would skew the numbers */
+	command = stk_command_new_from_pdu(select_item.data, select_item.len);
+	if (command == NULL || command->status != STK_PARSE_RESULT_OK) {
+		fprintf(stderr, "Failed to parse benchmark PDU\n");
+		return 1;
+	}
+
+	stk_command_free(command);
+
+	memset(&menu_selection, 0, sizeof(menu_selection));
+	menu_selection.type = STK_ENVELOPE_TYPE_MENU_SELECTION;
+	menu_selection.src = STK_DEVICE_IDENTITY_TYPE_KEYPAD;
+	menu_selection.dst = STK_DEVICE_IDENTITY_TYPE_UICC;
+	menu_selection.menu_selection.item_id = 0x2;
+
+	bench_run("stk_command_new_from_pdu/display-text",
+				bench_command_parse, (void *) &display_text);
+	bench_run("stk_command_new_from_pdu/select-item",
+				bench_command_parse, (void *) &select_item);
+	bench_run("stk_command_new_from_pdu/send-sms",
+				bench_command_parse, (void *) &send_sms);
+	bench_run("stk_pdu_from_envelope/menu-selection",
+				bench_envelope_build, &menu_selection);
+
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Minimal micro-benchmark harness shared by the unit/bench-* programs.
+ *
+ * Each benchmark is run for roughly BENCH_TIME_MS (overridable through the
+ * OFONO_BENCH_TIME environment variable) a number of times and the fastest
+ * round is reported, which keeps the numbers stable on a loaded machine.
+ * Heap allocations are counted by interposing the glibc allocator, so
+ * g_malloc and friends are included.  Any non-option arguments given to the
+ * program are used as substring filters on the benchmark names.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#define BENCH_TIME_MS		200
+#define BENCH_ROUNDS		5
+
+typedef void (*bench_func_t)(void *data);
+
+static unsigned long bench_allocs;
+static unsigned int bench_time_ms = BENCH_TIME_MS;
+static char **bench_filters;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+	bench_allocs += 1;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	bench_allocs += 1;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	bench_allocs += 1;
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+static inline guint64 bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (guint64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_init(int argc, char **argv)
+{
+	const char *env;
+
+	/* Make slice allocations visible to the allocation counter */
+	setenv("G_SLICE", "always-malloc", 1);
+
+	env = getenv("OFONO_BENCH_TIME");
+	if (env != NULL && atoi(env) > 0)
+		bench_time_ms = atoi(env);
+
+	if (argc > 1)
+		bench_filters = argv + 1;
+
+	printf("%-44s %12s %12s %10s\n", "benchmark", "iterations",
+						"ns/op", "allocs/op");
+}
+
+static gboolean bench_selected(const char *name)
+{
+	char **filter;
+
+	if (bench_filters == NULL)
+		return TRUE;
+
+	for (filter = bench_filters; *filter; filter++)
+		if (strstr(name, *filter) != NULL)
+			return TRUE;
+
+	return FALSE;
+}
+
+static guint64 bench_loop(bench_func_t func, void *data, unsigned long n)
+{
+	guint64 start = bench_now();
+	unsigned long i;
+
+	for (i = 0; i < n; i++)
+		func(data);
+
+	return bench_now() - start;
+}
+
+static void bench_run(const char *name, bench_func_t func, void *data)
+{
+	guint64 target = (guint64) bench_time_ms * 1000000ULL;
+	unsigned long iterations = 1;
+	unsigned long allocs;
+	guint64 elapsed;
+	guint64 best = G_MAXUINT64;
+	int round;
+
+	if (!bench_selected(name))
+		return;
+
+	/* Warm up caches and any lazily initialized state */
+	func(data);
+
+	/* Calibrate to about a tenth of the target, then scale up */
+	while ((elapsed = bench_loop(func, data, iterations)) < target / 10 &&
+			iterations < G_MAXULONG / 2)
+		iterations *= 2;
+
+	if (elapsed > 0)
+		iterations = MAX(1, iterations * (target / elapsed));
+
+	allocs = bench_allocs;
+	elapsed = bench_loop(func, data, iterations);
+	allocs = bench_allocs - allocs;
+	best = elapsed;
+
+	for (round = 1; round < BENCH_ROUNDS; round++) {
+		elapsed = bench_loop(func, data, iterations);
+
+		if (elapsed < best)
+			best = elapsed;
+	}
+
+	printf("%-44s %12lu %12.1f %10.2f\n", name, iterations,
+				(double) best / iterations,
+				(double) allocs / iterations);
+	fflush(stdout);
+}
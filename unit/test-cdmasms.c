@@ -100,6 +100,223 @@ static void test_wmt_deliver(gconstpointer data)
 	g_free(message);
 }
 
+static void test_wmt_deliver_encode(void)
+{
+	struct cdma_sms s;
+	guint8 pdu[CDMA_SMS_PDU_MAX_LEN];
+	int len;
+
+	memset(&s, 0, sizeof(struct cdma_sms));
+
+	g_assert(cdma_sms_decode(wmt_deliver_1, sizeof(wmt_deliver_1), &s));
+	g_assert(cdma_sms_encode(&s, pdu, &len));
+
+	g_assert(len == sizeof(wmt_deliver_1));
+	g_assert(memcmp(pdu, wmt_deliver_1, len) == 0);
+}
+
+static void test_wmt_deliver_time_stamp(void)
+{
+	struct cdma_sms s;
+	const struct cdma_sms_time_stamp *ts;
+
+	memset(&s, 0, sizeof(struct cdma_sms));
+
+	g_assert(cdma_sms_decode(wmt_deliver_2, sizeof(wmt_deliver_2), &s));
+
+	g_assert(check_bitmap(s.p2p_msg.bd.subparam_bitmap,
+				CDMA_SMS_SUBPARAM_ID_MC_TIME_STAMP));
+
+	ts = &s.p2p_msg.bd.wmt_deliver.mc_time;
+	g_assert(ts->year == 3);
+	g_assert(ts->month == 8);
+	g_assert(ts->day == 20);
+	g_assert(ts->hour == 13);
+	g_assert(ts->minute == 43);
+	g_assert(ts->second == 12);
+}
+
+struct wmt_submit_test {
+	const char *text;
+	const char *daddr;
+	enum cdma_sms_msg_encoding encoding;
+	guint8 num_fields;
+};
+
+static struct wmt_submit_test wmt_submit_ascii = {
+	.text = "Hello, world",
+	.daddr = "8589455699",
+	.encoding = CDMA_SMS_MSG_ENCODING_7BIT_ASCII,
+	.num_fields = 12,
+};
+
+static struct wmt_submit_test wmt_submit_latin = {
+	.text = "Gr\xc3\xbc\xc3\x9f Gott",
+	.daddr = "+358401234567",
+	.encoding = CDMA_SMS_MSG_ENCODING_LATIN,
+	.num_fields = 9,
+};
+
+static struct wmt_submit_test wmt_submit_unicode = {
+	.text = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 "
+		"\xf0\x9f\x98\x80",
+	.daddr = "*86#",
+	.encoding = CDMA_SMS_MSG_ENCODING_UNICODE,
+	.num_fields = 9,
+};
+
+static void test_wmt_submit(gconstpointer data)
+{
+	const struct wmt_submit_test *test = data;
+	struct cdma_sms s;
+	struct cdma_sms_bearer_data *bd = &s.p2p_msg.bd;
+	guint8 pdu[CDMA_SMS_PDU_MAX_LEN];
+	char *message;
+	int len;
+
+	memset(&s, 0, sizeof(struct cdma_sms));
+
+	s.type = CDMA_SMS_TP_MSG_TYPE_P2P;
+	s.p2p_msg.teleservice_id = CDMA_SMS_TELESERVICE_ID_WMT;
+	set_bitmap(&s.p2p_msg.param_bitmap,
+			CDMA_SMS_PARAM_ID_TELESERVICE_IDENTIFIER);
+
+	g_assert(cdma_sms_address_from_string(&s.p2p_msg.daddr, test->daddr));
+	set_bitmap(&s.p2p_msg.param_bitmap,
+			CDMA_SMS_PARAM_ID_DESTINATION_ADDRESS);
+	set_bitmap(&s.p2p_msg.param_bitmap, CDMA_SMS_PARAM_ID_BEARER_DATA);
+
+	bd->id.msg_type = CDMA_SMS_MSG_TYPE_SUBMIT;
+	bd->id.msg_id = 0xbeef;
+	set_bitmap(&bd->subparam_bitmap, CDMA_SMS_SUBPARAM_ID_MESSAGE_ID);
+
+	g_assert(cdma_sms_encode_text(test->text, &bd->wmt_submit.ud));
+	g_assert(bd->wmt_submit.ud.msg_encoding == test->encoding);
+	g_assert(bd->wmt_submit.ud.num_fields == test->num_fields);
+	set_bitmap(&bd->subparam_bitmap, CDMA_SMS_SUBPARAM_ID_USER_DATA);
+
+	bd->wmt_submit.priority = CDMA_SMS_PRIORITY_URGENT;
+	set_bitmap(&bd->subparam_bitmap,
+			CDMA_SMS_SUBPARAM_ID_PRIORITY_INDICATOR);
+
+	bd->wmt_submit.reply_option.dak_req = TRUE;
+	set_bitmap(&bd->subparam_bitmap, CDMA_SMS_SUBPARAM_ID_REPLY_OPTION);
+
+	g_assert(cdma_sms_encode(&s, pdu, &len));
+
+	memset(&s, 0, sizeof(struct cdma_sms));
+
+	g_assert(cdma_sms_decode(pdu, len, &s));
+
+	g_assert(s.type == CDMA_SMS_TP_MSG_TYPE_P2P);
+	g_assert(s.p2p_msg.teleservice_id == CDMA_SMS_TELESERVICE_ID_WMT);
+	g_assert(bd->id.msg_type == CDMA_SMS_MSG_TYPE_SUBMIT);
+	g_assert(bd->id.msg_id == 0xbeef);
+	g_assert(bd->wmt_submit.priority == CDMA_SMS_PRIORITY_URGENT);
+	g_assert(bd->wmt_submit.reply_option.dak_req == TRUE);
+	g_assert(bd->wmt_submit.reply_option.user_ack_req == FALSE);
+	g_assert(check_bitmap(bd->subparam_bitmap,
+			CDMA_SMS_SUBPARAM_ID_PRIVACY_INDICATOR) == FALSE);
+
+	check_text(cdma_sms_address_to_string(&s.p2p_msg.daddr), test->daddr);
+
+	message = cdma_sms_decode_text(&bd->wmt_submit.ud);
+	check_text(message, test->text);
+
+	g_free(message);
+}
+
+static void test_encode_limits(void)
+{
+	struct cdma_sms_ud ud;
+	struct cdma_sms_address addr;
+	char text[162];
+
+	memset(text, 'a', 160);
+	text[160] = '\0';
+	g_assert(cdma_sms_encode_text(text, &ud));
+	g_assert(ud.num_fields == 160);
+
+	text[160] = 'a';
+	text[161] = '\0';
+	g_assert(cdma_sms_encode_text(text, &ud) == FALSE);
+
+	g_assert(cdma_sms_encode_text("\xff", &ud) == FALSE);
+
+	g_assert(cdma_sms_address_from_string(&addr, "") == FALSE);
+	g_assert(cdma_sms_address_from_string(&addr, "+") == FALSE);
+	g_assert(cdma_sms_address_from_string(&addr, "555-1234") == FALSE);
+}
+
+static void test_decode_invalid(void)
+{
+	struct cdma_sms s;
+	guint8 pdu[sizeof(wmt_deliver_1)];
+
+	memset(&s, 0, sizeof(struct cdma_sms));
+	g_assert(cdma_sms_decode(wmt_deliver_1, 0, &s) == FALSE);
+
+	/* User data claiming more fields than its record holds */
+	memcpy(pdu, wmt_deliver_1, sizeof(pdu));
+	pdu[22] = 0x34;
+	memset(&s, 0, sizeof(struct cdma_sms));
+	g_assert(cdma_sms_decode(pdu, sizeof(pdu), &s) == FALSE);
+
+	/* No address at all */
+	memcpy(pdu, wmt_deliver_1, sizeof(pdu));
+	pdu[5] = CDMA_SMS_PARAM_ID_SERVICE_CATEGORY;
+	memset(&s, 0, sizeof(struct cdma_sms));
+	g_assert(cdma_sms_decode(pdu, sizeof(pdu), &s) == FALSE);
+
+	/* A DELIVER needs the originating address */
+	memcpy(pdu, wmt_deliver_1, sizeof(pdu));
+	pdu[5] = CDMA_SMS_PARAM_ID_DESTINATION_ADDRESS;
+	memset(&s, 0, sizeof(struct cdma_sms));
+	g_assert(cdma_sms_decode(pdu, sizeof(pdu), &s) == FALSE);
+}
+
+static void test_decode_bad_time_stamp(void)
+{
+	struct cdma_sms s;
+	guint8 pdu[sizeof(wmt_deliver_2)];
+	char *message;
+
+	/* Invalid BCD digit in the month, the message is still delivered */
+	memcpy(pdu, wmt_deliver_2, sizeof(pdu));
+	pdu[32] = 0x0A;
+
+	memset(&s, 0, sizeof(struct cdma_sms));
+	g_assert(cdma_sms_decode(pdu, sizeof(pdu), &s));
+
+	g_assert(!check_bitmap(s.p2p_msg.bd.subparam_bitmap,
+				CDMA_SMS_SUBPARAM_ID_MC_TIME_STAMP));
+
+	message = cdma_sms_decode_text(&s.p2p_msg.bd.wmt_deliver.ud);
+	check_text(message, "Test");
+	g_free(message);
+}
+
+static void test_address_to_string(void)
+{
+	struct cdma_sms_address addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.digit_mode = CDMA_SMS_DIGIT_MODE_8BIT_ASCII;
+	addr.number_mode = CDMA_SMS_NUM_MODE_DIGIT;
+	addr.digi_num_type = CDMA_SMS_DIGI_NUM_TYPE_INTERNATIONAL;
+	addr.num_fields = 3;
+	memcpy(addr.address, "123", 3);
+
+	check_text(cdma_sms_address_to_string(&addr), "+123");
+
+	/* Not valid UTF-8, which D-Bus would choke on */
+	addr.address[1] = 0xc3;
+	g_assert(cdma_sms_address_to_string(&addr) == NULL);
+
+	addr.address[1] = '\n';
+	g_assert(cdma_sms_address_to_string(&addr) == NULL);
+}
+
 int main(int argc, char **argv)
 {
 	g_test_init(&argc, &argv, NULL);
@@ -110,5 +327,28 @@ int main(int argc, char **argv)
 	g_test_add_data_func("/test-cdmasms/WMT DELIVER 2",
 			&wmt_deliver_data_2, test_wmt_deliver);
 
+	g_test_add_func("/test-cdmasms/WMT DELIVER encode",
+			test_wmt_deliver_encode);
+
+	g_test_add_func("/test-cdmasms/WMT DELIVER time stamp",
+			test_wmt_deliver_time_stamp);
+
+	g_test_add_data_func("/test-cdmasms/WMT SUBMIT ASCII",
+			&wmt_submit_ascii, test_wmt_submit);
+
+	g_test_add_data_func("/test-cdmasms/WMT SUBMIT Latin",
+			&wmt_submit_latin, test_wmt_submit);
+
+	g_test_add_data_func("/test-cdmasms/WMT SUBMIT Unicode",
+			&wmt_submit_unicode, test_wmt_submit);
+
+	g_test_add_func("/test-cdmasms/Encode limits", test_encode_limits);
+
+	g_test_add_func("/test-cdmasms/Decode invalid", test_decode_invalid);
+	g_test_add_func("/test-cdmasms/Decode bad time stamp",
+			test_decode_bad_time_stamp);
+	g_test_add_func("/test-cdmasms/Address to string",
+			test_address_to_string);
+
 	return g_test_run();
 }
@@ -554,6 +554,80 @@ static void test_extract_advanced(void)
 	g_assert(total == sizeof(advanced_input2) - 1);
 }
 
+struct extract_data {
+	int frames;
+	int len;
+	guint8 buf[64];
+};
+
+static void extract_frame_cb(guint8 dlc, guint8 control,
+				const guint8 *frame, int len,
+				gpointer user_data)
+{
+	struct extract_data *ed = user_data;
+
+	g_assert(dlc == 1);
+	g_assert(control == GSM0710_DATA);
+	g_assert(ed->len + len <= (int) sizeof(ed->buf));
+
+	memcpy(ed->buf + ed->len, frame, len);
+	ed->len += len;
+	ed->frames += 1;
+}
+
+static void test_extract_frames_basic(void)
+{
+	struct extract_data ed;
+	guint8 input[sizeof(basic_input2)];
+	int nread;
+
+	memset(&ed, 0, sizeof(ed));
+	memcpy(input, basic_input2, sizeof(input));
+
+	nread = gsm0710_basic_extract_frames(input, sizeof(input),
+						extract_frame_cb, &ed);
+
+	/* The closing flag of the last frame is left in the buffer */
+	g_assert(nread == sizeof(input) - 1);
+	g_assert(ed.frames == 2);
+	g_assert(ed.len == 2 * sizeof(basic_output));
+	g_assert(memcmp(ed.buf, basic_output, sizeof(basic_output)) == 0);
+	g_assert(memcmp(ed.buf + sizeof(basic_output), basic_output,
+						sizeof(basic_output)) == 0);
+}
+
+static void test_extract_frames_advanced(void)
+{
+	struct extract_data ed;
+	guint8 input[64];
+	int size;
+	int nread;
+
+	/* Two quoted frames sharing a flag, followed by a partial one */
+	size = gsm0710_advanced_fill_frame(input, 1, GSM0710_DATA,
+						advanced_quoted_data,
+						sizeof(advanced_quoted_data));
+	size += gsm0710_advanced_fill_frame(input + size - 1, 1, GSM0710_DATA,
+						advanced_quoted_data,
+						sizeof(advanced_quoted_data)) - 1;
+	input[size++] = 0x07;
+	input[size++] = 0xEF;
+
+	memset(&ed, 0, sizeof(ed));
+
+	nread = gsm0710_advanced_extract_frames(input, size,
+						extract_frame_cb, &ed);
+
+	g_assert(nread == size - 3);
+	g_assert(ed.frames == 2);
+	g_assert(ed.len == 2 * sizeof(advanced_quoted_data));
+	g_assert(memcmp(ed.buf, advanced_quoted_data,
+					sizeof(advanced_quoted_data)) == 0);
+	g_assert(memcmp(ed.buf + sizeof(advanced_quoted_data),
+					advanced_quoted_data,
+					sizeof(advanced_quoted_data)) == 0);
+}
+
 int main(int argc, char **argv)
 {
 	g_test_init(&argc, &argv, NULL);
@@ -562,6 +636,10 @@ int main(int argc, char **argv)
 	g_test_add_func("/testmux/fill_advanced", test_fill_advanced);
 	g_test_add_func("/testmux/extract_basic", test_extract_basic);
 	g_test_add_func("/testmux/extract_advanced", test_extract_advanced);
+	g_test_add_func("/testmux/extract_frames_basic",
+					test_extract_frames_basic);
+	g_test_add_func("/testmux/extract_frames_advanced",
+					test_extract_frames_advanced);
 	g_test_add_func("/testmux/basic", test_basic);
 	g_test_add_func("/testmux/basic:subprocess", test_mux);
 
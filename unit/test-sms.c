@@ -1478,7 +1478,7 @@ static void test_cbs_assembly(void)
 	/* Add an initial page to the assembly */
 	l = cbs_assembly_add_page(assembly, &dec1);
 	g_assert(l);
-	g_assert(g_slist_length(assembly->recv_cell) == 1);
+	g_assert(g_hash_table_size(assembly->recv_cell) == 1);
 	g_slist_foreach(l, (GFunc)g_free, NULL);
 	g_slist_free(l);
 
@@ -1486,7 +1486,7 @@ static void test_cbs_assembly(void)
 	dec1.update_number = 8;
 	l = cbs_assembly_add_page(assembly, &dec1);
 	g_assert(l);
-	g_assert(g_slist_length(assembly->recv_cell) == 1);
+	g_assert(g_hash_table_size(assembly->recv_cell) == 1);
 	g_slist_foreach(l, (GFunc)g_free, NULL);
 	g_slist_free(l);
 
@@ -1500,7 +1500,7 @@ static void test_cbs_assembly(void)
 	g_assert(l == NULL);
 
 	cbs_assembly_location_changed(assembly, TRUE, TRUE, TRUE);
-	g_assert(assembly->recv_cell == NULL);
+	g_assert(g_hash_table_size(assembly->recv_cell) == 0);
 
 	dec1.update_number = 9;
 	dec1.page = 3;
@@ -1631,6 +1631,46 @@ static void test_range_minimizer(void)
 	}
 }
 
+static void test_topic_index(void)
+{
+	struct cbs_topic_range unsorted[] = {
+		{ 4352, 4356 }, { 50, 60 }, { 1, 5 }, { 6, 10 }, { 55, 70 },
+		{ 999, 999 },
+	};
+	struct cbs_topic_index *index;
+	GSList *l = NULL;
+	unsigned int i;
+
+	for (i = 0; i < G_N_ELEMENTS(unsorted); i++)
+		l = g_slist_prepend(l, &unsorted[i]);
+
+	index = cbs_topic_index_new(l);
+	g_slist_free(l);
+
+	/* 1-5 and 6-10 are adjacent, 50-60 and 55-70 overlap */
+	g_assert(index->len == 4);
+	g_assert(index->ranges[0].min == 1 && index->ranges[0].max == 10);
+	g_assert(index->ranges[1].min == 50 && index->ranges[1].max == 70);
+
+	g_assert(!cbs_topic_index_contains(index, 0));
+	g_assert(cbs_topic_index_contains(index, 1));
+	g_assert(cbs_topic_index_contains(index, 7));
+	g_assert(!cbs_topic_index_contains(index, 11));
+	g_assert(cbs_topic_index_contains(index, 70));
+	g_assert(!cbs_topic_index_contains(index, 71));
+	g_assert(cbs_topic_index_contains(index, 999));
+	g_assert(cbs_topic_index_contains(index, 4354));
+	g_assert(!cbs_topic_index_contains(index, 4357));
+
+	cbs_topic_index_free(index);
+
+	index = cbs_topic_index_new(NULL);
+	g_assert(!cbs_topic_index_contains(index, 0));
+	cbs_topic_index_free(index);
+
+	g_assert(!cbs_topic_index_contains(NULL, 0));
+}
+
 static void test_sr_assembly(void)
 {
 	const char *sr_pdu1 = "06040D91945152991136F00160124130340A0160124130"
@@ -1890,6 +1930,7 @@ int main(int argc, char **argv)
 			test_cbs_padding_character);
 
 	g_test_add_func("/testsms/Range minimizer", test_range_minimizer);
+	g_test_add_func("/testsms/Topic index", test_topic_index);
 
 	g_test_add_func("/testsms/Status Report Assembly", test_sr_assembly);
 
@@ -0,0 +1,199 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "strtable.h"
+
+static const char *entries[][2] = {
+	{ "310260", "T-Mobile" },
+	{ "31026", "Short MNC" },
+	{ "23415", "Vodafone" },
+	{ "23410", "O2 - UK" },
+	{ "26202", "Vodafone" },
+	{ "001", "Test" },
+};
+
+static unsigned char *build_table(size_t *len)
+{
+	struct str_table_builder *builder;
+	unsigned int i;
+
+	builder = str_table_builder_new();
+
+	for (i = 0; i < G_N_ELEMENTS(entries); i++)
+		g_assert(str_table_builder_add(builder, entries[i][0],
+							entries[i][1]));
+
+	g_assert(!str_table_builder_add(builder, "", "Empty"));
+	g_assert(!str_table_builder_add(builder, "3102a", "Letters"));
+	g_assert(!str_table_builder_add(builder, "12345678", "Too long"));
+
+	return str_table_builder_finish(builder, 0x1234567890ULL, len);
+}
+
+static void check_table(struct str_table *table)
+{
+	unsigned int i;
+
+	g_assert(table);
+	g_assert(str_table_get_size(table) == G_N_ELEMENTS(entries));
+	g_assert(str_table_get_stamp(table) == 0x1234567890ULL);
+
+	for (i = 0; i < G_N_ELEMENTS(entries); i++)
+		g_assert_cmpstr(str_table_lookup(table, entries[i][0]), ==,
+							entries[i][1]);
+
+	g_assert(str_table_lookup(table, "23415") ==
+				str_table_lookup(table, "26202"));
+
+	g_assert(str_table_lookup(table, "0310260") == NULL);
+	g_assert(str_table_lookup(table, "31027") == NULL);
+	g_assert(str_table_lookup(table, "99999") == NULL);
+	g_assert(str_table_lookup(table, "") == NULL);
+	g_assert(str_table_lookup(table, "abc") == NULL);
+}
+
+static void test_lookup(void)
+{
+	struct str_table *table;
+	unsigned char *data;
+	size_t len;
+
+	data = build_table(&len);
+	table = str_table_new(data, len);
+
+	check_table(table);
+
+	str_table_free(table);
+}
+
+static void test_replace(void)
+{
+	struct str_table_builder *builder;
+	struct str_table *table;
+	unsigned char *data;
+	size_t len;
+
+	builder = str_table_builder_new();
+	str_table_builder_add(builder, "23410", "First");
+	str_table_builder_add(builder, "23410", "Second");
+
+	data = str_table_builder_finish(builder, 0, &len);
+	table = str_table_new(data, len);
+
+	g_assert(table);
+	g_assert(str_table_get_size(table) == 1);
+	g_assert_cmpstr(str_table_lookup(table, "23410"), ==, "Second");
+
+	str_table_free(table);
+}
+
+static void test_empty(void)
+{
+	struct str_table *table;
+	unsigned char *data;
+	size_t len;
+
+	data = str_table_builder_finish(str_table_builder_new(), 0, &len);
+	table = str_table_new(data, len);
+
+	g_assert(table);
+	g_assert(str_table_get_size(table) == 0);
+	g_assert(str_table_lookup(table, "23410") == NULL);
+
+	str_table_free(table);
+}
+
+static void test_invalid(void)
+{
+	unsigned char *data;
+	size_t len;
+
+	data = build_table(&len);
+
+	/* Truncated pool */
+	g_assert(str_table_new(g_memdup(data, len), len - 1) == NULL);
+
+	/* Truncated header */
+	g_assert(str_table_new(g_memdup(data, len), 8) == NULL);
+
+	/* Bad magic */
+	data[0] ^= 0xff;
+	g_assert(str_table_new(g_memdup(data, len), len) == NULL);
+	data[0] ^= 0xff;
+
+	/* Unterminated pool */
+	data[len - 1] = 'x';
+	g_assert(str_table_new(g_memdup(data, len), len) == NULL);
+	data[len - 1] = '\0';
+
+	/* Keys out of order */
+	memcpy(data + 24, data + 32, 4);
+	g_assert(str_table_new(data, len) == NULL);
+}
+
+static void test_open(void)
+{
+	struct str_table *table;
+	unsigned char *data;
+	char *path;
+	size_t len;
+	int fd;
+
+	fd = g_file_open_tmp("test-strtable-XXXXXX", &path, NULL);
+	g_assert(fd >= 0);
+
+	data = build_table(&len);
+	g_assert(write(fd, data, len) == (ssize_t) len);
+	close(fd);
+	g_free(data);
+
+	table = str_table_open(path);
+	check_table(table);
+	str_table_free(table);
+
+	g_assert(truncate(path, 0) == 0);
+	g_assert(str_table_open(path) == NULL);
+
+	unlink(path);
+	g_free(path);
+
+	g_assert(str_table_open("/nonexistent/strtable") == NULL);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/teststrtable/lookup", test_lookup);
+	g_test_add_func("/teststrtable/replace", test_replace);
+	g_test_add_func("/teststrtable/empty", test_empty);
+	g_test_add_func("/teststrtable/invalid", test_invalid);
+	g_test_add_func("/teststrtable/open", test_open);
+
+	return g_test_run();
+}
@@ -0,0 +1,236 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "timerwheel.h"
+
+struct test_timer {
+	unsigned int id;
+	unsigned int timeout;
+	unsigned int slack;
+	gint64 start;
+	gint64 fired;
+	int count;
+	int repeat;
+};
+
+static gint64 now;
+static int pending;
+static GSList *fired;
+
+static gint64 test_clock(void)
+{
+	return now;
+}
+
+static gboolean timer_cb(gpointer user_data)
+{
+	struct test_timer *t = user_data;
+
+	/* Never early, and late by at most the slack plus one 16ms tick */
+	g_assert(now - t->start >= t->timeout * 1000);
+	g_assert(now - t->start < (t->timeout + t->slack + 16) * 1000);
+
+	t->fired = now;
+	t->start = now;
+	t->count += 1;
+
+	if (t->count < t->repeat)
+		return TRUE;
+
+	fired = g_slist_append(fired, t);
+
+	pending -= 1;
+
+	return FALSE;
+}
+
+static void timer_start(struct test_timer *t, unsigned int timeout,
+							unsigned int slack)
+{
+	t->timeout = timeout;
+	t->slack = slack;
+	t->start = now;
+	t->id = timer_wheel_add(timeout, slack, timer_cb, t);
+
+	g_assert(t->id != 0);
+
+	pending += 1;
+}
+
+static void run_until_fired(void)
+{
+	while (pending > 0) {
+		gint64 wakeup = timer_wheel_next_wakeup();
+
+		g_assert(wakeup >= now);
+
+		now = wakeup;
+		timer_wheel_dispatch();
+	}
+}
+
+static void test_order(void)
+{
+	struct test_timer t[3] = { };
+
+	timer_start(&t[0], 60, 0);
+	timer_start(&t[1], 20, 0);
+	timer_start(&t[2], 40, 0);
+
+	run_until_fired();
+
+	g_assert(g_slist_nth_data(fired, 0) == &t[1]);
+	g_assert(g_slist_nth_data(fired, 1) == &t[2]);
+	g_assert(g_slist_nth_data(fired, 2) == &t[0]);
+
+	g_slist_free(fired);
+	fired = NULL;
+}
+
+static void test_repeat(void)
+{
+	struct test_timer t = { .repeat = 3 };
+
+	timer_start(&t, 30, 0);
+
+	run_until_fired();
+
+	g_assert(t.count == 3);
+
+	/* Already gone once the callback returned FALSE */
+	g_assert(timer_wheel_remove(t.id) == FALSE);
+
+	g_slist_free(fired);
+	fired = NULL;
+}
+
+static void test_remove(void)
+{
+	struct test_timer t[2] = { };
+
+	timer_start(&t[0], 20, 0);
+	timer_start(&t[1], 40, 0);
+
+	g_assert(timer_wheel_remove(t[0].id) == TRUE);
+	g_assert(timer_wheel_remove(t[0].id) == FALSE);
+	pending -= 1;
+
+	run_until_fired();
+
+	g_assert(t[0].count == 0);
+	g_assert(t[1].count == 1);
+
+	g_slist_free(fired);
+	fired = NULL;
+}
+
+static gboolean remove_self_cb(gpointer user_data)
+{
+	struct test_timer *t = user_data;
+
+	t->count += 1;
+
+	g_assert(timer_wheel_remove(t->id) == TRUE);
+
+	pending -= 1;
+
+	/* Must not be rearmed after being removed */
+	return TRUE;
+}
+
+static void test_remove_self(void)
+{
+	struct test_timer t = { };
+	struct test_timer other = { };
+
+	t.id = timer_wheel_add(10, 0, remove_self_cb, &t);
+	pending += 1;
+
+	/* Keeps the loop running past a possible rearm of the first one */
+	timer_start(&other, 100, 0);
+
+	run_until_fired();
+
+	g_assert(t.count == 1);
+	g_assert(other.count == 1);
+
+	g_slist_free(fired);
+	fired = NULL;
+}
+
+static void test_long(void)
+{
+	struct test_timer t = { };
+
+	/* Beyond the range of the first level of the wheel */
+	timer_start(&t, 1200, 0);
+
+	run_until_fired();
+
+	g_assert(t.count == 1);
+
+	g_slist_free(fired);
+	fired = NULL;
+}
+
+static void test_slack(void)
+{
+	struct test_timer t[2] = { };
+
+	timer_start(&t[0], 10, 1000);
+	timer_start(&t[1], 10, 1000);
+
+	run_until_fired();
+
+	/* Dispatched together */
+	g_assert(t[0].fired == t[1].fired);
+
+	g_slist_free(fired);
+	fired = NULL;
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	g_test_init(&argc, &argv, NULL);
+
+	/* Any start value, the wheel only looks at differences */
+	now = 1000000;
+	timer_wheel_set_clock(test_clock);
+
+	g_test_add_func("/testtimerwheel/order", test_order);
+	g_test_add_func("/testtimerwheel/repeat", test_repeat);
+	g_test_add_func("/testtimerwheel/remove", test_remove);
+	g_test_add_func("/testtimerwheel/remove_self", test_remove_self);
+	g_test_add_func("/testtimerwheel/long", test_long);
+	g_test_add_func("/testtimerwheel/slack", test_slack);
+
+	ret = g_test_run();
+
+	timer_wheel_cleanup();
+
+	return ret;
+}